@@ -0,0 +1,44 @@
+
+TEMPLATE = app
+
+exists(config.pri) {
+    include(config.pri)
+}
+
+!exists(config.pri) {
+    include(noconfig.pri)
+}
+
+include(base.pri)
+
+# Headless: only svcore (in libbase) is linked, never svgui or the
+# svapp framework, so this can run where there is no display
+CONFIG += console
+QT += network xml
+QT -= gui
+
+win32-x-g++:QMAKE_LFLAGS += -Wl,-subsystem,console
+macx*: CONFIG -= app_bundle
+
+TARGET = sv-batch
+
+!win32 {
+    PRE_TARGETDEPS += $$PWD/libbase.a
+}
+
+linux* {
+    batch_bins.path = $$PREFIX_PATH/bin/
+    batch_bins.files = sv-batch
+    batch_bins.CONFIG = no_check_exist executable
+    INSTALLS += batch_bins
+}
+
+OBJECTS_DIR = o
+MOC_DIR = o
+
+HEADERS += \
+        batch/BatchJob.h
+
+SOURCES += \
+        batch/BatchJob.cpp \
+        batch/main.cpp
@@ -0,0 +1,610 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "BatchJob.h"
+
+#include "base/BaseTypes.h"
+#include "base/Debug.h"
+#include "base/NoteExportable.h"
+#include "base/TempWriteFile.h"
+#include "base/Exceptions.h"
+#include "base/XmlExportable.h"
+
+#include "data/fileio/FileSource.h"
+#include "data/fileio/BZipFileDevice.h"
+#include "data/fileio/CSVFileWriter.h"
+#include "data/fileio/MIDIFileWriter.h"
+
+#include "data/model/ReadOnlyWaveFileModel.h"
+#include "data/model/SparseOneDimensionalModel.h"
+#include "data/model/SparseTimeValueModel.h"
+#include "data/model/NoteModel.h"
+#include "data/model/RegionModel.h"
+#include "data/model/TextModel.h"
+#include "data/model/BoxModel.h"
+#include "data/model/DenseThreeDimensionalModel.h"
+
+#include "rdf/RDFExporter.h"
+
+#include "plugin/RealTimePluginFactory.h"
+
+#include "transform/TransformFactory.h"
+#include "transform/FeatureExtractionModelTransformer.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QDir>
+#include <QThread>
+#include <QTextStream>
+#include <QTextCodec>
+#include <QDomDocument>
+#include <QRegExp>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <algorithm>
+#include <iostream>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+BatchJob::BatchJob(QString path, const Options &options, Result &result) :
+    m_path(path),
+    m_options(options),
+    m_result(result)
+{
+    m_result.path = path;
+}
+
+BatchJob::~BatchJob()
+{
+    releaseModels();
+}
+
+bool
+BatchJob::isSessionFile(QString path)
+{
+    return QFileInfo(path).suffix().toLower() == "sv";
+}
+
+void
+BatchJob::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    try {
+        m_result.ok = process();
+    } catch (const std::exception &e) {
+        m_result.error = e.what();
+        m_result.ok = false;
+    }
+
+    releaseModels();
+
+    m_result.seconds = double(timer.nsecsElapsed()) / 1e9;
+
+    report();
+}
+
+void
+BatchJob::report()
+{
+    // One tab-separated line per file on stdout, so that a job's
+    // timings can be collected by whatever runs it; diagnostics go
+    // to stderr
+
+    static QMutex mutex;
+    QMutexLocker locker(&mutex);
+
+    for (const auto &w: m_result.warnings) {
+        cerr << m_path << ": warning: " << w << endl;
+    }
+    if (!m_result.ok && m_result.error != "") {
+        cerr << m_path << ": error: " << m_result.error << endl;
+    }
+
+    cout << QString::number(m_result.seconds, 'f', 3) << "\t"
+         << (m_result.ok ? "ok" : "failed") << "\t"
+         << m_result.written.size() << "\t"
+         << m_path << endl;
+}
+
+// Models and transformers created on this thread deliver some of
+// their notifications through queued signals, so we must service
+// this thread's events while we wait for them
+
+static void
+waitForModel(ModelId modelId)
+{
+    auto model = ModelById::get(modelId);
+    if (!model) return;
+    int completion = 0;
+    while (!model->isReady(&completion)) {
+        QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+        QThread::msleep(20);
+    }
+}
+
+bool
+BatchJob::process()
+{
+    QString audioPath = m_path;
+    std::vector<Derivation> derivations;
+
+    if (isSessionFile(m_path)) {
+        if (!readSession(m_path, audioPath, derivations)) {
+            return false;
+        }
+    }
+
+    audioPath = QFileInfo(audioPath).absoluteFilePath();
+
+    FileSource source(audioPath);
+    source.waitForData();
+    if (!source.isAvailable() || !source.isOK()) {
+        m_result.error = QString("Failed to open audio file \"%1\": %2")
+            .arg(audioPath).arg(source.getErrorString());
+        return false;
+    }
+
+    auto model = std::make_shared<ReadOnlyWaveFileModel>(source);
+    if (!model->isOK()) {
+        m_result.error = QString("Failed to read audio file \"%1\"")
+            .arg(audioPath);
+        return false;
+    }
+    model->setObjectName(QFileInfo(audioPath).completeBaseName());
+
+    sv_samplerate_t rate = model->getSampleRate();
+
+    ModelId inputId = ModelById::add(model);
+    m_models.push_back(inputId);
+
+    for (const auto &t: m_options.transforms) {
+        derivations.push_back({ t, -1 });
+    }
+
+    auto factory = TransformFactory::getInstance();
+    for (const auto &id: m_options.defaultTransforms) {
+        if (!factory->haveTransform(id)) {
+            m_result.warnings.push_back
+                (QString("Unknown transform \"%1\", skipping").arg(id));
+            continue;
+        }
+        derivations.push_back({ factory->getDefaultTransformFor(id, rate), -1 });
+    }
+
+    waitForModel(inputId);
+
+    std::vector<Output> outputs;
+    if (!runTransforms(inputId, derivations, outputs)) {
+        return false;
+    }
+
+    bool ok = true;
+
+    for (const auto &output: outputs) {
+        if (!writeOutput(output)) ok = false;
+    }
+
+    if (m_options.writers & SessionWriter) {
+        if (!writeSession(inputId, outputs)) ok = false;
+    }
+
+    return ok;
+}
+
+bool
+BatchJob::readSession(QString sessionPath, QString &audioPath,
+                      std::vector<Derivation> &derivations)
+{
+    BZipFileDevice bzFile(sessionPath);
+    if (!bzFile.open(QIODevice::ReadOnly)) {
+        m_result.error = QString("Failed to open session file \"%1\": %2")
+            .arg(sessionPath).arg(bzFile.errorString());
+        return false;
+    }
+
+    QDomDocument doc;
+    QString error;
+    int line = 0, column = 0;
+    bool parsed = doc.setContent(&bzFile, false, &error, &line, &column);
+    bzFile.close();
+
+    if (!parsed) {
+        m_result.error =
+            QString("Failed to parse session file \"%1\": %2 at line %3, column %4")
+            .arg(sessionPath).arg(error).arg(line).arg(column);
+        return false;
+    }
+
+    QDomElement data = doc.documentElement().firstChildElement("data");
+    QString mainModelId;
+
+    for (QDomElement elt = data.firstChildElement("model");
+         !elt.isNull(); elt = elt.nextSiblingElement("model")) {
+        if (elt.attribute("mainModel") == "true") {
+            mainModelId = elt.attribute("id");
+            audioPath = elt.attribute("file");
+            break;
+        }
+    }
+
+    if (audioPath == "") {
+        m_result.error = QString("Session file \"%1\" has no main audio file")
+            .arg(sessionPath);
+        return false;
+    }
+
+    // Resolve an audio file that is not where the session says by
+    // looking alongside the session file, as the GUI's file finder
+    // would before asking the user
+    if (!QFileInfo(audioPath).exists()) {
+        QDir sessionDir = QFileInfo(sessionPath).absoluteDir();
+        QString candidate = sessionDir.filePath(audioPath);
+        if (!QFileInfo(candidate).exists()) {
+            candidate = sessionDir.filePath(QFileInfo(audioPath).fileName());
+        }
+        if (QFileInfo(candidate).exists()) {
+            audioPath = candidate;
+        }
+    }
+
+    for (QDomElement elt = data.firstChildElement("derivation");
+         !elt.isNull(); elt = elt.nextSiblingElement("derivation")) {
+
+        // Derivations from models other than the main one (e.g. from
+        // an aggregate model) cannot be reproduced here
+        if (elt.attribute("source") != mainModelId) continue;
+
+        QDomElement transformElt = elt.firstChildElement("transform");
+        if (elt.attribute("type") != "transform" || transformElt.isNull()) {
+            m_result.warnings.push_back
+                (QString("Skipping old-style derivation of transform \"%1\"")
+                 .arg(elt.attribute("transform")));
+            continue;
+        }
+
+        QString xml;
+        QTextStream stream(&xml);
+        transformElt.save(stream, 0);
+        stream.flush();
+
+        Transform transform(xml);
+        if (transform.getErrorString() != "") {
+            m_result.warnings.push_back
+                (QString("Skipping unreadable transform: %1")
+                 .arg(transform.getErrorString()));
+            continue;
+        }
+
+        bool ok = false;
+        int channel = elt.attribute("channel").toInt(&ok);
+        if (!ok) channel = -1;
+
+        derivations.push_back({ transform, channel });
+    }
+
+    return true;
+}
+
+bool
+BatchJob::runTransforms(ModelId inputId,
+                        const std::vector<Derivation> &derivations,
+                        std::vector<Output> &outputs)
+{
+    // Transforms sharing an input channel and extent can be run by a
+    // single transformer, which reads the audio only once and shares
+    // FFTs between plugins
+
+    std::vector<std::vector<Derivation>> groups;
+
+    for (const auto &d: derivations) {
+
+        if (RealTimePluginFactory::instanceFor
+            (d.transform.getPluginIdentifier())) {
+            m_result.warnings.push_back
+                (QString("Skipping real-time effect transform \"%1\": "
+                         "only feature extraction is supported")
+                 .arg(d.transform.getIdentifier()));
+            continue;
+        }
+
+        bool found = false;
+        for (auto &g: groups) {
+            const Derivation &first = g[0];
+            if (first.channel == d.channel &&
+                first.transform.getStartTime() == d.transform.getStartTime() &&
+                first.transform.getDuration() == d.transform.getDuration()) {
+                g.push_back(d);
+                found = true;
+                break;
+            }
+        }
+        if (!found) {
+            groups.push_back({ d });
+        }
+    }
+
+    auto factory = TransformFactory::getInstance();
+
+    for (const auto &g: groups) {
+
+        Transforms transforms;
+        for (const auto &d: g) transforms.push_back(d.transform);
+
+        FeatureExtractionModelTransformer transformer
+            (ModelTransformer::Input(inputId, g[0].channel), transforms);
+
+        transformer.start();
+        while (!transformer.wait(50)) {
+            QCoreApplication::processEvents(QEventLoop::AllEvents, 50);
+        }
+
+        QString message = transformer.getMessage();
+
+        ModelTransformer::Models models = transformer.getOutputModels();
+        if (models.empty()) {
+            m_result.error = QString("Transform failed: %1").arg(message);
+            return false;
+        }
+        if (message != "") {
+            m_result.warnings.push_back(message);
+        }
+
+        for (int i = 0; in_range_for(models, i); ++i) {
+            m_models.push_back(models[i]);
+            const Derivation &d = g[in_range_for(g, i) ? i : 0];
+            auto model = ModelById::get(models[i]);
+            if (!model) continue;
+            model->setObjectName(factory->getTransformFriendlyName
+                                 (d.transform.getIdentifier()));
+            outputs.push_back({ models[i], d, uniqueNameFor(d.transform) });
+        }
+
+        for (auto additional: transformer.getAdditionalOutputModels()) {
+            m_models.push_back(additional);
+            outputs.push_back({ additional, g[0], uniqueNameFor(g[0].transform) });
+        }
+    }
+
+    return true;
+}
+
+QString
+BatchJob::uniqueNameFor(const Transform &transform)
+{
+    QString base = QFileInfo(m_path).completeBaseName() + "_" +
+        transform.getIdentifier();
+    base.replace(QRegExp("[^A-Za-z0-9_.-]"), "_");
+
+    QString name = base;
+    for (int n = 2; m_usedNames.contains(name); ++n) {
+        name = QString("%1_%2").arg(base).arg(n);
+    }
+    m_usedNames.insert(name);
+    return name;
+}
+
+QString
+BatchJob::outputPathFor(QString name, QString extension)
+{
+    QDir dir = (m_options.outputDirectory != "" ?
+                QDir(m_options.outputDirectory) :
+                QFileInfo(m_path).absoluteDir());
+    return dir.filePath(name + "." + extension);
+}
+
+bool
+BatchJob::writeOutput(const Output &output)
+{
+    auto model = ModelById::get(output.model);
+    if (!model) return false;
+
+    bool ok = true;
+
+    if (m_options.writers & CSVWriter) {
+        QString path = outputPathFor(output.name, "csv");
+        CSVFileWriter writer(path, model.get());
+        writer.write();
+        if (writer.isOK()) {
+            m_result.written.push_back(path);
+        } else {
+            m_result.warnings.push_back(writer.getError());
+            ok = false;
+        }
+    }
+
+    if ((m_options.writers & RDFWriter) &&
+        RDFExporter::canExportModel(model.get())) {
+        QString path = outputPathFor(output.name, "n3");
+        RDFExporter writer(path, model.get());
+        writer.write();
+        if (writer.isOK()) {
+            m_result.written.push_back(path);
+        } else {
+            m_result.warnings.push_back(writer.getError());
+            ok = false;
+        }
+    }
+
+    NoteExportable *exportable = dynamic_cast<NoteExportable *>(model.get());
+    if ((m_options.writers & MIDIWriter) && exportable) {
+        QString path = outputPathFor(output.name, "mid");
+        MIDIFileWriter writer(path, exportable, model->getSampleRate());
+        writer.write();
+        if (writer.isOK()) {
+            m_result.written.push_back(path);
+        } else {
+            m_result.warnings.push_back(writer.getError());
+            ok = false;
+        }
+    }
+
+    return ok;
+}
+
+static QString
+layerTypeFor(ModelId modelId)
+{
+    // These are the names LayerFactory uses for the default layer
+    // type of each model type. We don't link the GUI library, so
+    // can't ask it
+    if (ModelById::isa<SparseOneDimensionalModel>(modelId)) return "timeinstants";
+    if (ModelById::isa<SparseTimeValueModel>(modelId)) return "timevalues";
+    if (ModelById::isa<NoteModel>(modelId)) return "notes";
+    if (ModelById::isa<RegionModel>(modelId)) return "regions";
+    if (ModelById::isa<TextModel>(modelId)) return "text";
+    if (ModelById::isa<BoxModel>(modelId)) return "boxes";
+    if (ModelById::isa<DenseThreeDimensionalModel>(modelId)) return "colour3dplot";
+    return "";
+}
+
+bool
+BatchJob::writeSession(ModelId inputId, const std::vector<Output> &outputs)
+{
+    auto input = ModelById::get(inputId);
+    if (!input) return false;
+
+    QString path = outputPathFor(QFileInfo(m_path).completeBaseName() +
+                                 (isSessionFile(m_path) ? "_batch" : ""),
+                                 "sv");
+
+    // A layer id only needs to be unique among the objects in the
+    // session, so we number layers on from the highest model id
+    int nextLayerId = input->getExportId();
+    for (const auto &output: outputs) {
+        auto model = ModelById::get(output.model);
+        if (model) nextLayerId = std::max(nextLayerId, model->getExportId());
+    }
+    ++nextLayerId;
+
+    struct LayerRec {
+        int id;
+        QString type;
+        QString name;
+        int model;
+    };
+    std::vector<LayerRec> layers;
+    layers.push_back({ nextLayerId++, "waveform", input->objectName(),
+                       input->getExportId() });
+
+    try {
+
+        TempWriteFile temp(path);
+
+        BZipFileDevice bzFile(temp.getTemporaryFilename());
+        if (!bzFile.open(QIODevice::WriteOnly)) {
+            m_result.warnings.push_back
+                (QString("Failed to open session file \"%1\" for writing: %2")
+                 .arg(temp.getTemporaryFilename()).arg(bzFile.errorString()));
+            return false;
+        }
+
+        QTextStream out(&bzFile);
+        out.setCodec(QTextCodec::codecForName("UTF-8"));
+
+        out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n";
+        out << "<!DOCTYPE sonic-visualiser>\n";
+        out << "<sv>\n";
+        out << "<data>\n";
+
+        input->toXml(out, "  ", "mainModel=\"true\"");
+
+        for (const auto &output: outputs) {
+
+            auto model = ModelById::get(output.model);
+            if (!model) continue;
+
+            QString type = layerTypeFor(output.model);
+            if (type == "") continue;
+
+            // As in Document, dense models are not streamed but
+            // regenerated from their derivation on load
+            if (!ModelById::isa<DenseThreeDimensionalModel>(output.model)) {
+                model->toXml(out, "  ");
+            }
+
+            out << QString("  <derivation type=\"transform\" source=\"%1\" "
+                           "model=\"%2\" channel=\"%3\">\n")
+                .arg(input->getExportId())
+                .arg(model->getExportId())
+                .arg(output.derivation.channel);
+            output.derivation.transform.toXml(out, "    ");
+            out << "  </derivation>\n";
+
+            layers.push_back({ nextLayerId++, type, model->objectName(),
+                               model->getExportId() });
+        }
+
+        for (const auto &layer: layers) {
+            out << QString("  <layer id=\"%1\" type=\"%2\" name=\"%3\" model=\"%4\"/>\n")
+                .arg(layer.id)
+                .arg(layer.type)
+                .arg(XmlExportable::encodeEntities(layer.name))
+                .arg(layer.model);
+        }
+
+        out << "</data>\n";
+        out << "<display>\n";
+
+        // One pane for the waveform and one for each output
+        for (const auto &layer: layers) {
+            out << "  <view type=\"pane\" centre=\"0\" zoom=\"1024\" "
+                   "followPan=\"1\" followZoom=\"1\" tracking=\"page\" "
+                   "centreLineVisible=\"1\">\n";
+            out << QString("    <layer id=\"%1\" type=\"%2\" name=\"%3\" model=\"%4\" visible=\"true\"/>\n")
+                .arg(layer.id)
+                .arg(layer.type)
+                .arg(XmlExportable::encodeEntities(layer.name))
+                .arg(layer.model);
+            out << "  </view>\n";
+        }
+
+        out << "</display>\n";
+        out << "</sv>\n";
+        out.flush();
+        bzFile.close();
+
+        if (!bzFile.isOK()) {
+            m_result.warnings.push_back
+                (QString("Failed to write session file \"%1\": %2")
+                 .arg(path).arg(bzFile.errorString()));
+            return false;
+        }
+
+        temp.moveToTarget();
+        m_result.written.push_back(path);
+        return true;
+
+    } catch (const FileOperationFailed &f) {
+        m_result.warnings.push_back
+            (QString("Failed to write session file \"%1\": %2")
+             .arg(path).arg(f.what()));
+        return false;
+    }
+}
+
+void
+BatchJob::releaseModels()
+{
+    // Release outputs before the input they were derived from
+    for (auto i = m_models.rbegin(); i != m_models.rend(); ++i) {
+        ModelById::release(*i);
+    }
+    m_models.clear();
+}
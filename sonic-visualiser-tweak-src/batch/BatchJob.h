@@ -0,0 +1,126 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_BATCH_JOB_H
+#define SV_BATCH_JOB_H
+
+#include "transform/Transform.h"
+#include "data/model/Model.h"
+
+#include <QRunnable>
+#include <QString>
+#include <QStringList>
+#include <QSet>
+
+#include <vector>
+
+/**
+ * Analyse a single audio file or session without any GUI: load the
+ * audio, run a set of feature extraction transforms on it, and write
+ * the resulting models out in one or more formats. BatchJob is a
+ * QRunnable so that sv-batch can run many of them at once on a
+ * QThreadPool.
+ *
+ * If the input is a session (.sv) file, its main audio file is
+ * analysed and the transforms that derived models from it in the
+ * session are run again, in addition to any transforms given in the
+ * options.
+ *
+ * Every model and object the job creates belongs to the job's own
+ * thread and is released before run() returns. When the job ends it
+ * prints a line to stdout with its time in seconds, its status, the
+ * number of files written, and the input path, separated by tabs.
+ */
+class BatchJob : public QRunnable
+{
+public:
+    enum Writer {
+        CSVWriter = 0x1,
+        RDFWriter = 0x2,
+        MIDIWriter = 0x4,
+        SessionWriter = 0x8
+    };
+    typedef int Writers;
+
+    struct Options {
+        /// Transforms given in full, e.g. loaded from XML files
+        Transforms transforms;
+
+        /// Transforms to be run with default parameters, which are
+        /// only resolved once the sample rate of the input is known
+        std::vector<TransformId> defaultTransforms;
+
+        Writers writers = CSVWriter;
+
+        /// Directory for output files; if empty, each output is
+        /// written alongside its input
+        QString outputDirectory;
+    };
+
+    struct Result {
+        QString path;
+        bool ok = false;
+        QString error;
+        QStringList warnings;
+        QStringList written;
+        double seconds = 0.0;
+    };
+
+    /**
+     * Construct a job for the given input file. The result will be
+     * filled in when the job is run, and must outlive it.
+     */
+    BatchJob(QString path, const Options &options, Result &result);
+    virtual ~BatchJob();
+
+    void run() override;
+
+    static bool isSessionFile(QString path);
+
+private:
+    struct Derivation {
+        Transform transform;
+        int channel;
+    };
+
+    struct Output {
+        ModelId model;
+        Derivation derivation;
+        QString name;
+    };
+
+    QString m_path;
+    Options m_options;
+    Result &m_result;
+
+    std::vector<ModelId> m_models;
+    QSet<QString> m_usedNames;
+
+    bool process();
+    bool readSession(QString sessionPath, QString &audioPath,
+                     std::vector<Derivation> &derivations);
+    bool runTransforms(ModelId input,
+                       const std::vector<Derivation> &derivations,
+                       std::vector<Output> &outputs);
+    bool writeOutput(const Output &output);
+    bool writeSession(ModelId input, const std::vector<Output> &outputs);
+
+    void report();
+
+    QString outputPathFor(QString name, QString extension);
+    QString uniqueNameFor(const Transform &transform);
+    void releaseModels();
+};
+
+#endif
@@ -0,0 +1,230 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+/*
+   sv-batch: run Sonic Visualiser transforms over many audio files
+   or sessions without a GUI, writing CSV, RDF, MIDI or session
+   files.
+
+   Each input is analysed by a BatchJob, and the jobs run on a
+   thread pool. Only svcore is used, so no display or audio device
+   is needed.
+*/
+
+#include "BatchJob.h"
+
+#include "system/Init.h"
+#include "base/Debug.h"
+#include "base/TempDirectory.h"
+#include "plugin/PluginScan.h"
+#include "plugin/PluginPathSetter.h"
+#include "transform/TransformFactory.h"
+
+#include "../version.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QThreadPool>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QDir>
+
+#include <iostream>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+int
+main(int argc, char **argv)
+{
+    svSystemSpecificInitialisation();
+
+    QCoreApplication application(argc, argv);
+
+    QCoreApplication::setOrganizationName("sonic-visualiser");
+    QCoreApplication::setOrganizationDomain("sonicvisualiser.org");
+    QCoreApplication::setApplicationName("Sonic Visualiser");
+    QCoreApplication::setApplicationVersion(SV_VERSION);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription
+        ("\nRun Sonic Visualiser transforms over audio files or session (.sv) files\n"
+         "without a GUI. For a session, the transforms it was built with are run\n"
+         "again on its main audio file, along with any given here.");
+    parser.addHelpOption();
+    parser.addVersionOption();
+
+    QCommandLineOption transformOption
+        ({ "t", "transform" },
+         "Run the transform described in the given XML file. May be repeated.",
+         "file.xml");
+    QCommandLineOption defaultOption
+        ({ "d", "default" },
+         "Run the transform with the given identifier, with default parameters. "
+         "May be repeated.",
+         "id");
+    QCommandLineOption writerOption
+        ({ "w", "writer" },
+         "Write outputs in the given format: csv, rdf, midi or sv. "
+         "May be repeated. The default is csv.",
+         "format");
+    QCommandLineOption outputOption
+        ({ "o", "output-dir" },
+         "Write outputs to the given directory instead of alongside each input.",
+         "dir");
+    QCommandLineOption jobsOption
+        ({ "j", "jobs" },
+         "Process at most the given number of files at once. The default is "
+         "the number of processor cores.",
+         "n");
+    QCommandLineOption listOption
+        ("list", "List the identifiers of the available transforms and exit.");
+
+    parser.addOption(transformOption);
+    parser.addOption(defaultOption);
+    parser.addOption(writerOption);
+    parser.addOption(outputOption);
+    parser.addOption(jobsOption);
+    parser.addOption(listOption);
+    parser.addPositionalArgument("files", "Audio or session files to process.",
+                                 "[files...]");
+
+    parser.process(application);
+
+    PluginPathSetter::initialiseEnvironmentVariables();
+    PluginScan::getInstance()->scan();
+
+    // Populate the transform list here, before any job can ask for
+    // it from its own thread
+    TransformFactory *factory = TransformFactory::getInstance();
+    TransformList descriptions = factory->getAllTransformDescriptions();
+
+    if (parser.isSet(listOption)) {
+        for (const auto &d: descriptions) {
+            if (d.type == TransformDescription::Analysis) {
+                cout << d.identifier << endl;
+            }
+        }
+        TransformFactory::deleteInstance();
+        return 0;
+    }
+
+    BatchJob::Options options;
+
+    for (QString path: parser.values(transformOption)) {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            cerr << "sv-batch: Failed to open transform file \"" << path
+                 << "\": " << file.errorString() << endl;
+            return 2;
+        }
+        Transform transform(QString::fromUtf8(file.readAll()));
+        if (transform.getErrorString() != "") {
+            cerr << "sv-batch: Failed to read transform file \"" << path
+                 << "\": " << transform.getErrorString() << endl;
+            return 2;
+        }
+        options.transforms.push_back(transform);
+    }
+
+    for (QString id: parser.values(defaultOption)) {
+        options.defaultTransforms.push_back(id);
+    }
+
+    if (parser.isSet(writerOption)) {
+        options.writers = 0;
+        for (QString w: parser.values(writerOption)) {
+            w = w.toLower();
+            if (w == "csv") options.writers |= BatchJob::CSVWriter;
+            else if (w == "rdf" || w == "n3") options.writers |= BatchJob::RDFWriter;
+            else if (w == "midi" || w == "mid") options.writers |= BatchJob::MIDIWriter;
+            else if (w == "sv") options.writers |= BatchJob::SessionWriter;
+            else {
+                cerr << "sv-batch: Unknown writer \"" << w << "\"" << endl;
+                return 2;
+            }
+        }
+    }
+
+    if (parser.isSet(outputOption)) {
+        options.outputDirectory = parser.value(outputOption);
+        if (!QDir().mkpath(options.outputDirectory)) {
+            cerr << "sv-batch: Failed to create output directory \""
+                 << options.outputDirectory << "\"" << endl;
+            return 2;
+        }
+    }
+
+    QStringList files = parser.positionalArguments();
+    if (files.empty()) {
+        parser.showHelp(2);
+    }
+
+    if (options.transforms.empty() && options.defaultTransforms.empty()) {
+        bool haveSession = false;
+        for (QString f: files) {
+            if (BatchJob::isSessionFile(f)) haveSession = true;
+        }
+        if (!haveSession) {
+            cerr << "sv-batch: No transforms given (use -t or -d)" << endl;
+            return 2;
+        }
+    }
+
+    int jobs = QThread::idealThreadCount();
+    if (parser.isSet(jobsOption)) {
+        bool ok = false;
+        jobs = parser.value(jobsOption).toInt(&ok);
+        if (!ok || jobs < 1) {
+            cerr << "sv-batch: Invalid job count \""
+                 << parser.value(jobsOption) << "\"" << endl;
+            return 2;
+        }
+    }
+
+    // Results are filled in by the jobs, and each job has its own
+    // slot, so they need no locking
+    std::vector<BatchJob::Result> results(files.size());
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(jobs);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for (int i = 0; i < files.size(); ++i) {
+        pool.start(new BatchJob(files[i], options, results[i]));
+    }
+
+    pool.waitForDone();
+
+    double elapsed = double(timer.nsecsElapsed()) / 1e9;
+    double total = 0.0;
+    int failed = 0;
+    for (const auto &r: results) {
+        total += r.seconds;
+        if (!r.ok) ++failed;
+    }
+
+    cerr << "sv-batch: Processed " << files.size() << " file(s) in "
+         << elapsed << " sec (" << total << " sec across " << jobs
+         << " job(s)), " << failed << " failed" << endl;
+
+    TransformFactory::deleteInstance();
+    TempDirectory::getInstance()->cleanup();
+
+    return failed > 0 ? 1 : 0;
+}
@@ -88,6 +88,26 @@ public:
     void forwardPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut);
     void forwardMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut);
 
+    /**
+     * Carry out forwardInterleaved on each of count consecutive input
+     * frames. Frame i is read from realIn + i * realInStride and its
+     * result written to complexOut + i * complexOutStride. Strides
+     * are in elements (not complex values): realInStride must be at
+     * least getSize() and complexOutStride at least getSize() + 2.
+     *
+     * This is equivalent to calling forwardInterleaved count times.
+     * The FFTW implementation (in single precision) transforms the
+     * frames in batches through a single FFTW "many" plan, writing
+     * straight into the caller's output where alignment allows; the
+     * other implementations simply loop over the frames.
+     */
+    void forwardInterleavedMulti(const double *BQ_R__ realIn, int realInStride,
+                                 double *BQ_R__ complexOut, int complexOutStride,
+                                 int count);
+    void forwardInterleavedMulti(const float *BQ_R__ realIn, int realInStride,
+                                 float *BQ_R__ complexOut, int complexOutStride,
+                                 int count);
+
     void inverse(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut);
     void inverseInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ realOut);
     void inversePolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, double *BQ_R__ realOut);
@@ -146,6 +146,23 @@ public:
     virtual void forwardPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut) = 0;
     virtual void forwardMagnitude(const float *BQ_R__ realIn, float *BQ_R__ magOut) = 0;
 
+    virtual void forwardInterleavedMulti(const double *BQ_R__ realIn, int realInStride,
+                                         double *BQ_R__ complexOut, int complexOutStride,
+                                         int count) {
+        for (int i = 0; i < count; ++i) {
+            forwardInterleaved(realIn + i * realInStride,
+                               complexOut + i * complexOutStride);
+        }
+    }
+    virtual void forwardInterleavedMulti(const float *BQ_R__ realIn, int realInStride,
+                                         float *BQ_R__ complexOut, int complexOutStride,
+                                         int count) {
+        for (int i = 0; i < count; ++i) {
+            forwardInterleaved(realIn + i * realInStride,
+                               complexOut + i * complexOutStride);
+        }
+    }
+
     virtual void inverse(const double *BQ_R__ realIn, const double *BQ_R__ imagIn, double *BQ_R__ realOut) = 0;
     virtual void inverseInterleaved(const double *BQ_R__ complexIn, double *BQ_R__ realOut) = 0;
     virtual void inversePolar(const double *BQ_R__ magIn, const double *BQ_R__ phaseIn, double *BQ_R__ realOut) = 0;
@@ -1573,7 +1590,10 @@ class D_FFTW : public FFTImpl
 {
 public:
     D_FFTW(int size) :
-        m_fplanf(0), m_dplanf(0), m_size(size)
+        m_fplanf(0),
+        m_fplanMulti(0), m_fmultiIn(0), m_fmultiOut(0),
+        m_fmultiCount(0), m_fmultiInStride(0), m_fmultiOutStride(0),
+        m_dplanf(0), m_size(size)
     {
     }
 
@@ -1592,6 +1612,11 @@ public:
             fftwf_destroy_plan(m_fplani);
             fftwf_free(m_fbuf);
             fftwf_free(m_fpacked);
+            if (m_fplanMulti) {
+                fftwf_destroy_plan(m_fplanMulti);
+                fftwf_free(m_fmultiIn);
+                fftwf_free(m_fmultiOut);
+            }
             unlock();
         }
         if (m_dplanf) {
@@ -1901,6 +1926,106 @@ public:
         v_convert(complexOut, (fft_float_type *)m_fpacked, sz + 2);
     }
 
+#ifndef FFTW_DOUBLE_ONLY
+    void forwardInterleavedMulti(const float *BQ_R__ realIn, int realInStride,
+                                 float *BQ_R__ complexOut, int complexOutStride,
+                                 int count) {
+        if (!m_fplanf) initFloat();
+
+        // Frames are transformed in batches through a single plan
+        // made with fftwf_plan_many_dft_r2c, for the batch size and
+        // strides of the first call. It is remade only when a call
+        // asks for a larger batch or different strides, so any frames
+        // left over after whole batches are transformed singly. An
+        // odd output stride does not fit the plan's complex output,
+        // so is handled singly too.
+
+        if (count > 1 && complexOutStride % 2 == 0 &&
+            (count > m_fmultiCount ||
+             realInStride != m_fmultiInStride ||
+             complexOutStride != m_fmultiOutStride)) {
+            initFloatMulti(count, realInStride, complexOutStride);
+        }
+
+        const int sz = m_size;
+        int i = 0;
+
+        if (m_fplanMulti &&
+            realInStride == m_fmultiInStride &&
+            complexOutStride == m_fmultiOutStride) {
+
+            const int batch = m_fmultiCount;
+            // The new-array execute function may write straight into
+            // the caller's output, saving a copy, provided that it has
+            // the same alignment as the array the plan was made with
+            const bool direct = (fftwf_alignment_of(complexOut) ==
+                                 fftwf_alignment_of((float *)m_fmultiOut));
+
+            for (; i + batch <= count; i += batch) {
+                for (int j = 0; j < batch; ++j) {
+                    v_copy(m_fmultiIn + j * realInStride,
+                           realIn + (i + j) * realInStride, sz);
+                }
+                float *out = complexOut + i * complexOutStride;
+                if (direct) {
+                    fftwf_execute_dft_r2c(m_fplanMulti, m_fmultiIn,
+                                          (fftwf_complex *)out);
+                } else {
+                    fftwf_execute(m_fplanMulti);
+                    for (int j = 0; j < batch; ++j) {
+                        v_copy(out + j * complexOutStride,
+                               (float *)m_fmultiOut + j * complexOutStride,
+                               sz + 2);
+                    }
+                }
+            }
+        }
+
+        fft_float_type *const BQ_R__ fbuf = m_fbuf;
+        for (; i < count; ++i) {
+            v_copy(fbuf, realIn + i * realInStride, sz);
+            fftwf_execute(m_fplanf);
+            v_copy(complexOut + i * complexOutStride,
+                   (fft_float_type *)m_fpacked, sz + 2);
+        }
+    }
+
+    void initFloatMulti(int count, int realInStride, int complexOutStride) {
+        lock();
+        if (m_fplanMulti) {
+            fftwf_destroy_plan(m_fplanMulti);
+            fftwf_free(m_fmultiIn);
+            fftwf_free(m_fmultiOut);
+        }
+        int n = m_size;
+        m_fmultiIn = (float *)fftwf_malloc
+            (count * realInStride * sizeof(float));
+        m_fmultiOut = (fftwf_complex *)fftwf_malloc
+            (count * (complexOutStride / 2) * sizeof(fftwf_complex));
+        v_zero(m_fmultiIn, count * realInStride);
+#ifdef USE_FFTW_WISDOM
+        const unsigned flags = FFTW_MEASURE;
+#else
+        const unsigned flags = FFTW_ESTIMATE;
+#endif
+        m_fplanMulti = fftwf_plan_many_dft_r2c
+            (1, &n, count,
+             m_fmultiIn, 0, 1, realInStride,
+             m_fmultiOut, 0, 1, complexOutStride / 2,
+             flags);
+        m_fmultiCount = count;
+        m_fmultiInStride = realInStride;
+        m_fmultiOutStride = complexOutStride;
+        if (!m_fplanMulti) {
+            fftwf_free(m_fmultiIn);
+            fftwf_free(m_fmultiOut);
+            m_fmultiIn = 0;
+            m_fmultiOut = 0;
+        }
+        unlock();
+    }
+#endif
+
     void forwardPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut) {
         if (!m_fplanf) initFloat();
         fft_float_type *const BQ_R__ fbuf = m_fbuf;
@@ -2068,6 +2193,12 @@ private:
     float *m_fbuf;
 #endif
     fftwf_complex *m_fpacked;
+    fftwf_plan m_fplanMulti;
+    fft_float_type *m_fmultiIn;
+    fftwf_complex *m_fmultiOut;
+    int m_fmultiCount;
+    int m_fmultiInStride;
+    int m_fmultiOutStride;
     fftw_plan m_dplanf;
     fftw_plan m_dplani;
 #ifdef FFTW_SINGLE_ONLY
@@ -3509,6 +3640,34 @@ FFT::forwardInterleaved(const float *BQ_R__ realIn, float *BQ_R__ complexOut)
     d->forwardInterleaved(realIn, complexOut);
 }
 
+void
+FFT::forwardInterleavedMulti(const double *BQ_R__ realIn, int realInStride,
+                             double *BQ_R__ complexOut, int complexOutStride,
+                             int count)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(complexOut);
+    if (realInStride < getSize() || complexOutStride < getSize() + 2) {
+        throw InvalidSize;
+    }
+    d->forwardInterleavedMulti(realIn, realInStride,
+                               complexOut, complexOutStride, count);
+}
+
+void
+FFT::forwardInterleavedMulti(const float *BQ_R__ realIn, int realInStride,
+                             float *BQ_R__ complexOut, int complexOutStride,
+                             int count)
+{
+    CHECK_NOT_NULL(realIn);
+    CHECK_NOT_NULL(complexOut);
+    if (realInStride < getSize() || complexOutStride < getSize() + 2) {
+        throw InvalidSize;
+    }
+    d->forwardInterleavedMulti(realIn, realInStride,
+                               complexOut, complexOutStride, count);
+}
+
 void
 FFT::forwardPolar(const float *BQ_R__ realIn, float *BQ_R__ magOut, float *BQ_R__ phaseOut)
 {
@@ -722,4 +722,75 @@ ALL_IMPL_AUTO_TEST_CASE(sineCosine_7)
 }
 
 
+/*
+ * 6. Multiple-frame transforms, compared against the single-frame
+ *    transform of each frame
+ */
+
+ALL_IMPL_AUTO_TEST_CASE(interleavedMulti)
+{
+    // Three frames of 8, with input and output strides larger than
+    // the minimum
+    double in[30];
+    for (int i = 0; i < 30; ++i) in[i] = sin(i * 0.37) + (i % 3) * 0.25;
+    double multi[36];
+    for (int i = 0; i < 36; ++i) multi[i] = -1.0;
+    USING_FFT(8);
+    fft.forwardInterleavedMulti(in, 10, multi, 12, 3);
+    for (int f = 0; f < 3; ++f) {
+        double single[10];
+        fft.forwardInterleaved(in + f * 10, single);
+        for (int i = 0; i < 10; ++i) {
+            COMPARE(multi[f * 12 + i], single[i]);
+        }
+        // padding between output frames must be untouched
+        COMPARE(multi[f * 12 + 10], -1.0);
+        COMPARE(multi[f * 12 + 11], -1.0);
+    }
+}
+
+ALL_IMPL_AUTO_TEST_CASE(interleavedMulti_F)
+{
+    float in[24];
+    for (int i = 0; i < 24; ++i) in[i] = float(cos(i * 0.61)) - 0.5f;
+    float multi[30];
+    USING_FFT(8);
+    fft.forwardInterleavedMulti(in, 8, multi, 10, 3);
+    for (int f = 0; f < 3; ++f) {
+        float single[10];
+        fft.forwardInterleaved(in + f * 8, single);
+        for (int i = 0; i < 10; ++i) {
+            COMPARE_F(multi[f * 10 + i], single[i]);
+        }
+    }
+}
+
+ALL_IMPL_AUTO_TEST_CASE(interleavedMultiBatches_F)
+{
+    // Successive calls with varying counts and strides, which some
+    // implementations handle partly in batches and partly singly
+    float in[7 * 9];
+    for (int i = 0; i < 7 * 9; ++i) in[i] = float(sin(i * 0.23) * (i % 5));
+    USING_FFT(8);
+    const int counts[] = { 4, 6, 5, 7, 3 };
+    const int outStrides[] = { 10, 10, 10, 12, 11 };
+    for (int c = 0; c < 5; ++c) {
+        int count = counts[c];
+        int outStride = outStrides[c];
+        float multi[7 * 12];
+        for (int i = 0; i < 7 * 12; ++i) multi[i] = -1.f;
+        fft.forwardInterleavedMulti(in, 9, multi, outStride, count);
+        for (int f = 0; f < count; ++f) {
+            float single[10];
+            fft.forwardInterleaved(in + f * 9, single);
+            for (int i = 0; i < 10; ++i) {
+                COMPARE_F(multi[f * outStride + i], single[i]);
+            }
+            for (int i = 10; i < outStride; ++i) {
+                COMPARE_F(multi[f * outStride + i], -1.f);
+            }
+        }
+    }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -58,7 +58,8 @@ class KnownPluginCandidates
     
 public:
     KnownPluginCandidates(std::string helperExecutableName,
-                          PluginCandidates::LogCallback *cb = 0);
+                          PluginCandidates::LogCallback *cb = 0,
+                          PluginCandidates::ResultCache *cache = 0);
     
     std::vector<KnownPlugins::PluginType> getKnownPluginTypes() const {
         return m_known.getKnownPluginTypes();
@@ -68,6 +68,26 @@ public:
      */
     void setLogCallback(LogCallback *cb);
 
+    struct ResultCache {
+        virtual ~ResultCache() { }
+
+        /// Return true and set result to the helper output line
+        /// previously recorded for the given library, if it is still
+        /// valid
+        virtual bool lookup(std::string tag, std::string library,
+                            std::string &result) = 0;
+
+        /// Record the helper output line for the given library
+        virtual void store(std::string tag, std::string library,
+                           std::string result) = 0;
+    };
+
+    /** Set a cache of results from previous scans. Libraries found
+     *  in the cache are not passed to the helper, and the results
+     *  for any that are passed to it are stored in the cache.
+     */
+    void setResultCache(ResultCache *cache);
+
     /** Scan the libraries found in the given plugin path (i.e. list
      *  of plugin directories), checking that the given descriptor
      *  symbol can be looked up in each. Store the results
@@ -75,6 +95,9 @@ public:
      *  later querying using getCandidateLibrariesFor() and
      *  getFailedLibrariesFor().
      *
+     *  The libraries are shared out among several helper
+     *  processes, run at once.
+     *
      *  Not thread-safe.
      */
     void scan(std::string tag,
@@ -108,10 +131,15 @@ private:
     std::map<std::string, stringlist> m_candidates;
     std::map<std::string, std::vector<FailureRec> > m_failures;
     LogCallback *m_logCallback;
+    ResultCache *m_resultCache;
 
     stringlist getLibrariesInPath(stringlist path);
     std::string getHelperCompatibilityVersion();
     stringlist runHelper(stringlist libraries, std::string descriptor);
+    void checkLibraries(stringlist libraries, std::string descriptor,
+                        stringlist &reported, stringlist &unreported);
+    std::string getLibraryFor(std::string outputLine);
+    void storeResults(std::string tag, stringlist output);
     void recordResult(std::string tag, stringlist results);
     void logErrors(QProcess *);
     void log(std::string);
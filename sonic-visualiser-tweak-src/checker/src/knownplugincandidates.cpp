@@ -48,7 +48,8 @@ is32bit(string helperExecutableName)
 }
 
 KnownPluginCandidates::KnownPluginCandidates(string helperExecutableName,
-                                             PluginCandidates::LogCallback *cb) :
+                                             PluginCandidates::LogCallback *cb,
+                                             PluginCandidates::ResultCache *cache) :
     m_known(is32bit(helperExecutableName) ?
             KnownPlugins::FormatNonNative32Bit :
             KnownPlugins::FormatNative),
@@ -56,6 +57,7 @@ KnownPluginCandidates::KnownPluginCandidates(string helperExecutableName,
     m_helperExecutableName(helperExecutableName)
 {
     m_candidates.setLogCallback(cb);
+    m_candidates.setResultCache(cache);
 
     auto knownTypes = m_known.getKnownPluginTypes();
         
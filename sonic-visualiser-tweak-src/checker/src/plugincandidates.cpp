@@ -32,8 +32,13 @@
 #include "../version.h"
 
 #include <set>
+#include <map>
 #include <stdexcept>
 #include <iostream>
+#include <thread>
+#include <mutex>
+#include <exception>
+#include <algorithm>
 
 #include <QProcess>
 #include <QDir>
@@ -51,7 +56,8 @@ using namespace std;
 
 PluginCandidates::PluginCandidates(string helperExecutableName) :
     m_helper(helperExecutableName),
-    m_logCallback(nullptr)
+    m_logCallback(nullptr),
+    m_resultCache(nullptr)
 {
 }
 
@@ -61,6 +67,12 @@ PluginCandidates::setLogCallback(LogCallback *cb)
     m_logCallback = cb;
 }
 
+void
+PluginCandidates::setResultCache(ResultCache *cache)
+{
+    m_resultCache = cache;
+}
+
 vector<string>
 PluginCandidates::getCandidateLibrariesFor(string tag) const
 {
@@ -75,9 +87,13 @@ PluginCandidates::getFailedLibrariesFor(string tag) const
     else return m_failures.at(tag);
 }
 
+// Helpers are run from several threads at once during a scan
+static mutex logMutex;
+
 void
 PluginCandidates::log(string message)
 {
+    lock_guard<mutex> guard(logMutex);
     if (m_logCallback) {
         m_logCallback->log("PluginCandidates: " + message);
     } else {
@@ -114,41 +130,142 @@ PluginCandidates::scan(string tag,
                        vector<string> pluginPath,
                        string descriptorSymbolName)
 {
-    string helperVersion = getHelperCompatibilityVersion();
-    if (helperVersion != CHECKER_COMPATIBILITY_VERSION) {
-        log("Wrong plugin checker helper version found: expected v" +
-            string(CHECKER_COMPATIBILITY_VERSION) + ", found v" +
-            helperVersion);
-        throw runtime_error("wrong version of plugin load helper found");
+    vector<string> libraries = getLibrariesInPath(pluginPath);
+    vector<string> remaining;
+
+    map<string, string> results; // library -> helper output line
+
+    for (auto &lib: libraries) {
+        string cached;
+        if (m_resultCache && m_resultCache->lookup(tag, lib, cached)) {
+            results[lib] = cached;
+        } else {
+            remaining.push_back(lib);
+        }
     }
+
+    if (m_resultCache) {
+        log("Found cached results for " + to_string(results.size()) +
+            " of " + to_string(libraries.size()) + " libraries");
+    }
+
+    if (!remaining.empty()) {
     
-    vector<string> libraries = getLibrariesInPath(pluginPath);
+        string helperVersion = getHelperCompatibilityVersion();
+        if (helperVersion != CHECKER_COMPATIBILITY_VERSION) {
+            log("Wrong plugin checker helper version found: expected v" +
+                string(CHECKER_COMPATIBILITY_VERSION) + ", found v" +
+                helperVersion);
+            throw runtime_error("wrong version of plugin load helper found");
+        }
+
+        // Share the libraries out among a pool of helper processes,
+        // one per core but with enough libraries each to be worth
+        // starting a process for. Each helper checks its libraries
+        // in sequence, so a library that is slow to load, or hangs,
+        // holds up only the ones that follow it in the same helper.
+        
+        int helperCount = int(thread::hardware_concurrency());
+        int perHelper = 4;
+        helperCount = min(helperCount,
+                          int(remaining.size() + perHelper - 1) / perHelper);
+        if (helperCount < 1) helperCount = 1;
+
+        log("Checking " + to_string(remaining.size()) + " libraries using " +
+            to_string(helperCount) + " helper process(es)");
+        
+        vector<vector<string>> shares(helperCount);
+        for (size_t i = 0; i < remaining.size(); ++i) {
+            shares[i % helperCount].push_back(remaining[i]);
+        }
+
+        vector<vector<string>> reported(helperCount);
+        vector<vector<string>> unreported(helperCount);
+        vector<exception_ptr> errors(helperCount);
+        
+        vector<thread> threads;
+        for (int i = 0; i < helperCount; ++i) {
+            threads.push_back(thread([&, i]() {
+                        try {
+                            checkLibraries(shares[i], descriptorSymbolName,
+                                           reported[i], unreported[i]);
+                        } catch (...) {
+                            errors[i] = current_exception();
+                        }
+                    }));
+        }
+        for (auto &t: threads) {
+            t.join();
+        }
+        for (auto &e: errors) {
+            if (e) rethrow_exception(e);
+        }
+
+        for (int i = 0; i < helperCount; ++i) {
+            storeResults(tag, reported[i]);
+            for (auto &r: reported[i]) {
+                results[getLibraryFor(r)] = r;
+            }
+            for (auto &r: unreported[i]) {
+                results[getLibraryFor(r)] = r;
+            }
+        }
+    }
+
+    // Record in the order the libraries were found, as callers
+    // prefer earlier directories in the path
+
+    vector<string> result;
+    for (auto &lib: libraries) {
+        auto itr = results.find(lib);
+        if (itr != results.end()) {
+            result.push_back(itr->second);
+        } else {
+            log("No result found for library " + lib);
+        }
+    }
+    
+    recordResult(tag, result);
+}
+
+void
+PluginCandidates::checkLibraries(vector<string> libraries,
+                                 string descriptor,
+                                 vector<string> &reported,
+                                 vector<string> &unreported)
+{
     vector<string> remaining = libraries;
 
     int runlimit = 20;
     int runcount = 0;
     
-    vector<string> result;
-    
-    while (result.size() < libraries.size() && runcount < runlimit) {
-        vector<string> output = runHelper(remaining, descriptorSymbolName);
-        result.insert(result.end(), output.begin(), output.end());
+    while (!remaining.empty() && runcount < runlimit) {
+        vector<string> output = runHelper(remaining, descriptor);
+        reported.insert(reported.end(), output.begin(), output.end());
         int shortfall = int(remaining.size()) - int(output.size());
         if (shortfall > 0) {
             // Helper bailed out for some reason presumably associated
             // with the plugin following the last one it reported
             // on. Add a failure entry for that one and continue with
             // the following ones.
-            string failed = *(remaining.rbegin() + shortfall - 1);
+            string failed = *(remaining.end() - shortfall);
             log("Helper output ended before result for plugin " + failed);
-            result.push_back("FAILURE|" + failed + "|Plugin load check failed or timed out");
+            unreported.push_back("FAILURE|" + failed + "|Plugin load check failed or timed out");
             remaining = vector<string>
-                (remaining.rbegin(), remaining.rbegin() + shortfall - 1);
+                (remaining.end() - shortfall + 1, remaining.end());
+        } else {
+            remaining.clear();
         }
         ++runcount;
     }
+}
 
-    recordResult(tag, result);
+string
+PluginCandidates::getLibraryFor(string outputLine)
+{
+    QStringList bits = QString(outputLine.c_str()).split("|");
+    if (bits.size() < 2) return "";
+    return bits[1].trimmed().toStdString();
 }
 
 string
@@ -231,6 +348,10 @@ PluginCandidates::runHelper(vector<string> libraries, string descriptor)
         process.write("\n", 1);
     }
 
+    // The timeout applies to each library in turn: the clock is
+    // restarted whenever the helper reports a result, so a library
+    // that hangs is abandoned (and the helper killed and restarted
+    // after it) without holding up those that follow for long
     QTime t;
     t.start();
     int timeout = 15000; // ms
@@ -244,6 +365,7 @@ PluginCandidates::runHelper(vector<string> libraries, string descriptor)
         if (linelen > 0) {
             output.push_back(buf);
             done = (output.size() == libraries.size());
+            t.restart();
         } else if (linelen < 0) {
             // error case
             log("Received error code while reading from helper");
@@ -254,8 +376,8 @@ PluginCandidates::runHelper(vector<string> libraries, string descriptor)
             done = (process.state() == QProcess::NotRunning);
             if (!done) {
                 if (t.elapsed() > timeout) {
-                    // this is purely an emergency measure
-                    log("Timeout: helper took too long, killing it");
+                    log("Timeout: helper took too long over library " +
+                        libraries[output.size()] + ", killing it");
                     process.kill();
                     done = true;
                 } else {
@@ -299,6 +421,23 @@ PluginCandidates::logErrors(QProcess *p)
     p->setReadChannel(QProcess::StandardOutput);
 }
 
+void
+PluginCandidates::storeResults(string tag, vector<string> output)
+{
+    // Only results actually reported by the helper are stored: a
+    // library that crashed the helper or timed out may do better
+    // next time
+    
+    if (!m_resultCache) return;
+    
+    for (auto &r: output) {
+        QStringList bits = QString(r.c_str()).split("|");
+        if (bits.size() < 2 || bits.size() > 3) continue;
+        if (bits[0] != "SUCCESS" && bits[0] != "FAILURE") continue;
+        m_resultCache->store(tag, getLibraryFor(r), r);
+    }
+}
+
 void
 PluginCandidates::recordResult(string tag, vector<string> result)
 {
@@ -3768,6 +3768,7 @@ MainWindow::checkSaveModified()
 
     if (button == QMessageBox::Yes) {
         saveSession();
+        waitForSessionSave(); // failure marks the document as modified
         if (m_documentModified) { // save failed -- don't proceed!
             return false;
         } else {
@@ -3822,13 +3823,11 @@ void
 MainWindow::saveSession()
 {
     if (m_sessionFile != "") {
-        if (!saveSessionFile(m_sessionFile)) {
-            QMessageBox::critical(this, tr("Failed to save file"),
-                                  tr("<b>Save failed</b><p>Session file \"%1\" could not be saved.").arg(m_sessionFile));
-        } else {
-            CommandHistory::getInstance()->documentSaved();
-            documentRestored();
-        }
+        // Any failure is reported, and the document marked as
+        // modified again, when the background save completes
+        saveSessionFileInBackground(m_sessionFile);
+        CommandHistory::getInstance()->documentSaved();
+        documentRestored();
     } else {
         saveSessionAs();
     }
@@ -3845,19 +3844,16 @@ MainWindow::saveSessionAs()
 
     if (path == "") return;
 
-    if (!saveSessionFile(path)) {
-        QMessageBox::critical(this, tr("Failed to save file"),
-                              tr("<b>Save failed</b><p>Session file \"%1\" could not be saved.").arg(path));
-    } else {
-        setWindowTitle(tr("%1: %2")
-                       .arg(QApplication::applicationName())
-                       .arg(QFileInfo(path).fileName()));
-        m_sessionFile = path;
-        CommandHistory::getInstance()->documentSaved();
-        documentRestored();
-        m_recentFiles.addFile(path);
-        emit activity(tr("Save session as \"%1\"").arg(path));
-    }
+    saveSessionFileInBackground(path);
+
+    setWindowTitle(tr("%1: %2")
+                   .arg(QApplication::applicationName())
+                   .arg(QFileInfo(path).fileName()));
+    m_sessionFile = path;
+    CommandHistory::getInstance()->documentSaved();
+    documentRestored();
+    m_recentFiles.addFile(path);
+    emit activity(tr("Save session as \"%1\"").arg(path));
 }
 
 void
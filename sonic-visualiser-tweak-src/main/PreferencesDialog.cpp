@@ -43,6 +43,7 @@
 #include "widgets/WidgetScale.h"
 #include "base/Preferences.h"
 #include "base/ResourceFinder.h"
+#include "data/fileio/BZipFileDevice.h"
 #include "layer/ColourMapper.h"
 #include "layer/ColourDatabase.h"
 
@@ -96,6 +97,13 @@ PreferencesDialog::PreferencesDialog(QWidget *parent) :
                                          Qt::Checked);
     connect(vampProcessSeparation, SIGNAL(stateChanged(int)),
             this, SLOT(vampProcessSeparationChanged(int)));
+
+    QCheckBox *storeSpectrogramData = new QCheckBox;
+    m_storeSpectrogramData = prefs->getStoreSpectrogramData();
+    storeSpectrogramData->setCheckState(m_storeSpectrogramData ?
+                                        Qt::Checked : Qt::Unchecked);
+    connect(storeSpectrogramData, SIGNAL(stateChanged(int)),
+            this, SLOT(storeSpectrogramDataChanged(int)));
     
     QComboBox *smoothing = new QComboBox;
     
@@ -285,6 +293,20 @@ PreferencesDialog::PreferencesDialog(QWidget *parent) :
     connect(showSplash, SIGNAL(stateChanged(int)),
             this, SLOT(showSplashChanged(int)));
 
+    QCheckBox *sessionContainers = new QCheckBox;
+    m_saveSessionContainers = prefs->getSaveSessionContainers();
+    sessionContainers->setCheckState(m_saveSessionContainers ?
+                                     Qt::Checked : Qt::Unchecked);
+    connect(sessionContainers, SIGNAL(stateChanged(int)),
+            this, SLOT(saveSessionContainersChanged(int)));
+
+    QCheckBox *fastCompression = new QCheckBox;
+    m_fastSessionCompression = prefs->getFastSessionCompression();
+    fastCompression->setCheckState(m_fastSessionCompression ?
+                                   Qt::Checked : Qt::Unchecked);
+    connect(fastCompression, SIGNAL(stateChanged(int)),
+            this, SLOT(fastSessionCompressionChanged(int)));
+
 #ifdef NOT_DEFINED // This no longer works correctly on any platform AFAICS
     QComboBox *bgMode = new QComboBox;
     int bg = prefs->getPropertyRangeAndValue("Background Mode", &min, &max,
@@ -490,6 +512,11 @@ PreferencesDialog::PreferencesDialog(QWidget *parent) :
     subgrid->addWidget(new QLabel(tr("Run Vamp plugins in separate process:")),
                        row, 0);
     subgrid->addWidget(vampProcessSeparation, row++, 1, 1, 1);
+
+    subgrid->addWidget(new QLabel(tr("%1:").arg(prefs->getPropertyLabel
+                                                ("Store Spectrogram Data"))),
+                       row, 0);
+    subgrid->addWidget(storeSpectrogramData, row++, 1, 1, 1);
     
     subgrid->setRowStretch(row, 10);
     
@@ -608,6 +635,16 @@ PreferencesDialog::PreferencesDialog(QWidget *parent) :
                        row, 0);
     subgrid->addWidget(showSplash, row++, 1, 1, 1);
 
+    subgrid->addWidget(new QLabel(tr("%1:").arg(prefs->getPropertyLabel
+                                                ("Save Session Containers"))),
+                       row, 0);
+    subgrid->addWidget(sessionContainers, row++, 1, 1, 1);
+
+    subgrid->addWidget(new QLabel(tr("%1:").arg(prefs->getPropertyLabel
+                                                ("Fast Session Compression"))),
+                       row, 0);
+    subgrid->addWidget(fastCompression, row++, 1, 1, 1);
+
     subgrid->addWidget(new QLabel(tr("%1:").arg(prefs->getPropertyLabel
                                                 ("Temporary Directory Root"))),
                        row, 0);
@@ -844,6 +881,43 @@ PreferencesDialog::showSplashChanged(int state)
     m_changesOnRestart = true;
 }
 
+void
+PreferencesDialog::saveSessionContainersChanged(int state)
+{
+    m_saveSessionContainers = (state == Qt::Checked);
+    m_applyButton->setEnabled(true);
+    // Does not require a restart
+}
+
+void
+PreferencesDialog::fastSessionCompressionChanged(int state)
+{
+    m_fastSessionCompression = (state == Qt::Checked);
+    m_applyButton->setEnabled(true);
+    // Does not require a restart
+
+    if (!m_fastSessionCompression) return;
+
+    QString how;
+    if (BZipFileDevice::isCodecSupported(BZipFileDevice::Zstd)) {
+        how = tr("<p>Sessions will be compressed using zstd, which versions of Sonic Visualiser before this one cannot open at all.</p>");
+    } else {
+        how = tr("<p>Sessions will be compressed in several independent parts. Versions of Sonic Visualiser before this one read only the first part, so they cannot open any but the smallest sessions saved this way.</p>");
+    }
+    
+    QMessageBox::information
+        (this, tr("Fast session compression"),
+         tr("<b>Older versions cannot read these sessions</b>%1<p>Switch this option off again before saving a session that you want to open in an older version.</p>").arg(how));
+}
+
+void
+PreferencesDialog::storeSpectrogramDataChanged(int state)
+{
+    m_storeSpectrogramData = (state == Qt::Checked);
+    m_applyButton->setEnabled(true);
+    // Takes effect for spectrograms created after the change
+}
+
 void
 PreferencesDialog::defaultTemplateChanged(int i)
 {
@@ -944,6 +1018,9 @@ PreferencesDialog::applyClicked()
     prefs->setUseGaplessMode(m_gapless);
     prefs->setRunPluginsInProcess(m_runPluginsInProcess);
     prefs->setShowSplash(m_showSplash);
+    prefs->setSaveSessionContainers(m_saveSessionContainers);
+    prefs->setFastSessionCompression(m_fastSessionCompression);
+    prefs->setStoreSpectrogramData(m_storeSpectrogramData);
     prefs->setTemporaryDirectoryRoot(m_tempDirRoot);
     prefs->setBackgroundMode(Preferences::BackgroundMode(m_backgroundMode));
     prefs->setTimeToTextMode(Preferences::TimeToTextMode(m_timeToTextMode));
@@ -77,6 +77,9 @@ protected slots:
     void octaveSystemChanged(int system);
     void viewFontSizeChanged(int sz);
     void showSplashChanged(int state);
+    void saveSessionContainersChanged(int state);
+    void fastSessionCompressionChanged(int state);
+    void storeSpectrogramDataChanged(int state);
     void defaultTemplateChanged(int);
     void localeChanged(int);
     void networkPermissionChanged(int state);
@@ -134,6 +137,9 @@ protected:
     int m_octaveSystem;
     int m_viewFontSize;
     bool m_showSplash;
+    bool m_saveSessionContainers;
+    bool m_fastSessionCompression;
+    bool m_storeSpectrogramData;
 
     bool m_audioDeviceChanged;
     bool m_coloursChanged;
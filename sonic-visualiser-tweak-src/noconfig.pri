@@ -7,7 +7,7 @@ CONFIG += release
 PREFIX_PATH = /usr/local
 
 DEFINES += NDEBUG BUILD_RELEASE
-DEFINES += NO_TIMING NO_HIT_COUNTS
+DEFINES += NO_HIT_COUNTS
 
 DEFINES += HAVE_PIPER HAVE_PLUGIN_CHECKER_HELPER
 
@@ -137,6 +137,21 @@ macx* {
 	-framework Accelerate
 }
 
+# Zstandard is optional, for fast session compression. The dependency
+# builds above do not include it, so use it only if one of the include
+# paths has it.
+
+for(dir, INCLUDEPATH) {
+    exists($$dir/zstd.h) {
+        CONFIG += sv_have_zstd
+    }
+}
+
+sv_have_zstd {
+    DEFINES += HAVE_ZSTD
+    LIBS += -lzstd
+}
+
 linux* {
 
     message("Building without ./configure on Linux is unlikely to work")
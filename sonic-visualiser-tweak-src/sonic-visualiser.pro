@@ -18,6 +18,7 @@ SUBDIRS += \
 	checker \
 	sub_server \
         sub_convert \
+        sub_batch \
 	sub_sv
 
 sub_base.file = base.pro
@@ -29,6 +30,7 @@ sub_test_svcore_data_model.file = test-svcore-data-model.pro
 
 sub_server.file = server.pro
 sub_convert.file = convert.pro
+sub_batch.file = batch.pro
 sub_sv.file = sv.pro
 
 CONFIG += ordered
@@ -39,6 +39,9 @@ using breakfastquay::v_zero_channels;
 
 #include <iostream>
 #include <cassert>
+#include <climits>
+#include <thread>
+#include <chrono>
 
 //#define DEBUG_AUDIO_PLAY_SOURCE 1
 //#define DEBUG_AUDIO_PLAY_SOURCE_PLAYING 1
@@ -50,8 +53,10 @@ AudioCallbackPlaySource::AudioCallbackPlaySource(ViewManagerBase *manager,
     m_viewManager(manager),
     m_audioGenerator(new AudioGenerator()),
     m_clientName(clientName.toUtf8().data()),
-    m_readBuffers(nullptr),
-    m_writeBuffers(nullptr),
+    m_ringBuffers{ nullptr, nullptr },
+    m_readBuffer(nullptr),
+    m_writeBuffer(nullptr),
+    m_callbackEpoch(0),
     m_readBufferFill(0),
     m_writeBufferFill(0),
     m_bufferScavenger(1),
@@ -77,6 +82,13 @@ AudioCallbackPlaySource::AudioCallbackPlaySource(ViewManagerBase *manager,
     m_auditioningPluginBypassed(false),
     m_playStartFrame(0),
     m_playStartFramePassed(false),
+    m_statCallbacks(0),
+    m_statUnderruns(0),
+    m_statUnderrunFrames(0),
+    m_statOverruns(0),
+    m_statHandovers(0),
+    m_statBufferedFrames(0),
+    m_statMinBufferedFrames(INT_MAX),
     m_timeStretcher(nullptr),
     m_monoStretcher(nullptr),
     m_stretchRatio(1.0),
@@ -125,12 +137,9 @@ AudioCallbackPlaySource::~AudioCallbackPlaySource()
     }
 
     clearModels();
-    
-    if (m_readBuffers != m_writeBuffers) {
-        delete m_readBuffers;
-    }
 
-    delete m_writeBuffers;
+    delete m_ringBuffers[0];
+    delete m_ringBuffers[1];
 
     delete m_audioGenerator;
 
@@ -238,8 +247,9 @@ AudioCallbackPlaySource::addModel(ModelId modelId)
         }
     }
 
-    if (!m_writeBuffers || (int)m_writeBuffers->size() < getTargetChannelCount()) {
-        cerr << "m_writeBuffers size = " << (m_writeBuffers ? m_writeBuffers->size() : 0) << endl;
+    if (!m_writeBuffer ||
+        m_writeBuffer->getChannelCount() < getTargetChannelCount()) {
+        cerr << "ring buffer channels = " << (m_writeBuffer ? m_writeBuffer->getChannelCount() : 0) << endl;
         cerr << "target channel count = " << (getTargetChannelCount()) << endl;
         clearRingBuffers(true, getTargetChannelCount());
         buffersIncreased = true;
@@ -398,7 +408,7 @@ AudioCallbackPlaySource::clearRingBuffers(bool haveLock, int count)
     rebuildRangeLists();
 
     if (count == 0) {
-        if (m_writeBuffers) count = int(m_writeBuffers->size());
+        if (m_writeBuffer) count = m_writeBuffer->getChannelCount();
     }
 
 #ifdef DEBUG_AUDIO_PLAY_SOURCE
@@ -413,24 +423,94 @@ AudioCallbackPlaySource::clearRingBuffers(bool haveLock, int count)
     cout << "current buffered frame = " << m_writeBufferFill << endl;
 #endif
 
-    if (m_readBuffers != m_writeBuffers) {
-        delete m_writeBuffers;
-    }
+    if (count > 0 &&
+        (!m_ringBuffers[0] ||
+         m_ringBuffers[0]->getChannelCount() < count ||
+         m_ringBuffers[0]->getSize() < m_ringBufferSize)) {
+
+        // We need bigger buffers. This happens only when the channel
+        // count or device block size goes up, not on every seek. The
+        // callback falls silent until the fill thread hands the new
+        // buffers over, and the old ones go to the scavenger as
+        // another thread may be looking at them in getCurrentFrame
+        
+        m_readBuffer.store(nullptr);
+        
+        for (int i = 0; i < 2; ++i) {
+            if (m_ringBuffers[i]) {
+                m_bufferScavenger.claim(m_ringBuffers[i]);
+            }
+            m_ringBuffers[i] = new InterleavedRingBuffer(count, m_ringBufferSize);
+        }
 
-    m_writeBuffers = new RingBufferVector;
+        m_writeBuffer = m_ringBuffers[0];
 
-    for (int i = 0; i < count; ++i) {
-        m_writeBuffers->push_back(new RingBuffer<float>(m_ringBufferSize));
+#ifdef DEBUG_AUDIO_PLAY_SOURCE
+        cout << "AudioCallbackPlaySource::clearRingBuffers: Created "
+             << count << "-channel ring buffers" << endl;
+#endif
+
+    } else if (m_ringBuffers[0]) {
+
+        // Switch to whichever buffer the callback is not reading. If
+        // the callback has only just been handed the other one, it
+        // may still be reading this one, so wait for it to finish
+        
+        InterleavedRingBuffer *reading = m_readBuffer.load();
+        m_writeBuffer = (reading == m_ringBuffers[0] ?
+                         m_ringBuffers[1] : m_ringBuffers[0]);
+        waitForCallbackToReturn();
+        m_writeBuffer->reset();
     }
 
     m_audioGenerator->reset();
     
-//    cout << "AudioCallbackPlaySource::clearRingBuffers: Created "
-//              << count << " write buffers" << endl;
-
     if (!haveLock) {
         m_mutex.unlock();
     }
+
+    m_condition.wakeAll();
+}
+
+void
+AudioCallbackPlaySource::waitForCallbackToReturn()
+{
+    // The callback increments the epoch on entry and exit. Anything
+    // published before we read it here will be seen by any callback
+    // that starts afterwards, so we need only outlast the current one
+    
+    unsigned int epoch = m_callbackEpoch.load();
+    if (!(epoch & 1)) return;
+
+    while (m_callbackEpoch.load() == epoch) {
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+}
+
+AudioCallbackPlaySource::PlaybackStatistics
+AudioCallbackPlaySource::getPlaybackStatistics() const
+{
+    PlaybackStatistics stats;
+    stats.callbacks = m_statCallbacks.load(std::memory_order_relaxed);
+    stats.underruns = m_statUnderruns.load(std::memory_order_relaxed);
+    stats.underrunFrames = m_statUnderrunFrames.load(std::memory_order_relaxed);
+    stats.overruns = m_statOverruns.load(std::memory_order_relaxed);
+    stats.handovers = m_statHandovers.load(std::memory_order_relaxed);
+    stats.bufferedFrames = m_statBufferedFrames.load(std::memory_order_relaxed);
+    int minBuffered = m_statMinBufferedFrames.load(std::memory_order_relaxed);
+    stats.minBufferedFrames = (minBuffered == INT_MAX ? 0 : minBuffered);
+    return stats;
+}
+
+void
+AudioCallbackPlaySource::resetPlaybackStatistics()
+{
+    m_statCallbacks.store(0, std::memory_order_relaxed);
+    m_statUnderruns.store(0, std::memory_order_relaxed);
+    m_statUnderrunFrames.store(0, std::memory_order_relaxed);
+    m_statOverruns.store(0, std::memory_order_relaxed);
+    m_statHandovers.store(0, std::memory_order_relaxed);
+    m_statMinBufferedFrames.store(INT_MAX, std::memory_order_relaxed);
 }
 
 void
@@ -489,16 +569,13 @@ AudioCallbackPlaySource::play(sv_frame_t startFrame)
         m_monoStretcher->reset();
     }
 
+    // Silence the callback, rather than let it play out whatever is
+    // buffered from the old position, until the fill thread has data
+    // from the new one to hand over
+    m_readBuffer.store(nullptr);
+    clearRingBuffers(true);
+
     m_readBufferFill = m_writeBufferFill = startFrame;
-    if (m_readBuffers) {
-        for (int c = 0; c < getTargetChannelCount(); ++c) {
-            RingBuffer<float> *rb = getReadRingBuffer(c);
-#ifdef DEBUG_AUDIO_PLAY_SOURCE
-            cout << "reset ring buffer for channel " << c << endl;
-#endif
-            if (rb) rb->reset();
-        }
-    }
 
     m_mutex.unlock();
 
@@ -651,7 +728,7 @@ AudioCallbackPlaySource::setSystemPlaybackBlockSize(int size)
              << endl;
 #endif
         m_ringBufferSize = size * 4;
-        if (m_writeBuffers && !m_writeBuffers->empty()) {
+        if (m_writeBuffer) {
             clearRingBuffers();
         }
     }
@@ -717,12 +794,9 @@ AudioCallbackPlaySource::getCurrentFrame(RealTime latency_t)
 
     int inbuffer = 0; // at target rate
 
-    for (int c = 0; c < getTargetChannelCount(); ++c) {
-        RingBuffer<float> *rb = getReadRingBuffer(c);
-        if (rb) {
-            int here = rb->getReadSpace();
-            if (c == 0 || here < inbuffer) inbuffer = here;
-        }
+    InterleavedRingBuffer *rb = m_readBuffer.load();
+    if (rb) {
+        inbuffer = rb->getReadSpace();
     }
 
     sv_frame_t readBufferFill = m_readBufferFill;
@@ -1060,6 +1134,13 @@ AudioCallbackPlaySource::getSourceSampleRate() const
     return m_sourceSampleRate;
 }
 
+double
+AudioCallbackPlaySource::getPlaySpeed() const
+{
+    double ratio = m_stretchRatio;
+    return ratio > 0.0 ? 1.0 / ratio : 1.0;
+}
+
 void
 AudioCallbackPlaySource::setTimeStretch(double factor)
 {
@@ -1143,6 +1224,18 @@ AudioCallbackPlaySource::getSourceSamples(float *const *buffer,
     // there's a race condition there, which we accommodate with this
     // check.
 
+    // Let the fill thread know while we might be holding on to a
+    // ring buffer, so that it does not reuse one we are reading
+    struct CallbackEpoch {
+        std::atomic<unsigned int> &m_epoch;
+        CallbackEpoch(std::atomic<unsigned int> &epoch) : m_epoch(epoch) {
+            ++m_epoch;
+        }
+        ~CallbackEpoch() {
+            ++m_epoch;
+        }
+    } epoch(m_callbackEpoch);
+
     int channels = getTargetChannelCount();
 
     if (!m_playing) {
@@ -1153,7 +1246,9 @@ AudioCallbackPlaySource::getSourceSamples(float *const *buffer,
         return 0;
     }
     if (requestedChannels < channels) {
-        SVDEBUG << "AudioCallbackPlaySource::getSourceSamples: Not enough device channels (" << requestedChannels << ", need " << channels << "); hoping device is about to be reopened" << endl;
+#ifdef DEBUG_AUDIO_PLAY_SOURCE
+        cerr << "AudioCallbackPlaySource::getSourceSamples: Not enough device channels (" << requestedChannels << ", need " << channels << "); hoping device is about to be reopened" << endl;
+#endif
         v_zero_channels(buffer, requestedChannels, count);
         return 0;
     }
@@ -1165,33 +1260,42 @@ AudioCallbackPlaySource::getSourceSamples(float *const *buffer,
     cout << "AudioCallbackPlaySource::getSourceSamples: Playing" << endl;
 #endif
 
-    // Ensure that all buffers have at least the amount of data we
-    // need -- else reduce the size of our requests correspondingly
+    m_statCallbacks.fetch_add(1, std::memory_order_relaxed);
 
-    for (int ch = 0; ch < channels; ++ch) {
+    // Load the ring buffer once only: the fill thread may hand over
+    // a different one at any moment, but will not reuse this one
+    // until we return
 
-        RingBuffer<float> *rb = getReadRingBuffer(ch);
-        
-        if (!rb) {
-            SVCERR << "WARNING: AudioCallbackPlaySource::getSourceSamples: "
-                      << "No ring buffer available for channel " << ch
-                      << ", returning no data here" << endl;
-            count = 0;
-            break;
-        }
+    InterleavedRingBuffer *rb = m_readBuffer.load();
 
-        int rs = rb->getReadSpace();
-        if (rs < count) {
+    if (!rb) {
+        // Between a reseek and the handover of the new buffer
+        v_zero_channels(buffer, channels, count);
+        return 0;
+    }
+
+    // Ensure that the buffer has at least the amount of data we need
+    // -- else reduce the size of our request correspondingly
+
+    int rs = rb->getReadSpace();
+
+    m_statBufferedFrames.store(rs, std::memory_order_relaxed);
+    if (rs < m_statMinBufferedFrames.load(std::memory_order_relaxed)) {
+        m_statMinBufferedFrames.store(rs, std::memory_order_relaxed);
+    }
+
+    if (rs < count) {
 #ifdef DEBUG_AUDIO_PLAY_SOURCE
-            cerr << "WARNING: AudioCallbackPlaySource::getSourceSamples: "
-                      << "Ring buffer for channel " << ch << " has only "
-                      << rs << " (of " << count << ") samples available ("
-                      << "ring buffer size is " << rb->getSize() << ", write "
-                      << "space " << rb->getWriteSpace() << "), "
-                      << "reducing request size" << endl;
+        cerr << "WARNING: AudioCallbackPlaySource::getSourceSamples: "
+             << "Ring buffer has only " << rs << " (of " << count
+             << ") frames available (ring buffer size is " << rb->getSize()
+             << "), reducing request size" << endl;
 #endif
-            count = rs;
-        }
+        // The fill thread writes silence past the end of playback,
+        // so running short here is always an underrun
+        m_statUnderruns.fetch_add(1, std::memory_order_relaxed);
+        m_statUnderrunFrames.fetch_add(count - rs, std::memory_order_relaxed);
+        count = rs;
     }
 
     if (count == 0) return 0;
@@ -1203,7 +1307,6 @@ AudioCallbackPlaySource::getSourceSamples(float *const *buffer,
 
     if (ratio != m_stretchRatio) {
         if (!ts) {
-            SVCERR << "WARNING: AudioCallbackPlaySource::getSourceSamples: Time ratio change to " << m_stretchRatio << " is pending, but no stretcher is set" << endl;
             m_stretchRatio = 1.0;
         } else {
             ts->setTimeRatio(m_stretchRatio);
@@ -1229,116 +1332,68 @@ AudioCallbackPlaySource::getSourceSamples(float *const *buffer,
 
     if (!ts || ratio == 1.f) {
 
-        int got = 0;
-
 #ifdef DEBUG_AUDIO_PLAY_SOURCE_PLAYING
         cout << "channels == " << channels << endl;
 #endif
-        
-        for (int ch = 0; ch < channels; ++ch) {
 
-            RingBuffer<float> *rb = getReadRingBuffer(ch);
+        // Reading all channels from the one interleaved buffer keeps
+        // them in step, and zeroes anything past what was available
+        int got = rb->read(buffer, channels, count);
 
-            if (rb) {
-
-                // this is marginally more likely to leave our channels in
-                // sync after a processing failure than just passing "count":
-                sv_frame_t request = count;
-                if (ch > 0) request = got;
-
-                got = rb->read(buffer[ch], int(request));
-            
 #ifdef DEBUG_AUDIO_PLAY_SOURCE_PLAYING
-                cout << "AudioCallbackPlaySource::getSamples: got " << got << " (of " << count << ") samples on channel " << ch << ", signalling for more (possibly)" << endl;
+        cout << "AudioCallbackPlaySource::getSamples: got " << got << " (of " << count << ") samples" << endl;
 #endif
-            }
-
-            for (int ch = 0; ch < channels; ++ch) {
-                for (int i = got; i < count; ++i) {
-                    buffer[ch][i] = 0.0;
-                }
-            }
-        }
 
         applyAuditioningEffect(count, buffer);
 
-#ifdef DEBUG_AUDIO_PLAY_SOURCE
-    cout << "AudioCallbackPlaySource::getSamples: awakening thread" << endl;
-#endif
-
-        m_condition.wakeAll();
-
         return got;
     }
 
     sv_frame_t available;
-    sv_frame_t fedToStretcher = 0;
     int warned = 0;
 
     // The input block for a given output is approx output / ratio,
     // but we can't predict it exactly, for an adaptive timestretcher.
+    // The stretcher inputs were allocated up front, so we feed them
+    // no more than they can hold at a time and go round again if the
+    // stretcher wants more
 
     while ((available = ts->available()) < count) {
 
         sv_frame_t reqd = lrint(double(count - available) / ratio);
         reqd = std::max(reqd, sv_frame_t(ts->getSamplesRequired()));
         if (reqd == 0) reqd = 1;
+        if (reqd > m_stretcherInputSizes[0]) reqd = m_stretcherInputSizes[0];
                 
-        sv_frame_t got = reqd;
-
 #ifdef DEBUG_AUDIO_PLAY_SOURCE_PLAYING
         cout << "reqd = " <<reqd << ", channels = " << channels << ", ic = " << m_stretcherInputCount << endl;
 #endif
 
-        for (int c = 0; c < channels; ++c) {
-            if (c >= m_stretcherInputCount) continue;
-            if (reqd > m_stretcherInputSizes[c]) {
-                if (c == 0) {
-                    SVDEBUG << "NOTE: resizing stretcher input buffer from " << m_stretcherInputSizes[c] << " to " << (reqd * 2) << endl;
-                }
-                delete[] m_stretcherInputs[c];
-                m_stretcherInputSizes[c] = reqd * 2;
-                m_stretcherInputs[c] = new float[m_stretcherInputSizes[c]];
-            }
+        sv_frame_t got;
+        if (stretchChannels == 1) {
+            got = rb->readMixedDown(m_stretcherInputs[0], int(reqd));
+        } else {
+            got = rb->read(m_stretcherInputs, m_stretcherInputCount, int(reqd));
         }
 
-        for (int c = 0; c < channels; ++c) {
-            if (c >= m_stretcherInputCount) continue;
-            RingBuffer<float> *rb = getReadRingBuffer(c);
-            if (rb) {
-                sv_frame_t gotHere;
-                if (stretchChannels == 1 && c > 0) {
-                    gotHere = rb->readAdding(m_stretcherInputs[0], int(got));
-                } else {
-                    gotHere = rb->read(m_stretcherInputs[c], int(got));
-                }
-                if (gotHere < got) got = gotHere;
-                
 #ifdef DEBUG_AUDIO_PLAY_SOURCE_PLAYING
-                if (c == 0) {
-                    cout << "feeding stretcher: got " << gotHere
-                              << ", " << rb->getReadSpace() << " remain" << endl;
-                }
+        cout << "feeding stretcher: got " << got
+             << ", " << rb->getReadSpace() << " remain" << endl;
 #endif
-                
-            } else {
-                SVCERR << "WARNING: No ring buffer available for channel " << c << " in stretcher input block" << endl;
-            }
-        }
 
         if (got < reqd) {
-            SVCERR << "WARNING: Read underrun in playback ("
-                      << got << " < " << reqd << ")" << endl;
+            m_statUnderruns.fetch_add(1, std::memory_order_relaxed);
+            m_statUnderrunFrames.fetch_add(reqd - got, std::memory_order_relaxed);
         }
 
         ts->process(m_stretcherInputs, size_t(got), false);
 
-        fedToStretcher += got;
-
         if (got == 0) break;
 
         if (ts->available() == available) {
-            SVCERR << "WARNING: AudioCallbackPlaySource::getSamples: Added " << got << " samples to time stretcher, created no new available output samples (warned = " << warned << ")" << endl;
+#ifdef DEBUG_AUDIO_PLAY_SOURCE
+            cerr << "WARNING: AudioCallbackPlaySource::getSamples: Added " << got << " samples to time stretcher, created no new available output samples (warned = " << warned << ")" << endl;
+#endif
             if (++warned == 5) break;
         }
     }
@@ -1349,12 +1404,6 @@ AudioCallbackPlaySource::getSourceSamples(float *const *buffer,
 
     applyAuditioningEffect(count, buffer);
 
-#ifdef DEBUG_AUDIO_PLAY_SOURCE
-    cout << "AudioCallbackPlaySource::getSamples [stretched]: awakening thread" << endl;
-#endif
-
-    m_condition.wakeAll();
-
     return count;
 }
 
@@ -1409,14 +1458,10 @@ AudioCallbackPlaySource::fillBuffers()
     static float *tmp = nullptr;
     static sv_frame_t tmpSize = 0;
 
-    sv_frame_t space = 0;
-    for (int c = 0; c < getTargetChannelCount(); ++c) {
-        RingBuffer<float> *wb = getWriteRingBuffer(c);
-        if (wb) {
-            sv_frame_t spaceHere = wb->getWriteSpace();
-            if (c == 0 || spaceHere < space) space = spaceHere;
-        }
-    }
+    InterleavedRingBuffer *wb = m_writeBuffer;
+    if (!wb) return false;
+
+    sv_frame_t space = wb->getWriteSpace();
     
     if (space == 0) {
 #ifdef DEBUG_AUDIO_PLAY_SOURCE
@@ -1425,12 +1470,12 @@ AudioCallbackPlaySource::fillBuffers()
         return false;
     }
 
-    // space is now the number of samples that can be written on each
-    // channel's write ringbuffer
+    // space is now the number of frames that can be written to the
+    // write ring buffer
     
     sv_frame_t f = m_writeBufferFill;
         
-    bool readWriteEqual = (m_readBuffers == m_writeBuffers);
+    bool readWriteEqual = (m_readBuffer.load() == wb);
 
 #ifdef DEBUG_AUDIO_PLAY_SOURCE
     if (!readWriteEqual) {
@@ -1443,7 +1488,9 @@ AudioCallbackPlaySource::fillBuffers()
     cout << "buffered to " << f << " already" << endl;
 #endif
 
-    int channels = getTargetChannelCount();
+    // We mix the target channels, but the ring buffer may have been
+    // allocated with more, in which case the rest are left silent
+    int channels = std::max(getTargetChannelCount(), wb->getChannelCount());
 
     static float **bufferPtrs = nullptr;
     static int bufferPtrCount = 0;
@@ -1485,22 +1532,16 @@ AudioCallbackPlaySource::fillBuffers()
 
     sv_frame_t got = mixModels(f, space, bufferPtrs); // also modifies f
 
-    for (int c = 0; c < channels; ++c) {
-
-        RingBuffer<float> *wb = getWriteRingBuffer(c);
-        if (wb) {
-            int actual = wb->write(bufferPtrs[c], int(got));
+    int actual = wb->write(bufferPtrs, int(got));
 #ifdef DEBUG_AUDIO_PLAY_SOURCE
-            cout << "Wrote " << actual << " samples for ch " << c << ", now "
-                 << wb->getReadSpace() << " to read" 
-                 << endl;
+    cout << "Wrote " << actual << " frames, now "
+         << wb->getReadSpace() << " to read" 
+         << endl;
 #endif
-            if (actual < got) {
-                SVCERR << "WARNING: Buffer overrun in channel " << c
-                       << ": wrote " << actual << " of " << got
-                       << " samples" << endl;
-            }
-        }
+    if (actual < got) {
+        m_statOverruns.fetch_add(1, std::memory_order_relaxed);
+        SVCERR << "WARNING: Buffer overrun: wrote " << actual << " of "
+               << got << " frames" << endl;
     }
 
     m_writeBufferFill = f;
@@ -1693,33 +1734,28 @@ AudioCallbackPlaySource::mixModels(sv_frame_t &frame, sv_frame_t count, float **
 void
 AudioCallbackPlaySource::unifyRingBuffers()
 {
-    if (m_readBuffers == m_writeBuffers) return;
+    InterleavedRingBuffer *wb = m_writeBuffer;
+    InterleavedRingBuffer *rb = m_readBuffer.load();
+    
+    if (!wb || rb == wb) return;
 
     // only unify if there will be something to read
-    for (int c = 0; c < getTargetChannelCount(); ++c) {
-        RingBuffer<float> *wb = getWriteRingBuffer(c);
-        if (wb) {
-            if (wb->getReadSpace() < m_blockSize * 2) {
-                if ((m_writeBufferFill + m_blockSize * 2) < 
-                    m_lastModelEndFrame) {
-                    // OK, we don't have enough and there's more to
-                    // read -- don't unify until we can do better
+    if (wb->getReadSpace() < m_blockSize * 2) {
+        if ((m_writeBufferFill + m_blockSize * 2) < 
+            m_lastModelEndFrame) {
+            // OK, we don't have enough and there's more to
+            // read -- don't unify until we can do better
 #ifdef DEBUG_AUDIO_PLAY_SOURCE_PLAYING
-                    cout << "AudioCallbackPlaySource::unifyRingBuffers: Not unifying: write buffer has less (" << wb->getReadSpace() << ") than " << m_blockSize*2 << " to read and write buffer fill (" << m_writeBufferFill << ") is not close to end frame (" << m_lastModelEndFrame << ")" << endl;
+            cout << "AudioCallbackPlaySource::unifyRingBuffers: Not unifying: write buffer has less (" << wb->getReadSpace() << ") than " << m_blockSize*2 << " to read and write buffer fill (" << m_writeBufferFill << ") is not close to end frame (" << m_lastModelEndFrame << ")" << endl;
 #endif
-                    return;
-                }
-            }
-            break;
+            return;
         }
     }
 
     sv_frame_t rf = m_readBufferFill;
-    RingBuffer<float> *rb = getReadRingBuffer(0);
     if (rb) {
         int rs = rb->getReadSpace();
         //!!! incorrect when in non-contiguous selection, see comments elsewhere
-//        cout << "rs = " << rs << endl;
         if (rs < rf) rf -= rs;
         else rf = 0;
     }
@@ -1728,32 +1764,23 @@ AudioCallbackPlaySource::unifyRingBuffers()
     cout << "AudioCallbackPlaySource::unifyRingBuffers: m_readBufferFill = " << m_readBufferFill << ", rf = " << rf << ", m_writeBufferFill = " << m_writeBufferFill << endl;
 #endif
 
+    // Skip whatever the callback has already played from the old
+    // buffer since the new one started filling. The callback is not
+    // reading the new buffer yet, so we may skip on its behalf
+    
     sv_frame_t wf = m_writeBufferFill;
-    sv_frame_t skip = 0;
-    for (int c = 0; c < getTargetChannelCount(); ++c) {
-        RingBuffer<float> *wb = getWriteRingBuffer(c);
-        if (wb) {
-            if (c == 0) {
-                
-                int wrs = wb->getReadSpace();
-//                cout << "wrs = " << wrs << endl;
-
-                if (wrs < wf) wf -= wrs;
-                else wf = 0;
-//                cout << "wf = " << wf << endl;
-                
-                if (wf < rf) skip = rf - wf;
-                if (skip == 0) break;
-            }
+    int wrs = wb->getReadSpace();
+    if (wrs < wf) wf -= wrs;
+    else wf = 0;
 
-//            cout << "skipping " << skip << endl;
-            wb->skip(int(skip));
-        }
+    if (wf < rf) {
+        wb->skip(int(rf - wf));
     }
-                    
-    m_bufferScavenger.claim(m_readBuffers);
-    m_readBuffers = m_writeBuffers;
+
+    m_readBuffer.store(wb);
     m_readBufferFill = m_writeBufferFill;
+    m_statHandovers.fetch_add(1, std::memory_order_relaxed);
+    
 #ifdef DEBUG_AUDIO_PLAY_SOURCE_PLAYING
     cout << "unified" << endl;
 #endif
@@ -1770,7 +1797,6 @@ AudioCallbackPlaySource::FillThread::run()
 
     s.m_mutex.lock();
 
-    bool previouslyPlaying = s.m_playing;
     bool work = false;
 
     while (!s.m_exiting) {
@@ -1793,9 +1819,15 @@ AudioCallbackPlaySource::FillThread::run()
             double ms = 100;
             if (s.getSourceSampleRate() > 0) {
                 ms = double(s.m_ringBufferSize) / s.getSourceSampleRate() * 1000.0;
+                if (s.m_playing) {
+                    // The audio callback never wakes us, as that
+                    // could block it, so poll about once per block
+                    ms = double(s.m_blockSize) / s.getSourceSampleRate() * 1000.0;
+                    if (ms < 1.0) ms = 1.0;
+                }
+            } else if (s.m_playing) {
+                ms /= 10;
             }
-            
-            if (s.m_playing) ms /= 10;
 
 #ifdef DEBUG_AUDIO_PLAY_SOURCE
             if (!s.m_playing) cout << endl;
@@ -1818,18 +1850,8 @@ AudioCallbackPlaySource::FillThread::run()
             continue;
         }
 
-        bool playing = s.m_playing;
-
-        if (playing && !previouslyPlaying) {
-#ifdef DEBUG_AUDIO_PLAY_SOURCE
-            cout << "AudioCallbackPlaySourceFillThread: playback state changed, resetting" << endl;
-#endif
-            for (int c = 0; c < s.getTargetChannelCount(); ++c) {
-                RingBuffer<float> *rb = s.getReadRingBuffer(c);
-                if (rb) rb->reset();
-            }
-        }
-        previouslyPlaying = playing;
+        // (There is no need to reset anything when playback starts,
+        // as play() has already switched us to an empty buffer)
 
         work = s.fillBuffers();
     }
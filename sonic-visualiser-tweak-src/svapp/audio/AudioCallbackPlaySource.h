@@ -16,7 +16,7 @@
 #ifndef SV_AUDIO_CALLBACK_PLAY_SOURCE_H
 #define SV_AUDIO_CALLBACK_PLAY_SOURCE_H
 
-#include "base/RingBuffer.h"
+#include "base/InterleavedRingBuffer.h"
 #include "base/AudioPlaySource.h"
 #include "base/PropertyContainer.h"
 #include "base/Scavenger.h"
@@ -35,6 +35,8 @@
 
 #include <set>
 #include <map>
+#include <atomic>
+#include <cstdint>
 
 namespace RubberBand {
     class RubberBandStretcher;
@@ -53,10 +55,19 @@ class AudioCallbackPlayTarget;
 
 /**
  * AudioCallbackPlaySource manages audio data supply to callback-based
- * audio APIs such as JACK or CoreAudio.  It maintains one ring buffer
- * per channel, filled during playback by a non-realtime thread, and
+ * audio APIs such as JACK or CoreAudio.  It maintains an interleaved
+ * ring buffer, filled during playback by a non-realtime thread, and
  * provides a method for a realtime thread to pick up the latest
- * available sample data from these buffers.
+ * available sample data from it.
+ *
+ * Two ring buffers are allocated up front and reused. When playback
+ * is repositioned (by a seek, a change of selection or loop mode and
+ * so on) the fill thread starts filling whichever buffer the audio
+ * callback is not reading from, and hands it over by publishing a
+ * pointer once it has enough data. The callback only ever loads that
+ * pointer; before the fill thread reuses the buffer it replaced, it
+ * waits for any callback that may still hold it to return. So
+ * getSourceSamples neither locks nor allocates.
  */
 class AudioCallbackPlaySource : public QObject,
                                 public AudioPlaySource,
@@ -273,6 +284,14 @@ public:
      */
     void setTimeStretch(double factor);
 
+    /**
+     * Return the playback speed, the reciprocal of the time stretcher
+     * factor.
+     *
+     * override from AudioPlaySource
+     */
+    virtual double getPlaySpeed() const override;
+
     /**
      * Set a single real-time plugin as a processing effect for
      * auditioning during playback.
@@ -305,6 +324,34 @@ public:
         return m_clientName;
     }
 
+    /**
+     * Counters describing how well playback is keeping up. These are
+     * updated without locking by the audio callback and the fill
+     * thread, and may be read from any thread at any time.
+     */
+    struct PlaybackStatistics {
+        /// Calls to getSourceSamples while playing
+        uint64_t callbacks = 0;
+        /// Callbacks that received less data than they asked for,
+        /// other than at the end of playback
+        uint64_t underruns = 0;
+        /// Frames of silence substituted by those underruns
+        uint64_t underrunFrames = 0;
+        /// Writes by the fill thread that did not fit in the buffer
+        uint64_t overruns = 0;
+        /// Ring buffers handed over to the callback after a reseek
+        uint64_t handovers = 0;
+        /// Frames buffered ahead of the callback, as of its last
+        /// call; the latency contributed by buffering
+        int bufferedFrames = 0;
+        /// The least that has been buffered at any callback since
+        /// the statistics were last reset
+        int minBufferedFrames = 0;
+    };
+
+    PlaybackStatistics getPlaybackStatistics() const;
+    void resetPlaybackStatistics();
+
 signals:
     void playStatusChanged(bool isPlaying);
 
@@ -335,22 +382,26 @@ protected:
     AudioGenerator                   *m_audioGenerator;
     std::string                       m_clientName;
 
-    class RingBufferVector : public std::vector<RingBuffer<float> *> {
-    public:
-        virtual ~RingBufferVector() {
-            while (!empty()) {
-                delete *begin();
-                erase(begin());
-            }
-        }
-    };
-
     std::set<ModelId>                 m_models;
-    RingBufferVector                 *m_readBuffers;
-    RingBufferVector                 *m_writeBuffers;
+
+    // The pair of ring buffers in use. They are reallocated only if
+    // the channel count or ring buffer size increases
+    InterleavedRingBuffer            *m_ringBuffers[2];
+
+    // The buffer the audio callback reads from, or null if it should
+    // play silence until the fill thread hands over a new one
+    std::atomic<InterleavedRingBuffer *> m_readBuffer;
+
+    // The buffer the fill thread writes to; accessed with m_mutex held
+    InterleavedRingBuffer            *m_writeBuffer;
+
+    // Incremented by the audio callback on entry and again on exit,
+    // so that it is odd while a callback is in progress
+    std::atomic<unsigned int>         m_callbackEpoch;
+
     sv_frame_t                        m_readBufferFill;
     sv_frame_t                        m_writeBufferFill;
-    Scavenger<RingBufferVector>       m_bufferScavenger;
+    Scavenger<InterleavedRingBuffer>  m_bufferScavenger;
     int                               m_sourceChannelCount;
     sv_frame_t                        m_blockSize;
     sv_samplerate_t                   m_sourceSampleRate;
@@ -376,26 +427,28 @@ protected:
     bool                              m_playStartFramePassed;
     RealTime                          m_playStartedAt;
 
-    RingBuffer<float> *getWriteRingBuffer(int c) {
-        if (m_writeBuffers && c < (int)m_writeBuffers->size()) {
-            return (*m_writeBuffers)[c];
-        } else {
-            return 0;
-        }
-    }
-
-    RingBuffer<float> *getReadRingBuffer(int c) {
-        RingBufferVector *rb = m_readBuffers;
-        if (rb && c < (int)rb->size()) {
-            return (*rb)[c];
-        } else {
-            return 0;
-        }
-    }
-
+    std::atomic<uint64_t>             m_statCallbacks;
+    std::atomic<uint64_t>             m_statUnderruns;
+    std::atomic<uint64_t>             m_statUnderrunFrames;
+    std::atomic<uint64_t>             m_statOverruns;
+    std::atomic<uint64_t>             m_statHandovers;
+    std::atomic<int>                  m_statBufferedFrames;
+    std::atomic<int>                  m_statMinBufferedFrames;
+
+    // Called with m_mutex held. Switch the fill thread to a ring
+    // buffer that the callback is not reading, reallocating the pair
+    // first if they have fewer than count channels
     void clearRingBuffers(bool haveLock = false, int count = 0);
+
+    // Called from the fill thread with m_mutex held. Hand the write
+    // buffer over to the callback, if it is not already reading it
+    // and there is enough in it to be worth switching
     void unifyRingBuffers();
 
+    // Wait until no audio callback that started before this call is
+    // still running. Not for use on the audio thread
+    void waitForCallbackToReturn();
+
     RubberBand::RubberBandStretcher *m_timeStretcher;
     RubberBand::RubberBandStretcher *m_monoStretcher;
     double m_stretchRatio;
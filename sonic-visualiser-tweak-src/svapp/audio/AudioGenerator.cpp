@@ -30,12 +30,16 @@
 #include "ClipMixer.h"
 #include "ContinuousSynth.h"
 
+#include "bqvec/VectorOps.h"
+
 #include <iostream>
 #include <cmath>
 
 #include <QDir>
 #include <QFile>
 
+using breakfastquay::v_add_with_gain;
+
 const sv_frame_t
 AudioGenerator::m_processingBlockSize = 1024;
 
@@ -444,15 +448,10 @@ AudioGenerator::mixDenseTimeValueModel(ModelId modelId,
 
     if (startFrame >= fadeIn/2) {
 
-        auto data = dtvm->getMultiChannelData(0, modelChannels - 1,
-                                              startFrame - fadeIn/2,
-                                              frames + fadeOut/2 + fadeIn/2);
-
-        for (int c = 0; c < modelChannels; ++c) {
-            copy(data[c].begin(), data[c].end(), m_channelBuffer[c]);
-        }
-
-        got = data[0].size();
+        got = dtvm->readMultiChannelData(0, modelChannels - 1,
+                                         startFrame - fadeIn/2,
+                                         frames + fadeOut/2 + fadeIn/2,
+                                         m_channelBuffer);
 
     } else {
         sv_frame_t missing = fadeIn/2 - startFrame;
@@ -464,14 +463,15 @@ AudioGenerator::mixDenseTimeValueModel(ModelId modelId,
                  << ", missing = " << missing << endl;
         }
 
-        auto data = dtvm->getMultiChannelData(0, modelChannels - 1,
-                                              startFrame,
-                                              frames + fadeOut/2);
+        std::vector<float *> offsetBuffers(modelChannels);
         for (int c = 0; c < modelChannels; ++c) {
-            copy(data[c].begin(), data[c].end(), m_channelBuffer[c] + missing);
+            offsetBuffers[c] = m_channelBuffer[c] + missing;
         }
 
-        got = data[0].size() + missing;
+        got = dtvm->readMultiChannelData(0, modelChannels - 1,
+                                         startFrame,
+                                         frames + fadeOut/2,
+                                         offsetBuffers.data()) + missing;
     }            
 
     for (int c = 0; c < m_targetChannelCount; ++c) {
@@ -497,18 +497,40 @@ AudioGenerator::mixDenseTimeValueModel(ModelId modelId,
                 / float(fadeIn);
         }
 
-        for (sv_frame_t i = 0; i < frames + fadeOut/2; ++i) {
-            float mult = channelGain;
-            if (i < fadeIn/2) {
-                mult = (mult * float(i)) / float(fadeIn);
+        // Only the frames within the fades need a gain of their own:
+        // everything between them gets the plain channel gain, which
+        // we apply in a single vector operation. Frames beyond those
+        // we got from the model are silent, so we skip them
+
+        const float *source = m_channelBuffer[sourceChannel];
+        float *target = buffer[c];
+
+        sv_frame_t end = std::min(frames + fadeOut/2, got);
+        sv_frame_t plainStart = fadeIn/2;
+        sv_frame_t plainEnd = std::min(frames - fadeOut/2 + 1, end);
+        if (plainEnd < plainStart) plainEnd = plainStart;
+
+        auto mixFaded = [&](sv_frame_t from, sv_frame_t to) {
+            for (sv_frame_t i = from; i < to; ++i) {
+                float mult = channelGain;
+                if (i < fadeIn/2) {
+                    mult = (mult * float(i)) / float(fadeIn);
+                }
+                if (i > frames - fadeOut/2) {
+                    mult = (mult * float((frames + fadeOut/2) - i)) / float(fadeOut);
+                }
+                target[i] += mult * source[i];
             }
-            if (i > frames - fadeOut/2) {
-                mult = (mult * float((frames + fadeOut/2) - i)) / float(fadeOut);
-            }
-            float val = m_channelBuffer[sourceChannel][i];
-            if (i >= got) val = 0.f;
-            buffer[c][i] += mult * val;
+        };
+
+        mixFaded(0, std::min(plainStart, end));
+
+        if (plainEnd > plainStart) {
+            v_add_with_gain(target + plainStart, source + plainStart,
+                            channelGain, int(plainEnd - plainStart));
         }
+
+        mixFaded(plainEnd, end);
     }
 
     return got;
@@ -551,7 +573,9 @@ AudioGenerator::mixClipModel(ModelId modelId,
 
     NoteOffSet &noteOffs = m_noteOffs[modelId];
 
-    float **bufferIndexes = new float *[m_targetChannelCount];
+    // (this keeps its capacity, so allocates only the first time)
+    m_bufferIndexes.resize(m_targetChannelCount);
+    float **bufferIndexes = m_bufferIndexes.data();
 
     //!!! + for first block, prime with notes already active
     
@@ -668,8 +692,6 @@ AudioGenerator::mixClipModel(ModelId modelId,
         clipMixer->mix(bufferIndexes, gain, starts, ends);
     }
 
-    delete[] bufferIndexes;
-
     return got;
 }
 
@@ -700,7 +722,9 @@ AudioGenerator::mixContinuousSynthModel(ModelId modelId,
               << ", blocks " << blocks << endl;
 #endif
     
-    float **bufferIndexes = new float *[m_targetChannelCount];
+    // (this keeps its capacity, so allocates only the first time)
+    m_bufferIndexes.resize(m_targetChannelCount);
+    float **bufferIndexes = m_bufferIndexes.data();
 
     for (int i = 0; i < blocks; ++i) {
 
@@ -744,8 +768,6 @@ AudioGenerator::mixContinuousSynthModel(ModelId modelId,
                    f0);
     }
 
-    delete[] bufferIndexes;
-
     return got;
 }
 
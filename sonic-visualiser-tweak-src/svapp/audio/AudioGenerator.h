@@ -181,6 +181,8 @@ protected:
     float **m_channelBuffer;
     sv_frame_t m_channelBufSiz;
     int m_channelBufCount;
+
+    std::vector<float *> m_bufferIndexes;
 };
 
 #endif
@@ -20,6 +20,11 @@
 
 #include "base/Debug.h"
 
+#include "bqvec/VectorOps.h"
+
+using breakfastquay::v_zero;
+using breakfastquay::v_add_with_gain;
+
 //#define DEBUG_CLIP_MIXER 1
 
 ClipMixer::ClipMixer(int channels, sv_samplerate_t sampleRate, sv_frame_t blockSize) :
@@ -29,7 +34,8 @@ ClipMixer::ClipMixer(int channels, sv_samplerate_t sampleRate, sv_frame_t blockS
     m_clipData(nullptr),
     m_clipLength(0),
     m_clipF0(0),
-    m_clipRate(0)
+    m_clipRate(0),
+    m_bus(blockSize, 0.f)
 {
 }
 
@@ -122,89 +128,125 @@ ClipMixer::getResampledClipDuration(double frequency)
 void
 ClipMixer::mix(float **toBuffers, 
                float gain,
-               std::vector<NoteStart> newNotes, 
-               std::vector<NoteEnd> endingNotes)
+               const std::vector<NoteStart> &newNotes, 
+               const std::vector<NoteEnd> &endingNotes)
 {
-    foreach (NoteStart note, newNotes) {
+    for (const auto &note: newNotes) {
         if (note.frequency > 20 && 
             note.frequency < 5000) {
             m_playing.push_back(note);
         }
     }
 
-    std::vector<NoteStart> remaining;
-
-    float *levels = new float[m_channels];
-
 #ifdef DEBUG_CLIP_MIXER
     cerr << "ClipMixer::mix: have " << m_playing.size() << " playing note(s)"
          << " and " << endingNotes.size() << " note(s) ending here"
          << endl;
 #endif
 
-    foreach (NoteStart note, m_playing) {
+    // Render the notes that share the first unmixed note's pan
+    // position into the bus, then mix the bus into the outputs, and
+    // repeat until every note has been seen. These vectors keep
+    // their capacity from one block to the next
+    
+    m_remaining.clear();
+    m_mixed.assign(m_playing.size(), 0);
 
-        for (int c = 0; c < m_channels; ++c) {
-            levels[c] = note.level * gain;
-        }
-        if (note.pan != 0.0 && m_channels == 2) {
-            levels[0] *= 1.0f - note.pan;
-            levels[1] *= note.pan + 1.0f;
-        }
+    for (size_t first = 0; first < m_playing.size(); ++first) {
+
+        if (m_mixed[first]) continue;
+        
+        float pan = m_playing[first].pan;
+        bool any = false;
+
+        v_zero(m_bus.data(), int(m_blockSize));
 
-        sv_frame_t start = note.frameOffset;
-        sv_frame_t durationHere = m_blockSize;
-        if (start > 0) durationHere = m_blockSize - start;
-
-        bool ending = false;
-
-        foreach (NoteEnd end, endingNotes) {
-            if (end.frequency == note.frequency &&
-                // This is > rather than >= because if we have a
-                // note-off and a note-on at the same time, the
-                // note-off must be switching off an earlier note-on,
-                // not the current one (zero-duration notes are
-                // forbidden earlier in the pipeline)
-                end.frameOffset > start &&
-                end.frameOffset <= m_blockSize) {
-                ending = true;
-                durationHere = end.frameOffset;
-                if (start > 0) durationHere = end.frameOffset - start;
-                break;
+        for (size_t i = first; i < m_playing.size(); ++i) {
+            if (m_mixed[i] || m_playing[i].pan != pan) continue;
+            m_mixed[i] = 1;
+            if (mixVoice(m_playing[i], endingNotes)) {
+                any = true;
             }
         }
 
-        sv_frame_t clipDuration = getResampledClipDuration(note.frequency);
-        if (start + clipDuration > 0) {
-            if (start < 0 && start + clipDuration < durationHere) {
-                durationHere = start + clipDuration;
-            }
-            if (durationHere > 0) {
-                mixNote(toBuffers,
-                        levels,
-                        note.frequency,
-                        start < 0 ? -start : 0,
-                        start > 0 ?  start : 0,
-                        durationHere,
-                        ending);
-            }
+        if (any) {
+            mixBus(toBuffers, gain, pan);
         }
+    }
 
-        if (!ending) {
-            NoteStart adjusted = note;
-            adjusted.frameOffset -= m_blockSize;
-            remaining.push_back(adjusted);
+    m_playing.swap(m_remaining);
+}
+
+bool
+ClipMixer::mixVoice(const NoteStart &note,
+                    const std::vector<NoteEnd> &endingNotes)
+{
+    sv_frame_t start = note.frameOffset;
+    sv_frame_t durationHere = m_blockSize;
+    if (start > 0) durationHere = m_blockSize - start;
+
+    bool ending = false;
+
+    for (const auto &end: endingNotes) {
+        if (end.frequency == note.frequency &&
+            // This is > rather than >= because if we have a
+            // note-off and a note-on at the same time, the
+            // note-off must be switching off an earlier note-on,
+            // not the current one (zero-duration notes are
+            // forbidden earlier in the pipeline)
+            end.frameOffset > start &&
+            end.frameOffset <= m_blockSize) {
+            ending = true;
+            durationHere = end.frameOffset;
+            if (start > 0) durationHere = end.frameOffset - start;
+            break;
         }
     }
 
-    delete[] levels;
+    bool mixed = false;
+    
+    sv_frame_t clipDuration = getResampledClipDuration(note.frequency);
+    if (start + clipDuration > 0) {
+        if (start < 0 && start + clipDuration < durationHere) {
+            durationHere = start + clipDuration;
+        }
+        if (durationHere > 0) {
+            mixNote(m_bus.data(),
+                    note.level,
+                    note.frequency,
+                    start < 0 ? -start : 0,
+                    start > 0 ?  start : 0,
+                    durationHere,
+                    ending);
+            mixed = true;
+        }
+    }
+
+    if (!ending) {
+        NoteStart adjusted = note;
+        adjusted.frameOffset -= m_blockSize;
+        m_remaining.push_back(adjusted);
+    }
+
+    return mixed;
+}
 
-    m_playing = remaining;
+void
+ClipMixer::mixBus(float **toBuffers, float gain, float pan)
+{
+    for (int c = 0; c < m_channels; ++c) {
+        float level = gain;
+        if (pan != 0.0 && m_channels == 2) {
+            if (c == 0) level *= 1.0f - pan;
+            else level *= pan + 1.0f;
+        }
+        v_add_with_gain(toBuffers[c], m_bus.data(), level, int(m_blockSize));
+    }
 }
 
 void
-ClipMixer::mixNote(float **toBuffers,
-                   float *levels,
+ClipMixer::mixNote(float *toBuffer,
+                   float level,
                    float frequency,
                    sv_frame_t sourceOffset,
                    sv_frame_t targetOffset,
@@ -214,6 +256,7 @@ ClipMixer::mixNote(float **toBuffers,
     if (!m_clipData) return;
 
     double ratio = getResampleRatioFor(frequency);
+    double step = 1.0 / ratio;
     
     double releaseTime = 0.01;
     sv_frame_t releaseSampleCount = sv_frame_t(round(releaseTime * m_sampleRate));
@@ -222,32 +265,54 @@ ClipMixer::mixNote(float **toBuffers,
     }
     double releaseFraction = 1.0/double(releaseSampleCount);
 
-    for (sv_frame_t i = 0; i < sampleCount; ++i) {
+    // Stop short of the point where the interpolation would read
+    // beyond the clip, rather than testing for it on every sample
+
+    sv_frame_t count = sampleCount;
+    double lastSource = double(m_clipLength - 1) * ratio;
+    if (double(sourceOffset + count) > lastSource - 1.0) {
+        // (one sample short, in case of rounding in the step)
+        count = sv_frame_t(ceil(lastSource)) - 1 - sourceOffset;
+        if (count < 0) count = 0;
+        if (count > sampleCount) count = sampleCount;
+    }
 
-        sv_frame_t s = sourceOffset + i;
+    float *out = toBuffer + targetOffset;
+    
+    for (sv_frame_t i = 0; i < count; ++i) {
 
-        double os = double(s) / ratio;
-        sv_frame_t osi = sv_frame_t(floor(os));
+        double os = double(sourceOffset + i) * step;
+        sv_frame_t osi = sv_frame_t(os);
 
         //!!! just linear interpolation for now (same as SV's sample
         //!!! player). a small sinc kernel would be better and
         //!!! probably "good enough"
-        double value = 0.0;
-        if (osi < m_clipLength) {
-            value += m_clipData[osi];
-        }
-        if (osi + 1 < m_clipLength) {
-            value += (m_clipData[osi + 1] - m_clipData[osi]) * (os - double(osi));
-        }
+        double value = m_clipData[osi] +
+            (m_clipData[osi + 1] - m_clipData[osi]) * (os - double(osi));
          
         if (isEnd && i + releaseSampleCount > sampleCount) {
             value *= releaseFraction * double(sampleCount - i); // linear ramp for release
         }
 
-        for (int c = 0; c < m_channels; ++c) {
-            toBuffers[c][targetOffset + i] += float(levels[c] * value);
-        }
+        out[i] += float(level * value);
     }
-}
 
+    // Then the few samples at the end of the clip, checking bounds
+    
+    for (sv_frame_t i = count; i < sampleCount; ++i) {
+
+        double os = double(sourceOffset + i) * step;
+        sv_frame_t osi = sv_frame_t(os);
+        if (osi >= m_clipLength) break;
 
+        double value = m_clipData[osi];
+        if (osi + 1 < m_clipLength) {
+            value += (m_clipData[osi + 1] - m_clipData[osi]) * (os - double(osi));
+        }
+        if (isEnd && i + releaseSampleCount > sampleCount) {
+            value *= releaseFraction * double(sampleCount - i);
+        }
+        
+        out[i] += float(level * value);
+    }
+}
@@ -26,6 +26,11 @@
  * clip. (i.e. this is an implementation of a digital sampler in the
  * musician's sense.) This can mix any number of notes of arbitrary
  * frequency, so long as they all use the same sample clip.
+ *
+ * Notes are rendered in mono into a single bus for each pan position
+ * (usually there is only one), which is then added to each output
+ * channel in one vector operation. The cost per output frame grows
+ * with the number of sounding notes, but not with the channel count.
  */
 
 class ClipMixer
@@ -61,8 +66,8 @@ public:
 
     void mix(float **toBuffers, 
              float gain,
-             std::vector<NoteStart> newNotes, 
-             std::vector<NoteEnd> endingNotes);
+             const std::vector<NoteStart> &newNotes, 
+             const std::vector<NoteEnd> &endingNotes);
 
 private:
     int m_channels;
@@ -77,12 +82,20 @@ private:
     sv_samplerate_t m_clipRate;
 
     std::vector<NoteStart> m_playing;
+    std::vector<NoteStart> m_remaining;
+    std::vector<char> m_mixed;
+    std::vector<float> m_bus;
 
     double getResampleRatioFor(double frequency);
     sv_frame_t getResampledClipDuration(double frequency);
 
-    void mixNote(float **toBuffers, 
-                 float *levels,
+    bool mixVoice(const NoteStart &note,
+                  const std::vector<NoteEnd> &endingNotes);
+
+    void mixBus(float **toBuffers, float gain, float pan);
+
+    void mixNote(float *toBuffer, 
+                 float level,
                  float frequency,
                  sv_frame_t sourceOffset, // within resampled note
                  sv_frame_t targetOffset, // within target buffer
@@ -17,15 +17,21 @@
 #include "base/Debug.h"
 #include "system/System.h"
 
+#include "bqvec/VectorOps.h"
+
 #include <cmath>
 
+using breakfastquay::v_zero;
+using breakfastquay::v_add_with_gain;
+
 ContinuousSynth::ContinuousSynth(int channels, sv_samplerate_t sampleRate, sv_frame_t blockSize, int waveType) :
     m_channels(channels),
     m_sampleRate(sampleRate),
     m_blockSize(blockSize),
     m_prevF0(-1.0),
     m_phase(0.0),
-    m_wavetype(waveType) // 0: 3 sinusoids, 1: 1 sinusoid, 2: sawtooth, 3: square
+    m_wavetype(waveType), // 0: 3 sinusoids, 1: 1 sinusoid, 2: sawtooth, 3: square
+    m_bus(blockSize, 0.f)
 {
 }
 
@@ -55,15 +61,11 @@ ContinuousSynth::mix(float **toBuffers, float gain, float pan, float f0f)
 
     sv_frame_t fadeLength = 100;
 
-    float *levels = new float[m_channels];
+    // The waveform is synthesised once, in mono, and then added to
+    // each channel with that channel's gain
     
-    for (int c = 0; c < m_channels; ++c) {
-        levels[c] = gain * 0.5f; // scale gain otherwise too loud compared to source
-    }
-    if (pan != 0.0 && m_channels == 2) {
-        levels[0] *= 1.0f - pan;
-        levels[1] *= pan + 1.0f;
-    }
+    float *bus = m_bus.data();
+    v_zero(bus, int(m_blockSize));
 
 //    cerr << "ContinuousSynth::mix: f0 = " << f0 << " (from " << m_prevF0 << "), phase = " << m_phase << endl;
 
@@ -136,14 +138,19 @@ ContinuousSynth::mix(float **toBuffers, float gain, float pan, float f0f)
                 else v = v * (1.0 - (double(i) / double(fadeLength)));
             }
 
-            for (int c = 0; c < m_channels; ++c) {
-                toBuffers[c][i] += float(levels[c] * v);
-            }
+            bus[i] += float(v);
         }
     }    
 
-    m_prevF0 = f0;
+    for (int c = 0; c < m_channels; ++c) {
+        float level = gain * 0.5f; // scale gain otherwise too loud compared to source
+        if (pan != 0.0 && m_channels == 2) {
+            if (c == 0) level *= 1.0f - pan;
+            else level *= pan + 1.0f;
+        }
+        v_add_with_gain(toBuffers[c], bus, level, int(m_blockSize));
+    }
 
-    delete[] levels;
+    m_prevF0 = f0;
 }
 
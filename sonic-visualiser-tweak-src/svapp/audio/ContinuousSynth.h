@@ -17,6 +17,8 @@
 
 #include "base/BaseTypes.h"
 
+#include <vector>
+
 /**
  * Mix into a target buffer a signal synthesised so as to sound at a
  * specific frequency. The frequency may change with each processing
@@ -60,6 +62,8 @@ private:
     double m_phase;
 
     int m_wavetype;
+
+    std::vector<float> m_bus;
 };
 
 #endif
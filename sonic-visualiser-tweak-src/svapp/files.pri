@@ -10,6 +10,7 @@ SVAPP_HEADERS += \
 	   framework/Document.h \
            framework/MainWindowBase.h \
            framework/OSCScript.h \
+           framework/SessionSaver.h \
            framework/SVFileReader.h \
            framework/TransformUserConfigurator.h \
            framework/VersionTester.h
@@ -24,6 +25,7 @@ SVAPP_SOURCES += \
 	   framework/Align.cpp \
 	   framework/Document.cpp \
            framework/MainWindowBase.cpp \
+           framework/SessionSaver.cpp \
            framework/SVFileReader.cpp \
            framework/TransformUserConfigurator.cpp \
            framework/VersionTester.cpp
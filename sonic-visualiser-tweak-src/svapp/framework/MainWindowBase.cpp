@@ -56,6 +56,7 @@
 #include "data/fileio/MIDIFileWriter.h"
 #include "data/fileio/CSVFileWriter.h"
 #include "data/fileio/BZipFileDevice.h"
+#include "data/fileio/SessionContainer.h"
 #include "data/fileio/FileSource.h"
 #include "data/fileio/AudioFileReaderFactory.h"
 #include "rdf/RDFImporter.h"
@@ -73,6 +74,7 @@
 #include "data/osc/OSCQueue.h"
 #include "data/midi/MIDIInput.h"
 #include "OSCScript.h"
+#include "SessionSaver.h"
 
 #include "system/System.h"
 
@@ -165,6 +167,8 @@ MainWindowBase::MainWindowBase(AudioMode audioMode,
     m_initialDarkBackground(false),
     m_defaultFfwdRwdStep(2, 0),
     m_audioRecordMode(RecordCreateAdditionalModel),
+    m_sessionSaver(nullptr),
+    m_reportSessionSave(false),
     m_statusLabel(nullptr),
     m_iconsVisibleInMenus(true),
     m_menuShortcutMapper(nullptr)
@@ -187,6 +191,12 @@ MainWindowBase::MainWindowBase(AudioMode audioMode,
             this, SLOT(documentModified()));
     connect(CommandHistory::getInstance(), SIGNAL(documentRestored()),
             this, SLOT(documentRestored()));
+
+    m_sessionSaver = new SessionSaver(this);
+    connect(m_sessionSaver, SIGNAL(progress(QString, int)),
+            this, SLOT(sessionSaveProgress(QString, int)));
+    connect(m_sessionSaver, SIGNAL(finished(QString, bool, QString)),
+            this, SLOT(sessionSaveFinished(QString, bool, QString)));
     
     SVDEBUG << "MainWindowBase: Creating view manager" << endl;
 
@@ -314,6 +324,11 @@ MainWindowBase::~MainWindowBase()
 {
     SVDEBUG << "MainWindowBase::~MainWindowBase" << endl;
 
+    // Let any save in progress complete, without reporting back to
+    // a window that is going away
+    disconnect(m_sessionSaver, nullptr, this, nullptr);
+    delete m_sessionSaver;
+
     // We have to delete the breakfastquay::SystemPlaybackTarget or
     // breakfastquay::SystemAudioIO object (whichever we have -- it
     // depends on whether we handle recording or not) before we delete
@@ -2142,8 +2157,20 @@ MainWindowBase::openSession(FileSource source)
     QXmlInputSource *inputSource = nullptr;
     BZipFileDevice *bzFile = nullptr;
     QFile *rawFile = nullptr;
-
-    if (source.getExtension().toLower() == sessionExt) {
+    // Shared with the models loaded from it, which decode their
+    // datasets from it only when first used
+    std::shared_ptr<SessionContainerReader> container;
+
+    if (source.getExtension().toLower() == sessionExt &&
+        SessionContainerReader::isSessionContainer(source.getLocalFilename())) {
+        container = std::make_shared<SessionContainerReader>
+            (source.getLocalFilename());
+        if (!container->isOK()) {
+            return FileOpenFailed;
+        }
+        inputSource = new QXmlInputSource;
+        inputSource->setData(container->getManifest());
+    } else if (source.getExtension().toLower() == sessionExt) {
         bzFile = new BZipFileDevice(source.getLocalFilename());
         if (!bzFile->open(QIODevice::ReadOnly)) {
             delete bzFile;
@@ -2171,6 +2198,7 @@ MainWindowBase::openSession(FileSource source)
     m_viewManager->clearSelections();
 
     SVFileReader reader(m_document, callback, source.getLocation());
+    reader.setSessionContainer(container);
     connect
             (&reader, SIGNAL(modelRegenerationFailed(QString, QString, QString)),
              this, SLOT(modelRegenerationFailed(QString, QString, QString)));
@@ -2715,46 +2743,84 @@ MainWindowBase::createDocument()
 bool
 MainWindowBase::saveSessionFile(QString path)
 {
-    try {
+    // Report the result here rather than in sessionSaveFinished, so
+    // that the wait cursor is gone before any message box appears
+    m_sessionSaver->waitForSave();
+    m_reportSessionSave = false;
 
-        TempWriteFile temp(path);
-
-        BZipFileDevice bzFile(temp.getTemporaryFilename());
-        if (!bzFile.open(QIODevice::WriteOnly)) {
-            cerr << "Failed to open session file \""
-                 << temp.getTemporaryFilename()
-                 << "\" for writing: "
-                 << bzFile.errorString() << endl;
-            return false;
-        }
+    QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
+    startSessionSave(path);
+    QString error;
+    bool succeeded = m_sessionSaver->waitForSave(&error);
+    QApplication::restoreOverrideCursor();
 
-        QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
+    if (!succeeded) {
+        QMessageBox::critical(this, tr("Failed to write file"),
+                              tr("<b>Save failed</b><p>Failed to write to file \"%1\": %2")
+                              .arg(path).arg(error));
+    }
+    return succeeded;
+}
 
-        QTextStream out(&bzFile);
-        out.setCodec(QTextCodec::codecForName("UTF-8"));
-        toXml(out, false);
-        out.flush();
+void
+MainWindowBase::saveSessionFileInBackground(QString path)
+{
+    m_sessionSaver->waitForSave();
+    m_reportSessionSave = true;
 
-        QApplication::restoreOverrideCursor();
+    QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
+    startSessionSave(path);
+    QApplication::restoreOverrideCursor();
+}
 
-        if (!bzFile.isOK()) {
-            QMessageBox::critical(this, tr("Failed to write file"),
-                                  tr("<b>Save failed</b><p>Failed to write to file \"%1\": %2")
-                                  .arg(path).arg(bzFile.errorString()));
-            bzFile.close();
-            return false;
+void
+MainWindowBase::startSessionSave(QString path)
+{
+    Preferences *prefs = Preferences::getInstance();
+    SessionSaver::Format format = SessionSaver::CompressedXml;
+    if (prefs->getSaveSessionContainers()) {
+        format = SessionSaver::Container;
+    } else if (prefs->getFastSessionCompression()) {
+        if (BZipFileDevice::isCodecSupported(BZipFileDevice::Zstd)) {
+            format = SessionSaver::ZstdXml;
+        } else {
+            format = SessionSaver::ParallelXml;
         }
+    }
+    m_sessionSaver->save(path, format, [this](QTextStream &out) {
+            toXml(out, false);
+        });
+}
 
-        bzFile.close();
-        temp.moveToTarget();
-        return true;
+bool
+MainWindowBase::waitForSessionSave()
+{
+    return m_sessionSaver->waitForSave();
+}
 
-    } catch (FileOperationFailed &f) {
-        
+void
+MainWindowBase::sessionSaveProgress(QString path, int percent)
+{
+    m_myStatusMessage = tr("Saving session to \"%1\": %2%")
+        .arg(QFileInfo(path).fileName()).arg(percent);
+    getStatusLabel()->setText(m_myStatusMessage);
+}
+
+void
+MainWindowBase::sessionSaveFinished(QString path, bool succeeded, QString error)
+{
+    m_myStatusMessage = "";
+    getStatusLabel()->setText(m_myStatusMessage);
+
+    if (!m_reportSessionSave) return;
+    m_reportSessionSave = false;
+
+    if (!succeeded) {
+        // The document was marked as saved when the save started
+        documentModified();
         QMessageBox::critical(this, tr("Failed to write file"),
                               tr("<b>Save failed</b><p>Failed to write to file \"%1\": %2")
-                              .arg(path).arg(f.what()));
-        return false;
+                              .arg(path).arg(error));
     }
 }
 
@@ -70,6 +70,7 @@ class ModelDataTableDialog;
 class QSignalMapper;
 class QShortcut;
 class AlignmentModel;
+class SessionSaver;
 
 namespace breakfastquay {
     class SystemPlaybackTarget;
@@ -162,7 +163,27 @@ public:
     virtual FileOpenStatus openSessionTemplate(QString templateName);
     virtual FileOpenStatus openSessionTemplate(FileSource source);
 
+    /**
+     * Save the session to the given path, returning only when it has
+     * been written. Report any failure to the user, and return false.
+     */
     virtual bool saveSessionFile(QString path);
+
+    /**
+     * Take a snapshot of the session and start saving it to the
+     * given path in the background (see SessionSaver), returning as
+     * soon as the snapshot has been taken. If the save fails, the
+     * failure is reported to the user and the document is marked as
+     * modified again.
+     */
+    virtual void saveSessionFileInBackground(QString path);
+
+    /**
+     * Wait for any background save to complete, and return true if
+     * it succeeded or if there was none.
+     */
+    virtual bool waitForSessionSave();
+
     virtual bool saveSessionTemplate(QString path);
 
     virtual bool exportLayerTo(Layer *layer, QString path, QString &error);
@@ -366,6 +387,9 @@ protected slots:
 
     virtual void emitHideSplash();
 
+    virtual void sessionSaveProgress(QString path, int percent);
+    virtual void sessionSaveFinished(QString path, bool succeeded, QString error);
+
     virtual void newerVersionAvailable(QString) { }
 
     virtual void menuActionMapperInvoked(QObject *);
@@ -440,6 +464,10 @@ protected:
     RealTime                 m_defaultFfwdRwdStep;
 
     AudioRecordMode          m_audioRecordMode;
+
+    SessionSaver            *m_sessionSaver;
+    bool                     m_reportSessionSave; // on completion
+    void startSessionSave(QString path);
     
     mutable QLabel *m_statusLabel;
     QLabel *getStatusLabel() const;
@@ -25,6 +25,7 @@
 #include "data/fileio/FileSource.h"
 
 #include "data/fileio/FileFinder.h"
+#include "data/fileio/SessionContainer.h"
 
 #include "data/model/ReadOnlyWaveFileModel.h"
 #include "data/model/EditableDenseThreeDimensionalModel.h"
@@ -37,6 +38,7 @@
 #include "data/model/BoxModel.h"
 #include "data/model/AlignmentModel.h"
 #include "data/model/AggregateWaveModel.h"
+#include "data/model/EventCommands.h"
 
 #include "transform/TransformFactory.h"
 
@@ -1088,6 +1090,59 @@ SVFileReader::readDatasetStart(const QXmlAttributes &attributes)
     }
 
     m_currentDataset = awaitingId;
+
+    QString blob = attributes.value("blob").trimmed();
+    if (blob != "") {
+        return readDatasetBlob(blob, modelId);
+    }
+    
+    return true;
+}
+
+bool
+SVFileReader::readDatasetBlob(QString blob, ModelId modelId)
+{
+    // The dataset's content is in a blob in the session container
+    // rather than in child elements. Hand it to the model, which
+    // decodes it in one go when it is first needed, typically when a
+    // layer showing it is first drawn; until then the model keeps
+    // the container open
+    
+    bool ok = false;
+    int index = blob.toInt(&ok);
+
+    const char *data = nullptr;
+    qint64 size = 0;
+    
+    if (!ok || !m_container || !m_container->getBlob(index, data, size)) {
+        SVCERR << "WARNING: SV-XML: Dataset refers to blob \"" << blob
+               << "\" which is not available" << endl;
+        return false;
+    }
+
+    if (auto dtdm = ModelById::getAs<EditableDenseThreeDimensionalModel>
+        (modelId)) {
+        if (!dtdm->setColumnsFromBlob(m_container, data, size)) {
+            SVCERR << "WARNING: SV-XML: Invalid 3-D dataset in blob "
+                   << index << endl;
+            return false;
+        }
+        return true;
+    }
+
+    auto editable = ModelById::getAs<EventEditable>(modelId);
+    if (!editable) {
+        SVCERR << "WARNING: SV-XML: Blob dataset found for model that cannot "
+               << "take one" << endl;
+        return false;
+    }
+    
+    if (!editable->setEventsFromBlob(m_container, data, size)) {
+        SVCERR << "WARNING: SV-XML: Invalid event dataset in blob "
+               << index << endl;
+        return false;
+    }
+    
     return true;
 }
 
@@ -22,12 +22,14 @@
 #include <QXmlDefaultHandler>
 
 #include <map>
+#include <memory>
 
 class Pane;
 class Model;
 class Path;
 class Document;
 class PlayParameters;
+class SessionContainerReader;
 
 class SVFileReaderPaneCallback
 {
@@ -181,6 +183,15 @@ public:
 
     // For loading a single layer onto an existing pane
     void setCurrentPane(Pane *pane) { m_currentPane = pane; }
+
+    // For loading from a session container, whose manifest is the
+    // XML being parsed and which holds the blobs referred to by its
+    // datasets. Models loaded from blobs share ownership of the
+    // container, as they decode them only when first used
+    void setSessionContainer(std::shared_ptr<const SessionContainerReader>
+                             container) {
+        m_container = container;
+    }
     
     bool startElement(const QString &namespaceURI,
                       const QString &localName,
@@ -217,6 +228,7 @@ protected:
     bool readView(const QXmlAttributes &);
     bool readLayer(const QXmlAttributes &);
     bool readDatasetStart(const QXmlAttributes &);
+    bool readDatasetBlob(QString blob, ModelId modelId);
     bool addBinToDataset(const QXmlAttributes &);
     bool addPointToDataset(const QXmlAttributes &);
     bool addRowToDataset(const QXmlAttributes &);
@@ -257,6 +269,7 @@ protected:
     };
     
     Document *m_document;
+    std::shared_ptr<const SessionContainerReader> m_container;
     SVFileReaderPaneCallback &m_paneCallback;
     QString m_location;
     Pane *m_currentPane;
@@ -0,0 +1,381 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "SessionSaver.h"
+
+#include "base/Debug.h"
+#include "base/Exceptions.h"
+#include "base/TempWriteFile.h"
+#include "base/Thread.h"
+#include "base/XmlExportable.h"
+#include "data/fileio/BZipFileDevice.h"
+#include "data/fileio/SessionContainer.h"
+
+#include <QBuffer>
+#include <QTextStream>
+#include <QTextCodec>
+
+#include <vector>
+#include <algorithm>
+
+/**
+ * Blob sink used while taking the snapshot. It only collects the
+ * blobs, and the encoders for those that are deferred, so that the
+ * save thread can encode and write them afterwards.
+ */
+class SessionSaver::SnapshotSink : public XmlExportable::BlobSink
+{
+public:
+    SnapshotSink(std::map<QString, QByteArray> &&previous) :
+        m_previous(std::move(previous)) { }
+
+    struct Blob {
+        QString key;
+        QByteArray data;
+        Encoder encoder; // if set, data is still to be encoded
+    };
+
+    std::vector<Blob> m_blobs;
+
+    int addBlob(const QByteArray &data, QString key) override {
+        return add({ key, data, Encoder() });
+    }
+
+    int addDeferredBlob(Encoder encoder, QString key) override {
+        return add({ key, QByteArray(), encoder });
+    }
+
+    int findBlob(QString key) override {
+        if (key == "") return -1;
+        auto itr = m_keys.find(key);
+        if (itr != m_keys.end()) {
+            return itr->second;
+        }
+        auto pitr = m_previous.find(key);
+        if (pitr != m_previous.end()) {
+            return add({ key, pitr->second, Encoder() });
+        }
+        return -1;
+    }
+
+private:
+    std::map<QString, QByteArray> m_previous;
+    std::map<QString, int> m_keys;
+
+    int add(const Blob &blob) {
+        int index = int(m_blobs.size());
+        if (blob.key != "") {
+            m_keys[blob.key] = index;
+        }
+        m_blobs.push_back(blob);
+        return index;
+    }
+};
+
+/**
+ * Fragment sink used while taking the snapshot. It notes where in the
+ * XML each deferred fragment belongs, so that the save thread can
+ * write the fragments and splice them in afterwards.
+ */
+class SessionSaver::SnapshotFragments : public XmlExportable::FragmentSink
+{
+public:
+    SnapshotFragments(QIODevice *device) : m_device(device) { }
+
+    struct Fragment {
+        qint64 position;
+        Writer writer;
+        int precision;
+        QTextStream::RealNumberNotation notation;
+    };
+
+    std::vector<Fragment> m_fragments;
+
+    void addDeferredFragment(QTextStream &out, Writer writer) override {
+        if (out.device() != m_device) {
+            // Not the snapshot stream, perhaps a string being built
+            // up by the exportable, so we can't say where it goes
+            writer(out);
+            return;
+        }
+        out.flush();
+        m_fragments.push_back({ m_device->pos(), writer,
+                                out.realNumberPrecision(),
+                                out.realNumberNotation() });
+    }
+
+private:
+    QIODevice *m_device;
+};
+
+class SessionSaver::SaveThread : public Thread
+{
+public:
+    SaveThread(SessionSaver &saver, QString path, Format format,
+               const QByteArray &xml, SnapshotSink *sink,
+               SnapshotFragments *fragments) :
+        Thread(Thread::NonRTThread),
+        m_path(path),
+        m_saver(saver),
+        m_format(format),
+        m_xml(xml),
+        m_sink(sink),
+        m_fragments(fragments),
+        m_lastPercent(-1)
+    { }
+
+    virtual ~SaveThread() {
+        delete m_sink;
+        delete m_fragments;
+    }
+
+    bool isContainer() const { return m_sink != nullptr; }
+
+    QString m_path;
+    QString m_error;
+
+    // Blobs to keep for the next save, keyed as in the sink
+    std::map<QString, QByteArray> m_blobs;
+
+protected:
+    void run() override {
+        completeXml();
+        try {
+            TempWriteFile temp(m_path);
+            if (m_sink) {
+                writeContainer(temp.getTemporaryFilename());
+            } else {
+                writeCompressedXml(temp.getTemporaryFilename());
+            }
+            if (m_error == "") {
+                temp.moveToTarget();
+            }
+        } catch (const FileOperationFailed &f) {
+            m_error = f.what();
+        }
+        if (m_error != "") {
+            SVCERR << "SessionSaver: Failed to save session to \""
+                   << m_path << "\": " << m_error << endl;
+        }
+    }
+
+private:
+    SessionSaver &m_saver;
+    Format m_format;
+    QByteArray m_xml;
+    SnapshotSink *m_sink;
+    SnapshotFragments *m_fragments;
+    int m_lastPercent;
+
+    void completeXml() {
+
+        if (m_fragments->m_fragments.empty()) {
+            return;
+        }
+        
+        QByteArray xml;
+        QBuffer buffer(&xml);
+        buffer.open(QIODevice::WriteOnly);
+        qint64 from = 0;
+
+        for (const auto &f: m_fragments->m_fragments) {
+            buffer.write(m_xml.constData() + from, f.position - from);
+            from = f.position;
+            QTextStream out(&buffer);
+            out.setCodec(QTextCodec::codecForName("UTF-8"));
+            out.setRealNumberPrecision(f.precision);
+            out.setRealNumberNotation(f.notation);
+            f.writer(out);
+            out.flush();
+        }
+
+        buffer.write(m_xml.constData() + from, m_xml.size() - from);
+        buffer.close();
+
+        SVDEBUG << "SessionSaver: Wrote " << m_fragments->m_fragments.size()
+                << " deferred fragments, for " << xml.size()
+                << " bytes of XML in all" << endl;
+        
+        m_xml = xml;
+    }
+
+    void reportProgress(qint64 done, qint64 total) {
+        int percent = int(total > 0 ? (done * 100) / total : 100);
+        if (percent != m_lastPercent) {
+            m_lastPercent = percent;
+            emit m_saver.progress(m_path, percent);
+        }
+    }
+
+    void writeContainer(QString filename) {
+
+        SessionContainerWriter writer(filename);
+
+        // Count the manifest as one more blob, for progress purposes
+        qint64 total = qint64(m_sink->m_blobs.size()) + 1;
+        qint64 done = 0;
+
+        for (auto &blob: m_sink->m_blobs) {
+            if (!writer.isOK()) break;
+            if (blob.encoder) {
+                blob.data = blob.encoder();
+                blob.encoder = SnapshotSink::Encoder();
+            }
+            // Keys have already been resolved by the snapshot sink,
+            // so the writer has no need of them
+            writer.addBlob(blob.data, QString());
+            if (blob.key != "") {
+                m_blobs[blob.key] = blob.data;
+            }
+            reportProgress(++done, total);
+        }
+
+        if (!writer.finish(m_xml)) {
+            m_error = writer.getError();
+        }
+        reportProgress(total, total);
+    }
+
+    void writeCompressedXml(QString filename) {
+
+        BZipFileDevice bzFile(filename, m_format == ZstdXml ?
+                              BZipFileDevice::Zstd :
+                              BZipFileDevice::BZip2,
+                              m_format != CompressedXml);
+        if (!bzFile.open(QIODevice::WriteOnly)) {
+            m_error = bzFile.errorString();
+            return;
+        }
+
+        const qint64 blockSize = 1024 * 1024;
+        const qint64 total = m_xml.size();
+        qint64 done = 0;
+
+        while (done < total && bzFile.isOK()) {
+            qint64 n = std::min(blockSize, total - done);
+            if (bzFile.write(m_xml.constData() + done, n) != n) {
+                break;
+            }
+            done += n;
+            reportProgress(done, total);
+        }
+
+        // Most of the data is compressed and written during close
+        bzFile.close();
+        if (done < total || !bzFile.isOK()) {
+            m_error = bzFile.errorString();
+        }
+    }
+};
+
+SessionSaver::SessionSaver(QObject *parent) :
+    QObject(parent),
+    m_thread(nullptr),
+    m_lastSucceeded(true)
+{
+}
+
+SessionSaver::~SessionSaver()
+{
+    waitForSave();
+}
+
+void
+SessionSaver::save(QString path, Format format, SessionWriter writer)
+{
+    waitForSave();
+
+    QByteArray xml;
+    SnapshotSink *sink = nullptr;
+    SnapshotFragments *fragments = nullptr;
+
+    if (format == Container) {
+        sink = new SnapshotSink(std::move(m_blobs));
+        m_blobs.clear();
+    }
+
+    {
+        QBuffer buffer(&xml);
+        buffer.open(QIODevice::WriteOnly);
+        QTextStream out(&buffer);
+        out.setCodec(QTextCodec::codecForName("UTF-8"));
+
+        fragments = new SnapshotFragments(&buffer);
+        
+        XmlExportable::BlobSink *previousBlobSink = nullptr;
+        if (sink) {
+            previousBlobSink = XmlExportable::setBlobSink(sink);
+        }
+        XmlExportable::FragmentSink *previousFragmentSink =
+            XmlExportable::setFragmentSink(fragments);
+        
+        writer(out);
+        out.flush();
+
+        XmlExportable::setFragmentSink(previousFragmentSink);
+        if (sink) {
+            XmlExportable::setBlobSink(previousBlobSink);
+        }
+    }
+
+    SVDEBUG << "SessionSaver::save: Snapshot of " << xml.size()
+            << " bytes of XML taken, with " << fragments->m_fragments.size()
+            << " fragments deferred, writing to \"" << path << "\"" << endl;
+
+    m_thread = new SaveThread(*this, path, format, xml, sink, fragments);
+    connect(m_thread, SIGNAL(finished()), this, SLOT(threadFinished()));
+    m_thread->start();
+}
+
+bool
+SessionSaver::waitForSave(QString *error)
+{
+    collect();
+    if (error) *error = m_lastError;
+    return m_lastSucceeded;
+}
+
+void
+SessionSaver::threadFinished()
+{
+    // This may arrive after waitForSave has already collected the
+    // thread that sent it, and perhaps started another
+    if (sender() == m_thread) {
+        collect();
+    }
+}
+
+void
+SessionSaver::collect()
+{
+    if (!m_thread) return;
+
+    SaveThread *thread = m_thread;
+    m_thread = nullptr;
+    thread->wait();
+
+    QString path = thread->m_path;
+    m_lastError = thread->m_error;
+    m_lastSucceeded = (m_lastError == "");
+
+    // Blobs not used in this save belong to data that has since
+    // changed or gone away, so they are not kept either
+    if (thread->isContainer()) {
+        m_blobs = std::move(thread->m_blobs);
+    }
+
+    thread->deleteLater();
+
+    emit finished(path, m_lastSucceeded, m_lastError);
+}
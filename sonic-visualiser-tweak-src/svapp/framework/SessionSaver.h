@@ -0,0 +1,113 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_SESSION_SAVER_H
+#define SV_SESSION_SAVER_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+
+#include <functional>
+#include <map>
+
+class QTextStream;
+
+/**
+ * Save sessions to file without holding up the GUI for the whole of
+ * the save.
+ *
+ * A save starts with a snapshot taken on the calling thread: the
+ * session XML is written to memory, except that models with large
+ * datasets contribute a copy of their data instead of writing it
+ * there and then (see XmlExportable::FragmentSink and, for session
+ * containers, XmlExportable::BlobSink). Writing the XML for that
+ * data, compression, blob encoding and the file writing itself then
+ * happen on a background thread, so the models can go on being
+ * edited while the file is written without affecting what is saved.
+ *
+ * Saving is incremental for session containers. Blobs are kept from
+ * one save to the next, keyed by the revision of the data they hold,
+ * and a model that has not changed since the previous save reuses
+ * its blob instead of being encoded again.
+ */
+class SessionSaver : public QObject
+{
+    Q_OBJECT
+
+public:
+    SessionSaver(QObject *parent = 0);
+
+    /**
+     * Wait for any save in progress to complete before returning.
+     */
+    virtual ~SessionSaver();
+
+    enum Format {
+        CompressedXml, // the usual bzipped XML
+        ParallelXml,   // bzipped XML in blocks compressed in parallel
+        ZstdXml,       // XML compressed with zstd in parallel, if supported
+        Container      // see SessionContainerWriter
+    };
+
+    typedef std::function<void(QTextStream &)> SessionWriter;
+
+    /**
+     * Take a snapshot of the session, by calling the given function
+     * to write its XML to a stream, and start writing it to the given
+     * path in the given format. Return as soon as the snapshot is
+     * complete. If another save is still in progress, wait for that
+     * to finish first.
+     */
+    void save(QString path, Format format, SessionWriter writer);
+
+    bool isSaving() const { return m_thread != nullptr; }
+
+    /**
+     * Wait for any save in progress to complete, and return true if
+     * it (or, if there is none, the last save) succeeded. If error is
+     * non-null, also return any error message through it. The
+     * finished signal is emitted before this returns, if it has not
+     * been already.
+     */
+    bool waitForSave(QString *error = 0);
+
+signals:
+    /**
+     * Emitted from the saving thread as the save progresses.
+     */
+    void progress(QString path, int percent);
+
+    /**
+     * Emitted once for each save, when it has completed.
+     */
+    void finished(QString path, bool succeeded, QString error);
+
+private slots:
+    void threadFinished();
+
+private:
+    class SnapshotSink;
+    class SnapshotFragments;
+    class SaveThread;
+
+    SaveThread *m_thread;
+    std::map<QString, QByteArray> m_blobs;
+    bool m_lastSucceeded;
+    QString m_lastError;
+
+    void collect();
+};
+
+#endif
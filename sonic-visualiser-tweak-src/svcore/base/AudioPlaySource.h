@@ -83,6 +83,12 @@ public:
      */
     virtual sv_samplerate_t getDeviceSampleRate() const = 0;
 
+    /**
+     * Return the speed at which playback is proceeding, as a multiple
+     * of normal speed (e.g. 2.0 for twice as fast).
+     */
+    virtual double getPlaySpeed() const = 0;
+
     /**
      * Get the block size of the target audio device.  This may be an
      * estimate or upper bound, if the target has a variable block
@@ -0,0 +1,128 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "CacheDirectory.h"
+
+#include "TempDirectory.h"
+#include "Exceptions.h"
+#include "Debug.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSettings>
+#include <QMutexLocker>
+
+CacheDirectory::CacheDirectory(QString name, int defaultLimitMB) :
+    m_name(name)
+{
+    QSettings settings;
+    settings.beginGroup("CacheDirectory");
+    int mb = settings.value(QString("%1-limit-mb").arg(name),
+                            defaultLimitMB).toInt();
+    settings.endGroup();
+    m_limit = qint64(mb) * 1024 * 1024;
+}
+
+QString
+CacheDirectory::getPath()
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (m_path != "") return m_path;
+
+    QDir dir(TempDirectory::getInstance()->getContainingPath());
+    QFileInfo fi(dir.filePath(m_name));
+
+    if ((fi.exists() && !fi.isDir()) ||
+        (!fi.exists() && !dir.mkdir(m_name))) {
+        throw DirectoryCreationFailed(fi.filePath());
+    }
+
+    m_path = fi.filePath();
+    return m_path;
+}
+
+QString
+CacheDirectory::getFilePath(QString filename)
+{
+    return QDir(getPath()).filePath(filename);
+}
+
+qint64
+CacheDirectory::getLimit() const
+{
+    return m_limit;
+}
+
+void
+CacheDirectory::touch(QString filename)
+{
+    QFile f(getFilePath(filename));
+    if (!f.open(QIODevice::ReadWrite)) return;
+    f.setFileTime(QDateTime::currentDateTime(),
+                  QFileDevice::FileModificationTime);
+}
+
+void
+CacheDirectory::acquire(QString filename)
+{
+    QMutexLocker locker(&m_mutex);
+    ++m_inUse[filename];
+}
+
+void
+CacheDirectory::release(QString filename)
+{
+    QMutexLocker locker(&m_mutex);
+    auto itr = m_inUse.find(filename);
+    if (itr == m_inUse.end()) return;
+    if (--itr->second <= 0) m_inUse.erase(itr);
+}
+
+void
+CacheDirectory::remove(QString filename)
+{
+    QFile(getFilePath(filename)).remove();
+}
+
+bool
+CacheDirectory::prune(qint64 reserveBytes)
+{
+    QDir dir(getPath());
+
+    QMutexLocker locker(&m_mutex);
+
+    // Oldest first
+    QFileInfoList files = dir.entryInfoList(QDir::Files, QDir::Time |
+                                            QDir::Reversed);
+    qint64 total = reserveBytes;
+    for (const auto &fi: files) {
+        total += fi.size();
+    }
+
+    for (const auto &fi: files) {
+        if (total <= m_limit) break;
+        if (m_inUse.find(fi.fileName()) != m_inUse.end()) continue;
+        qint64 size = fi.size();
+        if (QFile(fi.filePath()).remove()) {
+            SVDEBUG << "CacheDirectory[" << m_name << "]::prune: removed "
+                    << fi.fileName() << " (" << size << " bytes)" << endl;
+            total -= size;
+        }
+    }
+
+    return total <= m_limit;
+}
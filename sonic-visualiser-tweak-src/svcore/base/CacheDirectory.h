@@ -0,0 +1,105 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_CACHE_DIRECTORY_H
+#define SV_CACHE_DIRECTORY_H
+
+#include <QString>
+#include <QMutex>
+
+#include <map>
+
+/**
+ * A size-bounded directory of cache files that persist from one
+ * session to the next. The directory is a named subdirectory of the
+ * TempDirectory containing path, i.e. it lives alongside the
+ * per-session temporary directories but is never removed when the
+ * application exits.
+ *
+ * Files are evicted in least-recently-used order, judged by their
+ * modification times, whenever prune() finds the directory over its
+ * size limit. Users should call touch() whenever they reuse a file,
+ * and should mark files they currently have open (or mapped) using
+ * acquire() and release() so that they are not evicted from under
+ * them.
+ *
+ * The size limit is read from the "CacheDirectory" settings group,
+ * key "<name>-limit-mb", falling back to the default passed to the
+ * constructor.
+ *
+ * This class is thread safe.
+ */
+
+class CacheDirectory
+{
+public:
+    CacheDirectory(QString name, int defaultLimitMB);
+
+    /**
+     * Return the path of the cache directory, creating it if
+     * necessary. Throw DirectoryCreationFailed if the directory
+     * cannot be created.
+     */
+    QString getPath();
+
+    /**
+     * Return the full path of the given file within the cache
+     * directory. The file need not exist.
+     */
+    QString getFilePath(QString filename);
+
+    /**
+     * Return the size limit for this directory, in bytes.
+     */
+    qint64 getLimit() const;
+
+    /**
+     * Mark the given file as recently used.
+     */
+    void touch(QString filename);
+
+    /**
+     * Mark the given file as in use, so that prune() will not remove
+     * it. Calls nest: a file acquired twice must be released twice.
+     */
+    void acquire(QString filename);
+
+    /**
+     * Release a file previously marked as in use with acquire().
+     */
+    void release(QString filename);
+
+    /**
+     * Remove the given file from the cache directory.
+     */
+    void remove(QString filename);
+
+    /**
+     * Remove least-recently-used files until the total size of the
+     * directory plus the given number of reserved bytes is within
+     * the size limit, or until nothing more can be removed. Return
+     * true if the directory (plus reservation) now fits within the
+     * limit.
+     */
+    bool prune(qint64 reserveBytes = 0);
+
+private:
+    QString m_name;
+    qint64 m_limit;
+    QString m_path;
+    std::map<QString, int> m_inUse;
+    QMutex m_mutex;
+};
+
+#endif
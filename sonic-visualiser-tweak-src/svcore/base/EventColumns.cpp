@@ -0,0 +1,490 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "EventColumns.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+
+EventColumns::EventColumns() :
+    m_strings({ QString() })
+{
+}
+
+bool
+EventColumns::operator==(const EventColumns &other) const
+{
+    if (m_frames != other.m_frames || m_flags != other.m_flags) {
+        return false;
+    }
+    for (int i = 0; i < size(); ++i) {
+        if (other.compare(i, get(i)) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void
+EventColumns::clear()
+{
+    m_frames.clear();
+    m_flags.clear();
+    m_values.clear();
+    m_levels.clear();
+    m_durations.clear();
+    m_referenceFrames.clear();
+    m_labels.clear();
+    m_uris.clear();
+    m_strings = { QString() };
+    m_stringIds.clear();
+}
+
+void
+EventColumns::assign(const EventVector &sorted)
+{
+    clear();
+    m_frames.reserve(sorted.size());
+    m_flags.reserve(sorted.size());
+    for (const auto &e: sorted) {
+        insert(size(), e);
+    }
+}
+
+int
+EventColumns::intern(const QString &s)
+{
+    if (s.isEmpty()) {
+        return 0;
+    }
+    auto itr = m_stringIds.constFind(s);
+    if (itr != m_stringIds.constEnd()) {
+        return *itr;
+    }
+    int id = int(m_strings.size());
+    m_strings.push_back(s);
+    m_stringIds.insert(s, id);
+    return id;
+}
+
+void
+EventColumns::insert(int row, const Event &e)
+{
+    const int rows = size();
+
+    unsigned char flags = 0;
+    if (e.m_haveValue) flags |= HaveValue;
+    if (e.m_haveLevel) flags |= HaveLevel;
+    if (e.m_haveDuration) flags |= HaveDuration;
+    if (e.m_haveReferenceFrame) flags |= HaveReferenceFrame;
+
+    m_frames.insert(m_frames.begin() + row, e.m_frame);
+    m_flags.insert(m_flags.begin() + row, flags);
+
+    insertInto(m_values, row, rows, e.m_haveValue ? e.m_value : 0.f);
+    insertInto(m_levels, row, rows, e.m_haveLevel ? e.m_level : 0.f);
+    insertInto(m_durations, row, rows,
+               e.m_haveDuration ? e.m_duration : sv_frame_t(0));
+    insertInto(m_referenceFrames, row, rows,
+               e.m_haveReferenceFrame ? e.m_referenceFrame : sv_frame_t(0));
+    insertInto(m_labels, row, rows, intern(e.m_label));
+    insertInto(m_uris, row, rows, intern(e.m_uri));
+}
+
+void
+EventColumns::erase(int row)
+{
+    m_frames.erase(m_frames.begin() + row);
+    m_flags.erase(m_flags.begin() + row);
+    eraseFrom(m_values, row);
+    eraseFrom(m_levels, row);
+    eraseFrom(m_durations, row);
+    eraseFrom(m_referenceFrames, row);
+    eraseFrom(m_labels, row);
+    eraseFrom(m_uris, row);
+}
+
+Event
+EventColumns::get(int row) const
+{
+    const unsigned char flags = m_flags[row];
+
+    Event e(m_frames[row]);
+    e.m_haveValue = (flags & HaveValue);
+    e.m_haveLevel = (flags & HaveLevel);
+    e.m_haveDuration = (flags & HaveDuration);
+    e.m_haveReferenceFrame = (flags & HaveReferenceFrame);
+    e.m_value = at(m_values, row);
+    e.m_level = at(m_levels, row);
+    e.m_duration = at(m_durations, row);
+    e.m_referenceFrame = at(m_referenceFrames, row);
+    e.m_label = string(m_labels, row);
+    e.m_uri = string(m_uris, row);
+    return e;
+}
+
+EventVector
+EventColumns::getEvents(int from, int to) const
+{
+    EventVector ee;
+    if (to > from) {
+        ee.reserve(to - from);
+    }
+    for (int i = from; i < to; ++i) {
+        ee.push_back(get(i));
+    }
+    return ee;
+}
+
+int
+EventColumns::compare(int row, const Event &e) const
+{
+    // This must match Event::operator<, which orders events without
+    // a property before those with it
+
+    const sv_frame_t frame = m_frames[row];
+    if (frame != e.m_frame) {
+        return frame < e.m_frame ? -1 : 1;
+    }
+
+    const unsigned char flags = m_flags[row];
+
+    const bool haveDuration = (flags & HaveDuration);
+    if (haveDuration != e.m_haveDuration) {
+        return haveDuration ? 1 : -1;
+    }
+    if (haveDuration) {
+        const sv_frame_t duration = at(m_durations, row);
+        if (duration != e.m_duration) {
+            return duration < e.m_duration ? -1 : 1;
+        }
+    }
+
+    const bool haveValue = (flags & HaveValue);
+    if (haveValue != e.m_haveValue) {
+        return haveValue ? 1 : -1;
+    }
+    if (haveValue) {
+        const float value = at(m_values, row);
+        if (value != e.m_value) {
+            return value < e.m_value ? -1 : 1;
+        }
+    }
+
+    const bool haveLevel = (flags & HaveLevel);
+    if (haveLevel != e.m_haveLevel) {
+        return haveLevel ? 1 : -1;
+    }
+    if (haveLevel) {
+        const float level = at(m_levels, row);
+        if (level != e.m_level) {
+            return level < e.m_level ? -1 : 1;
+        }
+    }
+
+    const bool haveReferenceFrame = (flags & HaveReferenceFrame);
+    if (haveReferenceFrame != e.m_haveReferenceFrame) {
+        return haveReferenceFrame ? 1 : -1;
+    }
+    if (haveReferenceFrame) {
+        const sv_frame_t referenceFrame = at(m_referenceFrames, row);
+        if (referenceFrame != e.m_referenceFrame) {
+            return referenceFrame < e.m_referenceFrame ? -1 : 1;
+        }
+    }
+
+    const QString &label = string(m_labels, row);
+    if (label != e.m_label) {
+        return label < e.m_label ? -1 : 1;
+    }
+
+    const QString &uri = string(m_uris, row);
+    if (uri != e.m_uri) {
+        return uri < e.m_uri ? -1 : 1;
+    }
+
+    return 0;
+}
+
+int
+EventColumns::lowerBound(sv_frame_t frame) const
+{
+    return int(std::lower_bound(m_frames.begin(), m_frames.end(), frame)
+               - m_frames.begin());
+}
+
+int
+EventColumns::lowerBound(const Event &e) const
+{
+    // Narrow to the rows sharing e's frame using the frame column
+    // alone, then compare the rest of the properties within those
+
+    int lo = lowerBound(e.m_frame);
+    int hi = int(std::upper_bound(m_frames.begin() + lo, m_frames.end(),
+                                  e.m_frame)
+                 - m_frames.begin());
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (compare(mid, e) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+int
+EventColumns::upperBound(const Event &e) const
+{
+    int lo = lowerBound(e.m_frame);
+    int hi = int(std::upper_bound(m_frames.begin() + lo, m_frames.end(),
+                                  e.m_frame)
+                 - m_frames.begin());
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (compare(mid, e) <= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    return lo;
+}
+
+namespace {
+
+// Encoded form: a header of six 32-bit words (magic, version, row
+// count, mask of optional columns present, string count, and a zero
+// pad) and two 64-bit frames (first frame and latest end frame),
+// then the 64-bit columns, the 32-bit columns and the flags, then
+// each string as a 32-bit byte count followed by UTF-8
+
+const uint32_t encodingMagic = 0x43455653; // "SVEC" little-endian
+const uint32_t encodingVersion = 2;
+
+enum EncodedColumn : uint32_t {
+    EncodedDurations = 1,
+    EncodedReferenceFrames = 2,
+    EncodedValues = 4,
+    EncodedLevels = 8,
+    EncodedLabels = 16,
+    EncodedUris = 32
+};
+
+template <typename T>
+void appendColumn(QByteArray &out, const std::vector<T> &column)
+{
+    out.append(reinterpret_cast<const char *>(column.data()),
+               int(column.size() * sizeof(T)));
+}
+
+void appendWord(QByteArray &out, uint32_t word)
+{
+    out.append(reinterpret_cast<const char *>(&word), sizeof(word));
+}
+
+void appendFrame(QByteArray &out, sv_frame_t frame)
+{
+    int64_t value = frame;
+    out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+class EncodingReader
+{
+public:
+    EncodingReader(const char *data, qint64 size) :
+        m_p(data), m_end(data + size) { }
+
+    bool read(void *dest, qint64 n) {
+        if (m_end - m_p < n) return false;
+        if (n > 0) memcpy(dest, m_p, size_t(n));
+        m_p += n;
+        return true;
+    }
+
+    bool skip(uint32_t n, const char *&start) {
+        if (m_end - m_p < qint64(n)) return false;
+        start = m_p;
+        m_p += n;
+        return true;
+    }
+
+    template <typename T>
+    bool readColumn(std::vector<T> &column, int rows) {
+        qint64 n = qint64(rows) * qint64(sizeof(T));
+        if (m_end - m_p < n) return false;
+        column.resize(rows);
+        return read(column.data(), n);
+    }
+
+    template <typename T>
+    bool readColumnIf(bool present, std::vector<T> &column, int rows) {
+        return !present || readColumn(column, rows);
+    }
+
+    bool atEnd() const { return m_p == m_end; }
+
+private:
+    const char *m_p;
+    const char *m_end;
+};
+
+bool readEncodedHeader(EncodingReader &reader, uint32_t header[6],
+                       int64_t frames[2])
+{
+    return reader.read(header, 6 * sizeof(uint32_t)) &&
+        header[0] == encodingMagic &&
+        header[1] == encodingVersion &&
+        header[2] <= uint32_t(INT_MAX) &&
+        header[4] >= 1 &&
+        header[4] <= uint32_t(INT_MAX) &&
+        reader.read(frames, 2 * sizeof(int64_t));
+}
+
+}
+
+void
+EventColumns::encode(QByteArray &out) const
+{
+    uint32_t mask = 0;
+    if (!m_durations.empty()) mask |= EncodedDurations;
+    if (!m_referenceFrames.empty()) mask |= EncodedReferenceFrames;
+    if (!m_values.empty()) mask |= EncodedValues;
+    if (!m_levels.empty()) mask |= EncodedLevels;
+    if (!m_labels.empty()) mask |= EncodedLabels;
+    if (!m_uris.empty()) mask |= EncodedUris;
+
+    appendWord(out, encodingMagic);
+    appendWord(out, encodingVersion);
+    appendWord(out, uint32_t(size()));
+    appendWord(out, mask);
+    appendWord(out, uint32_t(m_strings.size()));
+    appendWord(out, 0);
+
+    sv_frame_t endFrame = 0;
+    for (int i = 0; i < size(); ++i) {
+        endFrame = std::max(endFrame, m_frames[i] + getDuration(i));
+    }
+    appendFrame(out, empty() ? 0 : m_frames[0]);
+    appendFrame(out, endFrame);
+
+    appendColumn(out, m_frames);
+    appendColumn(out, m_durations);
+    appendColumn(out, m_referenceFrames);
+    appendColumn(out, m_values);
+    appendColumn(out, m_levels);
+    appendColumn(out, m_labels);
+    appendColumn(out, m_uris);
+    appendColumn(out, m_flags);
+
+    for (const QString &s: m_strings) {
+        QByteArray utf8 = s.toUtf8();
+        appendWord(out, uint32_t(utf8.size()));
+        out.append(utf8);
+    }
+}
+
+bool
+EventColumns::readEncodedExtents(const char *data, qint64 size,
+                                 int &rows,
+                                 sv_frame_t &startFrame,
+                                 sv_frame_t &endFrame)
+{
+    EncodingReader reader(data, size);
+
+    uint32_t header[6];
+    int64_t frames[2];
+    if (!readEncodedHeader(reader, header, frames)) {
+        return false;
+    }
+
+    rows = int(header[2]);
+    startFrame = frames[0];
+    endFrame = frames[1];
+    return true;
+}
+
+bool
+EventColumns::decode(const char *data, qint64 size)
+{
+    clear();
+
+    EncodingReader reader(data, size);
+
+    uint32_t header[6];
+    int64_t frames[2];
+    if (!readEncodedHeader(reader, header, frames)) {
+        return false;
+    }
+
+    const int rows = int(header[2]);
+    const uint32_t mask = header[3];
+    const int stringCount = int(header[4]);
+
+    bool ok =
+        reader.readColumn(m_frames, rows) &&
+        reader.readColumnIf(mask & EncodedDurations, m_durations, rows) &&
+        reader.readColumnIf(mask & EncodedReferenceFrames,
+                            m_referenceFrames, rows) &&
+        reader.readColumnIf(mask & EncodedValues, m_values, rows) &&
+        reader.readColumnIf(mask & EncodedLevels, m_levels, rows) &&
+        reader.readColumnIf(mask & EncodedLabels, m_labels, rows) &&
+        reader.readColumnIf(mask & EncodedUris, m_uris, rows) &&
+        reader.readColumn(m_flags, rows);
+
+    m_strings.clear();
+
+    for (int i = 0; ok && i < stringCount; ++i) {
+        uint32_t length = 0;
+        const char *utf8 = nullptr;
+        ok = reader.read(&length, sizeof(length)) &&
+            reader.skip(length, utf8);
+        if (ok) {
+            m_strings.push_back(QString::fromUtf8(utf8, int(length)));
+        }
+    }
+
+    ok = ok && reader.atEnd() && m_strings[0].isEmpty();
+
+    // Check everything that get() and the searches rely on, so that
+    // a damaged file cannot lead to reads out of range
+    
+    for (int i = 1; ok && i < rows; ++i) {
+        if (m_frames[i] < m_frames[i-1]) ok = false;
+    }
+    for (int i = 0; ok && i < int(m_labels.size()); ++i) {
+        if (m_labels[i] < 0 || m_labels[i] >= stringCount) ok = false;
+    }
+    for (int i = 0; ok && i < int(m_uris.size()); ++i) {
+        if (m_uris[i] < 0 || m_uris[i] >= stringCount) ok = false;
+    }
+
+    if (!ok) {
+        clear();
+        return false;
+    }
+
+    for (int i = 1; i < stringCount; ++i) {
+        m_stringIds.insert(m_strings[i], i);
+    }
+    
+    return true;
+}
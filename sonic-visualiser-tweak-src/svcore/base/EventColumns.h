@@ -0,0 +1,207 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_EVENT_COLUMNS_H
+#define SV_EVENT_COLUMNS_H
+
+#include "Event.h"
+
+#include <QString>
+#include <QHash>
+#include <QByteArray>
+
+#include <vector>
+
+/**
+ * Compact storage for a sorted sequence of events, used by
+ * EventSeries in place of a vector of Event objects.
+ *
+ * Each property is held in its own contiguous column, indexed by
+ * row: frames and a byte of has-property flags for every event, and
+ * values, levels, durations, reference frames, labels and URIs only
+ * once some event actually has them -- so a series of bare instants
+ * costs nine bytes per event, and a pitch track thirteen. Labels
+ * and URIs are interned in a string table belonging to the store, so
+ * each distinct string is held once however many events carry it.
+ *
+ * Event objects are built only when asked for, via get() or
+ * getEvents(). Searching and scanning by frame use the frame column
+ * directly, and comparisons against an Event look at the columns
+ * without building one.
+ *
+ * Strings remain in the table after the last event using them is
+ * removed, until the store is cleared or reassigned.
+ *
+ * EventColumns is not thread-safe: EventSeries serialises access to
+ * it.
+ */
+class EventColumns
+{
+public:
+    EventColumns();
+
+    bool operator==(const EventColumns &other) const;
+
+    int size() const { return int(m_frames.size()); }
+    bool empty() const { return m_frames.empty(); }
+
+    void clear();
+
+    /**
+     * Replace the contents with the given events, which must already
+     * be sorted.
+     */
+    void assign(const EventVector &sorted);
+
+    /**
+     * Insert an event at the given row, which must be the position
+     * that keeps the rows sorted.
+     */
+    void insert(int row, const Event &e);
+
+    void erase(int row);
+
+    /**
+     * Build and return the event at the given row.
+     */
+    Event get(int row) const;
+
+    /**
+     * Build and return the events from row from up to (but not
+     * including) row to.
+     */
+    EventVector getEvents(int from, int to) const;
+
+    sv_frame_t getFrame(int row) const {
+        return m_frames[row];
+    }
+    bool hasDuration(int row) const {
+        return m_flags[row] & HaveDuration;
+    }
+    sv_frame_t getDuration(int row) const {
+        return hasDuration(row) ? at(m_durations, row) : 0;
+    }
+
+    /**
+     * Compare the event at the given row against e, returning a
+     * negative number, zero, or a positive number if the row sorts
+     * before, equal to, or after e in the ordering of Event's
+     * operator<.
+     */
+    int compare(int row, const Event &e) const;
+
+    bool equals(int row, const Event &e) const {
+        return compare(row, e) == 0;
+    }
+
+    /**
+     * Return the first row whose event does not sort before e.
+     */
+    int lowerBound(const Event &e) const;
+
+    /**
+     * Return the first row whose event sorts after e.
+     */
+    int upperBound(const Event &e) const;
+
+    /**
+     * Return the first row whose frame is not before the given
+     * frame. This is the same as lowerBound(Event(frame)).
+     */
+    int lowerBound(sv_frame_t frame) const;
+
+    /**
+     * Append the contents to the given byte array in a compact
+     * binary form, as used for datasets in a session container. Each
+     * column is written as a single block, in the byte order of the
+     * host, followed by the string table. The header also records the
+     * first frame and the latest end frame of any event, for
+     * readEncodedExtents().
+     */
+    void encode(QByteArray &out) const;
+
+    /**
+     * Read the number of rows, the frame of the first row, and the
+     * latest frame plus duration of any row (or 0 if that is later),
+     * from the header of data written by encode(), without decoding
+     * the rest. Return false if the header is not valid; a true
+     * return does not guarantee that decode() will succeed.
+     */
+    static bool readEncodedExtents(const char *data, qint64 size,
+                                   int &rows,
+                                   sv_frame_t &startFrame,
+                                   sv_frame_t &endFrame);
+
+    /**
+     * Replace the contents with those previously written by
+     * encode(). The columns are copied directly, and only the string
+     * table needs converting. Return false, leaving the store empty,
+     * if the data is not a valid encoding.
+     */
+    bool decode(const char *data, qint64 size);
+
+private:
+    enum Flag : unsigned char {
+        HaveValue = 1,
+        HaveLevel = 2,
+        HaveDuration = 4,
+        HaveReferenceFrame = 8
+    };
+
+    std::vector<sv_frame_t> m_frames;
+    std::vector<unsigned char> m_flags;
+
+    // These are empty until some event has a non-default value for
+    // them, and thereafter have one entry per row
+    std::vector<float> m_values;
+    std::vector<float> m_levels;
+    std::vector<sv_frame_t> m_durations;
+    std::vector<sv_frame_t> m_referenceFrames;
+    std::vector<int> m_labels;
+    std::vector<int> m_uris;
+
+    // Interned strings. Index 0 is always the empty string
+    std::vector<QString> m_strings;
+    QHash<QString, int> m_stringIds;
+
+    int intern(const QString &s);
+
+    const QString &string(const std::vector<int> &column, int row) const {
+        return m_strings[at(column, row)];
+    }
+
+    template <typename T>
+    static T at(const std::vector<T> &column, int row) {
+        return column.empty() ? T() : column[row];
+    }
+
+    template <typename T>
+    static void insertInto(std::vector<T> &column, int row, int rows,
+                           T value) {
+        if (column.empty()) {
+            if (value == T()) return;
+            column.resize(rows, T());
+        }
+        column.insert(column.begin() + row, value);
+    }
+
+    template <typename T>
+    static void eraseFrom(std::vector<T> &column, int row) {
+        if (!column.empty()) {
+            column.erase(column.begin() + row);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,269 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "EventIntervalIndex.h"
+
+#include <algorithm>
+#include <functional>
+
+EventIntervalIndex::EventIntervalIndex() :
+    m_root(-1),
+    m_seed(2463534242u)
+{
+}
+
+unsigned int
+EventIntervalIndex::nextPriority()
+{
+    // xorshift32: we need only a cheap, well-spread sequence, and a
+    // fixed seed keeps the tree shape reproducible
+    m_seed ^= m_seed << 13;
+    m_seed ^= m_seed >> 17;
+    m_seed ^= m_seed << 5;
+    return m_seed;
+}
+
+int
+EventIntervalIndex::allocate(const Event &e)
+{
+    Node node { e, e.getFrame() + e.getDuration(), 0, 1, -1, -1,
+                nextPriority() };
+    node.maxEnd = node.end;
+
+    if (!m_free.empty()) {
+        int n = m_free.back();
+        m_free.pop_back();
+        m_nodes[n] = node;
+        return n;
+    }
+
+    m_nodes.push_back(node);
+    return int(m_nodes.size()) - 1;
+}
+
+void
+EventIntervalIndex::release(int n)
+{
+    m_nodes[n].event = Event();
+    m_free.push_back(n);
+}
+
+void
+EventIntervalIndex::update(int n)
+{
+    Node &node = m_nodes[n];
+    node.maxEnd = node.end;
+    if (node.left >= 0) {
+        node.maxEnd = std::max(node.maxEnd, m_nodes[node.left].maxEnd);
+    }
+    if (node.right >= 0) {
+        node.maxEnd = std::max(node.maxEnd, m_nodes[node.right].maxEnd);
+    }
+}
+
+int
+EventIntervalIndex::rotateLeft(int n)
+{
+    int r = m_nodes[n].right;
+    m_nodes[n].right = m_nodes[r].left;
+    m_nodes[r].left = n;
+    update(n);
+    update(r);
+    return r;
+}
+
+int
+EventIntervalIndex::rotateRight(int n)
+{
+    int l = m_nodes[n].left;
+    m_nodes[n].left = m_nodes[l].right;
+    m_nodes[l].right = n;
+    update(n);
+    update(l);
+    return l;
+}
+
+int
+EventIntervalIndex::insert(int n, const Event &e)
+{
+    if (n < 0) {
+        return allocate(e);
+    }
+
+    // Note that allocate() may reallocate m_nodes, so we must not
+    // hold a reference to a node across the recursive calls
+
+    if (e < m_nodes[n].event) {
+        int l = insert(m_nodes[n].left, e);
+        m_nodes[n].left = l;
+        if (m_nodes[l].priority > m_nodes[n].priority) {
+            return rotateRight(n);
+        }
+    } else if (m_nodes[n].event < e) {
+        int r = insert(m_nodes[n].right, e);
+        m_nodes[n].right = r;
+        if (m_nodes[r].priority > m_nodes[n].priority) {
+            return rotateLeft(n);
+        }
+    } else {
+        ++m_nodes[n].count;
+        return n;
+    }
+
+    update(n);
+    return n;
+}
+
+int
+EventIntervalIndex::erase(int n, const Event &e)
+{
+    if (n < 0) {
+        return n;
+    }
+
+    if (e < m_nodes[n].event) {
+        m_nodes[n].left = erase(m_nodes[n].left, e);
+    } else if (m_nodes[n].event < e) {
+        m_nodes[n].right = erase(m_nodes[n].right, e);
+    } else if (m_nodes[n].count > 1) {
+        --m_nodes[n].count;
+        return n;
+    } else {
+        int l = m_nodes[n].left, r = m_nodes[n].right;
+        if (l < 0 || r < 0) {
+            release(n);
+            return l < 0 ? r : l;
+        }
+        // Rotate the node down past its higher-priority child and
+        // carry on until it has at most one child
+        if (m_nodes[l].priority > m_nodes[r].priority) {
+            n = rotateRight(n);
+            m_nodes[n].right = erase(m_nodes[n].right, e);
+        } else {
+            n = rotateLeft(n);
+            m_nodes[n].left = erase(m_nodes[n].left, e);
+        }
+    }
+
+    update(n);
+    return n;
+}
+
+void
+EventIntervalIndex::add(const Event &e)
+{
+    m_root = insert(m_root, e);
+}
+
+void
+EventIntervalIndex::remove(const Event &e)
+{
+    m_root = erase(m_root, e);
+}
+
+void
+EventIntervalIndex::clear()
+{
+    m_nodes.clear();
+    m_free.clear();
+    m_root = -1;
+}
+
+int
+EventIntervalIndex::build(const std::vector<int> &nodes, int lo, int hi)
+{
+    if (lo >= hi) {
+        return -1;
+    }
+    int mid = lo + (hi - lo) / 2;
+    int n = nodes[mid];
+    m_nodes[n].left = build(nodes, lo, mid);
+    m_nodes[n].right = build(nodes, mid + 1, hi);
+    update(n);
+    return n;
+}
+
+void
+EventIntervalIndex::assign(const std::vector<Event> &sorted)
+{
+    clear();
+
+    std::vector<int> nodes;
+    for (const auto &e: sorted) {
+        if (!nodes.empty() && m_nodes[nodes.back()].event == e) {
+            ++m_nodes[nodes.back()].count;
+        } else {
+            nodes.push_back(allocate(e));
+        }
+    }
+
+    m_root = build(nodes, 0, int(nodes.size()));
+    if (m_root < 0) return;
+
+    // The tree is now perfectly balanced, but later insertions still
+    // rely on the heap ordering of priorities. Hand out the random
+    // priorities we already allocated in descending order, breadth
+    // first, so that every node outranks its children
+
+    std::vector<unsigned int> priorities;
+    priorities.reserve(nodes.size());
+    for (int n: nodes) {
+        priorities.push_back(m_nodes[n].priority);
+    }
+    std::sort(priorities.begin(), priorities.end(),
+              std::greater<unsigned int>());
+
+    std::vector<int> queue { m_root };
+    queue.reserve(nodes.size());
+    for (size_t i = 0; i < queue.size(); ++i) {
+        int n = queue[i];
+        m_nodes[n].priority = priorities[i];
+        if (m_nodes[n].left >= 0) queue.push_back(m_nodes[n].left);
+        if (m_nodes[n].right >= 0) queue.push_back(m_nodes[n].right);
+    }
+}
+
+void
+EventIntervalIndex::getEventsSpanning(sv_frame_t start, sv_frame_t end,
+                                      std::vector<Event> &out) const
+{
+    query(m_root, start, end, out);
+}
+
+void
+EventIntervalIndex::query(int n, sv_frame_t start, sv_frame_t end,
+                          std::vector<Event> &out) const
+{
+    // Nothing in this subtree ends after the start of the range
+    if (n < 0 || m_nodes[n].maxEnd <= start) {
+        return;
+    }
+
+    const Node &node = m_nodes[n];
+
+    query(node.left, start, end, out);
+
+    // This node and everything to its right start too late
+    if (node.event.getFrame() >= end) {
+        return;
+    }
+
+    if (node.end > start && node.end > node.event.getFrame()) {
+        for (int i = 0; i < node.count; ++i) {
+            out.push_back(node.event);
+        }
+    }
+
+    query(node.right, start, end, out);
+}
@@ -0,0 +1,127 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_EVENT_INTERVAL_INDEX_H
+#define SV_EVENT_INTERVAL_INDEX_H
+
+#include "Event.h"
+
+#include <vector>
+
+/**
+ * An index of events with duration, supporting queries for the
+ * events that overlap a range of frames or cover a single frame.
+ *
+ * This is an augmented binary search tree (a treap) ordered by the
+ * normal event sort order, in which each node also records the
+ * latest end frame found in its subtree. That allows a query to
+ * skip any subtree whose events all end before the query range
+ * starts, and any right subtree whose events all start after it
+ * ends, so that a query costs O(log n) for each distinct event it
+ * returns (and O(log n) if it finds none) however many events are
+ * indexed. Adding or removing an event in any order also takes
+ * O(log n).
+ *
+ * Identical events share a node with a count, and a query returns
+ * each as many times as it has been added.
+ *
+ * Events with zero duration are indexed, and count toward
+ * getEndFrame(), but are never returned from a query, since they
+ * have no extent to overlap anything.
+ *
+ * EventIntervalIndex is not thread-safe: EventSeries serialises
+ * access to it.
+ */
+class EventIntervalIndex
+{
+public:
+    EventIntervalIndex();
+
+    /**
+     * Replace the contents of the index with the given events, which
+     * must be sorted in the normal event sort order and must all have
+     * duration. This takes O(n) time, rather than the O(n log n) of
+     * adding them one at a time.
+     */
+    void assign(const std::vector<Event> &sorted);
+
+    /**
+     * Add an event, which must have duration.
+     */
+    void add(const Event &e);
+
+    /**
+     * Remove one instance of an event, if present.
+     */
+    void remove(const Event &e);
+
+    void clear();
+
+    bool isEmpty() const { return m_root < 0; }
+
+    /**
+     * Return the latest end frame of any indexed event, or 0 if the
+     * index is empty.
+     */
+    sv_frame_t getEndFrame() const {
+        return m_root < 0 ? 0 : m_nodes[m_root].maxEnd;
+    }
+
+    /**
+     * Append to the given vector all events of non-zero duration
+     * that start before end and end after start, in sort order.
+     */
+    void getEventsSpanning(sv_frame_t start, sv_frame_t end,
+                           std::vector<Event> &out) const;
+
+    /**
+     * Append to the given vector all events of non-zero duration
+     * that start at or before the given frame and end after it, in
+     * sort order.
+     */
+    void getEventsCovering(sv_frame_t frame,
+                           std::vector<Event> &out) const {
+        getEventsSpanning(frame, frame + 1, out);
+    }
+
+private:
+    struct Node {
+        Event event;
+        sv_frame_t end;
+        sv_frame_t maxEnd;
+        int count;
+        int left;
+        int right;
+        unsigned int priority;
+    };
+
+    std::vector<Node> m_nodes;
+    std::vector<int> m_free;
+    int m_root;
+    unsigned int m_seed;
+
+    unsigned int nextPriority();
+    int allocate(const Event &e);
+    void release(int n);
+    void update(int n);
+    int rotateLeft(int n);
+    int rotateRight(int n);
+    int insert(int n, const Event &e);
+    int erase(int n, const Event &e);
+    int build(const std::vector<int> &nodes, int lo, int hi);
+    void query(int n, sv_frame_t start, sv_frame_t end,
+               std::vector<Event> &out) const;
+};
+
+#endif
@@ -16,25 +16,41 @@
 
 #include <QMutexLocker>
 
+#include <algorithm>
+#include <atomic>
+
+quint64
+EventSeries::newRevision()
+{
+    static std::atomic<quint64> revision(0);
+    return ++revision;
+}
+
 EventSeries::EventSeries(const EventSeries &other) :
     EventSeries(other, QMutexLocker(&other.m_mutex))
 {
 }
 
 EventSeries::EventSeries(const EventSeries &other, const QMutexLocker &) :
-    m_events(other.m_events),
-    m_seams(other.m_seams),
-    m_finalDurationlessEventFrame(other.m_finalDurationlessEventFrame)
+    m_finalDurationlessEventFrame(0),
+    m_revision(other.m_revision)
 {
+    other.decodeDeferredLocked();
+    m_events = other.m_events;
+    m_durationIndex = other.m_durationIndex;
+    m_finalDurationlessEventFrame = other.m_finalDurationlessEventFrame;
 }
 
 EventSeries &
 EventSeries::operator=(const EventSeries &other)
 {
     QMutexLocker locker(&m_mutex), otherLocker(&other.m_mutex);
+    other.decodeDeferredLocked();
+    m_deferred.reset();
     m_events = other.m_events;
-    m_seams = other.m_seams;
+    m_durationIndex = other.m_durationIndex;
     m_finalDurationlessEventFrame = other.m_finalDurationlessEventFrame;
+    m_revision = other.m_revision;
     return *this;
 }
 
@@ -42,33 +58,121 @@ EventSeries &
 EventSeries::operator=(EventSeries &&other)
 {
     QMutexLocker locker(&m_mutex), otherLocker(&other.m_mutex);
+    other.decodeDeferredLocked();
+    m_deferred.reset();
     m_events = std::move(other.m_events);
-    m_seams = std::move(other.m_seams);
+    m_durationIndex = std::move(other.m_durationIndex);
     m_finalDurationlessEventFrame = std::move(other.m_finalDurationlessEventFrame);
+    m_revision = other.m_revision;
+    other.m_revision = newRevision();
     return *this;
 }
 
 bool
 EventSeries::operator==(const EventSeries &other) const
 {
-    QMutexLocker locker(&m_mutex);
+    if (&other == this) return true;
+    QMutexLocker locker(&m_mutex), otherLocker(&other.m_mutex);
+    decodeDeferredLocked();
+    other.decodeDeferredLocked();
     return m_events == other.m_events;
 }
 
+EventSeries::EventSeries(const EventVector &events) :
+    m_finalDurationlessEventFrame(0),
+    m_revision(newRevision())
+{
+    EventVector sorted(events);
+    std::sort(sorted.begin(), sorted.end());
+
+    m_events.assign(sorted);
+    buildIndex({});
+}
+
+void
+EventSeries::buildIndex(const std::function<void(const Event &)> &visit)
+{
+    // Take the indexed events back from the store, so that they
+    // share its interned strings
+    EventVector withDuration;
+    m_finalDurationlessEventFrame = 0;
+    for (int i = 0; i < m_events.size(); ++i) {
+        const bool duration = m_events.hasDuration(i);
+        if (!duration &&
+            m_events.getFrame(i) > m_finalDurationlessEventFrame) {
+            m_finalDurationlessEventFrame = m_events.getFrame(i);
+        }
+        if (duration || visit) {
+            Event e = m_events.get(i);
+            if (visit) visit(e);
+            if (duration) withDuration.push_back(e);
+        }
+    }
+
+    m_durationIndex.assign(withDuration);
+}
+
+bool
+EventSeries::setFromBlob(std::shared_ptr<const void> owner,
+                         const char *data, qint64 size,
+                         std::function<void(const Event &)> visit)
+{
+    int count = 0;
+    sv_frame_t startFrame = 0, endFrame = 0;
+    if (!EventColumns::readEncodedExtents(data, size,
+                                          count, startFrame, endFrame)) {
+        return false;
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_events.clear();
+    m_durationIndex.clear();
+    m_finalDurationlessEventFrame = 0;
+    m_deferred.reset(new DeferredBlob {
+            owner, data, size, count, startFrame, endFrame, visit
+        });
+    m_revision = newRevision();
+    return true;
+}
+
+void
+EventSeries::decodeDeferred() const
+{
+    QMutexLocker locker(&m_mutex);
+    decodeDeferredLocked();
+}
+
+void
+EventSeries::decodeDeferredLocked() const
+{
+    if (!m_deferred) return;
+
+    // Decoding fills in the events that the series already logically
+    // contains, so it does not change the revision
+    EventSeries *self = const_cast<EventSeries *>(this);
+    std::unique_ptr<DeferredBlob> deferred(std::move(self->m_deferred));
+
+    if (!self->m_events.decode(deferred->data, deferred->size)) {
+        SVCERR << "WARNING: EventSeries: Failed to decode blob said to "
+               << "contain " << deferred->count << " events" << endl;
+        self->m_revision = newRevision();
+        return;
+    }
+
+    self->buildIndex(deferred->visit);
+}
+
 EventSeries
 EventSeries::fromEvents(const EventVector &v)
 {
-    EventSeries s;
-    for (const auto &e: v) {
-        s.add(e);
-    }
-    return s;
+    return EventSeries(v);
 }
 
 bool
 EventSeries::isEmpty() const
 {
     QMutexLocker locker(&m_mutex);
+    if (m_deferred) return m_deferred->count == 0;
     return m_events.empty();
 }
 
@@ -76,56 +180,31 @@ int
 EventSeries::count() const
 {
     QMutexLocker locker(&m_mutex);
-    if (m_events.size() > INT_MAX) {
-        throw std::logic_error("too many events");
-    }
-    return int(m_events.size());
+    decodeDeferredLocked();
+    return m_events.size();
 }
 
 void
 EventSeries::add(const Event &p)
 {
     QMutexLocker locker(&m_mutex);
+    decodeDeferredLocked();
 
-    bool isUnique = true;
-
-    auto pitr = lower_bound(m_events.begin(), m_events.end(), p);
-    if (pitr != m_events.end() && *pitr == p) {
-        isUnique = false;
-    }
-    m_events.insert(pitr, p);
+    const int row = m_events.upperBound(p);
+    m_events.insert(row, p);
+    m_revision = newRevision();
 
     if (!p.hasDuration() && p.getFrame() > m_finalDurationlessEventFrame) {
         m_finalDurationlessEventFrame = p.getFrame();
     }
     
-    if (p.hasDuration() && isUnique) {
-
-        const sv_frame_t frame = p.getFrame();
-        const sv_frame_t endFrame = p.getFrame() + p.getDuration();
-
-        createSeam(frame);
-        createSeam(endFrame);
-
-        // These calls must both succeed after calling createSeam above
-        const auto i0 = m_seams.find(frame);
-        const auto i1 = m_seams.find(endFrame);
-
-        for (auto i = i0; i != i1; ++i) {
-            if (i == m_seams.end()) {
-                SVCERR << "ERROR: EventSeries::add: "
-                       << "reached end of seam map"
-                       << endl;
-                break;
-            }
-            i->second.push_back(p);
-        }
+    if (p.hasDuration()) {
+        m_durationIndex.add(m_events.get(row));
     }
 
 #ifdef DEBUG_EVENT_SERIES
     std::cerr << "after add:" << std::endl;
     dumpEvents();
-    dumpSeams();
 #endif
 }
 
@@ -133,112 +212,39 @@ void
 EventSeries::remove(const Event &p)
 {
     QMutexLocker locker(&m_mutex);
+    decodeDeferredLocked();
 
-    // If we are removing the last (unique) example of an event,
-    // then we also need to remove it from the seam map. If this
-    // is only one of multiple identical events, then we don't.
     bool isUnique = true;
         
-    auto pitr = lower_bound(m_events.begin(), m_events.end(), p);
-    if (pitr == m_events.end() || *pitr != p) {
+    const int row = m_events.lowerBound(p);
+    if (row == m_events.size() || !m_events.equals(row, p)) {
         // we don't know this event
         return;
-    } else {
-        auto nitr = pitr;
-        ++nitr;
-        if (nitr != m_events.end() && *nitr == p) {
-            isUnique = false;
-        }
+    } else if (row + 1 < m_events.size() && m_events.equals(row + 1, p)) {
+        isUnique = false;
     }
 
-    m_events.erase(pitr);
+    m_events.erase(row);
+    m_revision = newRevision();
 
     if (!p.hasDuration() && isUnique &&
         p.getFrame() == m_finalDurationlessEventFrame) {
         m_finalDurationlessEventFrame = 0;
-        for (auto ritr = m_events.rbegin(); ritr != m_events.rend(); ++ritr) {
-            if (!ritr->hasDuration()) {
-                m_finalDurationlessEventFrame = ritr->getFrame();
+        for (int i = m_events.size() - 1; i >= 0; --i) {
+            if (!m_events.hasDuration(i)) {
+                m_finalDurationlessEventFrame = m_events.getFrame(i);
                 break;
             }
         }
     }
     
-    if (p.hasDuration() && isUnique) {
-            
-        const sv_frame_t frame = p.getFrame();
-        const sv_frame_t endFrame = p.getFrame() + p.getDuration();
-
-        const auto i0 = m_seams.find(frame);
-        const auto i1 = m_seams.find(endFrame);
-
-#ifdef DEBUG_EVENT_SERIES
-        // This should be impossible if we found p in m_events above
-        if (i0 == m_seams.end() || i1 == m_seams.end()) {
-            SVCERR << "ERROR: EventSeries::remove: either frame " << frame
-                   << " or endFrame " << endFrame
-                   << " for event not found in seam map: event is "
-                   << p.toXmlString() << endl;
-        }
-#endif
-
-        // Remove any and all instances of p from the seam map; we
-        // are only supposed to get here if we are removing the
-        // last instance of p from the series anyway
-            
-        for (auto i = i0; i != i1; ++i) {
-            if (i == m_seams.end()) {
-                // This can happen only if we have a negative
-                // duration, which Event forbids
-                throw std::logic_error("unexpectedly reached end of map");
-            }
-            for (size_t j = 0; j < i->second.size(); ) {
-                if (i->second[j] == p) {
-                    i->second.erase(i->second.begin() + j);
-                } else {
-                    ++j;
-                }
-            }
-        }
-
-        // Tidy up by removing any entries that are now identical
-        // to their predecessors
-            
-        std::vector<sv_frame_t> redundant;
-
-        auto pitr = m_seams.end();
-        if (i0 != m_seams.begin()) {
-            pitr = i0;
-            --pitr;
-        }
-
-        for (auto i = i0; i != m_seams.end(); ++i) {
-            if (pitr != m_seams.end() &&
-                seamsEqual(i->second, pitr->second)) {
-                redundant.push_back(i->first);
-            }
-            pitr = i;
-            if (i == i1) {
-                break;
-            }
-        }
-
-        for (sv_frame_t f: redundant) {
-            m_seams.erase(f);
-        }
-
-        // And remove any empty seams from the start of the map
-            
-        while (m_seams.begin() != m_seams.end() &&
-               m_seams.begin()->second.empty()) {
-            m_seams.erase(m_seams.begin());
-        }
+    if (p.hasDuration()) {
+        m_durationIndex.remove(p);
     }
 
 #ifdef DEBUG_EVENT_SERIES
     std::cerr << "after remove:" << std::endl;
     dumpEvents();
-    dumpSeams();
 #endif
 }
 
@@ -246,24 +252,38 @@ bool
 EventSeries::contains(const Event &p) const
 {
     QMutexLocker locker(&m_mutex);
-    return binary_search(m_events.begin(), m_events.end(), p);
+    decodeDeferredLocked();
+    const int row = m_events.lowerBound(p);
+    return row < m_events.size() && m_events.equals(row, p);
 }
 
 void
 EventSeries::clear()
 {
     QMutexLocker locker(&m_mutex);
+    m_deferred.reset();
     m_events.clear();
-    m_seams.clear();
+    m_durationIndex.clear();
     m_finalDurationlessEventFrame = 0;
+    m_revision = newRevision();
+}
+
+quint64
+EventSeries::getRevision() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_revision;
 }
 
 sv_frame_t
 EventSeries::getStartFrame() const
 {
     QMutexLocker locker(&m_mutex);
+    if (m_deferred) {
+        return m_deferred->count > 0 ? m_deferred->startFrame : 0;
+    }
     if (m_events.empty()) return 0;
-    return m_events.begin()->getFrame();
+    return m_events.getFrame(0);
 }
 
 sv_frame_t
@@ -271,17 +291,21 @@ EventSeries::getEndFrame() const
 {
     QMutexLocker locker(&m_mutex);
 
+    if (m_deferred) {
+        return m_deferred->count > 0 ? m_deferred->endFrame : 0;
+    }
+
     sv_frame_t latest = 0;
 
     if (m_events.empty()) return latest;
     
     latest = m_finalDurationlessEventFrame;
 
-    if (m_seams.empty()) return latest;
+    if (m_durationIndex.isEmpty()) return latest;
     
-    sv_frame_t lastSeam = m_seams.rbegin()->first;
-    if (lastSeam > latest) {
-        latest = lastSeam;
+    sv_frame_t lastEnd = m_durationIndex.getEndFrame();
+    if (lastEnd > latest) {
+        latest = lastEnd;
     }
 
     return latest;
@@ -292,6 +316,7 @@ EventSeries::getEventsSpanning(sv_frame_t frame,
                                sv_frame_t duration) const
 {
     QMutexLocker locker(&m_mutex);
+    decodeDeferredLocked();
 
     EventVector span;
     
@@ -300,37 +325,17 @@ EventSeries::getEventsSpanning(sv_frame_t frame,
         
     // first find any zero-duration events
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(),
-                            Event(start));
-    while (pitr != m_events.end() && pitr->getFrame() < end) {
-        if (!pitr->hasDuration()) {
-            span.push_back(*pitr);
+    const int n = m_events.size();
+    for (int i = m_events.lowerBound(start);
+         i < n && m_events.getFrame(i) < end; ++i) {
+        if (!m_events.hasDuration(i)) {
+            span.push_back(m_events.get(i));
         }
-        ++pitr;
     }
 
-    // now any non-zero-duration ones from the seam map
+    // now any non-zero-duration ones from the duration index
 
-    std::set<Event> found;
-    auto sitr = m_seams.lower_bound(start);
-    if (sitr == m_seams.end() || sitr->first > start) {
-        if (sitr != m_seams.begin()) {
-            --sitr;
-        }                
-    }
-    while (sitr != m_seams.end() && sitr->first < end) {
-        for (const auto &p: sitr->second) {
-            found.insert(p);
-        }
-        ++sitr;
-    }
-    for (const auto &p: found) {
-        auto pitr = lower_bound(m_events.begin(), m_events.end(), p);
-        while (pitr != m_events.end() && *pitr == p) {
-            span.push_back(p);
-            ++pitr;
-        }
-    }
+    m_durationIndex.getEventsSpanning(start, end, span);
             
     return span;
 }
@@ -341,6 +346,7 @@ EventSeries::getEventsWithin(sv_frame_t frame,
                              int overspill) const
 {
     QMutexLocker locker(&m_mutex);
+    decodeDeferredLocked();
 
     EventVector span;
     
@@ -352,36 +358,27 @@ EventSeries::getEventsWithin(sv_frame_t frame,
     // The core operation is very simple, it's just overspill that
     // complicates it.
 
-    Events::const_iterator reference = 
-        lower_bound(m_events.begin(), m_events.end(), Event(start));
+    const int n = m_events.size();
+    const int reference = m_events.lowerBound(start);
 
-    Events::const_iterator first = reference;
-    for (int i = 0; i < overspill; ++i) {
-        if (first == m_events.begin()) break;
-        --first;
-    }
-    for (int i = 0; i < overspill; ++i) {
-        if (first == reference) break;
-        span.push_back(*first);
-        ++first;
+    for (int i = std::max(0, reference - std::max(0, overspill));
+         i < reference; ++i) {
+        span.push_back(m_events.get(i));
     }
 
-    Events::const_iterator pitr = reference;
-    Events::const_iterator last = reference;
+    int last = reference;
 
-    while (pitr != m_events.end() && pitr->getFrame() < end) {
-        if (!pitr->hasDuration() ||
-            (pitr->getFrame() + pitr->getDuration() <= end)) {
-            span.push_back(*pitr);
-            last = pitr;
-            ++last;
+    for (int i = reference; i < n && m_events.getFrame(i) < end; ++i) {
+        if (!m_events.hasDuration(i) ||
+            (m_events.getFrame(i) + m_events.getDuration(i) <= end)) {
+            span.push_back(m_events.get(i));
+            last = i + 1;
         }
-        ++pitr;
     }
 
     for (int i = 0; i < overspill; ++i) {
-        if (last == m_events.end()) break;
-        span.push_back(*last);
+        if (last == n) break;
+        span.push_back(m_events.get(last));
         ++last;
     }
     
@@ -393,6 +390,7 @@ EventSeries::getEventsStartingWithin(sv_frame_t frame,
                                      sv_frame_t duration) const
 {
     QMutexLocker locker(&m_mutex);
+    decodeDeferredLocked();
 
     EventVector span;
     
@@ -403,12 +401,12 @@ EventSeries::getEventsStartingWithin(sv_frame_t frame,
     // earlier than the start of the given range, we can do this
     // entirely from m_events
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(),
-                            Event(start));
-    while (pitr != m_events.end() && pitr->getFrame() < end) {
-        span.push_back(*pitr);
-        ++pitr;
+    const int from = m_events.lowerBound(start);
+    int to = from;
+    while (to < m_events.size() && m_events.getFrame(to) < end) {
+        ++to;
     }
+    span = m_events.getEvents(from, to);
             
     return span;
 }
@@ -417,42 +415,23 @@ EventVector
 EventSeries::getEventsCovering(sv_frame_t frame) const
 {
     QMutexLocker locker(&m_mutex);
+    decodeDeferredLocked();
 
     EventVector cover;
 
     // first find any zero-duration events
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(),
-                            Event(frame));
-    while (pitr != m_events.end() && pitr->getFrame() == frame) {
-        if (!pitr->hasDuration()) {
-            cover.push_back(*pitr);
+    const int n = m_events.size();
+    for (int i = m_events.lowerBound(frame);
+         i < n && m_events.getFrame(i) == frame; ++i) {
+        if (!m_events.hasDuration(i)) {
+            cover.push_back(m_events.get(i));
         }
-        ++pitr;
     }
         
-    // now any non-zero-duration ones from the seam map
+    // now any non-zero-duration ones from the duration index
         
-    std::set<Event> found;
-    auto sitr = m_seams.lower_bound(frame);
-    if (sitr == m_seams.end() || sitr->first > frame) {
-        if (sitr != m_seams.begin()) {
-            --sitr;
-        }                
-    }
-    if (sitr != m_seams.end() && sitr->first <= frame) {
-        for (const auto &p: sitr->second) {
-            found.insert(p);
-        }
-        ++sitr;
-    }
-    for (const auto &p: found) {
-        auto pitr = lower_bound(m_events.begin(), m_events.end(), p);
-        while (pitr != m_events.end() && *pitr == p) {
-            cover.push_back(p);
-            ++pitr;
-        }
-    }
+    m_durationIndex.getEventsCovering(frame, cover);
         
     return cover;
 }
@@ -461,24 +440,25 @@ EventVector
 EventSeries::getAllEvents() const
 {
     QMutexLocker locker(&m_mutex);
+    decodeDeferredLocked();
 
-    return m_events;
+    return m_events.getEvents(0, m_events.size());
 }
 
 bool
 EventSeries::getEventPreceding(const Event &e, Event &preceding) const
 {
     QMutexLocker locker(&m_mutex);
+    decodeDeferredLocked();
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(), e);
-    if (pitr == m_events.end() || *pitr != e) {
+    const int row = m_events.lowerBound(e);
+    if (row == m_events.size() || !m_events.equals(row, e)) {
         return false;
     }
-    if (pitr == m_events.begin()) {
+    if (row == 0) {
         return false;
     }
-    --pitr;
-    preceding = *pitr;
+    preceding = m_events.get(row - 1);
     return true;
 }
 
@@ -486,18 +466,19 @@ bool
 EventSeries::getEventFollowing(const Event &e, Event &following) const
 {
     QMutexLocker locker(&m_mutex);
+    decodeDeferredLocked();
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(), e);
-    if (pitr == m_events.end() || *pitr != e) {
+    int row = m_events.lowerBound(e);
+    if (row == m_events.size() || !m_events.equals(row, e)) {
         return false;
     }
-    while (*pitr == e) {
-        ++pitr;
-        if (pitr == m_events.end()) {
+    while (m_events.equals(row, e)) {
+        ++row;
+        if (row == m_events.size()) {
             return false;
         }
     }
-    following = *pitr;
+    following = m_events.get(row);
     return true;
 }
 
@@ -508,32 +489,32 @@ EventSeries::getNearestEventMatching(sv_frame_t startSearchAt,
                                      Event &found) const
 {
     QMutexLocker locker(&m_mutex);
+    decodeDeferredLocked();
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(),
-                            Event(startSearchAt));
+    int row = m_events.lowerBound(startSearchAt);
 
     while (true) {
 
         if (direction == Backward) {
-            if (pitr == m_events.begin()) {
+            if (row == 0) {
                 break;
             } else {
-                --pitr;
+                --row;
             }
         } else {
-            if (pitr == m_events.end()) {
+            if (row == m_events.size()) {
                 break;
             }
         }
 
-        const Event &e = *pitr;
+        const Event e = m_events.get(row);
         if (predicate(e)) {
             found = e;
             return true;
         }
 
         if (direction == Forward) {
-            ++pitr;
+            ++row;
         }
     }
 
@@ -544,20 +525,19 @@ Event
 EventSeries::getEventByIndex(int index) const
 {
     QMutexLocker locker(&m_mutex);
-    if (!in_range_for(m_events, index)) {
+    decodeDeferredLocked();
+    if (index < 0 || index >= m_events.size()) {
         throw std::logic_error("index out of range");
     }
-    return m_events[index];
+    return m_events.get(index);
 }
 
 int
 EventSeries::getIndexForEvent(const Event &e) const
 {
     QMutexLocker locker(&m_mutex);
-    auto pitr = lower_bound(m_events.begin(), m_events.end(), e);
-    auto d = distance(m_events.begin(), pitr);
-    if (d < 0 || d > INT_MAX) return 0;
-    return int(d);
+    decodeDeferredLocked();
+    return m_events.lowerBound(e);
 }
 
 void
@@ -567,14 +547,35 @@ EventSeries::toXml(QTextStream &out,
 {
     QMutexLocker locker(&m_mutex);
 
+    if (toXmlAsBlob(out, indent, extraAttributes)) {
+        return;
+    }
+
+    decodeDeferredLocked();
+
     out << indent << QString("<dataset id=\"%1\" %2>\n")
         .arg(getExportId())
         .arg(extraAttributes);
-    
-    for (const auto &p: m_events) {
-        p.toXml(out, indent + "  ", "", {});
-        qDebug() << "JPMAUS Event Frame: " << p.getFrame();
-        qDebug() << "JPMAUS Event Label: " << p.getLabel();
+
+    auto writeEvents = [](QTextStream &out, QString indent,
+                          const EventColumns &events) {
+        for (int i = 0; i < events.size(); ++i) {
+            const Event p = events.get(i);
+            p.toXml(out, indent + "  ", "", {});
+            qDebug() << "JPMAUS Event Frame: " << p.getFrame();
+            qDebug() << "JPMAUS Event Label: " << p.getLabel();
+        }
+    };
+
+    if (FragmentSink *sink = getFragmentSink()) {
+        // Write from a copy, as for the blob in toXmlAsBlob
+        EventColumns events(m_events);
+        sink->addDeferredFragment
+            (out, [writeEvents, indent, events](QTextStream &fout) {
+                writeEvents(fout, indent, events);
+            });
+    } else {
+        writeEvents(out, indent, m_events);
     }
     
     out << indent << "</dataset>\n";
@@ -588,17 +589,77 @@ EventSeries::toXml(QTextStream &out,
 {
     QMutexLocker locker(&m_mutex);
 
+    if (toXmlAsBlob(out, indent, extraAttributes)) {
+        return;
+    }
+
+    decodeDeferredLocked();
+
     out << indent << QString("<dataset id=\"%1\" %2>\n")
         .arg(getExportId())
         .arg(extraAttributes);
-    
-    for (const auto &p: m_events) {
-        p.toXml(out, indent + "  ", "", options);
+
+    auto writeEvents = [](QTextStream &out, QString indent,
+                          const EventColumns &events,
+                          Event::ExportNameOptions options) {
+        for (int i = 0; i < events.size(); ++i) {
+            events.get(i).toXml(out, indent + "  ", "", options);
+        }
+    };
+
+    if (FragmentSink *sink = getFragmentSink()) {
+        EventColumns events(m_events);
+        sink->addDeferredFragment
+            (out, [writeEvents, indent, events, options](QTextStream &fout) {
+                writeEvents(fout, indent, events, options);
+            });
+    } else {
+        writeEvents(out, indent, m_events, options);
     }
     
     out << indent << "</dataset>\n";
 }
 
+bool
+EventSeries::toXmlAsBlob(QTextStream &out,
+                         QString indent,
+                         QString extraAttributes) const
+{
+    BlobSink *sink = getBlobSink();
+    if (!sink) {
+        return false;
+    }
+
+    QString key = QString("events:%1").arg(m_revision);
+    int index = sink->findBlob(key);
+    if (index < 0 && m_deferred) {
+        // Still undecoded, so the blob we were given is current
+        std::shared_ptr<const void> owner = m_deferred->owner;
+        const char *data = m_deferred->data;
+        qint64 size = m_deferred->size;
+        index = sink->addDeferredBlob([owner, data, size]() -> QByteArray {
+                return QByteArray(data, int(size));
+            }, key);
+    } else if (index < 0) {
+        // Encode from a copy, so that a sink that writes its blobs
+        // in the background has a consistent view of the events
+        // without our having to hold the lock until it is done
+        EventColumns events(m_events);
+        index = sink->addDeferredBlob([events]() -> QByteArray {
+                QByteArray blob;
+                events.encode(blob);
+                return blob;
+            }, key);
+    }
+    
+    out << indent << QString("<dataset id=\"%1\" %2 blob=\"%3\"/>\n")
+        .arg(getExportId())
+        .arg(extraAttributes)
+        .arg(index);
+
+    return true;
+}
+
 QString
 EventSeries::toDelimitedDataString(QString delimiter,
                                    DataExportOptions options,
@@ -609,30 +670,31 @@ EventSeries::toDelimitedDataString(QString delimiter,
                                    Event fillEvent) const
 {
     QMutexLocker locker(&m_mutex);
+    decodeDeferredLocked();
 
     QString s;
 
     const sv_frame_t end = startFrame + duration;
 
-    auto pitr = lower_bound(m_events.begin(), m_events.end(),
-                            Event(startFrame));
+    const int n = m_events.size();
+    int row = m_events.lowerBound(startFrame);
             
     if (!(options & DataExportFillGaps)) {
         
-        while (pitr != m_events.end() && pitr->getFrame() < end) {
-            s += pitr->toDelimitedDataString(delimiter,
-                                             options,
-                                             sampleRate);
+        while (row < n && m_events.getFrame(row) < end) {
+            s += m_events.get(row).toDelimitedDataString(delimiter,
+                                                         options,
+                                                         sampleRate);
             s += "\n";
-            ++pitr;
+            ++row;
         }
 
     } else {
         
         // find frame time of first point in range (if any)
         sv_frame_t first = startFrame;
-        if (pitr != m_events.end()) {
-            first = pitr->getFrame();
+        if (row < n) {
+            first = m_events.getFrame(row);
         }
 
         // project back to first frame time in range according to
@@ -646,12 +708,12 @@ EventSeries::toDelimitedDataString(QString delimiter,
         // now progress, either writing the next point (if within
         // distance) or a default fill point
         while (f < end) {
-            if (pitr != m_events.end() && pitr->getFrame() <= f) {
-                s += pitr->toDelimitedDataString
+            if (row < n && m_events.getFrame(row) <= f) {
+                s += m_events.get(row).toDelimitedDataString
                     (delimiter,
                      options & ~DataExportFillGaps,
                      sampleRate);
-                ++pitr;
+                ++row;
             } else {
                 s += fillEvent.withFrame(f).toDelimitedDataString
                     (delimiter,
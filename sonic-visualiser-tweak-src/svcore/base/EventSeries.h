@@ -16,10 +16,12 @@
 #define SV_EVENT_SERIES_H
 
 #include "Event.h"
+#include "EventColumns.h"
+#include "EventIntervalIndex.h"
 #include "XmlExportable.h"
 
-#include <set>
 #include <functional>
+#include <memory>
 
 #include <QMutex>
 
@@ -30,26 +32,30 @@
  * and supporting the ability to query which events are active at a
  * given frame or within a span of frames.
  *
- * To that end, in addition to the series of events, it stores a
- * series of "seams", which are frame positions at which the set of
- * simultaneous events changes (i.e. an event of non-zero duration
- * starts or ends) associated with a set of the events that are active
- * at or from that position. These are updated when an event is added
- * or removed.
- *
- * This class is highly optimised for inserting events in increasing
- * order of start frame. Inserting (or deleting) events in the middle
- * does work, and should be acceptable in interactive use, but it is
- * very slow in bulk.
+ * To that end, in addition to the series of events, it keeps an
+ * interval index (see EventIntervalIndex) of the events that have
+ * durations, which is updated when an event is added or removed.
+ * Queries for the events spanning a range or covering a frame take
+ * logarithmic time per result, and events may be added or removed in
+ * any order. To load many events at once, construct the series from
+ * a vector of them, which builds the index in a single pass, or give
+ * it an encoded blob with setFromBlob().
  *
  * EventSeries is thread-safe.
  */
 class EventSeries : public XmlExportable
 {
 public:
-    EventSeries() : m_finalDurationlessEventFrame(0) { }
+    EventSeries() :
+        m_finalDurationlessEventFrame(0), m_revision(newRevision()) { }
     ~EventSeries() =default;
 
+    /**
+     * Construct a series containing the given events, which need not
+     * be sorted. This is much quicker than adding them one at a time.
+     */
+    explicit EventSeries(const EventVector &events);
+
     EventSeries(const EventSeries &);
 
     EventSeries &operator=(const EventSeries &);
@@ -60,6 +66,36 @@ public:
     static EventSeries fromEvents(const EventVector &ee);
     
     void clear();
+
+    /**
+     * Replace the contents of the series with the events in the given
+     * data, in the form written by EventColumns::encode, such as a
+     * blob in a session container. The data are not decoded here, but
+     * by the first call that needs the events themselves, which
+     * decodes them in one go and builds the index in a single pass;
+     * until then, isEmpty(), getStartFrame() and getEndFrame() are
+     * answered from the header of the data, and toXml() with a blob
+     * sink writes the data out unchanged.
+     *
+     * The owner is held until the data have been decoded, and must
+     * keep them valid until then. If visit is provided, it is called
+     * with each event as it is decoded, with the series locked, and
+     * so must not call back into the series.
+     *
+     * Return false, leaving the series unchanged, if the data do not
+     * start with a valid header. If they turn out not to be valid
+     * when decoded, a warning is printed and the series is left empty.
+     */
+    bool setFromBlob(std::shared_ptr<const void> owner,
+                     const char *data, qint64 size,
+                     std::function<void(const Event &)> visit = {});
+
+    /**
+     * Decode any events still held in a blob (see setFromBlob) now,
+     * rather than on the next call that needs them.
+     */
+    void decodeDeferred() const;
+    
     void add(const Event &e);
     void remove(const Event &e);
     bool contains(const Event &e) const;
@@ -206,7 +242,23 @@ public:
     int getIndexForEvent(const Event &e) const;
 
     /**
-     * Emit to XML as a dataset element.
+     * Return a number identifying the current contents of the
+     * series. It changes whenever an event is added or removed, and
+     * is unique to those contents across all series in the process
+     * except for copies, which share the revision of the series they
+     * were copied from until either is changed.
+     */
+    quint64 getRevision() const;
+
+    /**
+     * Emit to XML as a dataset element. If a blob sink is set for
+     * the calling thread (see XmlExportable::getBlobSink), the events
+     * are written to it in the form produced by EventColumns::encode,
+     * and the dataset element is left empty but for a blob attribute
+     * giving the index of the blob. The blob is keyed by revision, so
+     * a sink that still has the blob from an earlier export of the
+     * same contents can supply it without the events being encoded
+     * again.
      */
     void toXml(QTextStream &out,
                QString indent,
@@ -236,131 +288,79 @@ private:
     mutable QMutex m_mutex;
 
     EventSeries(const EventSeries &other, const QMutexLocker &);
+
+    bool toXmlAsBlob(QTextStream &out,
+                     QString indent,
+                     QString extraAttributes) const;
+
+    /**
+     * Events set by setFromBlob and not yet decoded. While this
+     * exists, m_events and m_durationIndex are empty.
+     */
+    struct DeferredBlob {
+        std::shared_ptr<const void> owner;
+        const char *data;
+        qint64 size;
+        int count;
+        sv_frame_t startFrame;
+        sv_frame_t endFrame;
+        std::function<void(const Event &)> visit;
+    };
+    std::unique_ptr<DeferredBlob> m_deferred;
+
+    void decodeDeferredLocked() const; // call with m_mutex held
+    void buildIndex(const std::function<void(const Event &)> &visit);
     
     /**
-     * This vector contains all events in the series, in the normal
-     * sort order. For backward compatibility we must support series
+     * This contains all events in the series, in the normal sort
+     * order. For backward compatibility we must support series
      * containing multiple instances of identical events, so
-     * consecutive events in this vector will not always be distinct.
-     * The vector is used in preference to a multiset or map<Event,
-     * int> in order to allow indexing by "row number" as well as by
-     * properties such as frame.
+     * consecutive rows will not always be distinct. A sequence is
+     * used in preference to a multiset or map<Event, int> in order to
+     * allow indexing by "row number" as well as by properties such as
+     * frame.
+     *
+     * The events are stored column-wise, with interned labels (see
+     * EventColumns), and Event objects are built from them only as
+     * they are returned.
      * 
      * Because events are immutable, we do not have to worry about the
      * order changing once an event is inserted - we only add or
      * delete them.
      */
-    typedef std::vector<Event> Events;
-    Events m_events;
+    EventColumns m_events;
     
     /**
-     * The FrameEventMap maps from frame number to a set of events. In
-     * the seam map this is used to represent the events that are
-     * active at that frame, either because they begin at that frame
-     * or because they are continuing from an earlier frame. There is
-     * an entry here for each frame at which an event starts or ends,
-     * with the event appearing in all entries from its start time
-     * onward and disappearing again at its end frame.
-     *
-     * Only events with duration appear in this map; point events
-     * appear only in m_events. Note that unlike m_events, we only
-     * store one instance of each event here, even if we hold many -
-     * we refer back to m_events when we need to know how many
-     * identical copies of a given event we have.
+     * Index of the events with duration, for the spanning and
+     * covering queries. Like m_events, this holds each instance of an
+     * event, but identical events are counted rather than stored
+     * separately. Point events appear only in m_events.
      */
-    typedef std::map<sv_frame_t, std::vector<Event>> FrameEventMap;
-    FrameEventMap m_seams;
+    EventIntervalIndex m_durationIndex;
 
     /**
      * The frame of the last durationless event we have in the series.
      * This is to support a fast-ish getEndFrame(): we can easily keep
      * this up-to-date when events are added or removed, and we can
      * easily find the end frame of the last with-duration event from
-     * the seam map, but it's not so easy to continuously update an
-     * overall end frame or to find the last frame of all events
+     * the duration index, but it's not so easy to continuously update
+     * an overall end frame or to find the last frame of all events
      * without this.
      */
     sv_frame_t m_finalDurationlessEventFrame;
-    
-    /** 
-     * Create a seam at the given frame, copying from the prior seam
-     * if there is one. If a seam already exists at the given frame,
-     * leave it untouched.
-     *
-     * Call with m_mutex locked.
-     */
-    void createSeam(sv_frame_t frame) {
-        auto itr = m_seams.lower_bound(frame);
-        if (itr == m_seams.end() || itr->first > frame) {
-            if (itr != m_seams.begin()) {
-                --itr;
-            }
-        }
-        if (itr == m_seams.end()) {
-            m_seams[frame] = {};
-        } else if (itr->first < frame) {
-            m_seams[frame] = itr->second;
-        } else if (itr->first > frame) { // itr must be begin()
-            m_seams[frame] = {};
-        }
-    }
 
-    /** 
-     * Return true if the two seam map entries contain the same set of
-     * events.
-     *
-     * Precondition: no duplicates, i.e. no event appears more than
-     * once in s1 or more than once in s2.
-     *
-     * Call with m_mutex locked.
+    /**
+     * See getRevision(). Updated from newRevision() by every change.
      */
-    bool seamsEqual(const std::vector<Event> &s1,
-                    const std::vector<Event> &s2) const {
-        
-        if (s1.size() != s2.size()) {
-            return false;
-        }
-
-#ifdef DEBUG_EVENT_SERIES
-        for (int i = 0; in_range_for(s1, i); ++i) {
-            for (int j = i + 1; in_range_for(s1, j); ++j) {
-                if (s1[i] == s1[j] || s2[i] == s2[j]) {
-                    throw std::runtime_error
-                        ("debug error: duplicate event in s1 or s2");
-                }
-            }
-        }
-#endif
-
-        std::set<Event> ee;
-        for (const auto &e: s1) {
-            ee.insert(e);
-        }
-        for (const auto &e: s2) {
-            if (ee.find(e) == ee.end()) {
-                return false;
-            }
-        }
-        return true;
-    }
+    quint64 m_revision;
 
+    static quint64 newRevision();
+    
 #ifdef DEBUG_EVENT_SERIES
     void dumpEvents() const {
         std::cerr << "EVENTS (" << m_events.size() << ") [" << std::endl;
-        for (const auto &i: m_events) {
-            std::cerr << "  " << i.toXmlString();
-        }
-        std::cerr << "]" << std::endl;
-    }
-    
-    void dumpSeams() const {
-        std::cerr << "SEAMS (" << m_seams.size() << ") [" << std::endl;
-        for (const auto &s: m_seams) {
-            std::cerr << "  " << s.first << " -> {" << std::endl;
-            for (const auto &p: s.second) {
-                std::cerr << p.toXmlString("    ");
-            }
-            std::cerr << "  }" << std::endl;
+        for (int i = 0; i < m_events.size(); ++i) {
+            std::cerr << "  " << m_events.get(i).toXmlString();
         }
         std::cerr << "]" << std::endl;
     }
@@ -0,0 +1,185 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "InterleavedRingBuffer.h"
+
+#include <cstdint>
+#include <cstring>
+
+static const int cacheLineFloats = 64 / sizeof(float);
+
+static int
+roundUpToPowerOfTwo(int n)
+{
+    int p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+InterleavedRingBuffer::InterleavedRingBuffer(int channels, int frames) :
+    m_channels(channels < 1 ? 1 : channels),
+    m_size(roundUpToPowerOfTwo(frames < 1 ? 1 : frames)),
+    m_mask(unsigned(m_size) - 1),
+    m_writeCount(0),
+    m_readCount(0)
+{
+    // Over-allocate by a cache line so that we can align the start
+    m_allocation = new float[size_t(m_size) * m_channels + cacheLineFloats];
+    uintptr_t p = reinterpret_cast<uintptr_t>(m_allocation);
+    uintptr_t aligned = (p + 63) & ~uintptr_t(63);
+    m_buffer = m_allocation + (aligned - p) / sizeof(float);
+    memset(m_buffer, 0, size_t(m_size) * m_channels * sizeof(float));
+}
+
+InterleavedRingBuffer::~InterleavedRingBuffer()
+{
+    delete[] m_allocation;
+}
+
+void
+InterleavedRingBuffer::reset()
+{
+    m_writeCount.store(0, std::memory_order_relaxed);
+    m_readCount.store(0, std::memory_order_release);
+}
+
+int
+InterleavedRingBuffer::getReadSpace() const
+{
+    unsigned int w = m_writeCount.load(std::memory_order_acquire);
+    unsigned int r = m_readCount.load(std::memory_order_acquire);
+    return int(w - r);
+}
+
+int
+InterleavedRingBuffer::getWriteSpace() const
+{
+    return m_size - getReadSpace();
+}
+
+int
+InterleavedRingBuffer::write(const float *const *source, int n)
+{
+    unsigned int w = m_writeCount.load(std::memory_order_relaxed);
+    unsigned int r = m_readCount.load(std::memory_order_acquire);
+
+    int space = m_size - int(w - r);
+    if (n > space) n = space;
+    if (n <= 0) return 0;
+
+    // Write in up to two runs, either side of the wrap point
+    int done = 0;
+    while (done < n) {
+        unsigned int start = (w + unsigned(done)) & m_mask;
+        int run = m_size - int(start);
+        if (run > n - done) run = n - done;
+        float *out = m_buffer + size_t(start) * m_channels;
+        for (int i = 0; i < run; ++i) {
+            for (int c = 0; c < m_channels; ++c) {
+                out[i * m_channels + c] = source[c][done + i];
+            }
+        }
+        done += run;
+    }
+
+    m_writeCount.store(w + unsigned(n), std::memory_order_release);
+    return n;
+}
+
+int
+InterleavedRingBuffer::read(float *const *destination, int outChannels, int n)
+{
+    unsigned int r = m_readCount.load(std::memory_order_relaxed);
+    unsigned int w = m_writeCount.load(std::memory_order_acquire);
+
+    int available = int(w - r);
+    int got = (n < available ? n : available);
+    if (got < 0) got = 0;
+
+    int channels = (outChannels < m_channels ? outChannels : m_channels);
+
+    int done = 0;
+    while (done < got) {
+        unsigned int start = (r + unsigned(done)) & m_mask;
+        int run = m_size - int(start);
+        if (run > got - done) run = got - done;
+        const float *in = m_buffer + size_t(start) * m_channels;
+        for (int c = 0; c < channels; ++c) {
+            float *out = destination[c] + done;
+            for (int i = 0; i < run; ++i) {
+                out[i] = in[i * m_channels + c];
+            }
+        }
+        done += run;
+    }
+
+    for (int c = 0; c < outChannels; ++c) {
+        int from = (c < channels ? got : 0);
+        if (from < n) {
+            memset(destination[c] + from, 0, (n - from) * sizeof(float));
+        }
+    }
+
+    m_readCount.store(r + unsigned(got), std::memory_order_release);
+    return got;
+}
+
+int
+InterleavedRingBuffer::readMixedDown(float *destination, int n)
+{
+    unsigned int r = m_readCount.load(std::memory_order_relaxed);
+    unsigned int w = m_writeCount.load(std::memory_order_acquire);
+
+    int available = int(w - r);
+    int got = (n < available ? n : available);
+    if (got < 0) got = 0;
+
+    int done = 0;
+    while (done < got) {
+        unsigned int start = (r + unsigned(done)) & m_mask;
+        int run = m_size - int(start);
+        if (run > got - done) run = got - done;
+        const float *in = m_buffer + size_t(start) * m_channels;
+        float *out = destination + done;
+        for (int i = 0; i < run; ++i) {
+            float sum = 0.f;
+            for (int c = 0; c < m_channels; ++c) {
+                sum += in[i * m_channels + c];
+            }
+            out[i] = sum;
+        }
+        done += run;
+    }
+
+    if (got < n) {
+        memset(destination + got, 0, (n - got) * sizeof(float));
+    }
+
+    m_readCount.store(r + unsigned(got), std::memory_order_release);
+    return got;
+}
+
+int
+InterleavedRingBuffer::skip(int n)
+{
+    unsigned int r = m_readCount.load(std::memory_order_relaxed);
+    unsigned int w = m_writeCount.load(std::memory_order_acquire);
+
+    int available = int(w - r);
+    if (n > available) n = available;
+    if (n <= 0) return 0;
+
+    m_readCount.store(r + unsigned(n), std::memory_order_release);
+    return n;
+}
@@ -0,0 +1,119 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_INTERLEAVED_RING_BUFFER_H
+#define SV_INTERLEAVED_RING_BUFFER_H
+
+#include <atomic>
+
+/**
+ * A lock-free ring buffer of multi-channel float audio, for exactly
+ * one writer thread and one reader thread.
+ *
+ * All channels share a single interleaved buffer and a single pair
+ * of read and write counters, so the channels cannot drift out of
+ * step with one another and a read or write of several channels
+ * touches one contiguous block of memory. The counters sit on
+ * separate cache lines so that the reader and writer do not
+ * contend for them, and the storage itself is cache-line aligned.
+ *
+ * The capacity is rounded up to a power of two frames, and all of
+ * it may be used. Nothing is allocated after construction, and no
+ * method blocks, so the reader may be a realtime audio thread.
+ */
+class InterleavedRingBuffer
+{
+public:
+    /**
+     * Create a ring buffer with room for at least the given number
+     * of frames in each of the given number of channels.
+     */
+    InterleavedRingBuffer(int channels, int frames);
+    ~InterleavedRingBuffer();
+
+    InterleavedRingBuffer(const InterleavedRingBuffer &) = delete;
+    InterleavedRingBuffer &operator=(const InterleavedRingBuffer &) = delete;
+
+    int getChannelCount() const { return m_channels; }
+
+    /**
+     * Return the capacity in frames.
+     */
+    int getSize() const { return m_size; }
+
+    /**
+     * Empty the buffer. This touches both counters, so it may only
+     * be called when no other thread is using the buffer.
+     */
+    void reset();
+
+    /**
+     * Return the number of frames available to read. May be called
+     * from any thread, though the value is only exact on the reader.
+     */
+    int getReadSpace() const;
+
+    /**
+     * Return the number of frames that may be written. May be called
+     * from any thread, though the value is only exact on the writer.
+     */
+    int getWriteSpace() const;
+
+    /**
+     * Write up to n frames, taking each channel from the
+     * corresponding element of source. Return the number of frames
+     * written, which will be fewer than n if there is not enough
+     * space. Writer thread only.
+     */
+    int write(const float *const *source, int n);
+
+    /**
+     * Read up to n frames into the first outChannels channels of
+     * destination, discarding any further channels in the buffer and
+     * zeroing any further channels in destination. If fewer than n
+     * frames are available, the remainder of each destination channel
+     * is zeroed. Return the number of frames read. Reader thread only.
+     */
+    int read(float *const *destination, int outChannels, int n);
+
+    /**
+     * Read up to n frames, writing the sum of all channels into the
+     * single channel destination. If fewer than n frames are
+     * available, the remainder is zeroed. Return the number of
+     * frames read. Reader thread only.
+     */
+    int readMixedDown(float *destination, int n);
+
+    /**
+     * Discard up to n frames. Return the number discarded. Reader
+     * thread only, or the writer when there is no reader.
+     */
+    int skip(int n);
+
+private:
+    const int m_channels;
+    const int m_size;
+    const unsigned int m_mask;
+    float *m_allocation;
+    float *m_buffer;
+
+    // Each counter counts frames since the last reset, wrapping at
+    // 2^32, which is a multiple of the power-of-two size. The
+    // alignment also pads the object out to a whole number of cache
+    // lines, so nothing else shares the read counter's line
+    alignas(64) std::atomic<unsigned int> m_writeCount;
+    alignas(64) std::atomic<unsigned int> m_readCount;
+};
+
+#endif
@@ -0,0 +1,280 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "MemoryBudget.h"
+
+#include "Debug.h"
+
+#include "system/System.h"
+
+#include <QSettings>
+#include <QMutexLocker>
+
+#include <algorithm>
+
+//#define DEBUG_MEMORY_BUDGET 1
+
+struct MemoryBudget::AccountData
+{
+    AccountData(QString n, Cost c, Evictor e) :
+        name(n), cost(c), evictor(e), bytes(0), lastUse(0), alive(true) { }
+
+    const QString name;
+    const Cost cost;
+    const Evictor evictor;
+    std::atomic<size_t> bytes;
+    std::atomic<uint64_t> lastUse;
+
+    // Held while the evictor is called, and by the account's
+    // destructor while it marks the account as no longer alive
+    QMutex evictMutex;
+    bool alive;
+};
+
+MemoryBudget::Account::Account(QString name, Cost cost, Evictor evictor,
+                               MemoryBudget *budget) :
+    m_budget(budget ? budget : MemoryBudget::getInstance()),
+    m_data(std::make_shared<AccountData>(name, cost, evictor))
+{
+    m_data->lastUse = ++m_budget->m_clock;
+    m_budget->add(m_data);
+}
+
+MemoryBudget::Account::~Account()
+{
+    {
+        QMutexLocker locker(&m_data->evictMutex);
+        m_data->alive = false;
+    }
+    m_budget->remove(m_data.get());
+}
+
+void
+MemoryBudget::Account::setBytes(size_t bytes)
+{
+    m_budget->update(m_data.get(), bytes);
+}
+
+size_t
+MemoryBudget::Account::getBytes() const
+{
+    return m_data->bytes;
+}
+
+void
+MemoryBudget::Account::touch()
+{
+    m_data->lastUse.store(++m_budget->m_clock, std::memory_order_relaxed);
+}
+
+MemoryBudget::MemoryBudget(size_t limit) :
+    m_limit(limit),
+    m_usage(0),
+    m_unevictable(0),
+    m_clock(0)
+{
+}
+
+MemoryBudget::~MemoryBudget()
+{
+    if (!m_accounts.empty()) {
+        SVCERR << "WARNING: MemoryBudget::~MemoryBudget: "
+               << m_accounts.size() << " account(s) still open" << endl;
+    }
+}
+
+MemoryBudget *
+MemoryBudget::getInstance()
+{
+    static MemoryBudget instance(getDefaultLimit());
+    return &instance;
+}
+
+size_t
+MemoryBudget::getDefaultLimit()
+{
+    const size_t mb = 1024 * 1024;
+
+    QSettings settings;
+    settings.beginGroup("MemoryBudget");
+    int limitMb = settings.value("limit-mb", 0).toInt();
+    settings.endGroup();
+
+    if (limitMb > 0) {
+        SVDEBUG << "MemoryBudget: Using limit of " << limitMb
+                << "M from settings" << endl;
+        return size_t(limitMb) * mb;
+    }
+
+    ssize_t available = 0, total = 0;
+    GetRealMemoryMBAvailable(available, total);
+
+    size_t limit = 1024 * mb;
+    if (total > 0) {
+        limit = (size_t(total) / 2) * mb;
+    }
+
+    // In a 32-bit process we can't address much more than this
+    // whatever the physical memory
+    if (sizeof(void *) < 8) {
+        limit = std::min(limit, size_t(1536) * mb);
+    }
+
+    SVDEBUG << "MemoryBudget: Physical memory " << total
+            << "M, using default limit of " << (limit / mb) << "M" << endl;
+
+    return limit;
+}
+
+size_t
+MemoryBudget::getLimit() const
+{
+    return m_limit;
+}
+
+void
+MemoryBudget::setLimit(size_t limit)
+{
+    m_limit = limit;
+    evict(0, nullptr);
+}
+
+size_t
+MemoryBudget::getUsage() const
+{
+    return m_usage;
+}
+
+size_t
+MemoryBudget::getUnevictableUsage() const
+{
+    return m_unevictable;
+}
+
+bool
+MemoryBudget::canAccommodate(size_t bytes) const
+{
+    size_t limit = m_limit;
+    size_t fixed = m_unevictable;
+    return fixed <= limit && bytes <= limit - fixed;
+}
+
+bool
+MemoryBudget::makeRoom(size_t bytes, const Account *except)
+{
+    return evict(bytes, except ? except->m_data.get() : nullptr);
+}
+
+void
+MemoryBudget::add(std::shared_ptr<AccountData> data)
+{
+    QMutexLocker locker(&m_mutex);
+    m_accounts.push_back(data);
+}
+
+void
+MemoryBudget::remove(const AccountData *data)
+{
+    update(const_cast<AccountData *>(data), 0);
+
+    QMutexLocker locker(&m_mutex);
+    for (auto i = m_accounts.begin(); i != m_accounts.end(); ++i) {
+        if (i->get() == data) {
+            m_accounts.erase(i);
+            break;
+        }
+    }
+}
+
+void
+MemoryBudget::update(AccountData *data, size_t bytes)
+{
+    size_t previous = data->bytes.exchange(bytes);
+    if (previous == bytes) return;
+
+    if (bytes > previous) {
+        size_t diff = bytes - previous;
+        if (data->cost == Unevictable) m_unevictable += diff;
+        size_t usage = (m_usage += diff);
+        data->lastUse.store(++m_clock, std::memory_order_relaxed);
+        if (usage > m_limit) {
+            evict(0, data);
+        }
+    } else {
+        size_t diff = previous - bytes;
+        if (data->cost == Unevictable) m_unevictable -= diff;
+        m_usage -= diff;
+    }
+}
+
+bool
+MemoryBudget::evict(size_t bytes, const AccountData *except)
+{
+    auto fits = [&]() -> bool {
+        size_t usage = m_usage, limit = m_limit;
+        return usage <= limit && bytes <= limit - usage;
+    };
+
+    if (fits()) return true;
+
+    std::vector<std::shared_ptr<AccountData>> candidates;
+    {
+        QMutexLocker locker(&m_mutex);
+        for (const auto &a: m_accounts) {
+            if (a.get() != except && a->cost != Unevictable && a->bytes > 0) {
+                candidates.push_back(a);
+            }
+        }
+    }
+
+    // Release first whatever has the highest ratio of time since
+    // last use to cost of recalculation. Ages are taken now, so
+    // that the order is stable while sorting.
+    uint64_t now = m_clock;
+    std::vector<std::pair<double, std::shared_ptr<AccountData>>> ordered;
+    for (const auto &a: candidates) {
+        double age = double(now - std::min(now, uint64_t(a->lastUse))) + 1.0;
+        ordered.push_back({ age / double(a->cost), a });
+    }
+    std::stable_sort(ordered.begin(), ordered.end(),
+                     [](const std::pair<double, std::shared_ptr<AccountData>> &a,
+                        const std::pair<double, std::shared_ptr<AccountData>> &b)
+                     -> bool {
+                         return a.first > b.first;
+                     });
+
+    for (const auto &o: ordered) {
+
+        if (fits()) break;
+
+        AccountData *a = o.second.get();
+
+        // Skip any account that is being evicted by another thread,
+        // or is being closed
+        if (!a->evictMutex.tryLock()) continue;
+
+        if (a->alive && a->evictor) {
+#ifdef DEBUG_MEMORY_BUDGET
+            SVDEBUG << "MemoryBudget: Usage " << m_usage << " of limit "
+                    << m_limit << ", releasing " << a->bytes
+                    << " bytes from " << a->name << endl;
+#endif
+            a->evictor();
+        }
+
+        a->evictMutex.unlock();
+    }
+
+    return fits();
+}
@@ -0,0 +1,190 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_MEMORY_BUDGET_H
+#define SV_MEMORY_BUDGET_H
+
+#include <QString>
+#include <QMutex>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * A process-wide budget for the memory used by caches: decoded audio,
+ * waveform summaries, spectrogram peak caches, rendered images and
+ * the like.
+ *
+ * Each cache holds an Account with the budget, and keeps it up to
+ * date with the number of bytes it is actually using. When the total
+ * across all accounts exceeds the limit, the budget asks caches that
+ * can be recalculated to release their memory, preferring those that
+ * have gone longest without being used and that are cheapest to
+ * recalculate, until the total is back within the limit.
+ *
+ * Caches that cannot be released (for example because they are the
+ * only copy of some data, or because they may only be touched from
+ * one thread) are still accounted, and other caches are released to
+ * make room for them.
+ *
+ * The limit is taken from the "limit-mb" value in the "MemoryBudget"
+ * settings group if present, or is otherwise half of the physical
+ * memory.
+ *
+ * MemoryBudget is thread-safe.
+ */
+class MemoryBudget
+{
+public:
+    /**
+     * The relative cost of recalculating a byte of a cache after it
+     * has been released, used as a weight when choosing what to
+     * release.
+     */
+    enum Cost {
+        Unevictable = 0, // cannot be released at all
+        Cheap = 1,
+        Moderate = 4,
+        Expensive = 16
+    };
+
+    /**
+     * A function that releases all the memory of a cache that can be
+     * released, and then reports the new size through the cache's
+     * Account::setBytes. It may be called from any thread, and must
+     * not wait for any lock that the cache might hold while calling
+     * into the budget: use tryLock and do nothing if it fails.
+     */
+    typedef std::function<void()> Evictor;
+
+private:
+    struct AccountData;
+
+public:
+    /**
+     * A record of the memory used by a single cache. The account
+     * is registered with the budget on construction and removed on
+     * destruction, after which its evictor will not be called. A
+     * cache should therefore declare its account after the data it
+     * accounts for, so that the account is destroyed first.
+     */
+    class Account
+    {
+    public:
+        /**
+         * Open an account in the given budget, or the global one if
+         * budget is null. The name is used only for debug output.
+         */
+        Account(QString name, Cost cost, Evictor evictor = Evictor(),
+                MemoryBudget *budget = nullptr);
+        ~Account();
+
+        /**
+         * Set the number of bytes in use. If this is an increase
+         * that takes the budget over its limit, other caches are
+         * released (on the calling thread) to make room.
+         */
+        void setBytes(size_t bytes);
+
+        size_t getBytes() const;
+
+        /**
+         * Note that the cache has just been used. This is cheap
+         * enough to call on every lookup.
+         */
+        void touch();
+
+    private:
+        Account(const Account &) =delete;
+        Account &operator=(const Account &) =delete;
+
+        MemoryBudget *m_budget;
+        std::shared_ptr<AccountData> m_data;
+
+        friend class MemoryBudget;
+    };
+
+    /**
+     * Construct a budget with the given limit in bytes. Normally the
+     * global instance is used, but separate budgets may be useful
+     * for testing.
+     */
+    explicit MemoryBudget(size_t limit);
+    ~MemoryBudget();
+
+    static MemoryBudget *getInstance();
+
+    size_t getLimit() const;
+
+    /**
+     * Change the limit, releasing caches if the budget is now over
+     * it.
+     */
+    void setLimit(size_t limit);
+
+    /**
+     * Return the total number of bytes in use across all accounts.
+     */
+    size_t getUsage() const;
+
+    /**
+     * Return the number of bytes in use by caches that cannot be
+     * released.
+     */
+    size_t getUnevictableUsage() const;
+
+    /**
+     * Return true if the given number of further bytes could be
+     * used within the limit, if necessary after releasing caches
+     * that can be released. Callers deciding how large a cache to
+     * create should ask this, rather than about free memory.
+     */
+    bool canAccommodate(size_t bytes) const;
+
+    /**
+     * Release caches until the given number of further bytes can be
+     * used within the limit, or until there is nothing left that can
+     * be released, skipping the given account if any. Return true if
+     * there is now room.
+     */
+    bool makeRoom(size_t bytes, const Account *except = nullptr);
+
+    /**
+     * Return the limit to be used for the global budget, from the
+     * settings or the amount of physical memory.
+     */
+    static size_t getDefaultLimit();
+
+private:
+    MemoryBudget(const MemoryBudget &) =delete;
+    MemoryBudget &operator=(const MemoryBudget &) =delete;
+
+    mutable QMutex m_mutex; // for m_accounts
+    std::vector<std::shared_ptr<AccountData>> m_accounts;
+    std::atomic<size_t> m_limit;
+    std::atomic<size_t> m_usage;
+    std::atomic<size_t> m_unevictable;
+    std::atomic<uint64_t> m_clock;
+
+    void add(std::shared_ptr<AccountData> data);
+    void remove(const AccountData *data);
+    void update(AccountData *data, size_t bytes);
+    bool evict(size_t bytes, const AccountData *except);
+};
+
+#endif
@@ -52,7 +52,10 @@ Preferences::Preferences() :
     m_timeToTextMode(TimeToTextMs),
     m_showHMS(true),
     m_octave(4),
-    m_showSplash(true)
+    m_showSplash(true),
+    m_saveSessionContainers(false),
+    m_fastSessionCompression(false),
+    m_storeSpectrogramData(true)
 {
     QSettings settings;
     settings.beginGroup("Preferences");
@@ -78,6 +81,12 @@ Preferences::Preferences() :
     m_octave = (settings.value("octave-of-middle-c", 4)).toInt();
     m_viewFontSize = settings.value("view-font-size", 10).toInt();
     m_showSplash = settings.value("show-splash", true).toBool();
+    m_saveSessionContainers =
+        settings.value("save-session-containers", false).toBool();
+    m_fastSessionCompression =
+        settings.value("fast-session-compression", false).toBool();
+    m_storeSpectrogramData =
+        settings.value("store-spectrogram-data", true).toBool();
     settings.endGroup();
 
     settings.beginGroup("TempDirectory");
@@ -111,6 +120,9 @@ Preferences::getProperties() const
     props.push_back("Octave Numbering System");
     props.push_back("View Font Size");
     props.push_back("Show Splash Screen");
+    props.push_back("Save Session Containers");
+    props.push_back("Fast Session Compression");
+    props.push_back("Store Spectrogram Data");
     return props;
 }
 
@@ -171,6 +183,15 @@ Preferences::getPropertyLabel(const PropertyName &name) const
     if (name == "Show Splash Screen") {
         return tr("Show splash screen on startup");
     }
+    if (name == "Save Session Containers") {
+        return tr("Save sessions in compact binary form");
+    }
+    if (name == "Fast Session Compression") {
+        return tr("Compress sessions for speed (not readable by older versions)");
+    }
+    if (name == "Store Spectrogram Data") {
+        return tr("Keep spectrogram data on disc for reuse");
+    }
     return name;
 }
 
@@ -232,6 +253,15 @@ Preferences::getPropertyType(const PropertyName &name) const
     if (name == "Show Splash Screen") {
         return ToggleProperty;
     }
+    if (name == "Save Session Containers") {
+        return ToggleProperty;
+    }
+    if (name == "Fast Session Compression") {
+        return ToggleProperty;
+    }
+    if (name == "Store Spectrogram Data") {
+        return ToggleProperty;
+    }
     return InvalidProperty;
 }
 
@@ -318,6 +348,21 @@ Preferences::getPropertyRangeAndValue(const PropertyName &name,
         return m_showSplash ? 1 : 0;
     }
 
+    if (name == "Save Session Containers") {
+        if (deflt) *deflt = 0;
+        return m_saveSessionContainers ? 1 : 0;
+    }
+
+    if (name == "Fast Session Compression") {
+        if (deflt) *deflt = 0;
+        return m_fastSessionCompression ? 1 : 0;
+    }
+
+    if (name == "Store Spectrogram Data") {
+        if (deflt) *deflt = 1;
+        return m_storeSpectrogramData ? 1 : 0;
+    }
+
     return 0;
 }
 
@@ -433,6 +478,12 @@ Preferences::setProperty(const PropertyName &name, int value)
         setViewFontSize(value);
     } else if (name == "Show Splash Screen") {
         setShowSplash(value ? true : false);
+    } else if (name == "Save Session Containers") {
+        setSaveSessionContainers(value ? true : false);
+    } else if (name == "Fast Session Compression") {
+        setFastSessionCompression(value ? true : false);
+    } else if (name == "Store Spectrogram Data") {
+        setStoreSpectrogramData(value ? true : false);
     }
 }
 
@@ -717,3 +768,48 @@ Preferences::setShowSplash(bool show)
     }
 }
         
+
+void
+Preferences::setSaveSessionContainers(bool save)
+{
+    if (m_saveSessionContainers != save) {
+
+        m_saveSessionContainers = save;
+
+        QSettings settings;
+        settings.beginGroup("Preferences");
+        settings.setValue("save-session-containers", save);
+        settings.endGroup();
+        emit propertyChanged("Save Session Containers");
+    }
+}
+
+void
+Preferences::setFastSessionCompression(bool fast)
+{
+    if (m_fastSessionCompression != fast) {
+
+        m_fastSessionCompression = fast;
+
+        QSettings settings;
+        settings.beginGroup("Preferences");
+        settings.setValue("fast-session-compression", fast);
+        settings.endGroup();
+        emit propertyChanged("Fast Session Compression");
+    }
+}
+
+void
+Preferences::setStoreSpectrogramData(bool store)
+{
+    if (m_storeSpectrogramData != store) {
+
+        m_storeSpectrogramData = store;
+
+        QSettings settings;
+        settings.beginGroup("Preferences");
+        settings.setValue("store-spectrogram-data", store);
+        settings.endGroup();
+        emit propertyChanged("Store Spectrogram Data");
+    }
+}
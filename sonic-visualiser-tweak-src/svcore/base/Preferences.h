@@ -107,6 +107,15 @@ public:
     
     bool getShowSplash() const { return m_showSplash; }
 
+    /// True if sessions should be saved as binary session containers rather than XML
+    bool getSaveSessionContainers() const { return m_saveSessionContainers; }
+
+    /// True if session XML should be compressed in parallel, with zstd where supported, in a form older versions cannot read
+    bool getFastSessionCompression() const { return m_fastSessionCompression; }
+
+    /// True if spectrogram FFT columns should be kept on disc for reuse, in this session and later ones
+    bool getStoreSpectrogramData() const { return m_storeSpectrogramData; }
+
 public slots:
     void setProperty(const PropertyName &, int) override;
 
@@ -128,6 +137,9 @@ public slots:
     void setOctaveOfMiddleC(int oct);
     void setViewFontSize(int size);
     void setShowSplash(bool);
+    void setSaveSessionContainers(bool);
+    void setFastSessionCompression(bool);
+    void setStoreSpectrogramData(bool);
 
 private:
     Preferences(); // may throw DirectoryCreationFailed
@@ -166,6 +178,9 @@ private:
     bool m_showHMS;
     int m_octave;
     bool m_showSplash;
+    bool m_saveSessionContainers;
+    bool m_fastSessionCompression;
+    bool m_storeSpectrogramData;
 };
 
 #endif
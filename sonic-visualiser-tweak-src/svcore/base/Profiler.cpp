@@ -19,206 +19,557 @@
    and QMUL.
 */
 
-#include <iostream>
 #include "Profiler.h"
 
-#include <cstdio>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QFile>
+#include <QTextStream>
 
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <cmath>
 #include <vector>
 #include <algorithm>
-#include <set>
 #include <map>
 
-Profiles* Profiles::m_instance = nullptr;
+namespace {
 
-Profiles* Profiles::getInstance()
+int
+initialMode()
 {
-    if (!m_instance) m_instance = new Profiles();
-    
-    return m_instance;
+    std::string value;
+    if (!getEnvUtf8("SV_PROFILE", value) || value == "" || value == "0") {
+        return 0;
+    }
+    return (value == "trace" ? 2 : 1);
 }
 
-Profiles::Profiles()
+QString
+jsonString(const std::string &s)
 {
+    QString out("\"");
+    for (char c: s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (uchar(c) < 0x20) {
+            out += QString("\\u%1").arg(int(uchar(c)), 4, 16, QChar('0'));
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+    return out;
 }
 
-Profiles::~Profiles()
-{
-    dump();
 }
 
+std::atomic<bool> Profiles::m_enabled(initialMode() > 0);
+std::atomic<bool> Profiles::m_tracing(initialMode() > 1);
+
 #ifndef NO_TIMING
-void Profiles::accumulate(
-    const char* id, clock_t time, RealTime rt
-)
-{
-    ProfilePair &pair(m_profiles[id]);
-    ++pair.first;
-    pair.second.first += time;
-    pair.second.second = pair.second.second + rt;
 
-    TimePair &lastPair(m_lastCalls[id]);
-    lastPair.first = time;
-    lastPair.second = rt;
+namespace {
+
+// Each thread has a fixed table of this many profile points, which
+// is far more than any thread reaches in practice; calls to points
+// that don't fit are counted as dropped
+const int slotCount = 128;
+
+// Durations are histogrammed in nanoseconds, two buckets per octave
+const int bucketCount = 84;
+
+// Number of recent calls kept per thread when tracing
+const int traceSize = 4096;
+
+// All of the counters below are written only by the thread that owns
+// them, with plain loads and stores rather than read-modify-write
+// operations, and are read by other threads only when taking a
+// snapshot. They are atomic so that those reads are well-defined.
+
+struct Slot {
+    std::atomic<const char *> name;
+    std::atomic<uint64_t> calls;
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> worst;
+    std::atomic<uint32_t> buckets[bucketCount];
+};
+
+// A trace entry is guarded by a sequence number, which is odd while
+// the entry is being written, so that a reader can tell when it has
+// seen a torn entry and skip it
+struct TraceEntry {
+    std::atomic<uint32_t> seq;
+    std::atomic<const char *> name;
+    std::atomic<int64_t> start;
+    std::atomic<int64_t> duration;
+};
+
+struct ThreadData {
+    ThreadData(int id_) : id(id_), dropped(0), trace(nullptr), traced(0) {
+        for (auto &s: slots) {
+            s.name.store(nullptr);
+            s.calls.store(0);
+            s.total.store(0);
+            s.worst.store(0);
+            for (auto &b: s.buckets) {
+                b.store(0);
+            }
+        }
+    }
+    
+    const int id;
+    Slot slots[slotCount];
+    std::atomic<uint64_t> dropped;
+    std::atomic<TraceEntry *> trace;
+    std::atomic<uint64_t> traced;
+};
+
+// ThreadData objects are never deleted. When a thread exits, its
+// data (with the figures it accumulated) is handed on to the next
+// thread to start profiling, so the number in existence is bounded
+// by the number of threads running at once
+struct Registry {
+    QMutex mutex;
+    std::vector<ThreadData *> all;
+    std::vector<ThreadData *> spare;
+};
+
+Registry &
+registry()
+{
+    static Registry *r = new Registry;
+    return *r;
+}
 
-    TimePair &worstPair(m_worstCalls[id]);
-    if (time > worstPair.first) {
-        worstPair.first = time;
+struct ThreadHolder {
+    ThreadData *data = nullptr;
+    ~ThreadHolder() {
+        if (data) {
+            QMutexLocker locker(&registry().mutex);
+            registry().spare.push_back(data);
+        }
     }
-    if (rt > worstPair.second) {
-        worstPair.second = rt;
+};
+
+thread_local ThreadHolder threadHolder;
+
+ThreadData *
+getThreadData()
+{
+    if (!threadHolder.data) {
+        Registry &r = registry();
+        QMutexLocker locker(&r.mutex);
+        if (!r.spare.empty()) {
+            threadHolder.data = r.spare.back();
+            r.spare.pop_back();
+        } else {
+            threadHolder.data = new ThreadData(int(r.all.size()) + 1);
+            r.all.push_back(threadHolder.data);
+        }
     }
+    return threadHolder.data;
 }
-#endif
 
-void Profiles::dump() const
+std::vector<ThreadData *>
+getAllThreadData()
 {
-#ifndef NO_TIMING
+    Registry &r = registry();
+    QMutexLocker locker(&r.mutex);
+    return r.all;
+}
 
-    fprintf(stderr, "Profiling points:\n");
+template <typename T, typename U>
+inline void
+bump(std::atomic<T> &a, U n)
+{
+    a.store(T(a.load(std::memory_order_relaxed) + n),
+            std::memory_order_relaxed);
+}
 
-    fprintf(stderr, "\nBy name:\n");
+inline int
+floorLog2(uint64_t n)
+{
+#ifdef __GNUC__
+    return 63 - __builtin_clzll(n);
+#else
+    int r = 0;
+    while (n >>= 1) ++r;
+    return r;
+#endif
+}
 
-    typedef std::set<const char *, std::less<std::string> > StringSet;
+inline int
+bucketFor(uint64_t ns)
+{
+    if (ns < 2) return 0;
+    int octave = floorLog2(ns);
+    int half = int((ns >> (octave - 1)) & 1);
+    return std::min(octave * 2 + half, bucketCount - 1);
+}
 
-    StringSet profileNames;
-    for (ProfileMap::const_iterator i = m_profiles.begin();
-         i != m_profiles.end(); ++i) {
-        profileNames.insert(i->first);
-    }
+double
+bucketLowerBound(int bucket)
+{
+    int octave = bucket / 2;
+    if (octave == 0) return 0.0;
+    double base = std::ldexp(1.0, octave);
+    return (bucket % 2) ? base * 1.5 : base;
+}
 
-    for (StringSet::const_iterator i = profileNames.begin();
-         i != profileNames.end(); ++i) {
+double
+bucketMidpoint(int bucket)
+{
+    return (bucketLowerBound(bucket) + bucketLowerBound(bucket + 1)) / 2.0;
+}
 
-        ProfileMap::const_iterator j = m_profiles.find(*i);
+const std::chrono::steady_clock::time_point epoch =
+    std::chrono::steady_clock::now();
 
-        if (j == m_profiles.end()) continue;
+}
 
-        const ProfilePair &pp(j->second);
+int64_t
+Profiles::now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>
+        (std::chrono::steady_clock::now() - epoch).count();
+}
 
-        fprintf(stderr, "%s(%d):\n", *i, pp.first);
+void
+Profiles::record(const char *id, int64_t start, int64_t duration)
+{
+    ThreadData *d = getThreadData();
+
+    const uint64_t ns = uint64_t(std::max(duration, int64_t(0)));
+    const uintptr_t hash = (reinterpret_cast<uintptr_t>(id) >> 3) * 31;
+
+    Slot *slot = nullptr;
+    for (int i = 0; i < slotCount; ++i) {
+        Slot &s = d->slots[(hash + i) % slotCount];
+        const char *name = s.name.load(std::memory_order_relaxed);
+        if (name == id) {
+            slot = &s;
+            break;
+        }
+        if (!name) {
+            s.name.store(id, std::memory_order_release);
+            slot = &s;
+            break;
+        }
+    }
 
-        fprintf(stderr, "\tCPU:  \t%.9g ms/call \t[%d ms total]\n",
-                (((double)pp.second.first * 1000.0 /
-                  (double)pp.first) / CLOCKS_PER_SEC),
-                int((double(pp.second.first) * 1000.0) / CLOCKS_PER_SEC));
+    if (!slot) {
+        bump(d->dropped, 1);
+        return;
+    }
 
-        fprintf(stderr, "\tReal: \t%s ms      \t[%s ms total]\n",
-                ((pp.second.second / pp.first) * 1000).toString().c_str(),
-                (pp.second.second * 1000).toString().c_str());
+    bump(slot->calls, 1);
+    bump(slot->total, ns);
+    if (ns > slot->worst.load(std::memory_order_relaxed)) {
+        slot->worst.store(ns, std::memory_order_relaxed);
+    }
+    bump(slot->buckets[bucketFor(ns)], 1);
 
-        WorstCallMap::const_iterator k = m_worstCalls.find(*i);
-        if (k == m_worstCalls.end()) continue;
-        
-        const TimePair &wc(k->second);
+    if (!isTracing()) {
+        return;
+    }
 
-        fprintf(stderr, "\tWorst:\t%s ms/call \t[%d ms CPU]\n",
-                (wc.second * 1000).toString().c_str(),
-                int((double(wc.first) * 1000.0) / CLOCKS_PER_SEC));
+    TraceEntry *ring = d->trace.load(std::memory_order_relaxed);
+    if (!ring) {
+        ring = new TraceEntry[traceSize]();
+        d->trace.store(ring, std::memory_order_release);
     }
 
-    typedef std::multimap<RealTime, const char *> TimeRMap;
-    typedef std::multimap<int, const char *> IntRMap;
-    
-    TimeRMap totmap, avgmap, worstmap;
-    IntRMap ncallmap;
+    const uint64_t n = d->traced.load(std::memory_order_relaxed);
+    TraceEntry &e = ring[n % traceSize];
+    const uint32_t seq = e.seq.load(std::memory_order_relaxed);
+    e.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    e.name.store(id, std::memory_order_relaxed);
+    e.start.store(start, std::memory_order_relaxed);
+    e.duration.store(duration, std::memory_order_relaxed);
+    e.seq.store(seq + 2, std::memory_order_release);
+    d->traced.store(n + 1, std::memory_order_release);
+}
+
+#endif
+
+Profiles* Profiles::getInstance()
+{
+    static Profiles *instance = new Profiles();
+    return instance;
+}
+
+Profiles::Profiles()
+{
+}
 
-    for (ProfileMap::const_iterator i = m_profiles.begin();
-         i != m_profiles.end(); ++i) {
-        totmap.insert(TimeRMap::value_type(i->second.second.second, i->first));
-        avgmap.insert(TimeRMap::value_type(i->second.second.second /
-                                           i->second.first, i->first));
-        ncallmap.insert(IntRMap::value_type(i->second.first, i->first));
+Profiles::~Profiles()
+{
+    dump();
+}
+
+void
+Profiles::setEnabled(bool enabled)
+{
+    m_enabled.store(enabled);
+    if (!enabled) {
+        m_tracing.store(false);
     }
+}
 
-    for (WorstCallMap::const_iterator i = m_worstCalls.begin();
-         i != m_worstCalls.end(); ++i) {
-        worstmap.insert(TimeRMap::value_type(i->second.second,
-                                             i->first));
+void
+Profiles::setTracing(bool tracing)
+{
+    if (tracing) {
+        m_enabled.store(true);
     }
+    m_tracing.store(tracing);
+}
 
+std::vector<Profiles::Summary>
+Profiles::getSummaries() const
+{
+    std::vector<Summary> summaries;
+
+#ifndef NO_TIMING
 
-    fprintf(stderr, "\nBy total:\n");
-    for (TimeRMap::const_iterator i = totmap.end(); i != totmap.begin(); ) {
-        --i;
-        fprintf(stderr, "%-40s  %s ms\n", i->second,
-                (i->first * 1000).toString().c_str());
+    // The same name may appear at more than one address, or in more
+    // than one thread, so we gather by name
+
+    struct Totals {
+        uint64_t calls = 0;
+        uint64_t total = 0;
+        uint64_t worst = 0;
+        std::vector<uint64_t> buckets = std::vector<uint64_t>(bucketCount, 0);
+    };
+    std::map<std::string, Totals> totals;
+
+    for (const ThreadData *d: getAllThreadData()) {
+        for (const auto &s: d->slots) {
+            const char *name = s.name.load(std::memory_order_acquire);
+            if (!name) continue;
+            Totals &t = totals[name];
+            t.calls += s.calls.load(std::memory_order_relaxed);
+            t.total += s.total.load(std::memory_order_relaxed);
+            t.worst = std::max(t.worst, s.worst.load(std::memory_order_relaxed));
+            for (int i = 0; i < bucketCount; ++i) {
+                t.buckets[i] += s.buckets[i].load(std::memory_order_relaxed);
+            }
+        }
     }
 
-    fprintf(stderr, "\nBy average:\n");
-    for (TimeRMap::const_iterator i = avgmap.end(); i != avgmap.begin(); ) {
-        --i;
-        fprintf(stderr, "%-40s  %s ms\n", i->second,
-                (i->first * 1000).toString().c_str());
+    for (const auto &entry: totals) {
+
+        const Totals &t = entry.second;
+        if (t.calls == 0) continue;
+
+        uint64_t counted = 0;
+        for (auto b: t.buckets) counted += b;
+
+        auto percentile = [&](double p) {
+            uint64_t target = uint64_t(std::ceil(double(counted) * p));
+            uint64_t sum = 0;
+            for (int i = 0; i < bucketCount; ++i) {
+                sum += t.buckets[i];
+                if (sum >= target && sum > 0) {
+                    return std::min(bucketMidpoint(i), double(t.worst));
+                }
+            }
+            return double(t.worst);
+        };
+
+        Summary s;
+        s.name = entry.first;
+        s.calls = t.calls;
+        s.totalMs = double(t.total) / 1.0e6;
+        s.meanMs = s.totalMs / double(t.calls);
+        s.p50Ms = percentile(0.5) / 1.0e6;
+        s.p99Ms = percentile(0.99) / 1.0e6;
+        s.maxMs = double(t.worst) / 1.0e6;
+        summaries.push_back(s);
     }
 
-    fprintf(stderr, "\nBy worst case:\n");
-    for (TimeRMap::const_iterator i = worstmap.end(); i != worstmap.begin(); ) {
-        --i;
-        fprintf(stderr, "%-40s  %s ms\n", i->second,
-                (i->first * 1000).toString().c_str());
+    std::sort(summaries.begin(), summaries.end(),
+              [](const Summary &a, const Summary &b) {
+                  return a.totalMs > b.totalMs;
+              });
+#endif
+
+    return summaries;
+}
+
+QString
+Profiles::toJson() const
+{
+    QString json = "{\n  \"profiles\": [";
+
+    bool first = true;
+    for (const auto &s: getSummaries()) {
+        json += (first ? "\n" : ",\n");
+        first = false;
+        json += QString("    { \"name\": %1, \"calls\": %2, "
+                        "\"total_ms\": %3, \"mean_ms\": %4, "
+                        "\"p50_ms\": %5, \"p99_ms\": %6, \"max_ms\": %7 }")
+            .arg(jsonString(s.name))
+            .arg(s.calls)
+            .arg(s.totalMs, 0, 'g', 9)
+            .arg(s.meanMs, 0, 'g', 9)
+            .arg(s.p50Ms, 0, 'g', 9)
+            .arg(s.p99Ms, 0, 'g', 9)
+            .arg(s.maxMs, 0, 'g', 9);
     }
 
-    fprintf(stderr, "\nBy number of calls:\n");
-    for (IntRMap::const_iterator i = ncallmap.end(); i != ncallmap.begin(); ) {
-        --i;
-        fprintf(stderr, "%-40s  %d\n", i->second, i->first);
+    uint64_t dropped = 0;
+#ifndef NO_TIMING
+    for (const ThreadData *d: getAllThreadData()) {
+        dropped += d->dropped.load(std::memory_order_relaxed);
     }
+#endif
+    
+    json += QString("\n  ],\n  \"dropped\": %1\n}\n").arg(dropped);
+    return json;
+}
+
+QString
+Profiles::toChromeTrace() const
+{
+    QString json = "{\n  \"displayTimeUnit\": \"ms\",\n  \"traceEvents\": [";
 
+#ifndef NO_TIMING
+    bool first = true;
+    
+    for (const ThreadData *d: getAllThreadData()) {
+
+        const TraceEntry *ring = d->trace.load(std::memory_order_acquire);
+        if (!ring) continue;
+
+        const uint64_t n = d->traced.load(std::memory_order_acquire);
+        const uint64_t from = (n > uint64_t(traceSize) ? n - traceSize : 0);
+
+        for (uint64_t i = from; i < n; ++i) {
+
+            const TraceEntry &e = ring[i % traceSize];
+            const uint32_t seq = e.seq.load(std::memory_order_acquire);
+            if (seq & 1) continue;
+            const char *name = e.name.load(std::memory_order_relaxed);
+            const int64_t start = e.start.load(std::memory_order_relaxed);
+            const int64_t duration = e.duration.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (e.seq.load(std::memory_order_relaxed) != seq || !name) {
+                continue;
+            }
+
+            json += (first ? "\n" : ",\n");
+            first = false;
+            json += QString("    { \"name\": %1, \"cat\": \"sv\", "
+                            "\"ph\": \"X\", \"pid\": 1, \"tid\": %2, "
+                            "\"ts\": %3, \"dur\": %4 }")
+                .arg(jsonString(name))
+                .arg(d->id)
+                .arg(double(start) / 1000.0, 0, 'f', 3)
+                .arg(double(duration) / 1000.0, 0, 'f', 3);
+        }
+    }
 #endif
+
+    json += "\n  ]\n}\n";
+    return json;
 }
 
-#ifndef NO_TIMING    
+static bool
+writeText(QString path, QString text)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate |
+                   QIODevice::Text)) {
+        std::cerr << "Profiles: failed to open \"" << path.toStdString()
+                  << "\" for writing" << std::endl;
+        return false;
+    }
+    QTextStream out(&file);
+    out << text;
+    out.flush();
+    return file.error() == QFile::NoError;
+}
 
-Profiler::Profiler(const char* c, bool showOnDestruct) :
-    m_c(c),
-    m_showOnDestruct(showOnDestruct),
-    m_ended(false)
+bool
+Profiles::writeJson(QString path) const
 {
-    m_startCPU = clock();
+    return writeText(path, toJson());
+}
 
-    struct timeval tv;
-    (void)gettimeofday(&tv, 0);
-    m_startTime = RealTime::fromTimeval(tv);
+bool
+Profiles::writeChromeTrace(QString path) const
+{
+    return writeText(path, toChromeTrace());
 }
 
 void
-Profiler::update() const
+Profiles::dump() const
 {
-    clock_t elapsedCPU = clock() - m_startCPU;
+    auto summaries = getSummaries();
+    if (summaries.empty()) {
+        return;
+    }
+    
+    fprintf(stderr, "Profiling points, by total time:\n\n");
+    fprintf(stderr, "%-48s %10s %12s %10s %10s %10s %10s\n",
+            "name", "calls", "total ms", "mean ms", "p50 ms", "p99 ms",
+            "max ms");
+    
+    for (const auto &s: summaries) {
+        fprintf(stderr, "%-48s %10llu %12.3f %10.4f %10.4f %10.4f %10.4f\n",
+                s.name.c_str(), (unsigned long long)s.calls,
+                s.totalMs, s.meanMs, s.p50Ms, s.p99Ms, s.maxMs);
+    }
 
-    struct timeval tv;
-    (void)gettimeofday(&tv, 0);
-    RealTime elapsedTime = RealTime::fromTimeval(tv) - m_startTime;
+    std::string output;
+    if (getEnvUtf8("SV_PROFILE_OUTPUT", output) && output != "") {
+        QString base = QString::fromStdString(output);
+        writeJson(base + ".json");
+        if (isTracing()) {
+            writeChromeTrace(base + ".trace.json");
+        }
+    }
+}
 
-    cerr << "Profiler : id = " << m_c
-         << " - elapsed so far = " << ((elapsedCPU * 1000) / CLOCKS_PER_SEC)
-         << "ms CPU, " << elapsedTime << " real" << endl;
-}    
+#ifndef NO_TIMING    
 
-Profiler::~Profiler()
+void
+Profiler::update() const
 {
-    if (!m_ended) end();
-}
+    if (!m_active) return;
+    
+    double elapsed = double(Profiles::now() - m_start) / 1.0e6;
+
+    std::cerr << "Profiler : id = " << m_c
+              << " - elapsed so far = " << elapsed << "ms real" << std::endl;
+}    
 
 void
 Profiler::end()
 {
-    clock_t elapsedCPU = clock() - m_startCPU;
-
-    struct timeval tv;
-    (void)gettimeofday(&tv, 0);
-    RealTime elapsedTime = RealTime::fromTimeval(tv) - m_startTime;
+    if (!m_active || m_ended) {
+        m_ended = true;
+        return;
+    }
+    
+    int64_t elapsed = Profiles::now() - m_start;
 
-    Profiles::getInstance()->accumulate(m_c, elapsedCPU, elapsedTime);
+    if (Profiles::isEnabled()) {
+        Profiles::getInstance()->record(m_c, m_start, elapsed);
+    }
 
-    if (m_showOnDestruct)
-        cerr << "Profiler : id = " << m_c
-             << " - elapsed = " << ((elapsedCPU * 1000) / CLOCKS_PER_SEC)
-             << "ms CPU, " << elapsedTime << " real" << endl;
+    if (m_showOnDestruct) {
+        std::cerr << "Profiler : id = " << m_c
+                  << " - elapsed = " << double(elapsed) / 1.0e6
+                  << "ms real" << std::endl;
+    }
 
     m_ended = true;
 }
  
 #endif
-
@@ -26,23 +26,20 @@
 #include "system/System.h"
 
 #include <map>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <cstdint>
 
-#include "RealTime.h"
+#include <QString>
 
-//#define NO_TIMING 1
+#include "RealTime.h"
 
-//#define WANT_TIMING 1
+// Define NO_TIMING to compile profiling out altogether. Otherwise
+// profile points are always present, but cost only a test of an
+// atomic flag unless profiling is switched on at runtime.
 
-#ifdef NDEBUG
-#ifndef WANT_TIMING
-#define NO_TIMING 1
-#endif
-#endif
-
-#ifndef NO_TIMING
-#include <ctime>
-#include <sys/time.h>
-#endif
+//#define NO_TIMING 1
 
 /**
  * Profiling classes
@@ -51,7 +48,20 @@
 /**
  * The class holding all profiling data
  *
- * This class is a singleton
+ * This class is a singleton. Profiling is off at startup unless the
+ * SV_PROFILE environment variable is set, to 1 for timings or to
+ * "trace" for timings and a trace of individual calls; it can also
+ * be switched on and off with setEnabled() and setTracing().
+ *
+ * Each thread records into its own buffers, without locking: a
+ * table of per-name call counts, totals, worst cases and
+ * log-bucketed duration histograms, and (when tracing) a ring of its
+ * most recent calls. The accessors here take a snapshot across all
+ * threads at any time, without stopping them.
+ *
+ * If SV_PROFILE_OUTPUT is set, dump() also writes the summaries to
+ * $SV_PROFILE_OUTPUT.json and, when tracing, the trace to
+ * $SV_PROFILE_OUTPUT.trace.json.
  */
 class Profiles
 {
@@ -59,26 +69,65 @@ public:
     static Profiles* getInstance();
     ~Profiles();
 
+    static bool isEnabled() {
+        return m_enabled.load(std::memory_order_relaxed);
+    }
+    static bool isTracing() {
+        return m_tracing.load(std::memory_order_relaxed);
+    }
+
+    void setEnabled(bool enabled);
+    void setTracing(bool tracing); // implies setEnabled(true)
+
+    struct Summary {
+        std::string name;
+        uint64_t calls;
+        double totalMs;
+        double meanMs;
+        double p50Ms;   // percentiles are estimated from histogram
+        double p99Ms;   // buckets, and are accurate to about 25%
+        double maxMs;
+    };
+
+    /**
+     * Return the accumulated figures for every profile point that
+     * has been reached since profiling was first enabled, ordered by
+     * descending total time.
+     */
+    std::vector<Summary> getSummaries() const;
+
+    /**
+     * Return the summaries as a JSON document.
+     */
+    QString toJson() const;
+
+    /**
+     * Return the calls recorded while tracing, in the Chrome Trace
+     * Event format understood by chrome://tracing and Perfetto. Only
+     * the most recent few thousand calls from each thread are kept.
+     */
+    QString toChromeTrace() const;
+
+    bool writeJson(QString path) const;
+    bool writeChromeTrace(QString path) const;
+
+    /**
+     * Print the summaries to stderr, if there are any, and write
+     * them to the file named in SV_PROFILE_OUTPUT if set.
+     */
+    void dump() const;
+
 #ifndef NO_TIMING
-    void accumulate(const char* id, clock_t time, RealTime rt);
+    static int64_t now(); // ns
+
+    void record(const char *id, int64_t start, int64_t duration);
 #endif
-    void dump() const;
 
 protected:
     Profiles();
 
-#ifndef NO_TIMING
-    typedef std::pair<clock_t, RealTime> TimePair;
-    typedef std::pair<int, TimePair> ProfilePair;
-    typedef std::map<const char *, ProfilePair> ProfileMap;
-    typedef std::map<const char *, TimePair> LastCallMap;
-    typedef std::map<const char *, TimePair> WorstCallMap;
-    ProfileMap m_profiles;
-    LastCallMap m_lastCalls;
-    WorstCallMap m_worstCalls;
-#endif
-
-    static Profiles* m_instance;
+    static std::atomic<bool> m_enabled;
+    static std::atomic<bool> m_tracing;
 };
 
 #ifndef NO_TIMING
@@ -86,9 +135,10 @@ protected:
 /**
  * Profile point instance class.  Construct one of these on the stack
  * at the start of a function, in order to record the time consumed
- * within that function.  The profiler object should be effectively
- * optimised out if NO_TIMING is defined, so any overhead in a release
- * build should be negligible so long as you remember to define that.
+ * within that function.  The name must be a string that lives for
+ * the duration of the program, normally a literal. When profiling is
+ * not enabled, construction and destruction do nothing beyond
+ * testing a flag.
  */
 class Profiler
 {
@@ -97,22 +147,41 @@ public:
      * Create a profile point instance that records time consumed
      * against the given profiling point name.  If showOnDestruct is
      * true, the time consumed will be printed to stderr when the
-     * object is destroyed; otherwise, only the accumulated, mean and
-     * worst-case times will be shown when the program exits or
-     * Profiles::dump() is called.
+     * object is destroyed, provided that profiling is enabled or this
+     * is a debug build; otherwise, only the accumulated figures will
+     * be shown when the program exits or Profiles::dump() is called.
      */
-    Profiler(const char *name, bool showOnDestruct = false);
-    ~Profiler();
+    Profiler(const char *name, bool showOnDestruct = false) :
+        m_c(name),
+        m_start(0),
+        m_showOnDestruct(showOnDestruct),
+        m_ended(false),
+        m_active(Profiles::isEnabled() ||
+                 (showOnDestruct && isDebugBuild())) {
+        if (m_active) m_start = Profiles::now();
+    }
+    
+    ~Profiler() {
+        if (m_active && !m_ended) end();
+    }
 
     void update() const;
     void end(); // same action as dtor
 
 protected:
+    static constexpr bool isDebugBuild() {
+#ifdef BUILD_DEBUG
+        return true;
+#else
+        return false;
+#endif
+    }
+    
     const char* m_c;
-    clock_t m_startCPU;
-    RealTime m_startTime;
+    int64_t m_start;
     bool m_showOnDestruct;
     bool m_ended;
+    bool m_active;
 };
 
 #else
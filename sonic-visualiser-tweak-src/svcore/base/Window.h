@@ -72,7 +72,7 @@ public:
     }
 
     inline void cut(const T *const BQ_R__ src, T *const BQ_R__ dst) const {
-        breakfastquay::v_multiply(dst, src, m_cache, m_size);
+        breakfastquay::v_multiply_to(dst, src, m_cache, m_size);
     }
 
     T getArea() { return m_area; }
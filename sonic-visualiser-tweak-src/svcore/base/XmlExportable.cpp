@@ -67,6 +67,38 @@ XmlExportable::encodeColour(int ri, int gi, int bi)
     return "#" + r + g + b;
 }
 
+static thread_local XmlExportable::BlobSink *blobSink = nullptr;
+
+XmlExportable::BlobSink *
+XmlExportable::getBlobSink()
+{
+    return blobSink;
+}
+
+XmlExportable::BlobSink *
+XmlExportable::setBlobSink(BlobSink *sink)
+{
+    BlobSink *previous = blobSink;
+    blobSink = sink;
+    return previous;
+}
+
+static thread_local XmlExportable::FragmentSink *fragmentSink = nullptr;
+
+XmlExportable::FragmentSink *
+XmlExportable::getFragmentSink()
+{
+    return fragmentSink;
+}
+
+XmlExportable::FragmentSink *
+XmlExportable::setFragmentSink(FragmentSink *sink)
+{
+    FragmentSink *previous = fragmentSink;
+    fragmentSink = sink;
+    return previous;
+}
+
 int
 XmlExportable::getExportId() const
 {
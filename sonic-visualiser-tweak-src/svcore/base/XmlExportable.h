@@ -17,9 +17,12 @@
 #define SV_XML_EXPORTABLE_H
 
 #include <QString>
+#include <QByteArray>
 
 #include "Debug.h"
 
+#include <functional>
+
 class QTextStream;
 
 class XmlExportable
@@ -59,6 +62,100 @@ public:
 
     static QString encodeEntities(QString);
 
+    /**
+     * Destination for bulk binary data written alongside the XML when
+     * saving to a session container (see SessionContainerWriter).
+     */
+    class BlobSink
+    {
+    public:
+        virtual ~BlobSink() { }
+
+        /**
+         * Store the given data and return the index by which it can
+         * be referred to from the XML. If the key is not empty, it
+         * identifies the content, and the sink may keep the blob
+         * under that key for findBlob to find in future.
+         */
+        virtual int addBlob(const QByteArray &data, QString key) = 0;
+
+        /**
+         * If a blob with the given key is available, for example from
+         * an earlier save, store it as if by addBlob and return its
+         * index. Otherwise return -1. An exportable whose content has
+         * not changed since it was last stored can use this to avoid
+         * encoding it again.
+         */
+        virtual int findBlob(QString key) { (void)key; return -1; }
+
+        typedef std::function<QByteArray()> Encoder;
+
+        /**
+         * Reserve a blob whose data is to be obtained by calling the
+         * given encoder, and return its index as for addBlob. A sink
+         * may call the encoder later and on another thread, so it
+         * must refer only to data it owns, such as a copy of the
+         * exportable's contents. The default implementation calls
+         * it straight away.
+         */
+        virtual int addDeferredBlob(Encoder encoder, QString key) {
+            return addBlob(encoder(), key);
+        }
+    };
+
+    /**
+     * Return the blob sink set for the calling thread, or nullptr if
+     * there is none. When there is one, exportables with large
+     * datasets may write their data to it and refer to the blob from
+     * their XML, instead of writing an element for every point.
+     */
+    static BlobSink *getBlobSink();
+
+    /**
+     * Set the blob sink for the calling thread, returning the one
+     * previously set. Pass nullptr to go back to writing plain XML.
+     */
+    static BlobSink *setBlobSink(BlobSink *sink);
+
+    /**
+     * Destination for the bulk of the XML of exportables with large
+     * datasets, for use when that part of the document may be
+     * written later than the rest of it.
+     */
+    class FragmentSink
+    {
+    public:
+        virtual ~FragmentSink() { }
+
+        typedef std::function<void(QTextStream &)> Writer;
+
+        /**
+         * Arrange for the given writer to be called to write a
+         * fragment of XML at the current position of the given
+         * stream. A sink may call the writer later and on another
+         * thread, with another stream, so it must refer only to data
+         * it owns, such as a copy of the exportable's contents. The
+         * default implementation calls it straight away.
+         */
+        virtual void addDeferredFragment(QTextStream &out, Writer writer) {
+            writer(out);
+        }
+    };
+
+    /**
+     * Return the fragment sink set for the calling thread, or nullptr
+     * if there is none. When there is one, exportables with large
+     * datasets may pass it a writer for their data elements, instead
+     * of writing them out straight away.
+     */
+    static FragmentSink *getFragmentSink();
+
+    /**
+     * Set the fragment sink for the calling thread, returning the one
+     * previously set.
+     */
+    static FragmentSink *setFragmentSink(FragmentSink *sink);
+
     static QString encodeColour(int r, int g, int b); 
 
 private:
@@ -16,11 +16,13 @@
 #define TEST_EVENT_SERIES_H
 
 #include "../EventSeries.h"
+#include "../EventColumns.h"
 
 #include <QObject>
 #include <QtTest>
 
 #include <iostream>
+#include <algorithm>
 
 using namespace std;
 
@@ -314,6 +316,7 @@ private slots:
         s.add(b);
         QCOMPARE(s.getEventsCovering(0), EventVector());
         QCOMPARE(s.getEventsCovering(10), EventVector({ a }));
+        QCOMPARE(s.getEventsStartingWithin(10, 1), EventVector({ a }));
         QCOMPARE(s.getEventsCovering(15), EventVector({ a }));
         QCOMPARE(s.getEventsCovering(30), EventVector());
         QCOMPARE(s.getEventsCovering(99), EventVector());
@@ -742,6 +745,321 @@ private slots:
                   EventSeries::Backward, p), true);
         QCOMPARE(p, dd);
     }
+
+    void propertiesSurviveStorage() {
+
+        // Events are stored column-wise and rebuilt on the way out,
+        // so check that every property comes back intact, including
+        // shared and distinct labels and URIs, and that the absence
+        // of a property is preserved separately from a zero value
+
+        EventSeries s;
+        Event a(10, 0.f, 0, QString("shared"));
+        Event b = Event(10, QString("shared")).withURI("http://x/1");
+        Event c = Event(12).withLevel(0.5f).withReferenceFrame(7);
+        Event d = Event(12, 2.f, 3, 0.25f, QString("other"))
+            .withURI("http://x/2");
+        Event e(12);
+        EventVector ee { a, b, c, d, e };
+        for (const auto &x: ee) {
+            s.add(x);
+        }
+        std::sort(ee.begin(), ee.end());
+        QCOMPARE(s.getAllEvents(), ee);
+        for (int i = 0; i < int(ee.size()); ++i) {
+            Event x = s.getEventByIndex(i);
+            QCOMPARE(x, ee[i]);
+            QCOMPARE(x.hasValue(), ee[i].hasValue());
+            QCOMPARE(x.hasDuration(), ee[i].hasDuration());
+            QCOMPARE(x.hasLevel(), ee[i].hasLevel());
+            QCOMPARE(x.hasReferenceFrame(), ee[i].hasReferenceFrame());
+            QCOMPARE(x.getLabel(), ee[i].getLabel());
+            QCOMPARE(x.getURI(), ee[i].getURI());
+            QCOMPARE(s.getIndexForEvent(ee[i]), i);
+        }
+        s.remove(b);
+        QVERIFY(!s.contains(b));
+        QVERIFY(s.contains(a));
+        QCOMPARE(s.getEventsStartingWithin(10, 1), EventVector({ a }));
+    }
+
+    void bulkLoadMatchesIncremental() {
+
+        // Build one series by adding events one at a time in random
+        // order, another from a vector, and check that they answer
+        // every query the same, before and after removing some events
+        // from the middle
+        
+        EventVector ee;
+        srand(17);
+        for (int i = 0; i < 500; ++i) {
+            int duration = rand() % 5 == 0 ? 0 : rand() % 50;
+            ee.push_back(Event(rand() % 1000, float(rand() % 4), duration,
+                               QString("e%1").arg(i % 7)));
+            if (i % 10 == 0) {
+                ee.push_back(ee[ee.size() - 1]); // a duplicate
+            }
+            if (i % 13 == 0) {
+                ee.push_back(Event(rand() % 1000, QString("p")));
+            }
+        }
+
+        EventSeries incremental;
+        for (const auto &e: ee) {
+            incremental.add(e);
+        }
+        EventSeries bulk(ee);
+
+        QCOMPARE(bulk.count(), incremental.count());
+        QVERIFY(bulk == incremental);
+
+        for (int i = 0; i < 2; ++i) {
+            QCOMPARE(bulk.getEndFrame(), incremental.getEndFrame());
+            for (sv_frame_t f = -10; f < 1070; f += 7) {
+                QCOMPARE(bulk.getEventsSpanning(f, 13),
+                         incremental.getEventsSpanning(f, 13));
+                QCOMPARE(bulk.getEventsCovering(f),
+                         incremental.getEventsCovering(f));
+            }
+            for (int j = 0; j < 200; ++j) {
+                const Event &e = ee[(j * 37) % ee.size()];
+                bulk.remove(e);
+                incremental.remove(e);
+            }
+        }
+    }
+
+    void spanningAgainstBruteForce() {
+
+        EventSeries s;
+        EventVector ee;
+        srand(23);
+        for (int i = 0; i < 300; ++i) {
+            Event e(rand() % 500, float(i), rand() % 40 + 1, QString());
+            ee.push_back(e);
+            s.add(e);
+        }
+        for (int i = 0; i < 100; ++i) {
+            s.remove(ee[i * 3]);
+        }
+        for (sv_frame_t f = 0; f < 560; f += 3) {
+            EventVector expected;
+            for (int i = 0; i < 300; ++i) {
+                if (i % 3 == 0) continue;
+                const Event &e = ee[i];
+                if (e.getFrame() < f + 5 &&
+                    e.getFrame() + e.getDuration() > f) {
+                    expected.push_back(e);
+                }
+            }
+            std::sort(expected.begin(), expected.end());
+            QCOMPARE(s.getEventsSpanning(f, 5), expected);
+        }
+    }
+
+    void blobRoundTrip() {
+
+        struct Sink : public XmlExportable::BlobSink {
+            vector<QByteArray> blobs;
+            vector<QString> keys;
+            int addBlob(const QByteArray &data, QString key) override {
+                blobs.push_back(data);
+                keys.push_back(key);
+                return int(blobs.size()) - 1;
+            }
+        } sink;
+
+        EventVector ee {
+            Event(10, 1.5f, 4, 0.5f, "label"),
+            Event(10, 1.5f, 4, 0.5f, "label"),
+            Event(20, QString("another label")),
+            Event(20, QString::fromUtf8("caf\xc3\xa9")),
+            Event(30).withURI("file:///x.png").withReferenceFrame(5),
+            Event(40, 2.f, QString())
+        };
+        EventSeries s(ee);
+
+        QString xml;
+        {
+            QTextStream out(&xml);
+            XmlExportable::BlobSink *previous =
+                XmlExportable::setBlobSink(&sink);
+            s.toXml(out, "", "dimensions=\"3\"");
+            XmlExportable::setBlobSink(previous);
+        }
+
+        QCOMPARE(int(sink.blobs.size()), 1);
+        QCOMPARE(sink.keys[0], QString("events:%1").arg(s.getRevision()));
+        QVERIFY(xml.contains("blob=\"0\""));
+        QVERIFY(!xml.contains("<point"));
+
+        const QByteArray &blob = sink.blobs[0];
+        EventColumns columns;
+        QVERIFY(columns.decode(blob.constData(), blob.size()));
+        QCOMPARE(columns.getEvents(0, columns.size()), s.getAllEvents());
+
+        // Anything truncated, extended, or with an out-of-range
+        // string reference, must be refused
+        QVERIFY(!columns.decode(blob.constData(), blob.size() - 1));
+        QCOMPARE(columns.size(), 0);
+        QByteArray longer = blob + QByteArray(1, '\0');
+        QVERIFY(!columns.decode(longer.constData(), longer.size()));
+        QByteArray damaged = blob;
+        const int labelsStart = 40 + 6 * 8 * 3 + 6 * 4 * 2;
+        damaged[labelsStart] = char(100);
+        QVERIFY(!columns.decode(damaged.constData(), damaged.size()));
+        
+        // Without a sink, the usual XML
+        QString plain = s.toXmlString();
+        QVERIFY(!plain.contains("blob="));
+        QVERIFY(plain.contains("<point"));
+    }
+
+    void deferredBlob() {
+
+        struct Sink : public XmlExportable::BlobSink {
+            vector<QByteArray> blobs;
+            int addBlob(const QByteArray &data, QString) override {
+                blobs.push_back(data);
+                return int(blobs.size()) - 1;
+            }
+        } sink;
+
+        EventVector ee {
+            Event(10, 1.5f, 4, 0.5f, "label"),
+            Event(20, QString("another label")),
+            Event(25, 2.f, 100, QString()),
+            Event(40, 2.f, QString())
+        };
+        EventSeries original(ee);
+
+        QByteArray blob;
+        {
+            EventColumns columns;
+            columns.assign(original.getAllEvents());
+            columns.encode(blob);
+        }
+
+        auto owner = std::make_shared<QByteArray>(blob);
+        EventVector visited;
+        EventSeries s;
+        s.add(Event(5));
+        QVERIFY(s.setFromBlob(owner, owner->constData(), owner->size(),
+                              [&](const Event &e) {
+                                  visited.push_back(e);
+                              }));
+        owner.reset();
+
+        // Answered from the header, without decoding
+        QVERIFY(!s.isEmpty());
+        QCOMPARE(s.getStartFrame(), sv_frame_t(10));
+        QCOMPARE(s.getEndFrame(), sv_frame_t(125));
+        QVERIFY(visited.empty());
+
+        // Written back out unchanged, still without decoding
+        {
+            QString xml;
+            QTextStream out(&xml);
+            XmlExportable::BlobSink *previous =
+                XmlExportable::setBlobSink(&sink);
+            s.toXml(out, "", "");
+            XmlExportable::setBlobSink(previous);
+        }
+        QCOMPARE(int(sink.blobs.size()), 1);
+        QCOMPARE(sink.blobs[0], blob);
+        QVERIFY(visited.empty());
+
+        // Decoded in full on first use
+        QCOMPARE(s.getEventsCovering(30), EventVector({ ee[2] }));
+        QCOMPARE(visited, original.getAllEvents());
+        QCOMPARE(s.getAllEvents(), original.getAllEvents());
+        QCOMPARE(s.getEndFrame(), original.getEndFrame());
+        QVERIFY(s == original);
+
+        // A bad header is refused at once, leaving the series alone
+        QVERIFY(!s.setFromBlob({}, blob.constData(), 20));
+        QCOMPARE(s.count(), 4);
+
+        // Bad contents are found on decoding, leaving it empty
+        QByteArray damaged = blob;
+        damaged.chop(1);
+        QVERIFY(s.setFromBlob({}, damaged.constData(), damaged.size()));
+        QVERIFY(!s.isEmpty());
+        QCOMPARE(s.getAllEvents(), EventVector());
+        QVERIFY(s.isEmpty());
+    }
+
+    void deferredFragment() {
+
+        struct Sink : public XmlExportable::FragmentSink {
+            vector<Writer> writers;
+            void addDeferredFragment(QTextStream &out, Writer writer)
+                override {
+                out << "[fragment]";
+                writers.push_back(writer);
+            }
+        } sink;
+
+        EventVector ee {
+            Event(10, 1.5f, 4, 0.5f, "label"),
+            Event(20, QString("another label"))
+        };
+        EventSeries s(ee);
+        QString plain = s.toXmlString();
+
+        QString xml;
+        {
+            QTextStream out(&xml);
+            XmlExportable::FragmentSink *previous =
+                XmlExportable::setFragmentSink(&sink);
+            s.toXml(out, "", "");
+            XmlExportable::setFragmentSink(previous);
+        }
+        QCOMPARE(int(sink.writers.size()), 1);
+        QVERIFY(!xml.contains("<point"));
+
+        // Changes made after the export are not seen by the writer
+        s.add(Event(30, QString("later")));
+        s.remove(ee[0]);
+
+        QString fragment;
+        {
+            QTextStream out(&fragment);
+            sink.writers[0](out);
+        }
+        QCOMPARE(xml.replace("[fragment]", fragment), plain);
+    }
+
+    void revisions() {
+
+        EventSeries s;
+        EventSeries t;
+        QVERIFY(s.getRevision() != t.getRevision());
+
+        Event p(10, QString("a"));
+        s.add(p);
+        quint64 r = s.getRevision();
+        
+        EventSeries copy(s);
+        QCOMPARE(copy.getRevision(), r);
+        t = s;
+        QCOMPARE(t.getRevision(), r);
+
+        // A change to a copy leaves the original alone
+        t.add(Event(20));
+        QVERIFY(t.getRevision() != r);
+        QCOMPARE(s.getRevision(), r);
+
+        // Even if it is undone again
+        t.remove(Event(20));
+        QVERIFY(t.getRevision() != r);
+        QVERIFY(t == s);
+
+        s.remove(Event(30)); // not present, so no change
+        QCOMPARE(s.getRevision(), r);
+        s.clear();
+        QVERIFY(s.getRevision() != r);
+    }
 };
 
 #endif
@@ -0,0 +1,164 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_INTERLEAVED_RING_BUFFER_H
+#define TEST_INTERLEAVED_RING_BUFFER_H
+
+#include "../InterleavedRingBuffer.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+class TestInterleavedRingBuffer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void empty() {
+        InterleavedRingBuffer rb(2, 100);
+        QCOMPARE(rb.getChannelCount(), 2);
+        QCOMPARE(rb.getSize(), 128);
+        QCOMPARE(rb.getReadSpace(), 0);
+        QCOMPARE(rb.getWriteSpace(), 128);
+        float a[4] = { 1, 1, 1, 1 }, b[4] = { 1, 1, 1, 1 };
+        float *out[] = { a, b };
+        QCOMPARE(rb.read(out, 2, 4), 0);
+        for (int i = 0; i < 4; ++i) {
+            QCOMPARE(a[i], 0.f);
+            QCOMPARE(b[i], 0.f);
+        }
+    }
+
+    void wrap() {
+        InterleavedRingBuffer rb(2, 8);
+        float l[6], r[6];
+        const float *in[] = { l, r };
+        float ol[6], orr[6];
+        float *out[] = { ol, orr };
+        int next = 0, expected = 0;
+        for (int round = 0; round < 10; ++round) {
+            for (int i = 0; i < 6; ++i) {
+                l[i] = float(next + i);
+                r[i] = -float(next + i);
+            }
+            QCOMPARE(rb.write(in, 6), 6);
+            next += 6;
+            QCOMPARE(rb.getReadSpace(), 6);
+            QCOMPARE(rb.read(out, 2, 6), 6);
+            for (int i = 0; i < 6; ++i) {
+                QCOMPARE(ol[i], float(expected + i));
+                QCOMPARE(orr[i], -float(expected + i));
+            }
+            expected += 6;
+        }
+    }
+
+    void overrun() {
+        InterleavedRingBuffer rb(1, 8);
+        float in[10] = { 0 };
+        const float *inp[] = { in };
+        QCOMPARE(rb.write(inp, 10), 8);
+        QCOMPARE(rb.getWriteSpace(), 0);
+        QCOMPARE(rb.write(inp, 1), 0);
+    }
+
+    void channels() {
+        // Reading fewer channels than the buffer has drops the rest,
+        // and reading more zeroes the extras
+        InterleavedRingBuffer rb(2, 8);
+        float l[3] = { 1, 2, 3 }, r[3] = { 4, 5, 6 };
+        const float *in[] = { l, r };
+        rb.write(in, 3);
+        rb.write(in, 3);
+        float a[3], b[3], c[3];
+        float *out1[] = { a };
+        QCOMPARE(rb.read(out1, 1, 3), 3);
+        QCOMPARE(a[2], 3.f);
+        float *out3[] = { a, b, c };
+        QCOMPARE(rb.read(out3, 3, 3), 3);
+        QCOMPARE(b[0], 4.f);
+        QCOMPARE(c[0], 0.f);
+        QCOMPARE(c[2], 0.f);
+    }
+
+    void mixdownAndSkip() {
+        InterleavedRingBuffer rb(2, 8);
+        float l[4] = { 1, 2, 3, 4 }, r[4] = { 10, 20, 30, 40 };
+        const float *in[] = { l, r };
+        rb.write(in, 4);
+        QCOMPARE(rb.skip(1), 1);
+        float out[4];
+        QCOMPARE(rb.readMixedDown(out, 4), 3);
+        QCOMPARE(out[0], 22.f);
+        QCOMPARE(out[2], 44.f);
+        QCOMPARE(out[3], 0.f);
+        QCOMPARE(rb.skip(5), 0);
+    }
+
+    void threaded() {
+        // One writer and one reader pass a ramp through a small
+        // buffer; every frame must arrive once, in order, with its
+        // channels in step
+        const int total = 1000000;
+        InterleavedRingBuffer rb(2, 64);
+
+        std::thread writer([&]() {
+            float l[17], r[17];
+            const float *in[] = { l, r };
+            int n = 0;
+            while (n < total) {
+                int want = std::min(17, total - n);
+                for (int i = 0; i < want; ++i) {
+                    l[i] = float(n + i);
+                    r[i] = float(n + i) + 0.5f;
+                }
+                int done = 0;
+                while (done < want) {
+                    const float *part[] = { in[0] + done, in[1] + done };
+                    int w = rb.write(part, want - done);
+                    if (w == 0) std::this_thread::yield();
+                    done += w;
+                }
+                n += want;
+            }
+        });
+
+        float l[23], r[23];
+        float *out[] = { l, r };
+        int n = 0;
+        bool ok = true;
+        while (n < total && ok) {
+            int got = rb.read(out, 2, 23);
+            if (got == 0) std::this_thread::yield();
+            for (int i = 0; i < got; ++i) {
+                if (l[i] != float(n + i) || r[i] != float(n + i) + 0.5f) {
+                    ok = false;
+                    break;
+                }
+            }
+            n += got;
+        }
+
+        writer.join();
+        QVERIFY(ok);
+        QCOMPARE(n, total);
+    }
+};
+
+#endif
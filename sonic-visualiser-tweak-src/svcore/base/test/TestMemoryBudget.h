@@ -0,0 +1,118 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_MEMORY_BUDGET_H
+#define TEST_MEMORY_BUDGET_H
+
+#include "../MemoryBudget.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+
+using namespace std;
+
+class TestMemoryBudget : public QObject
+{
+    Q_OBJECT
+
+    // A cache whose memory can be released completely
+    struct Cache {
+        Cache(MemoryBudget &budget, MemoryBudget::Cost cost) :
+            evictions(0),
+            account("test", cost, [this]() {
+                    ++evictions;
+                    account.setBytes(0);
+                }, &budget) { }
+        int evictions;
+        MemoryBudget::Account account;
+    };
+
+private slots:
+    void accounting() {
+        MemoryBudget budget(1000);
+        {
+            Cache a(budget, MemoryBudget::Cheap);
+            Cache b(budget, MemoryBudget::Unevictable);
+            a.account.setBytes(300);
+            b.account.setBytes(200);
+            QCOMPARE(budget.getUsage(), size_t(500));
+            QCOMPARE(budget.getUnevictableUsage(), size_t(200));
+            a.account.setBytes(100);
+            QCOMPARE(budget.getUsage(), size_t(300));
+            QVERIFY(budget.canAccommodate(800));
+            QVERIFY(!budget.canAccommodate(801));
+            QCOMPARE(a.evictions, 0);
+        }
+        // closing accounts returns their bytes
+        QCOMPARE(budget.getUsage(), size_t(0));
+        QCOMPARE(budget.getUnevictableUsage(), size_t(0));
+    }
+
+    void leastRecentlyUsedFirst() {
+        MemoryBudget budget(1000);
+        Cache a(budget, MemoryBudget::Moderate);
+        Cache b(budget, MemoryBudget::Moderate);
+        Cache c(budget, MemoryBudget::Unevictable);
+        a.account.setBytes(400);
+        b.account.setBytes(400);
+        a.account.touch();
+        c.account.setBytes(300); // over the limit, b is older
+        QCOMPARE(a.evictions, 0);
+        QCOMPARE(b.evictions, 1);
+        QCOMPARE(budget.getUsage(), size_t(700));
+    }
+
+    void cheapestFirst() {
+        MemoryBudget budget(1000);
+        Cache a(budget, MemoryBudget::Cheap);
+        Cache b(budget, MemoryBudget::Expensive);
+        b.account.setBytes(400);
+        a.account.setBytes(400); // a is now more recent, but cheap
+        Cache c(budget, MemoryBudget::Unevictable);
+        c.account.setBytes(300);
+        QCOMPARE(a.evictions, 1);
+        QCOMPARE(b.evictions, 0);
+    }
+
+    void neverEvictsTheGrowingAccount() {
+        MemoryBudget budget(1000);
+        Cache a(budget, MemoryBudget::Cheap);
+        a.account.setBytes(1500);
+        QCOMPARE(a.evictions, 0);
+        QCOMPARE(budget.getUsage(), size_t(1500));
+    }
+
+    void makeRoomAndSetLimit() {
+        MemoryBudget budget(1000);
+        Cache a(budget, MemoryBudget::Cheap);
+        Cache b(budget, MemoryBudget::Expensive);
+        a.account.setBytes(300);
+        b.account.setBytes(300);
+        QVERIFY(budget.makeRoom(400));
+        QCOMPARE(a.evictions, 0);
+        QVERIFY(budget.makeRoom(600));
+        QCOMPARE(a.evictions, 1);
+        QCOMPARE(b.evictions, 0);
+        budget.setLimit(200);
+        QCOMPARE(b.evictions, 1);
+        QCOMPARE(budget.getUsage(), size_t(0));
+        Cache c(budget, MemoryBudget::Unevictable);
+        c.account.setBytes(300);
+        QVERIFY(!budget.makeRoom(1));
+    }
+};
+
+#endif
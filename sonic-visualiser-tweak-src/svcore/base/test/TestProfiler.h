@@ -0,0 +1,96 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+    
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_PROFILER_H
+#define TEST_PROFILER_H
+
+#include "../Profiler.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <thread>
+#include <chrono>
+
+using namespace std;
+
+class TestProfiler : public QObject
+{
+    Q_OBJECT
+
+    Profiles::Summary find(string name) {
+        for (const auto &s: Profiles::getInstance()->getSummaries()) {
+            if (s.name == name) return s;
+        }
+        return { "", 0, 0, 0, 0, 0, 0 };
+    }
+
+private slots:
+    void cleanup() {
+        Profiles::getInstance()->setEnabled(false);
+    }
+    
+    void disabled() {
+        Profiles::getInstance()->setEnabled(false);
+        for (int i = 0; i < 10; ++i) {
+            Profiler p("TestProfiler::disabled");
+        }
+        QCOMPARE(find("TestProfiler::disabled").calls, uint64_t(0));
+    }
+
+    void summary() {
+        Profiles::getInstance()->setEnabled(true);
+        for (int i = 0; i < 100; ++i) {
+            Profiler p("TestProfiler::summary");
+            if (i == 99) {
+                this_thread::sleep_for(chrono::milliseconds(20));
+            }
+        }
+        auto s = find("TestProfiler::summary");
+        QCOMPARE(s.calls, uint64_t(100));
+        QVERIFY(s.maxMs >= 20.0);
+        QVERIFY(s.totalMs >= s.maxMs);
+        QVERIFY(s.p50Ms <= s.p99Ms);
+        QVERIFY(s.p99Ms <= s.maxMs);
+        QVERIFY(s.p50Ms < 1.0);
+    }
+
+    void threads() {
+        Profiles::getInstance()->setEnabled(true);
+        auto work = []() {
+            for (int i = 0; i < 1000; ++i) {
+                Profiler p("TestProfiler::threads");
+            }
+        };
+        thread t1(work), t2(work), t3(work);
+        t1.join(); t2.join(); t3.join();
+        QCOMPARE(find("TestProfiler::threads").calls, uint64_t(3000));
+    }
+
+    void exports() {
+        Profiles::getInstance()->setTracing(true);
+        {
+            Profiler p("TestProfiler::\"exports\"");
+        }
+        QString json = Profiles::getInstance()->toJson();
+        QVERIFY(json.contains("\"name\": \"TestProfiler::\\\"exports\\\"\""));
+        QVERIFY(json.contains("\"p99_ms\""));
+        QString trace = Profiles::getInstance()->toChromeTrace();
+        QVERIFY(trace.contains("\"traceEvents\""));
+        QVERIFY(trace.contains("TestProfiler::\\\"exports\\\""));
+        Profiles::getInstance()->setTracing(false);
+    }
+};
+
+#endif
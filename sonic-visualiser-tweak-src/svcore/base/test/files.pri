@@ -1,10 +1,13 @@
 TEST_HEADERS = \
 	     TestById.h \
 	     TestColumnOp.h \
+	     TestInterleavedRingBuffer.h \
 	     TestLogRange.h \
+	     TestMemoryBudget.h \
 	     TestMovingMedian.h \
 	     TestOurRealTime.h \
 	     TestPitch.h \
+	     TestProfiler.h \
 	     TestEventSeries.h \
 	     TestRangeMapper.h \
 	     TestScaleTickIntervals.h \
@@ -21,7 +21,10 @@
 #include "TestColumnOp.h"
 #include "TestMovingMedian.h"
 #include "TestById.h"
+#include "TestProfiler.h"
+#include "TestInterleavedRingBuffer.h"
 #include "TestEventSeries.h"
+#include "TestMemoryBudget.h"
 #include "StressEventSeries.h"
 
 #include "system/Init.h"
@@ -97,6 +100,21 @@ int main(int argc, char *argv[])
         if (QTest::qExec(&t, argc, argv) == 0) ++good;
         else ++bad;
     }
+    {
+        TestProfiler t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+    {
+        TestInterleavedRingBuffer t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+    {
+        TestMemoryBudget t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
 
 #ifdef NOT_DEFINED
     {
@@ -15,8 +15,23 @@
 
 #include "AudioFileReader.h"
 
+#include <algorithm>
+
 using std::vector;
 
+sv_frame_t
+AudioFileReader::readInterleavedFrames(sv_frame_t start, sv_frame_t count,
+                                       float *buffer) const
+{
+    floatvec_t interleaved = getInterleavedFrames(start, count);
+
+    int channels = getChannelCount();
+    if (channels == 0) return 0;
+
+    std::copy(interleaved.begin(), interleaved.end(), buffer);
+    return sv_frame_t(interleaved.size()) / channels;
+}
+
 vector<floatvec_t>
 AudioFileReader::getDeInterleavedFrames(sv_frame_t start, sv_frame_t count) const
 {
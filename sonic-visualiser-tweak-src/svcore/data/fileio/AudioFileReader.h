@@ -152,6 +152,22 @@ public:
     virtual floatvec_t getInterleavedFrames(sv_frame_t start,
                                             sv_frame_t count) const = 0;
 
+    /**
+     * Convert interleaved samples for up to count frames from index
+     * start into the given buffer, which must have room for count *
+     * getChannelCount() samples. Return the number of frames
+     * written, which is fewer than count if end of file is reached.
+     *
+     * This avoids allocating a vector for each read. The default
+     * implementation calls getInterleavedFrames and copies; readers
+     * that can convert directly from their underlying storage (such
+     * as a memory-mapped file) override it. Like
+     * getInterleavedFrames, it must be thread-safe.
+     */
+    virtual sv_frame_t readInterleavedFrames(sv_frame_t start,
+                                             sv_frame_t count,
+                                             float *buffer) const;
+
     /**
      * Return de-interleaved samples for count frames from index
      * start.  Implemented in this class (it calls
@@ -21,7 +21,7 @@
 #include "BQAFileReader.h"
 #include "AudioFileSizeEstimator.h"
 
-#include "base/StorageAdviser.h"
+#include "base/MemoryBudget.h"
 
 #include <QString>
 #include <QFileInfo>
@@ -99,13 +99,12 @@ AudioFileReaderFactory::createReader(FileSource source,
         CodedAudioFileReader::CacheInTemporaryFile;
 
     if (estimatedSamples > 0) {
-        size_t kb = (estimatedSamples * sizeof(float)) / 1024;
+        size_t bytes = size_t(estimatedSamples) * sizeof(float);
         SVDEBUG << "AudioFileReaderFactory: checking where to potentially cache "
-                << kb << "K of sample data" << endl;
-        StorageAdviser::Recommendation rec =
-            StorageAdviser::recommend(StorageAdviser::SpeedCritical, kb, kb);
-        if ((rec & StorageAdviser::UseMemory) ||
-            (rec & StorageAdviser::PreferMemory)) {
+                << bytes / 1024 << "K of sample data" << endl;
+        // Decoded audio in memory can't be released again, so leave
+        // at least as much again in the budget for other caches
+        if (MemoryBudget::getInstance()->canAccommodate(bytes * 2)) {
             SVDEBUG << "AudioFileReaderFactory: cacheing (if at all) in memory" << endl;
             cacheMode = CodedAudioFileReader::CacheInMemory;
         } else {
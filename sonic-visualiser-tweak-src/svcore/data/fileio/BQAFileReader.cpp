@@ -64,6 +64,15 @@ BQAFileReader::BQAFileReader(FileSource source,
     m_title = QString::fromUtf8(m_stream->getTrackName().c_str());
     m_maker = QString::fromUtf8(m_stream->getArtistName().c_str());
 
+    if (openPersistentDecodeCache(m_path, "BQAFileReader")) {
+        // Decoded in an earlier session
+        delete m_stream;
+        m_stream = 0;
+        m_completion = 100;
+        if (m_reporter) m_reporter->setProgress(100);
+        return;
+    }
+
     initialiseDecodeCache();
 
     if (decodeMode == DecodeAtOnce) {
@@ -96,6 +105,7 @@ BQAFileReader::BQAFileReader(FileSource source,
 	    if (m_cancelled) break;
         }
 
+        if (m_cancelled) abandonPersistentDecodeCache();
         if (isDecodeCacheInitialised()) finishDecodeCache();
         endSerialised();
 
@@ -159,7 +169,8 @@ BQAFileReader::DecodeThread::run()
 
 	if (m_reader->m_cancelled) break;
     }
-    
+
+    if (m_reader->m_cancelled) m_reader->abandonPersistentDecodeCache();
     if (m_reader->isDecodeCacheInitialised()) m_reader->finishDecodeCache();
     m_reader->m_completion = 100;
 
@@ -17,31 +17,448 @@
 
 #include <bzlib.h>
 
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+
 #include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <climits>
+#include <vector>
 
 #include "base/Debug.h"
 
-// for dup:
-#ifdef _MSC_VER
-#include <io.h>
+namespace {
+
+// A bzip2 block at level 9 holds up to 900k of input, so there is
+// little to be lost in compression by starting a new stream at each
+// one. Zstd matches across longer distances, so its blocks are
+// longer.
+const int bzip2BlockSize = 900000;
+const int zstdBlockSize = 4 * 1024 * 1024;
+
+const int zstdLevel = 3;
+
+const int readSize = 256 * 1024;
+const int writeSize = 256 * 1024;
+
+QThreadPool *getCompressionThreadPool()
+{
+    static QThreadPool *pool = []() {
+        auto p = new QThreadPool;
+        p->setMaxThreadCount(std::max(1, QThread::idealThreadCount()));
+        return p;
+    }();
+    return pool;
+}
+
+int getMaxBlocksInFlight()
+{
+    // Enough to keep every thread busy while the oldest block is
+    // written, without holding too much of the input in memory
+    return 2 * std::max(1, QThread::idealThreadCount());
+}
+
+}
+
+class BZipFileDevice::BlockJob : public QRunnable
+{
+public:
+    BlockJob(Codec codec, const QByteArray &input) :
+        m_codec(codec), m_input(input), m_ok(false) {
+        setAutoDelete(false);
+    }
+
+    void run() override {
+        m_ok = compress();
+        m_input = QByteArray();
+        m_done.release();
+    }
+
+    void wait() {
+        m_done.acquire();
+    }
+
+    bool isOK() const { return m_ok; }
+    const QByteArray &getOutput() const { return m_output; }
+
+private:
+    Codec m_codec;
+    QByteArray m_input;
+    QByteArray m_output;
+    bool m_ok;
+    QSemaphore m_done;
+
+    bool compress() {
+        if (m_codec == Zstd) {
+#ifdef HAVE_ZSTD
+            size_t bound = ZSTD_compressBound(m_input.size());
+            m_output.resize(int(bound));
+            size_t n = ZSTD_compress(m_output.data(), bound,
+                                     m_input.constData(), m_input.size(),
+                                     zstdLevel);
+            if (ZSTD_isError(n)) {
+                SVCERR << "BZipFileDevice: zstd compression failed: "
+                       << ZSTD_getErrorName(n) << endl;
+                return false;
+            }
+            m_output.resize(int(n));
+            return true;
 #else
-#include <unistd.h>
+            return false;
 #endif
+        }
+
+        // Worst case from the bzip2 documentation
+        unsigned int n = unsigned(m_input.size() + m_input.size() / 100 + 600);
+        m_output.resize(int(n));
+        int rv = BZ2_bzBuffToBuffCompress
+            (m_output.data(), &n, const_cast<char *>(m_input.constData()),
+             unsigned(m_input.size()), 9, 0, 0);
+        if (rv != BZ_OK) {
+            SVCERR << "BZipFileDevice: bzip2 compression failed with code "
+                   << rv << endl;
+            return false;
+        }
+        m_output.resize(int(n));
+        return true;
+    }
+};
+
+class BZipFileDevice::Encoder
+{
+public:
+    Encoder() : m_buffer(writeSize) { }
+    virtual ~Encoder() { }
+
+    virtual bool isOK() const = 0;
+
+    /**
+     * Compress the given data, writing any output that is ready to
+     * the given device. Return false on failure.
+     */
+    virtual bool write(const char *data, int n, QIODevice &out) = 0;
+
+    /**
+     * End the stream, writing the rest of the output to the given
+     * device. Return false on failure.
+     */
+    virtual bool finish(QIODevice &out) = 0;
+
+protected:
+    std::vector<char> m_buffer;
+
+    bool flush(int n, QIODevice &out) {
+        return n == 0 || out.write(m_buffer.data(), n) == qint64(n);
+    }
+};
+
+class BZipFileDevice::BZip2Encoder : public Encoder
+{
+public:
+    BZip2Encoder() {
+        memset(&m_stream, 0, sizeof(m_stream));
+        m_ok = (BZ2_bzCompressInit(&m_stream, 9, 0, 0) == BZ_OK);
+    }
+
+    virtual ~BZip2Encoder() {
+        if (m_ok) BZ2_bzCompressEnd(&m_stream);
+    }
+
+    bool isOK() const override { return m_ok; }
+
+    bool write(const char *data, int n, QIODevice &out) override {
+        m_stream.next_in = const_cast<char *>(data);
+        m_stream.avail_in = unsigned(n);
+        while (m_stream.avail_in > 0) {
+            m_stream.next_out = m_buffer.data();
+            m_stream.avail_out = unsigned(m_buffer.size());
+            if (BZ2_bzCompress(&m_stream, BZ_RUN) != BZ_RUN_OK) {
+                return false;
+            }
+            if (!flush(int(m_buffer.size() - m_stream.avail_out), out)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool finish(QIODevice &out) override {
+        int rv = BZ_FINISH_OK;
+        while (rv != BZ_STREAM_END) {
+            m_stream.next_in = nullptr;
+            m_stream.avail_in = 0;
+            m_stream.next_out = m_buffer.data();
+            m_stream.avail_out = unsigned(m_buffer.size());
+            rv = BZ2_bzCompress(&m_stream, BZ_FINISH);
+            if (rv != BZ_FINISH_OK && rv != BZ_STREAM_END) {
+                return false;
+            }
+            if (!flush(int(m_buffer.size() - m_stream.avail_out), out)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    bz_stream m_stream;
+    bool m_ok;
+};
+
+#ifdef HAVE_ZSTD
+class BZipFileDevice::ZstdEncoder : public Encoder
+{
+public:
+    ZstdEncoder() :
+        m_stream(ZSTD_createCStream()) {
+        m_ok = (m_stream && !ZSTD_isError(ZSTD_initCStream(m_stream,
+                                                           zstdLevel)));
+    }
+
+    virtual ~ZstdEncoder() {
+        ZSTD_freeCStream(m_stream);
+    }
+
+    bool isOK() const override { return m_ok; }
+
+    bool write(const char *data, int n, QIODevice &out) override {
+        ZSTD_inBuffer input = { data, size_t(n), 0 };
+        while (input.pos < input.size) {
+            ZSTD_outBuffer output = { m_buffer.data(), m_buffer.size(), 0 };
+            size_t rv = ZSTD_compressStream(m_stream, &output, &input);
+            if (ZSTD_isError(rv)) {
+                SVCERR << "BZipFileDevice: zstd compression failed: "
+                       << ZSTD_getErrorName(rv) << endl;
+                return false;
+            }
+            if (!flush(int(output.pos), out)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool finish(QIODevice &out) override {
+        size_t remaining = 1;
+        while (remaining != 0) {
+            ZSTD_outBuffer output = { m_buffer.data(), m_buffer.size(), 0 };
+            remaining = ZSTD_endStream(m_stream, &output);
+            if (ZSTD_isError(remaining)) {
+                SVCERR << "BZipFileDevice: zstd compression failed: "
+                       << ZSTD_getErrorName(remaining) << endl;
+                return false;
+            }
+            if (!flush(int(output.pos), out)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    ZSTD_CStream *m_stream;
+    bool m_ok;
+};
+#endif
+
+class BZipFileDevice::Decoder
+{
+public:
+    virtual ~Decoder() { }
+
+    enum Result {
+        Continue,  // all well, call again for more
+        Finished,  // there is no more compressed data in the file
+        Failed
+    };
+
+    /**
+     * Decompress as much as possible of the input into the output,
+     * advancing both to show how much was consumed and produced.
+     */
+    virtual Result decode(const char *&in, const char *inEnd,
+                          char *&out, char *outEnd) = 0;
+
+    /**
+     * Return true if all the data consumed so far has made up whole
+     * streams, so that the file may end here.
+     */
+    virtual bool atStreamBoundary() const = 0;
+};
+
+class BZipFileDevice::BZip2Decoder : public Decoder
+{
+public:
+    BZip2Decoder() : m_active(false), m_streams(0) { }
+
+    virtual ~BZip2Decoder() {
+        if (m_active) BZ2_bzDecompressEnd(&m_stream);
+    }
+
+    Result decode(const char *&in, const char *inEnd,
+                  char *&out, char *outEnd) override {
+
+        if (!m_active) {
+            // Only start a stream when there is input for it, so
+            // that the end of the input leaves us at a boundary
+            if (in == inEnd) return Continue;
+            memset(&m_stream, 0, sizeof(m_stream));
+            if (BZ2_bzDecompressInit(&m_stream, 0, 0) != BZ_OK) {
+                return Failed;
+            }
+            m_active = true;
+        }
+
+        m_stream.next_in = const_cast<char *>(in);
+        m_stream.avail_in = unsigned(inEnd - in);
+        m_stream.next_out = out;
+        m_stream.avail_out = unsigned(outEnd - out);
+
+        int rv = BZ2_bzDecompress(&m_stream);
+
+        in = m_stream.next_in;
+        out = m_stream.next_out;
+
+        if (rv == BZ_OK) {
+            return Continue;
+        }
+
+        BZ2_bzDecompressEnd(&m_stream);
+        m_active = false;
+
+        if (rv == BZ_STREAM_END) {
+            ++m_streams;
+            return Continue;
+        }
+
+        if (rv == BZ_DATA_ERROR_MAGIC && m_streams > 0) {
+            // Trailing data after the last stream, which bunzip2
+            // also ignores
+            SVDEBUG << "BZipFileDevice: Ignoring trailing data after "
+                    << m_streams << " bzip2 stream(s)" << endl;
+            return Finished;
+        }
+
+        return Failed;
+    }
+
+    bool atStreamBoundary() const override {
+        return !m_active && m_streams > 0;
+    }
+
+private:
+    bz_stream m_stream;
+    bool m_active;
+    int m_streams;
+};
+
+#ifdef HAVE_ZSTD
+class BZipFileDevice::ZstdDecoder : public Decoder
+{
+public:
+    ZstdDecoder() :
+        m_stream(ZSTD_createDStream()),
+        m_hint(1),
+        m_frames(0) {
+        ZSTD_initDStream(m_stream);
+    }
+
+    virtual ~ZstdDecoder() {
+        ZSTD_freeDStream(m_stream);
+    }
+
+    Result decode(const char *&in, const char *inEnd,
+                  char *&out, char *outEnd) override {
+
+        ZSTD_inBuffer input = { in, size_t(inEnd - in), 0 };
+        ZSTD_outBuffer output = { out, size_t(outEnd - out), 0 };
 
-BZipFileDevice::BZipFileDevice(QString fileName) :
+        size_t rv = ZSTD_decompressStream(m_stream, &output, &input);
+
+        in += input.pos;
+        out += output.pos;
+
+        if (ZSTD_isError(rv)) {
+            if (ZSTD_getErrorCode(rv) == ZSTD_error_prefix_unknown &&
+                atStreamBoundary()) {
+                SVDEBUG << "BZipFileDevice: Ignoring trailing data after "
+                        << m_frames << " zstd frame(s)" << endl;
+                return Finished;
+            }
+            SVCERR << "BZipFileDevice: zstd decompression failed: "
+                   << ZSTD_getErrorName(rv) << endl;
+            return Failed;
+        }
+
+        // A zero return means a frame has been completely decoded
+        // and flushed
+        if (rv == 0 && m_hint != 0) {
+            ++m_frames;
+        }
+        m_hint = rv;
+        return Continue;
+    }
+
+    bool atStreamBoundary() const override {
+        return m_hint == 0 && m_frames > 0;
+    }
+
+private:
+    ZSTD_DStream *m_stream;
+    size_t m_hint;
+    int m_frames;
+};
+#endif
+
+namespace {
+
+bool
+hasMagic(const QByteArray &data, const char *magic, int n)
+{
+    return data.size() >= n && memcmp(data.constData(), magic, n) == 0;
+}
+
+}
+
+BZipFileDevice::BZipFileDevice(QString fileName, Codec codec,
+                               bool parallel) :
     m_fileName(fileName),
+    m_codec(codec),
+    m_parallel(parallel),
     m_qfile(fileName),
-    m_file(nullptr),
-    m_bzFile(nullptr),
     m_atEnd(true),
-    m_ok(true)
+    m_ok(true),
+    m_blockSize(codec == Zstd ? zstdBlockSize : bzip2BlockSize),
+    m_blocksStarted(0),
+    m_inputPos(0)
 {
 }
 
 BZipFileDevice::~BZipFileDevice()
 {
 //    SVDEBUG << "BZipFileDevice::~BZipFileDevice(" << m_fileName << ")" << endl;
-    if (m_bzFile) close();
+    if (m_qfile.isOpen()) close();
+}
+
+bool
+BZipFileDevice::isCodecSupported(Codec codec)
+{
+    switch (codec) {
+    case BZip2: return true;
+#ifdef HAVE_ZSTD
+    case Zstd: return true;
+#else
+    case Zstd: return false;
+#endif
+    }
+    return false;
 }
 
 bool
@@ -55,7 +472,7 @@ BZipFileDevice::open(OpenMode mode)
 {
     setErrorString("");
 
-    if (m_bzFile) {
+    if (m_qfile.isOpen()) {
         setErrorString(tr("File is already open"));
         return false;
     }
@@ -78,53 +495,36 @@ BZipFileDevice::open(OpenMode mode)
         return false;
     }
 
-    // This is all going to be a bit silly.
-    //
-    // We open the file with QFile so as not to have to worry about locale
-    // support ourselves (especially on Windows). Then we get a fd from
-    // QFile and "convert" it to a FILE* using fdopen because that is what
-    // the bz2 library needs for reading and writing an already-open file.
-    //
-    // fdopen takes over the fd it is given, and will close it when fclose
-    // is called. (We must call fclose, because it's needed to avoid
-    // leaking the file stream structure.)
-    //
-    // But QFile will also close its fd, either when we call QFile::close
-    // or on destruction -- there doesn't seem to be a way to avoid that
-    // for a file that QFile opened.
-    //
-    // So we have to add an extra dup() in to the fdopen to avoid a double
-    // close.
-    //
-    // Note that bz2 will *not* fclose the FILE* it was passed, so we
-    // don't have a problem with calling both bzWriteClose and fclose.
-
     if (mode & WriteOnly) {
 
-        if (!m_qfile.open(QIODevice::WriteOnly)) {
-            setErrorString(tr("Failed to open file for writing"));
+        if (!isCodecSupported(m_codec)) {
+            setErrorString(tr("Compression format not supported in this build"));
             m_ok = false;
             return false;
         }
-        
-        m_file = fdopen(dup(m_qfile.handle()), "wb");
-        if (!m_file) {
-            setErrorString(tr("Failed to open file handle for writing"));
-            m_qfile.close();
+
+        if (!m_qfile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            setErrorString(tr("Failed to open file for writing"));
             m_ok = false;
             return false;
         }
 
-        int bzError = BZ_OK;
-        m_bzFile = BZ2_bzWriteOpen(&bzError, m_file, 9, 0, 0);
-
-        if (!m_bzFile) {
-            fclose(m_file);
-            m_file = nullptr;
-            m_qfile.close();
-            setErrorString(tr("Failed to open bzip2 stream for writing"));
-            m_ok = false;
-            return false;
+        if (m_parallel) {
+            m_block = QByteArray();
+            m_block.reserve(m_blockSize);
+            m_blocksStarted = 0;
+        } else {
+#ifdef HAVE_ZSTD
+            if (m_codec == Zstd) m_encoder.reset(new ZstdEncoder);
+#endif
+            if (m_codec == BZip2) m_encoder.reset(new BZip2Encoder);
+            if (!m_encoder || !m_encoder->isOK()) {
+                m_encoder.reset();
+                m_qfile.close();
+                setErrorString(tr("Failed to initialise compressor"));
+                m_ok = false;
+                return false;
+            }
         }
 
 //        cerr << "BZipFileDevice: opened \"" << m_fileName << "\" for writing" << endl;
@@ -141,22 +541,28 @@ BZipFileDevice::open(OpenMode mode)
             m_ok = false;
             return false;
         }
-        
-        m_file = fdopen(dup(m_qfile.handle()), "rb");
-        if (!m_file) {
-            setErrorString(tr("Failed to open file handle for reading"));
-            m_ok = false;
-            return false;
-        }
 
-        int bzError = BZ_OK;
-        m_bzFile = BZ2_bzReadOpen(&bzError, m_file, 0, 0, nullptr, 0);
+        m_input = m_qfile.read(readSize);
+        m_inputPos = 0;
 
-        if (!m_bzFile) {
-            fclose(m_file);
-            m_file = nullptr;
+        if (hasMagic(m_input, "BZh", 3)) {
+            m_codec = BZip2;
+            m_decoder.reset(new BZip2Decoder);
+        } else if (hasMagic(m_input, "\x28\xb5\x2f\xfd", 4)) {
+            m_codec = Zstd;
+#ifdef HAVE_ZSTD
+            m_decoder.reset(new ZstdDecoder);
+#endif
+        }
+
+        if (!m_decoder) {
+            if (m_codec == Zstd) {
+                setErrorString(tr("File is compressed in zstd format, which is not supported in this build"));
+            } else {
+                setErrorString(tr("File is not in a supported compressed format"));
+            }
+            m_input = QByteArray();
             m_qfile.close();
-            setErrorString(tr("Failed to open bzip2 stream for reading"));
             m_ok = false;
             return false;
         }
@@ -178,39 +584,56 @@ BZipFileDevice::open(OpenMode mode)
 void
 BZipFileDevice::close()
 {
-    if (!m_bzFile) {
+    if (!m_qfile.isOpen()) {
         setErrorString(tr("File not open"));
         m_ok = false;
         return;
     }
 
-    int bzError = BZ_OK;
-
     if (openMode() & WriteOnly) {
-        unsigned int in = 0, out = 0;
-        BZ2_bzWriteClose(&bzError, m_bzFile, 0, &in, &out);
-//        cerr << "Wrote bzip2 stream (in=" << in << ", out=" << out << ")" << endl;
-        if (bzError != BZ_OK) {
-            setErrorString(tr("bzip2 stream write close error"));
+
+        if (m_encoder) {
+            if (m_ok && !m_encoder->finish(m_qfile)) {
+                setErrorString(tr("Failed to write compressed data to file"));
+                m_ok = false;
+            }
+            m_encoder.reset();
+        } else {
+            // The final block is compressed here. A file with no data
+            // still gets one (empty) stream, so that it can be read
+            if (m_block.size() > 0 || m_blocksStarted == 0) {
+                std::unique_ptr<BlockJob> job(new BlockJob(m_codec, m_block));
+                job->run();
+                m_jobs.push_back(std::move(job));
+                m_block = QByteArray();
+            }
+
+            while (!m_jobs.empty()) {
+                writeOldestBlock();
+            }
+        }
+
+        if (m_ok && !m_qfile.flush()) {
+            setErrorString(tr("Failed to write compressed data to file"));
+            m_ok = false;
         }
-        fclose(m_file);
         m_qfile.close();
-        m_bzFile = nullptr;
-        m_file = nullptr;
-        m_ok = false;
+
+        // Keep any error string past QIODevice::close, which clears it
+        QString error = errorString();
+        QIODevice::close();
+        setErrorString(error);
         return;
     }
 
     if (openMode() & ReadOnly) {
-        BZ2_bzReadClose(&bzError, m_bzFile);
-        if (bzError != BZ_OK) {
-            setErrorString(tr("bzip2 stream read close error"));
-        }
-        fclose(m_file);
+        m_decoder.reset();
+        m_input = QByteArray();
+        m_inputPos = 0;
         m_qfile.close();
-        m_bzFile = nullptr;
-        m_file = nullptr;
-        m_ok = false;
+        QString error = errorString();
+        QIODevice::close();
+        setErrorString(error);
         return;
     }
 
@@ -221,40 +644,95 @@ BZipFileDevice::close()
 qint64
 BZipFileDevice::readData(char *data, qint64 maxSize)
 {
-    if (m_atEnd) return 0;
+    if (m_atEnd || !m_decoder) return 0;
 
-    int bzError = BZ_OK;
-    int read = BZ2_bzRead(&bzError, m_bzFile, data, int(maxSize));
+    char *out = data;
+    char *outEnd = data + std::min(maxSize, qint64(INT_MAX));
 
-//    SVDEBUG << "BZipFileDevice::readData: requested " << maxSize << ", read " << read << endl;
+    // Return as soon as we have anything, as a stream may have
+    // decompressed data ready before its input is all read
 
-    if (bzError != BZ_OK) {
-        if (bzError != BZ_STREAM_END) {
-            cerr << "BZipFileDevice::readData: error condition" << endl;
-            setErrorString(tr("bzip2 stream read error"));
-            m_ok = false;
-            return -1;
-        } else {
+    while (out == data) {
+
+        const char *inStart = m_input.constData() + m_inputPos;
+        const char *in = inStart;
+        const char *inEnd = m_input.constData() + m_input.size();
+
+        if (in < inEnd || !m_decoder->atStreamBoundary()) {
+
+            Decoder::Result result = m_decoder->decode(in, inEnd, out, outEnd);
+            m_inputPos += int(in - inStart);
+
+            if (result == Decoder::Failed ||
+                (result == Decoder::Continue &&
+                 in == inStart && out == data && in < inEnd)) {
+                cerr << "BZipFileDevice::readData: error condition" << endl;
+                setErrorString(tr("Compressed stream read error"));
+                m_ok = false;
+                return -1;
+            }
+
+            if (result == Decoder::Finished) {
+                m_atEnd = true;
+                break;
+            }
+
+            if (in < inEnd) continue;
+            if (out > data) break;
+        }
+
+        m_input = m_qfile.read(readSize);
+        m_inputPos = 0;
+
+        if (m_input.isEmpty()) {
+            if (m_qfile.error() != QFile::NoError ||
+                !m_decoder->atStreamBoundary()) {
+                cerr << "BZipFileDevice::readData: error condition" << endl;
+                setErrorString(tr("Compressed stream ended unexpectedly"));
+                m_ok = false;
+                return -1;
+            }
 //            SVDEBUG << "BZipFileDevice::readData: reached end of file" << endl;
             m_atEnd = true;
-        }            
+            break;
+        }
     }
 
-    return read;
+    return out - data;
 }
 
 qint64
 BZipFileDevice::writeData(const char *data, qint64 maxSize)
 {
-    int bzError = BZ_OK;
-    BZ2_bzWrite(&bzError, m_bzFile, (void *)data, int(maxSize));
-
 //    SVDEBUG << "BZipFileDevice::writeData: " << maxSize << " to write" << endl;
 
-    if (bzError != BZ_OK) {
+    if (!m_ok) return -1;
+
+    qint64 done = 0;
+
+    while (done < maxSize) {
+        if (m_encoder) {
+            int n = int(std::min(maxSize - done, qint64(writeSize)));
+            if (!m_encoder->write(data + done, n, m_qfile)) {
+                setErrorString(tr("Failed to write compressed data to file"));
+                m_ok = false;
+                break;
+            }
+            done += n;
+        } else {
+            int n = int(std::min(maxSize - done,
+                                 qint64(m_blockSize - m_block.size())));
+            m_block.append(data + done, n);
+            done += n;
+            if (m_block.size() >= m_blockSize) {
+                startBlock();
+                if (!m_ok) break;
+            }
+        }
+    }
+
+    if (!m_ok) {
         cerr << "BZipFileDevice::writeData: error condition" << endl;
-        setErrorString("bzip2 stream write error");
-        m_ok = false;
         return -1;
     }
 
@@ -263,3 +741,45 @@ BZipFileDevice::writeData(const char *data, qint64 maxSize)
     return maxSize;
 }
 
+void
+BZipFileDevice::startBlock()
+{
+    BlockJob *job = new BlockJob(m_codec, m_block);
+    m_jobs.push_back(std::unique_ptr<BlockJob>(job));
+    ++m_blocksStarted;
+
+    m_block = QByteArray();
+    m_block.reserve(m_blockSize);
+
+    getCompressionThreadPool()->start(job);
+
+    while (int(m_jobs.size()) > getMaxBlocksInFlight()) {
+        writeOldestBlock();
+    }
+}
+
+void
+BZipFileDevice::writeOldestBlock()
+{
+    std::unique_ptr<BlockJob> job = std::move(m_jobs.front());
+    m_jobs.pop_front();
+
+    job->wait();
+
+    if (!m_ok) {
+        // An earlier block has failed: nothing after it is any use
+        return;
+    }
+
+    if (!job->isOK()) {
+        setErrorString(tr("Compression failed"));
+        m_ok = false;
+        return;
+    }
+
+    const QByteArray &output = job->getOutput();
+    if (m_qfile.write(output) != output.size()) {
+        setErrorString(tr("Failed to write compressed data to file"));
+        m_ok = false;
+    }
+}
@@ -18,20 +18,65 @@
 
 #include <QIODevice>
 #include <QFile>
+#include <QByteArray>
 
-#include <bzlib.h>
+#include <deque>
+#include <memory>
 
+/**
+ * A QIODevice that reads and writes a compressed file.
+ *
+ * By default, data written is compressed as it arrives into a single
+ * bzip2 stream, which any bzip2 reader can decode. Zstd may be used
+ * instead, if the build supports it.
+ *
+ * Optionally, the data may instead be divided into blocks which are
+ * compressed independently on a pool of threads, each as a complete
+ * stream (or frame) of its own, and written one after another. With
+ * bzip2 this is the multi-stream layout produced by pbzip2, which
+ * bunzip2 and other multi-stream readers decode as a single file,
+ * but of which readers that expect a single stream (including Sonic
+ * Visualiser releases before multi-stream reading was added) will
+ * see only the first block. Data that fits in one block is still
+ * written as a single ordinary stream.
+ *
+ * When reading, the codec is identified from the magic bytes at the
+ * start of the file, and all the streams in the file are read in
+ * turn.
+ */
 class BZipFileDevice : public QIODevice
 {
     Q_OBJECT
 
 public:
-    BZipFileDevice(QString fileName);
+    enum Codec {
+        BZip2,
+        Zstd
+    };
+
+    /**
+     * Construct a device for the given file. The codec, and whether
+     * to compress in parallel blocks, are used when writing only:
+     * when reading, the codec is taken from the file itself and any
+     * number of streams is accepted.
+     */
+    BZipFileDevice(QString fileName, Codec codec = BZip2,
+                   bool parallel = false);
     virtual ~BZipFileDevice();
+
+    /**
+     * Return true if this build can read and write the given codec.
+     */
+    static bool isCodecSupported(Codec codec);
     
     bool open(OpenMode mode) override;
     void close() override;
 
+    /**
+     * Return false if anything has failed. After closing a device
+     * that was open for writing, this also reports whether the last
+     * of the data was successfully compressed and written.
+     */
     virtual bool isOK() const;
 
     bool isSequential() const override { return true; }
@@ -41,12 +86,38 @@ protected:
     qint64 writeData(const char *data, qint64 maxSize) override;
 
     QString m_fileName;
+    Codec m_codec;
+    bool m_parallel;
 
     QFile m_qfile;
-    FILE *m_file;
-    BZFILE *m_bzFile;
     bool m_atEnd;
     bool m_ok;
+
+    // For writing a single stream
+    class Encoder;
+    class BZip2Encoder;
+    class ZstdEncoder;
+    std::unique_ptr<Encoder> m_encoder;
+
+    // For writing in parallel: input not yet handed to a compression
+    // job, and the jobs whose output has not yet been written, oldest
+    // first
+    class BlockJob;
+    QByteArray m_block;
+    int m_blockSize;
+    int m_blocksStarted;
+    std::deque<std::unique_ptr<BlockJob>> m_jobs;
+
+    void startBlock();
+    void writeOldestBlock();
+
+    // For reading: file data not yet decompressed
+    class Decoder;
+    class BZip2Decoder;
+    class ZstdDecoder;
+    std::unique_ptr<Decoder> m_decoder;
+    QByteArray m_input;
+    int m_inputPos;
 };
 
 #endif
@@ -28,6 +28,9 @@
 #include "model/BoxModel.h"
 #include "model/WritableWaveFileModel.h"
 #include "DataFileReaderFactory.h"
+#include "CSVTokeniser.h"
+
+#include "base/Thread.h"
 
 #include <QFile>
 #include <QDir>
@@ -41,9 +44,35 @@
 #include <iostream>
 #include <map>
 #include <string>
+#include <vector>
+#include <algorithm>
 
 using namespace std;
 
+// Windows of input are tokenised in parts on separate threads, but
+// only if each part would be at least this long
+static const int minBytesPerThread = 256 * 1024;
+
+// Windows are this long, or a little longer to reach a line ending
+static const qint64 windowBytes = 16 * 1024 * 1024;
+
+class TokeniserThread : public Thread
+{
+public:
+    TokeniserThread(CSVTokeniser &tokeniser, const char *text, int length) :
+        m_tokeniser(tokeniser), m_text(text), m_length(length) { }
+
+protected:
+    void run() override {
+        m_tokeniser.tokenise(m_text, m_length);
+    }
+
+private:
+    CSVTokeniser &m_tokeniser;
+    const char *m_text;
+    int m_length;
+};
+
 CSVFileReader::CSVFileReader(QString path, CSVFormat format,
                              sv_samplerate_t mainModelSampleRate,
                              ProgressReporter *reporter) :
@@ -170,6 +199,42 @@ CSVFileReader::convertTimeValue(QString s, int lineno,
     return calculatedFrame;
 }
 
+sv_frame_t
+CSVFileReader::convertTimeValue(const CSVTokeniser &tokeniser,
+                                int line, int field, int lineno,
+                                sv_samplerate_t sampleRate,
+                                int windowSize) const
+{
+    // A field the tokeniser found to be a plain number is one that
+    // would have nothing but whitespace removed by the filtering in
+    // the QString version, so gives the same result here
+    
+    double number = 0.0;
+    bool integral = false;
+
+    if (tokeniser.getNumber(line, field, number, integral)) {
+        
+        CSVFormat::TimeUnits timeUnits = m_format.getTimeUnits();
+
+        if (timeUnits == CSVFormat::TimeSeconds) {
+            return sv_frame_t(number * sampleRate + 0.5);
+        } else if (timeUnits == CSVFormat::TimeMilliseconds) {
+            return sv_frame_t((number / 1000.0) * sampleRate + 0.5);
+        } else if (integral) {
+            sv_frame_t calculatedFrame = 0;
+            sv_frame_t n = sv_frame_t(number);
+            if (n >= 0) calculatedFrame = n;
+            if (timeUnits == CSVFormat::TimeWindows) {
+                calculatedFrame *= windowSize;
+            }
+            return calculatedFrame;
+        }
+    }
+
+    return convertTimeValue(tokeniser.getString(line, field), lineno,
+                            sampleRate, windowSize);
+}
+
 Model *
 CSVFileReader::load() const
 {
@@ -207,8 +272,6 @@ CSVFileReader::load() const
     WritableWaveFileModel *modelW = nullptr;
     Model *model = nullptr;
 
-    QTextStream in(m_device);
-
     unsigned int warnings = 0, warnLimit = 10;
     unsigned int lineno = 0;
 
@@ -264,316 +327,453 @@ CSVFileReader::load() const
 
     map<QString, int> labelCountMap;
 
-    bool abandoned = false;
-    
-    while (!in.atEnd() && !abandoned) {
-
-        // QTextStream's readLine doesn't cope with old-style Mac
-        // CR-only line endings.  Why did they bother making the class
-        // cope with more than one sort of line ending, if it still
-        // can't be configured to cope with all the common sorts?
-
-        // For the time being we'll deal with this case (which is
-        // relatively uncommon for us, but still necessary to handle)
-        // by reading the entire file using a single readLine, and
-        // splitting it.  For CR and CR/LF line endings this will just
-        // read a line at a time, and that's obviously OK.
-
-        QString chunk = in.readLine();
-        QStringList lines = chunk.split('\r', QString::SkipEmptyParts);
-
-        m_readCount += chunk.size() + 1;
-
-        if (m_reporter) {
-            if (m_reporter->wasCancelled()) {
-                abandoned = true;
-                break;
-            }
-            int progress;
-            if (m_fileSize > 0) {
-                progress = int((double(m_readCount) / double(m_fileSize))
-                               * 100.0);
-            } else {
-                progress = int(m_readCount / 10000);
-            }
-            if (progress != m_progress) {
-                m_reporter->setProgress(progress);
-                m_progress = progress;
-            }
-        }
-        
-        for (int li = 0; li < lines.size(); ++li) {
+    DenseThreeDimensionalModel::Column values;
 
-            QString line = lines[li];
-            
-            if (line.startsWith("#")) continue;
+    // Add the given line to the model, creating the model first if
+    // this is the first line. Return false if the model could not be
+    // created.
+    
+    auto addLine = [&](const CSVTokeniser &tokeniser, int li) -> bool {
 
-            QStringList list = StringBits::split(line, separator, allowQuoting);
-            if (!model) {
+        if (!model) {
 
-                QString modelName = m_filename;
+            QString modelName = m_filename;
                 
-                switch (modelType) {
+            switch (modelType) {
 
-                case CSVFormat::OneDimensionalModel:
-                    model1 = new SparseOneDimensionalModel(sampleRate, windowSize);
-                    model = model1;
-                    break;
+            case CSVFormat::OneDimensionalModel:
+                model1 = new SparseOneDimensionalModel(sampleRate, windowSize);
+                model = model1;
+                break;
                 
-                case CSVFormat::TwoDimensionalModel:
-                    model2 = new SparseTimeValueModel(sampleRate, windowSize, false);
-                    model = model2;
-                    break;
+            case CSVFormat::TwoDimensionalModel:
+                model2 = new SparseTimeValueModel(sampleRate, windowSize, false);
+                model = model2;
+                break;
                 
-                case CSVFormat::TwoDimensionalModelWithDuration:
-                    model2a = new RegionModel(sampleRate, windowSize, false);
-                    model = model2a;
-                    break;
+            case CSVFormat::TwoDimensionalModelWithDuration:
+                model2a = new RegionModel(sampleRate, windowSize, false);
+                model = model2a;
+                break;
                 
-                case CSVFormat::TwoDimensionalModelWithDurationAndPitch:
-                    model2b = new NoteModel(sampleRate, windowSize, false);
-                    model = model2b;
-                    break;
+            case CSVFormat::TwoDimensionalModelWithDurationAndPitch:
+                model2b = new NoteModel(sampleRate, windowSize, false);
+                model = model2b;
+                break;
                 
-                case CSVFormat::TwoDimensionalModelWithDurationAndExtent:
-                    model2c = new BoxModel(sampleRate, windowSize, false);
-                    model = model2c;
-                    break;
+            case CSVFormat::TwoDimensionalModelWithDurationAndExtent:
+                model2c = new BoxModel(sampleRate, windowSize, false);
+                model = model2c;
+                break;
                 
-                case CSVFormat::ThreeDimensionalModel:
-                    model3 = new EditableDenseThreeDimensionalModel
-                        (sampleRate, windowSize, valueColumns);
-                    model = model3;
-                    break;
+            case CSVFormat::ThreeDimensionalModel:
+                model3 = new EditableDenseThreeDimensionalModel
+                    (sampleRate, windowSize, valueColumns);
+                model = model3;
+                break;
 
-                case CSVFormat::WaveFileModel:
-                {
-                    bool normalise = (m_format.getAudioSampleRange()
-                                      == CSVFormat::SampleRangeOther);
-                    QString path = getConvertedAudioFilePath();
-                    modelW = new WritableWaveFileModel
-                        (path, sampleRate, valueColumns,
-                         normalise ?
-                         WritableWaveFileModel::Normalisation::Peak :
-                         WritableWaveFileModel::Normalisation::None);
-                    modelName = QFileInfo(path).fileName();
-                    model = modelW;
-                    break;
-                }
-                }
+            case CSVFormat::WaveFileModel:
+            {
+                bool normalise = (m_format.getAudioSampleRange()
+                                  == CSVFormat::SampleRangeOther);
+                QString path = getConvertedAudioFilePath();
+                modelW = new WritableWaveFileModel
+                    (path, sampleRate, valueColumns,
+                     normalise ?
+                     WritableWaveFileModel::Normalisation::Peak :
+                     WritableWaveFileModel::Normalisation::None);
+                modelName = QFileInfo(path).fileName();
+                model = modelW;
+                break;
+            }
+            }
 
-                if (model && model->isOK()) {
-                    if (modelName != "") {
-                        model->setObjectName(modelName);
-                    }
+            if (model && model->isOK()) {
+                if (modelName != "") {
+                    model->setObjectName(modelName);
                 }
             }
+        }
 
-            if (!model || !model->isOK()) {
-                SVCERR << "Failed to create model to load CSV file into"
-                       << endl;
-                if (model) {
-                    delete model;
-                    model = nullptr;
-                    model1 = nullptr; model2 = nullptr;
-                    model2a = nullptr; model2b = nullptr; model2c = nullptr;
-                    model3 = nullptr; modelW = nullptr;
-                }
-                abandoned = true;
-                break;
+        if (!model || !model->isOK()) {
+            SVCERR << "Failed to create model to load CSV file into"
+                   << endl;
+            if (model) {
+                delete model;
+                model = nullptr;
+                model1 = nullptr; model2 = nullptr;
+                model2a = nullptr; model2b = nullptr; model2c = nullptr;
+                model3 = nullptr; modelW = nullptr;
             }
-            
-            float value = 0.f;
-            float otherValue = 0.f;
-            float pitch = 0.f;
-            QString label = "";
+            return false;
+        }
 
-            duration = 0.f;
-            haveEndTime = false;
+        int fieldCount = tokeniser.getFieldCount(li);
             
-            for (int i = 0; i < list.size(); ++i) {
+        float value = 0.f;
+        float otherValue = 0.f;
+        float pitch = 0.f;
+        QString label = "";
 
-                QString s = list[i];
+        duration = 0.f;
+        haveEndTime = false;
+            
+        for (int i = 0; i < fieldCount; ++i) {
 
-                CSVFormat::ColumnPurpose purpose = m_format.getColumnPurpose(i);
+            CSVFormat::ColumnPurpose purpose = m_format.getColumnPurpose(i);
 
-                switch (purpose) {
+            switch (purpose) {
 
-                case CSVFormat::ColumnUnknown:
-                    break;
+            case CSVFormat::ColumnUnknown:
+                break;
 
-                case CSVFormat::ColumnStartTime:
-                    frameNo = convertTimeValue(s, lineno, sampleRate, windowSize);
-                    break;
+            case CSVFormat::ColumnStartTime:
+                frameNo = convertTimeValue(tokeniser, li, i, lineno,
+                                           sampleRate, windowSize);
+                break;
                 
-                case CSVFormat::ColumnEndTime:
-                    endFrame = convertTimeValue(s, lineno, sampleRate, windowSize);
-                    haveEndTime = true;
-                    break;
-
-                case CSVFormat::ColumnDuration:
-                    duration = convertTimeValue(s, lineno, sampleRate, windowSize);
-                    break;
+            case CSVFormat::ColumnEndTime:
+                endFrame = convertTimeValue(tokeniser, li, i, lineno,
+                                            sampleRate, windowSize);
+                haveEndTime = true;
+                break;
 
-                case CSVFormat::ColumnValue:
-                    if (haveAnyValue) {
-                        otherValue = value;
-                    }
-                    value = s.toFloat();
-                    haveAnyValue = true;
-                    break;
+            case CSVFormat::ColumnDuration:
+                duration = convertTimeValue(tokeniser, li, i, lineno,
+                                            sampleRate, windowSize);
+                break;
 
-                case CSVFormat::ColumnPitch:
-                    pitch = s.toFloat();
-                    if (pitch < 0.f || pitch > 127.f) {
-                        pitchLooksLikeMIDI = false;
-                    }
-                    break;
+            case CSVFormat::ColumnValue:
+                if (haveAnyValue) {
+                    otherValue = value;
+                }
+                value = tokeniser.getFloat(li, i);
+                haveAnyValue = true;
+                break;
 
-                case CSVFormat::ColumnLabel:
-                    label = s;
-                    break;
+            case CSVFormat::ColumnPitch:
+                pitch = tokeniser.getFloat(li, i);
+                if (pitch < 0.f || pitch > 127.f) {
+                    pitchLooksLikeMIDI = false;
                 }
+                break;
+
+            case CSVFormat::ColumnLabel:
+                label = tokeniser.getString(li, i);
+                break;
             }
+        }
 
-            ++labelCountMap[label];
+        ++labelCountMap[label];
             
-            if (haveEndTime) { // ... calculate duration now all cols read
-                if (endFrame > frameNo) {
-                    duration = endFrame - frameNo;
-                }
+        if (haveEndTime) { // ... calculate duration now all cols read
+            if (endFrame > frameNo) {
+                duration = endFrame - frameNo;
             }
+        }
 
-            if (modelType == CSVFormat::OneDimensionalModel) {
+        if (modelType == CSVFormat::OneDimensionalModel) {
             
-                Event point(frameNo, label);
-                model1->add(point);
+            Event point(frameNo, label);
+            model1->add(point);
 
-            } else if (modelType == CSVFormat::TwoDimensionalModel) {
+        } else if (modelType == CSVFormat::TwoDimensionalModel) {
 
-                Event point(frameNo, value, label);
-                model2->add(point);
+            Event point(frameNo, value, label);
+            model2->add(point);
 
-            } else if (modelType == CSVFormat::TwoDimensionalModelWithDuration) {
+        } else if (modelType == CSVFormat::TwoDimensionalModelWithDuration) {
 
-                Event region(frameNo, value, duration, label);
-                model2a->add(region);
+            Event region(frameNo, value, duration, label);
+            model2a->add(region);
 
-            } else if (modelType == CSVFormat::TwoDimensionalModelWithDurationAndPitch) {
+        } else if (modelType == CSVFormat::TwoDimensionalModelWithDurationAndPitch) {
 
-                float level = ((value >= 0.f && value <= 1.f) ? value : 1.f);
-                Event note(frameNo, pitch, duration, level, label);
-                model2b->add(note);
+            float level = ((value >= 0.f && value <= 1.f) ? value : 1.f);
+            Event note(frameNo, pitch, duration, level, label);
+            model2b->add(note);
 
-            } else if (modelType == CSVFormat::TwoDimensionalModelWithDurationAndExtent) {
+        } else if (modelType == CSVFormat::TwoDimensionalModelWithDurationAndExtent) {
 
-                float level = 0.f;
-                if (value > otherValue) {
-                    level = value - otherValue;
-                    value = otherValue;
-                } else {
-                    level = otherValue - value;
-                }
-                Event box(frameNo, value, duration, level, label);
-                model2c->add(box);
+            float level = 0.f;
+            if (value > otherValue) {
+                level = value - otherValue;
+                value = otherValue;
+            } else {
+                level = otherValue - value;
+            }
+            Event box(frameNo, value, duration, level, label);
+            model2c->add(box);
 
-            } else if (modelType == CSVFormat::ThreeDimensionalModel) {
+        } else if (modelType == CSVFormat::ThreeDimensionalModel) {
 
-                DenseThreeDimensionalModel::Column values;
+            values.clear();
 
-                for (int i = 0; i < list.size(); ++i) {
+            for (int i = 0; i < fieldCount; ++i) {
 
-                    if (m_format.getColumnPurpose(i) != CSVFormat::ColumnValue) {
-                        continue;
-                    }
+                if (m_format.getColumnPurpose(i) != CSVFormat::ColumnValue) {
+                    continue;
+                }
 
-                    bool ok = false;
-                    float value = list[i].toFloat(&ok);
+                bool ok = false;
+                float value = tokeniser.getFloat(li, i, &ok);
 
-                    values.push_back(value);
+                values.push_back(value);
             
-                    if (firstEverValue || value < min) min = value;
-                    if (firstEverValue || value > max) max = value;
+                if (firstEverValue || value < min) min = value;
+                if (firstEverValue || value > max) max = value;
                     
-                    if (firstEverValue) {
-                        startFrame = frameNo;
-                        model3->setStartFrame(startFrame);
-                    } else if (lineno == 1 &&
-                               timingType == CSVFormat::ExplicitTiming) {
-                        model3->setResolution(int(frameNo - startFrame));
-                    }
+                if (firstEverValue) {
+                    startFrame = frameNo;
+                    model3->setStartFrame(startFrame);
+                } else if (lineno == 1 &&
+                           timingType == CSVFormat::ExplicitTiming) {
+                    model3->setResolution(int(frameNo - startFrame));
+                }
                     
-                    firstEverValue = false;
-
-                    if (!ok) {
-                        if (warnings < warnLimit) {
-                            SVCERR << "WARNING: CSVFileReader::load: "
-                                      << "Non-numeric value \""
-                                      << list[i]
-                                      << "\" in data line " << lineno+1
-                                      << ":" << endl;
-                            SVCERR << line << endl;
-                            ++warnings;
-                        } else if (warnings == warnLimit) {
-//                            SVCERR << "WARNING: Too many warnings" << endl;
-                        }
+                firstEverValue = false;
+
+                if (!ok) {
+                    if (warnings < warnLimit) {
+                        SVCERR << "WARNING: CSVFileReader::load: "
+                               << "Non-numeric value \""
+                               << tokeniser.getString(li, i)
+                               << "\" in data line " << lineno+1
+                               << ":" << endl;
+                        SVCERR << tokeniser.getLine(li) << endl;
+                        ++warnings;
+                    } else if (warnings == warnLimit) {
+//                        SVCERR << "WARNING: Too many warnings" << endl;
                     }
                 }
+            }
         
-//                SVDEBUG << "Setting bin values for count " << lineno << ", frame "
-//                          << frameNo << ", time " << RealTime::frame2RealTime(frameNo, sampleRate) << endl;
+//            SVDEBUG << "Setting bin values for count " << lineno << ", frame "
+//                      << frameNo << ", time " << RealTime::frame2RealTime(frameNo, sampleRate) << endl;
 
-                model3->setColumn(lineno, values);
+            model3->setColumn(lineno, values);
 
-            } else if (modelType == CSVFormat::WaveFileModel) {
+        } else if (modelType == CSVFormat::WaveFileModel) {
 
-                int channel = 0;
+            int channel = 0;
 
-                for (int i = 0;
-                     i < list.size() && channel < audioChannels;
-                     ++i) {
+            for (int i = 0;
+                 i < fieldCount && channel < audioChannels;
+                 ++i) {
 
-                    if (m_format.getColumnPurpose(i) !=
-                        CSVFormat::ColumnValue) {
-                        continue;
-                    }
+                if (m_format.getColumnPurpose(i) !=
+                    CSVFormat::ColumnValue) {
+                    continue;
+                }
 
-                    bool ok = false;
-                    float value = list[i].toFloat(&ok);
-                    if (!ok) {
-                        value = 0.f;
-                    }
+                bool ok = false;
+                float value = tokeniser.getFloat(li, i, &ok);
+                if (!ok) {
+                    value = 0.f;
+                }
 
-                    value += sampleShift;
-                    value *= sampleScale;
+                value += sampleShift;
+                value *= sampleScale;
                     
-                    audioSamples[channel][0] = value;
+                audioSamples[channel][0] = value;
+
+                ++channel;
+            }
+
+            while (channel < audioChannels) {
+                audioSamples[channel][0] = 0.f;
+                ++channel;
+            }
 
-                    ++channel;
+            bool ok = modelW->addSamples(audioSamples, 1);
+                
+            if (!ok) {
+                if (warnings < warnLimit) {
+                    SVCERR << "WARNING: CSVFileReader::load: "
+                           << "Unable to add sample to wave-file model"
+                           << endl;
+                    SVCERR << tokeniser.getLine(li) << endl;
+                    ++warnings;
                 }
+            }
+        }
+            
+        ++lineno;
+        if (timingType == CSVFormat::ImplicitTiming ||
+            fieldCount == 0) {
+            frameNo += windowSize;
+        }
+
+        return true;
+    };
+
+    // We read the text a window of a few MB at a time, with each
+    // window ending at a line ending. Each window is divided at line
+    // endings into one part per processor core, and the parts are
+    // tokenised (which includes parsing any numbers) on separate
+    // threads. Then the lines of each part are added to the model in
+    // order, on this thread.
+
+    bool abandoned = false;
+    
+    int threadCount = std::max(1, QThread::idealThreadCount());
+    std::vector<CSVTokeniser> tokenisers
+        (threadCount, CSVTokeniser(separator, allowQuoting));
+
+    qint64 windowOffset = 0; // position of current window in the input
 
-                while (channel < audioChannels) {
-                    audioSamples[channel][0] = 0.f;
-                    ++channel;
+    auto updateProgress = [&]() {
+        if (!m_reporter) return;
+        if (m_reporter->wasCancelled()) {
+            abandoned = true;
+            return;
+        }
+        int progress;
+        if (m_fileSize > 0) {
+            progress = int((double(m_readCount) / double(m_fileSize))
+                           * 100.0);
+        } else {
+            progress = int(m_readCount / 10000);
+        }
+        if (progress != m_progress) {
+            m_reporter->setProgress(progress);
+            m_progress = progress;
+        }
+    };
+
+    auto processWindow = [&](const char *text, int length) {
+
+        int parts = 1;
+        if (length >= minBytesPerThread * 2) {
+            parts = std::min(threadCount, length / minBytesPerThread);
+        }
+
+        std::vector<int> bounds(parts + 1, length);
+        bounds[0] = 0;
+        for (int p = 1; p < parts; ++p) {
+            int b = std::max(bounds[p-1], int((qint64(length) * p) / parts));
+            while (b < length && text[b] != '\n' && text[b] != '\r') ++b;
+            bounds[p] = (b < length ? b + 1 : length);
+        }
+
+        if (parts == 1) {
+            tokenisers[0].tokenise(text, length);
+        } else {
+            std::vector<TokeniserThread *> threads;
+            for (int p = 0; p < parts; ++p) {
+                threads.push_back(new TokeniserThread
+                                  (tokenisers[p], text + bounds[p],
+                                   bounds[p+1] - bounds[p]));
+                threads[p]->start();
+            }
+            for (auto t: threads) {
+                t->wait();
+                delete t;
+            }
+        }
+
+        for (int p = 0; p < parts && !abandoned; ++p) {
+            const CSVTokeniser &tokeniser = tokenisers[p];
+            int n = tokeniser.getLineCount();
+            for (int li = 0; li < n; ++li) {
+                if (!addLine(tokeniser, li)) {
+                    abandoned = true;
+                    break;
+                }
+                if (li % 4096 == 4095) {
+                    m_readCount = windowOffset + bounds[p] +
+                        tokeniser.getLineEnd(li);
+                    updateProgress();
+                    if (abandoned) break;
                 }
+            }
+        }
 
-                bool ok = modelW->addSamples(audioSamples, 1);
-                
-                if (!ok) {
-                    if (warnings < warnLimit) {
-                        SVCERR << "WARNING: CSVFileReader::load: "
-                               << "Unable to add sample to wave-file model"
-                               << endl;
-                        SVCERR << line << endl;
-                        ++warnings;
-                    }
+        windowOffset += length;
+        m_readCount = windowOffset;
+        if (!abandoned) updateProgress();
+    };
+
+    // Process whole windows from the given text, which is final if
+    // there is no more to come after it. Return the number of bytes
+    // used: if the text is not final, anything after the last line
+    // ending is left for the next call.
+    
+    auto processText = [&](const char *text, qint64 length, bool final) {
+
+        qint64 start = 0;
+        
+        while (start < length && !abandoned) {
+
+            qint64 end = start + windowBytes;
+
+            if (end < length) {
+                while (end < length && text[end] != '\n' && text[end] != '\r') {
+                    ++end;
                 }
+                if (end < length) ++end;
+            } else {
+                end = length;
             }
+
+            if (end == length && !final) {
+                while (end > start && text[end-1] != '\n' && text[end-1] != '\r') {
+                    --end;
+                }
+                if (end == start) break;
+            }
+
+            processWindow(text + start, int(end - start));
+            start = end;
+        }
+        
+        return start;
+    };
+
+    // QTextStream, which we used to read with, detects a byte-order
+    // mark. We skip a UTF-8 one, and let QTextStream decode anything
+    // in UTF-16, which should be rare enough that we don't mind
+    // reading it all into memory first.
+    
+    QByteArray head = m_device->peek(3);
+    
+    if (head.startsWith("\xff\xfe") || head.startsWith("\xfe\xff")) {
+
+        QTextStream in(m_device);
+        QByteArray text = in.readAll().toUtf8();
+        processText(text.constData(), text.size(), true);
+        
+    } else {
+
+        qint64 bomLength = (head.startsWith("\xef\xbb\xbf") ? 3 : 0);
+        
+        QFile *file = (m_ownDevice ? qobject_cast<QFile *>(m_device) : nullptr);
+        uchar *mapped = nullptr;
+        if (file && m_fileSize > bomLength) {
+            mapped = file->map(0, m_fileSize);
+        }
+
+        if (mapped) {
+
+            const char *text = reinterpret_cast<const char *>(mapped);
+            processText(text + bomLength, m_fileSize - bomLength, true);
+            file->unmap(mapped);
+
+        } else {
+
+            if (bomLength > 0) {
+                m_device->read(bomLength);
+            }
+
+            QByteArray buffer;
             
-            ++lineno;
-            if (timingType == CSVFormat::ImplicitTiming ||
-                list.size() == 0) {
-                frameNo += windowSize;
+            while (!abandoned) {
+                QByteArray block = m_device->read(windowBytes);
+                bool final = block.isEmpty();
+                buffer.append(block);
+                qint64 used = processText(buffer.constData(), buffer.size(), final);
+                buffer.remove(0, int(used));
+                if (final) break;
             }
         }
     }
@@ -28,6 +28,7 @@
 
 class QFile;
 class ProgressReporter;
+class CSVTokeniser;
 
 class CSVFileReader : public DataFileReader
 {
@@ -73,6 +74,10 @@ protected:
     sv_frame_t convertTimeValue(QString, int lineno, sv_samplerate_t sampleRate,
                                 int windowSize) const;
 
+    sv_frame_t convertTimeValue(const CSVTokeniser &, int line, int field,
+                                int lineno, sv_samplerate_t sampleRate,
+                                int windowSize) const;
+
     QString getConvertedAudioFilePath() const;
 };
 
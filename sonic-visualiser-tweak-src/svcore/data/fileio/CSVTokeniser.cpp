@@ -0,0 +1,363 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "CSVTokeniser.h"
+
+#include "base/StringBits.h"
+
+#include <QStringList>
+
+#include <cstdint>
+#include <limits>
+#include <cmath>
+
+static inline bool
+isAsciiSpace(char c)
+{
+    // The ASCII characters for which QChar::isSpace is true
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+CSVTokeniser::CSVTokeniser(QChar separator, bool allowQuoting) :
+    m_separator(separator),
+    m_quoting(allowQuoting),
+    m_bytewise(separator.unicode() < 0x80),
+    m_separatorByte(char(separator.unicode() & 0x7f)),
+    m_text(nullptr)
+{
+}
+
+void
+CSVTokeniser::tokenise(const char *text, int length)
+{
+    m_text = text;
+    m_store.clear();
+    m_fields.clear();
+    m_lines.clear();
+
+    int start = 0;
+
+    for (int i = 0; i <= length; ++i) {
+        if (i == length || text[i] == '\n' || text[i] == '\r') {
+            if (i > start && text[start] != '#') {
+                tokeniseLine(start, i - start);
+            }
+            start = i + 1;
+        }
+    }
+}
+
+void
+CSVTokeniser::tokeniseLine(int offset, int length)
+{
+    Line line;
+    line.offset = offset;
+    line.length = length;
+    line.firstField = int(m_fields.size());
+
+    const char *text = m_text + offset;
+
+    bool bytewise = m_bytewise;
+
+    if (bytewise && m_separatorByte == ' ' && m_quoting) {
+        // Splitting at whitespace treats non-ASCII space characters
+        // as separators too, so leave those lines to StringBits
+        for (int i = 0; i < length; ++i) {
+            if (text[i] & 0x80) {
+                bytewise = false;
+                break;
+            }
+        }
+    }
+
+    if (!bytewise) {
+        tokeniseWithStringBits(text, length);
+    } else if (m_quoting) {
+        tokeniseQuoted(text, length);
+    } else {
+        tokeniseUnquoted(text, length);
+    }
+
+    line.fieldCount = int(m_fields.size()) - line.firstField;
+    m_lines.push_back(line);
+}
+
+void
+CSVTokeniser::endField(int start)
+{
+    Field f;
+    f.start = start;
+    f.length = int(m_store.size()) - start;
+    f.number = 0.0;
+    f.kind = Text;
+
+    bool integral = false;
+    const char *p = m_store.data() + start;
+    if (parseNumber(p, p + f.length, f.number, integral)) {
+        f.kind = (integral ? Integer : Number);
+    }
+
+    m_fields.push_back(f);
+}
+
+void
+CSVTokeniser::tokeniseUnquoted(const char *line, int length)
+{
+    // As QString::split, skipping empty parts only when the
+    // separator is a space
+
+    bool skipEmpty = (m_separatorByte == ' ');
+    int start = 0;
+
+    for (int i = 0; i <= length; ++i) {
+        if (i == length || line[i] == m_separatorByte) {
+            if (i > start || !skipEmpty) {
+                int fieldStart = int(m_store.size());
+                m_store.insert(m_store.end(), line + start, line + i);
+                endField(fieldStart);
+            }
+            start = i + 1;
+        }
+    }
+}
+
+void
+CSVTokeniser::tokeniseQuoted(const char *line, int length)
+{
+    // This follows StringBits::splitQuoted exactly. All of the
+    // characters it treats specially are ASCII, and no byte of a
+    // multi-byte UTF-8 sequence is, so working on bytes gives the
+    // same tokens as working on characters
+
+    enum { sep, unq, q1, q2 } mode = sep;
+
+    char separator = m_separatorByte;
+    bool spaceSeparated = (separator == ' ');
+
+    int fieldStart = int(m_store.size());
+
+    for (int i = 0; i < length; ++i) {
+
+        char c = line[i];
+
+        if (c == '\'') {
+            switch (mode) {
+            case sep: mode = q1; break;
+            case unq: case q2: m_store.push_back(c); break;
+            case q1: mode = unq; break;
+            }
+
+        } else if (c == '"') {
+            switch (mode) {
+            case sep: mode = q2; break;
+            case unq: case q1: m_store.push_back(c); break;
+            case q2: mode = unq; break;
+            }
+
+        } else if (c == separator || (spaceSeparated && isAsciiSpace(c))) {
+            switch (mode) {
+            case sep:
+                if (!spaceSeparated) {
+                    endField(fieldStart);
+                    fieldStart = int(m_store.size());
+                }
+                break;
+            case unq:
+                mode = sep;
+                endField(fieldStart);
+                fieldStart = int(m_store.size());
+                break;
+            case q1: case q2:
+                m_store.push_back(c);
+                break;
+            }
+
+        } else if (c == '\\') {
+            if (++i < length) {
+                m_store.push_back(line[i]);
+                if (mode == sep) mode = unq;
+            }
+
+        } else {
+            m_store.push_back(c);
+            if (mode == sep) mode = unq;
+        }
+    }
+
+    if (int(m_store.size()) > fieldStart || mode != sep) {
+        if (mode == q1) {
+            // turns out it wasn't quoted after all
+            m_store.insert(m_store.begin() + fieldStart, '\'');
+        } else if (mode == q2) {
+            m_store.insert(m_store.begin() + fieldStart, '"');
+        }
+        endField(fieldStart);
+    }
+}
+
+void
+CSVTokeniser::tokeniseWithStringBits(const char *line, int length)
+{
+    QStringList list = StringBits::split(QString::fromUtf8(line, length),
+                                         m_separator, m_quoting);
+    for (const QString &s: list) {
+        QByteArray bytes = s.toUtf8();
+        int fieldStart = int(m_store.size());
+        m_store.insert(m_store.end(), bytes.begin(), bytes.end());
+        endField(fieldStart);
+    }
+}
+
+QString
+CSVTokeniser::getLine(int line) const
+{
+    const Line &l = m_lines[line];
+    return QString::fromUtf8(m_text + l.offset, l.length);
+}
+
+QString
+CSVTokeniser::getString(int line, int index) const
+{
+    const Field &f = field(line, index);
+    return QString::fromUtf8(m_store.data() + f.start, f.length);
+}
+
+bool
+CSVTokeniser::getNumber(int line, int index,
+                        double &number, bool &integral) const
+{
+    const Field &f = field(line, index);
+    if (f.kind == Text) return false;
+    number = f.number;
+    integral = (f.kind == Integer);
+    return true;
+}
+
+float
+CSVTokeniser::getFloat(int line, int index, bool *ok) const
+{
+    const Field &f = field(line, index);
+
+    if (f.kind != Text) {
+        // QString::toFloat converts via double, and fails for values
+        // out of float range or that underflow to zero; leave those
+        // to it
+        double d = f.number;
+        float v = float(d);
+        if (std::fabs(d) <= double(std::numeric_limits<float>::max()) &&
+            (v != 0.f || d == 0.0)) {
+            if (ok) *ok = true;
+            return v;
+        }
+    }
+
+    return getString(line, index).toFloat(ok);
+}
+
+bool
+CSVTokeniser::parseNumber(const char *p, const char *end,
+                          double &result, bool &integral)
+{
+    // A mantissa of up to 2^53 times a power of ten of up to 10^22
+    // is converted with a single correctly rounded multiplication or
+    // division, so gives the same result as a full conversion (this
+    // is Clinger's fast path). Anything outside that range, and
+    // anything unusual such as a leading '+' or a missing digit
+    // either side of the decimal point, is refused so that the
+    // caller can fall back to Qt.
+
+    static const double powers[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    static const uint64_t maxMantissa = uint64_t(1) << 53;
+
+    while (p < end && isAsciiSpace(*p)) ++p;
+    while (end > p && isAsciiSpace(end[-1])) --end;
+
+    if (p == end) return false;
+
+    bool negative = false;
+    if (*p == '-') {
+        negative = true;
+        ++p;
+    }
+
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    bool whole = true;
+
+    const char *q = p;
+    while (p < end && *p >= '0' && *p <= '9') {
+        if (mantissa > 0 || *p != '0') {
+            if (++digits > 18) return false;
+            mantissa = mantissa * 10 + uint64_t(*p - '0');
+        }
+        ++p;
+    }
+    if (p == q) return false;
+
+    if (p < end && *p == '.') {
+        whole = false;
+        ++p;
+        q = p;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (mantissa > 0 || *p != '0') {
+                if (++digits > 18) return false;
+                mantissa = mantissa * 10 + uint64_t(*p - '0');
+            }
+            --exponent;
+            ++p;
+        }
+        if (p == q) return false;
+    }
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        whole = false;
+        ++p;
+        bool negativeExponent = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negativeExponent = (*p == '-');
+            ++p;
+        }
+        q = p;
+        int e = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            if (e < 10000) e = e * 10 + (*p - '0');
+            ++p;
+        }
+        if (p == q) return false;
+        exponent += (negativeExponent ? -e : e);
+    }
+
+    if (p != end) return false;
+    if (mantissa > maxMantissa) return false;
+
+    double value = double(mantissa);
+
+    if (mantissa == 0 || exponent == 0) {
+        // exact as it stands
+    } else if (exponent > 0 && exponent <= 22) {
+        value *= powers[exponent];
+    } else if (exponent < 0 && exponent >= -22) {
+        value /= powers[-exponent];
+    } else {
+        return false;
+    }
+
+    result = (negative ? -value : value);
+    integral = whole;
+    return true;
+}
@@ -0,0 +1,151 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_CSV_TOKENISER_H
+#define SV_CSV_TOKENISER_H
+
+#include <QString>
+#include <QChar>
+
+#include <vector>
+
+/**
+ * Split a block of UTF-8 CSV text into lines and fields, working on
+ * the bytes directly rather than converting each line to a QString.
+ *
+ * Lines end at either CR or LF. Empty lines, and lines starting with
+ * '#', are skipped. Fields are split with the same rules as
+ * StringBits::split, so the results are the same as those of the
+ * line-by-line QTextStream reading that CSVFileReader used to do.
+ * Any line the byte-level splitter cannot handle exactly (such as one
+ * with non-ASCII characters when splitting at whitespace) is passed
+ * through StringBits::split instead.
+ *
+ * Each field that looks like a plain decimal number is also parsed
+ * during tokenisation, so that the expensive part of reading a large
+ * numeric file can be done by several CSVTokenisers on separate
+ * threads, each with its own part of the text. Reading the results
+ * back is then cheap, and must happen on one thread, in order.
+ */
+class CSVTokeniser
+{
+public:
+    CSVTokeniser(QChar separator, bool allowQuoting);
+
+    /**
+     * Tokenise the given text, replacing anything tokenised
+     * before. The text must remain valid for as long as getLine is
+     * to be called. If it does not end with a line ending, the last
+     * line is taken to end at the end of the text.
+     */
+    void tokenise(const char *text, int length);
+
+    /**
+     * Return the number of (non-empty, non-comment) lines found.
+     */
+    int getLineCount() const {
+        return int(m_lines.size());
+    }
+
+    /**
+     * Return the byte offset, within the tokenised text, of the end
+     * of the given line.
+     */
+    int getLineEnd(int line) const {
+        return m_lines[line].offset + m_lines[line].length;
+    }
+
+    /**
+     * Return the text of the given line, for use in warnings.
+     */
+    QString getLine(int line) const;
+
+    int getFieldCount(int line) const {
+        return m_lines[line].fieldCount;
+    }
+
+    /**
+     * Return the text of a field, with any quoting removed.
+     */
+    QString getString(int line, int field) const;
+
+    /**
+     * If the field was found to contain a plain decimal number,
+     * return true and set number to its value, and integral to true
+     * if it was written as a whole number without a decimal point or
+     * exponent. Otherwise return false.
+     */
+    bool getNumber(int line, int field, double &number, bool &integral) const;
+
+    /**
+     * Return the field as a float, exactly as QString::toFloat would
+     * for the same text.
+     */
+    float getFloat(int line, int field, bool *ok = nullptr) const;
+
+    /**
+     * Parse a plain decimal number, optionally negative, with
+     * optional fractional part and exponent, and surrounded by
+     * optional whitespace. Return true only if the number can be
+     * converted exactly as QString::toDouble would convert it (with
+     * the C locale), using a cheap method; return false for anything
+     * else, including valid numbers that would need a slower method
+     * to get exactly the right result.
+     */
+    static bool parseNumber(const char *begin, const char *end,
+                            double &result, bool &integral);
+
+private:
+    enum FieldKind : char {
+        Text,
+        Number,
+        Integer
+    };
+
+    struct Field {
+        int start;
+        int length;
+        double number;
+        FieldKind kind;
+    };
+
+    struct Line {
+        int offset;
+        int length;
+        int firstField;
+        int fieldCount;
+    };
+
+    QChar m_separator;
+    bool m_quoting;
+    bool m_bytewise;
+    char m_separatorByte;
+
+    const char *m_text;
+    std::vector<char> m_store;
+    std::vector<Field> m_fields;
+    std::vector<Line> m_lines;
+
+    void tokeniseLine(int offset, int length);
+    void tokeniseUnquoted(const char *line, int length);
+    void tokeniseQuoted(const char *line, int length);
+    void tokeniseWithStringBits(const char *line, int length);
+    void endField(int start);
+
+    const Field &field(int line, int field) const {
+        return m_fields[m_lines[line].firstField + field];
+    }
+};
+
+#endif
@@ -20,12 +20,12 @@
 #include "base/Exceptions.h"
 #include "base/Profiler.h"
 #include "base/Serialiser.h"
-#include "base/StorageAdviser.h"
 
 #include <bqresample/Resampler.h>
 
 #include <stdint.h>
 #include <iostream>
+#include <algorithm>
 #include <QDir>
 #include <QMutexLocker>
 
@@ -54,7 +54,13 @@ CodedAudioFileReader::CodedAudioFileReader(CacheMode cacheMode,
     m_trimFromEnd(0),
     m_clippedCount(0),
     m_firstNonzero(0),
-    m_lastNonzero(0)
+    m_lastNonzero(0),
+    m_persistentCacheWriter(nullptr),
+    m_persistentCacheReader(nullptr),
+    m_requestedTrimFromStart(0),
+    m_requestedTrimFromEnd(0),
+    m_memoryAccount("CodedAudioFileReader decode cache",
+                    MemoryBudget::Unevictable)
 {
     SVDEBUG << "CodedAudioFileReader:: cache mode: " << cacheMode
             << " (" << (cacheMode == CacheInTemporaryFile
@@ -90,11 +96,8 @@ CodedAudioFileReader::~CodedAudioFileReader()
     delete m_resampler;
     delete[] m_resampleBuffer;
 
-    if (!m_data.empty()) {
-        StorageAdviser::notifyDoneAllocation
-            (StorageAdviser::MemoryAllocation,
-             (m_data.size() * sizeof(float)) / 1024);
-    }
+    delete m_persistentCacheWriter; // discards it if never committed
+    delete m_persistentCacheReader;
 }
 
 void
@@ -102,6 +105,76 @@ CodedAudioFileReader::setFramesToTrim(sv_frame_t fromStart, sv_frame_t fromEnd)
 {
     m_trimFromStart = fromStart;
     m_trimFromEnd = fromEnd;
+    m_requestedTrimFromStart = fromStart;
+    m_requestedTrimFromEnd = fromEnd;
+}
+
+bool
+CodedAudioFileReader::openPersistentDecodeCache(QString encodedPath,
+                                                QString decoderParams)
+{
+    QMutexLocker locker(&m_cacheMutex);
+
+    if (m_initialised || !DecodeCache::isEnabled()) return false;
+
+    // The target rate here is the one requested (zero for the file's
+    // own rate), which is all we know before decoding
+    QString params = QString("%1:%2:%3")
+        .arg(decoderParams)
+        .arg(m_sampleRate)
+        .arg(m_normalised);
+
+    QString key = DecodeCache::makeKey(encodedPath, params);
+    if (key == "") return false;
+
+    DecodeCache::Reader *reader = new DecodeCache::Reader(key);
+    const DecodeCache::Metadata &md = reader->getMetadata();
+
+    if (!reader->isOK() ||
+        (m_sampleRate != 0 && md.sampleRate != m_sampleRate)) {
+        delete reader;
+        SVDEBUG << "CodedAudioFileReader::openPersistentDecodeCache: "
+                << "no cached decode of \"" << encodedPath << "\"" << endl;
+        m_persistentCacheKey = key;
+        return false;
+    }
+
+    SVDEBUG << "CodedAudioFileReader::openPersistentDecodeCache: using "
+            << "cached decode of \"" << encodedPath << "\"" << endl;
+
+    m_persistentCacheReader = reader;
+
+    m_channelCount = md.channels;
+    m_fileRate = md.fileRate;
+    m_sampleRate = md.sampleRate;
+    m_frameCount = md.frameCount;
+    m_fileFrameCount = md.fileFrameCount;
+    m_max = md.max;
+    m_gain = md.gain;
+    m_requestedTrimFromStart = md.trimFromStart;
+    m_requestedTrimFromEnd = md.trimFromEnd;
+    m_trimFromStart = 0;
+    m_trimFromEnd = 0;
+    m_clippedCount = md.clippedCount;
+    m_firstNonzero = md.firstNonzero;
+    m_lastNonzero = md.lastNonzero;
+
+    m_initialised = true;
+    return true;
+}
+
+void
+CodedAudioFileReader::abandonPersistentDecodeCache()
+{
+    QMutexLocker locker(&m_cacheMutex);
+
+    if (m_persistentCacheWriter) {
+        SVDEBUG << "CodedAudioFileReader::abandonPersistentDecodeCache: "
+                << "discarding incomplete cache entry" << endl;
+        delete m_persistentCacheWriter;
+        m_persistentCacheWriter = nullptr;
+    }
+    m_persistentCacheKey = "";
 }
 
 void
@@ -213,7 +286,11 @@ CodedAudioFileReader::initialiseDecodeCache()
                 // not threaded -- but we don't have access to that
                 // information here
 
-                m_cacheFileReader = new WavFileReader(m_cacheFileName);
+                // The reader is told the file is updating, so that
+                // it reads through libsndfile (following the file as
+                // it grows) until finishDecodeCache() tells it
+                // otherwise, when it can map the completed file
+                m_cacheFileReader = new WavFileReader(m_cacheFileName, true);
 
                 if (!m_cacheFileReader->isOK()) {
                     SVDEBUG << "ERROR: CodedAudioFileReader::initialiseDecodeCache: Failed to construct WAV file reader for temporary file: " << m_cacheFileReader->getError() << endl;
@@ -243,6 +320,15 @@ CodedAudioFileReader::initialiseDecodeCache()
         m_trimFromEnd = 0;
     }
 
+    if (m_persistentCacheKey != "") {
+        m_persistentCacheWriter = new DecodeCache::Writer
+            (m_persistentCacheKey, m_channelCount);
+        if (!m_persistentCacheWriter->isOK()) {
+            delete m_persistentCacheWriter;
+            m_persistentCacheWriter = nullptr;
+        }
+    }
+
     m_initialised = true;
 }
 
@@ -343,13 +429,34 @@ CodedAudioFileReader::finishDecodeCache()
 
         sf_close(m_cacheFileWritePtr);
         m_cacheFileWritePtr = nullptr;
-        if (m_cacheFileReader) m_cacheFileReader->updateFrameCount();
+        if (m_cacheFileReader) m_cacheFileReader->updateDone();
 
     } else {
-        // I know, I know, we already allocated it...
-        StorageAdviser::notifyPlannedAllocation
-            (StorageAdviser::MemoryAllocation,
-             (m_data.size() * sizeof(float)) / 1024);
+        m_dataLock.lock();
+        size_t bytes = m_data.capacity() * sizeof(float);
+        m_dataLock.unlock();
+        m_memoryAccount.setBytes(bytes);
+    }
+
+    if (m_persistentCacheWriter) {
+        if (isOK() && getError() == "") {
+            DecodeCache::Metadata md;
+            md.channels = m_channelCount;
+            md.sampleRate = m_sampleRate;
+            md.fileRate = m_fileRate;
+            md.frameCount = m_frameCount;
+            md.fileFrameCount = m_fileFrameCount;
+            md.max = m_max;
+            md.gain = m_gain;
+            md.trimFromStart = m_requestedTrimFromStart;
+            md.trimFromEnd = m_requestedTrimFromEnd;
+            md.clippedCount = m_clippedCount;
+            md.firstNonzero = m_firstNonzero;
+            md.lastNonzero = m_lastNonzero;
+            m_persistentCacheWriter->commit(md);
+        }
+        delete m_persistentCacheWriter;
+        m_persistentCacheWriter = nullptr;
     }
 
     SVDEBUG << "CodedAudioFileReader: File decodes to " << m_fileFrameCount
@@ -477,6 +584,7 @@ CodedAudioFileReader::pushBufferNonResampling(float *buffer, sv_frame_t sz)
         break;
 
     case CacheInMemory:
+    {
         m_dataLock.lock();
         try {
             m_data.insert(m_data.end(), buffer, buffer + count);
@@ -486,9 +594,20 @@ CodedAudioFileReader::pushBufferNonResampling(float *buffer, sv_frame_t sz)
             m_dataLock.unlock();
             throw e;
         }
+        size_t bytes = m_data.capacity() * sizeof(float);
         m_dataLock.unlock();
+        // Outside the lock, as this may release other caches
+        m_memoryAccount.setBytes(bytes);
         break;
     }
+    }
+
+    if (m_persistentCacheWriter) {
+        if (!m_persistentCacheWriter->write(buffer, sz)) {
+            delete m_persistentCacheWriter;
+            m_persistentCacheWriter = nullptr;
+        }
+    }
 }
 
 void
@@ -558,8 +677,18 @@ CodedAudioFileReader::getInterleavedFrames(sv_frame_t start, sv_frame_t count) c
     }
 
     floatvec_t frames;
-    
-    switch (m_cacheMode) {
+
+    if (m_persistentCacheReader) {
+
+        // The mapped cache entry is read-only and needs no lock
+
+        if (count <= 0 || start < 0) return {};
+        frames = floatvec_t(count * m_channelCount, 0.f);
+        sv_frame_t got = m_persistentCacheReader->getInterleavedFrames
+            (start, count, frames.data());
+        frames.resize(got * m_channelCount);
+
+    } else switch (m_cacheMode) {
 
     case CacheInTemporaryFile:
         if (m_cacheFileReader) {
@@ -596,3 +725,45 @@ CodedAudioFileReader::getInterleavedFrames(sv_frame_t start, sv_frame_t count) c
     return frames;
 }
 
+
+sv_frame_t
+CodedAudioFileReader::readInterleavedFrames(sv_frame_t start, sv_frame_t count,
+                                            float *buffer) const
+{
+    if (!m_initialised || !isOK() || start < 0 || count <= 0) {
+        return 0;
+    }
+
+    sv_frame_t got = 0;
+
+    if (m_persistentCacheReader) {
+        got = m_persistentCacheReader->getInterleavedFrames
+            (start, count, buffer);
+
+    } else if (m_cacheMode == CacheInTemporaryFile) {
+        if (m_cacheFileReader) {
+            got = m_cacheFileReader->readInterleavedFrames
+                (start, count, buffer);
+        }
+
+    } else {
+        m_dataLock.lock();
+        sv_frame_t available = sv_frame_t(m_data.size()) / m_channelCount;
+        if (start < available) {
+            got = std::min(count, available - start);
+            std::copy(m_data.begin() + start * m_channelCount,
+                      m_data.begin() + (start + got) * m_channelCount,
+                      buffer);
+        }
+        m_dataLock.unlock();
+    }
+
+    if (m_normalised) {
+        sv_frame_t n = got * m_channelCount;
+        for (sv_frame_t i = 0; i < n; ++i) {
+            buffer[i] *= m_gain;
+        }
+    }
+
+    return got;
+}
@@ -17,6 +17,9 @@
 #define SV_CODED_AUDIO_FILE_READER_H
 
 #include "AudioFileReader.h"
+#include "DecodeCache.h"
+
+#include "base/MemoryBudget.h"
 
 #include <QMutex>
 #include <QReadWriteLock>
@@ -54,6 +57,9 @@ public:
 
     floatvec_t getInterleavedFrames(sv_frame_t start, sv_frame_t count) const override;
 
+    sv_frame_t readInterleavedFrames(sv_frame_t start, sv_frame_t count,
+                                     float *buffer) const override;
+
     sv_samplerate_t getNativeRate() const override { return m_fileRate; }
 
     QString getLocalFilename() const override { return m_cacheFileName; }
@@ -69,6 +75,28 @@ protected:
                          sv_samplerate_t targetRate,
                          bool normalised);
 
+    /**
+     * Look for a persistent cache of the decoded form of the given
+     * encoded file. The decoder parameters must describe everything
+     * apart from the file content, target rate and normalisation
+     * that may affect the decoded audio (e.g. gapless mode). If a
+     * cache entry is found, initialise this reader from it and
+     * return true: the subclass should then not decode at all.
+     * Otherwise return false, and the decoded audio will be written
+     * to a new cache entry as it is decoded, for use next time.
+     *
+     * Call this before initialiseDecodeCache().
+     */
+    bool openPersistentDecodeCache(QString encodedPath,
+                                   QString decoderParams);
+
+    /**
+     * Discard the persistent cache entry being written, if any. Call
+     * this if decoding is cancelled or fails part way through, so
+     * that an incomplete decode is not cached.
+     */
+    void abandonPersistentDecodeCache();
+
     void initialiseDecodeCache(); // samplerate, channels must have been set
 
     // compensation for encoder delays:
@@ -129,6 +157,15 @@ protected:
     sv_frame_t m_clippedCount;
     sv_frame_t m_firstNonzero;
     sv_frame_t m_lastNonzero;
+
+    QString m_persistentCacheKey;
+    DecodeCache::Writer *m_persistentCacheWriter;
+    DecodeCache::Reader *m_persistentCacheReader;
+    sv_frame_t m_requestedTrimFromStart;
+    sv_frame_t m_requestedTrimFromEnd;
+
+    // Accounts for m_data when caching in memory
+    MemoryBudget::Account m_memoryAccount;
 };
 
 #endif
@@ -0,0 +1,467 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "DecodeCache.h"
+
+#include "base/CacheDirectory.h"
+#include "base/Exceptions.h"
+#include "base/Debug.h"
+#include "base/Profiler.h"
+
+#include <QSettings>
+#include <QCryptographicHash>
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QDateTime>
+
+#include <cstring>
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+
+namespace {
+
+const char *const magic = "SVDECCA1";
+const uint32_t formatVersion = 1;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t sampleFormat;
+    uint32_t channels;
+    uint32_t reserved0;
+    double sampleRate;
+    double fileRate;
+    int64_t frameCount;
+    int64_t fileFrameCount;
+    float max;
+    float gain;
+    int64_t trimFromStart;
+    int64_t trimFromEnd;
+    int64_t clippedCount;
+    int64_t firstNonzero;
+    int64_t lastNonzero;
+    uint32_t reserved[6];
+};
+
+static_assert(sizeof(Header) == 128, "DecodeCache header must be 128 bytes");
+
+qint64 bytesPerSample(DecodeCache::SampleFormat format) {
+    return format == DecodeCache::Int16 ? 2 : 4;
+}
+
+}
+
+bool
+DecodeCache::isEnabled()
+{
+    QSettings settings;
+    settings.beginGroup("DecodeCache");
+    bool enabled = settings.value("enabled", true).toBool();
+    settings.endGroup();
+    return enabled;
+}
+
+DecodeCache::SampleFormat
+DecodeCache::getPreferredSampleFormat()
+{
+    QSettings settings;
+    settings.beginGroup("DecodeCache");
+    QString format = settings.value("sample-format", "float").toString();
+    settings.endGroup();
+    return format == "int16" ? Int16 : Float32;
+}
+
+CacheDirectory &
+DecodeCache::getCacheDirectory()
+{
+    static CacheDirectory directory("decode-cache", 4096);
+    return directory;
+}
+
+QString
+DecodeCache::makeKey(QString encodedPath, QString decoderParams)
+{
+    Profiler profiler("DecodeCache::makeKey");
+
+    QFileInfo fi(encodedPath);
+    QFile file(encodedPath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        SVDEBUG << "DecodeCache::makeKey: failed to open " << encodedPath
+                << ": " << file.errorString() << endl;
+        return {};
+    }
+
+    // The file's identity, plus a fingerprint of its first and last
+    // blocks as a check against anything that leaves the size and
+    // modification time unchanged. This costs the same however long
+    // the file is.
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(decoderParams.toUtf8());
+    hash.addData(QString(":%1:%2:%3")
+                 .arg(fi.canonicalFilePath())
+                 .arg(fi.size())
+                 .arg(fi.lastModified().toMSecsSinceEpoch())
+                 .toUtf8());
+
+    const qint64 fingerprintSize = 65536;
+    qint64 size = file.size();
+
+    QByteArray head = file.read(std::min(size, fingerprintSize));
+    QByteArray tail;
+    if (size > fingerprintSize) {
+        qint64 tailStart = std::max(fingerprintSize, size - fingerprintSize);
+        if (file.seek(tailStart)) {
+            tail = file.read(size - tailStart);
+        }
+    }
+    
+    if (head.size() != std::min(size, fingerprintSize) ||
+        (size > fingerprintSize && tail.isEmpty())) {
+        SVDEBUG << "DecodeCache::makeKey: read failed for " << encodedPath
+                << ": " << file.errorString() << endl;
+        return {};
+    }
+    
+    hash.addData(head);
+    hash.addData(tail);
+
+    return QString::fromLatin1(hash.result().toHex()) + ".svdec";
+}
+
+DecodeCache::Reader::Reader(QString key) :
+    m_key(key),
+    m_data(nullptr),
+    m_samples(nullptr),
+    m_format(Float32)
+{
+    CacheDirectory &directory = getCacheDirectory();
+
+    try {
+        m_file.setFileName(directory.getFilePath(m_key));
+    } catch (const DirectoryCreationFailed &f) {
+        SVCERR << "WARNING: DecodeCache::Reader: " << f.what() << endl;
+        return;
+    }
+
+    directory.acquire(m_key);
+
+    if (!m_file.exists() || !m_file.open(QIODevice::ReadOnly)) {
+        directory.release(m_key);
+        return;
+    }
+
+    qint64 size = m_file.size();
+    if (size < qint64(sizeof(Header))) {
+        SVDEBUG << "DecodeCache::Reader: entry " << m_key
+                << " is truncated, removing it" << endl;
+        m_file.close();
+        directory.release(m_key);
+        directory.remove(m_key);
+        return;
+    }
+
+    uchar *data = m_file.map(0, size);
+    if (!data) {
+        SVCERR << "WARNING: DecodeCache::Reader: failed to map "
+               << m_file.fileName() << ": " << m_file.errorString() << endl;
+        m_file.close();
+        directory.release(m_key);
+        return;
+    }
+
+    Header header;
+    memcpy(&header, data, sizeof(header));
+
+    bool valid =
+        !memcmp(header.magic, magic, sizeof(header.magic)) &&
+        header.version == formatVersion &&
+        (header.sampleFormat == uint32_t(Float32) ||
+         header.sampleFormat == uint32_t(Int16)) &&
+        header.channels > 0 &&
+        header.frameCount >= 0 &&
+        size == qint64(sizeof(Header)) +
+        header.frameCount * qint64(header.channels) *
+        bytesPerSample(SampleFormat(header.sampleFormat));
+
+    if (!valid) {
+        SVDEBUG << "DecodeCache::Reader: entry " << m_key
+                << " is invalid or from an incompatible version, removing it"
+                << endl;
+        m_file.unmap(data);
+        m_file.close();
+        directory.release(m_key);
+        directory.remove(m_key);
+        return;
+    }
+
+    m_format = SampleFormat(header.sampleFormat);
+
+    m_metadata.channels = int(header.channels);
+    m_metadata.sampleRate = header.sampleRate;
+    m_metadata.fileRate = header.fileRate;
+    m_metadata.frameCount = header.frameCount;
+    m_metadata.fileFrameCount = header.fileFrameCount;
+    m_metadata.max = header.max;
+    m_metadata.gain = header.gain;
+    m_metadata.trimFromStart = header.trimFromStart;
+    m_metadata.trimFromEnd = header.trimFromEnd;
+    m_metadata.clippedCount = header.clippedCount;
+    m_metadata.firstNonzero = header.firstNonzero;
+    m_metadata.lastNonzero = header.lastNonzero;
+
+    m_data = data;
+    m_samples = data + sizeof(Header);
+
+    directory.touch(m_key);
+
+    SVDEBUG << "DecodeCache::Reader: opened " << m_file.fileName()
+            << " with " << m_metadata.frameCount << " frames of "
+            << m_metadata.channels << " channel(s) at "
+            << m_metadata.sampleRate << " Hz" << endl;
+}
+
+DecodeCache::Reader::~Reader()
+{
+    if (m_data) {
+        m_file.unmap(m_data);
+        m_file.close();
+        getCacheDirectory().release(m_key);
+    }
+}
+
+sv_frame_t
+DecodeCache::Reader::getInterleavedFrames(sv_frame_t start, sv_frame_t count,
+                                          float *to) const
+{
+    if (!m_data || start < 0 || count <= 0) return 0;
+    if (start >= m_metadata.frameCount) return 0;
+    if (count > m_metadata.frameCount - start) {
+        count = m_metadata.frameCount - start;
+    }
+
+    const int channels = m_metadata.channels;
+    const sv_frame_t n = count * channels;
+    const sv_frame_t offset = start * channels;
+
+    if (m_format == Float32) {
+        memcpy(to, m_samples + offset * sizeof(float), n * sizeof(float));
+    } else {
+        const short *from =
+            reinterpret_cast<const short *>(m_samples) + offset;
+        for (sv_frame_t i = 0; i < n; ++i) {
+            to[i] = float(from[i]) / 32767.f;
+        }
+    }
+
+    return count;
+}
+
+DecodeCache::Writer::Writer(QString key, int channels) :
+    m_key(key),
+    m_channels(channels),
+    m_format(getPreferredSampleFormat()),
+    m_written(0)
+{
+    CacheDirectory &directory = getCacheDirectory();
+
+    // A unique temporary name, so that two readers decoding the same
+    // file at once (in this process or another) don't collide
+    m_partName = QString("%1.%2-%3.part")
+        .arg(m_key)
+        .arg(QCoreApplication::applicationPid())
+        .arg(quintptr(this));
+
+    try {
+        m_file.setFileName(directory.getFilePath(m_partName));
+    } catch (const DirectoryCreationFailed &f) {
+        SVCERR << "WARNING: DecodeCache::Writer: " << f.what() << endl;
+        return;
+    }
+
+    directory.acquire(m_partName);
+
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        SVCERR << "WARNING: DecodeCache::Writer: failed to open "
+               << m_file.fileName() << ": " << m_file.errorString() << endl;
+        directory.release(m_partName);
+        return;
+    }
+
+    // Placeholder header, filled in by commit()
+    Header header;
+    memset(&header, 0, sizeof(header));
+    if (m_file.write(reinterpret_cast<const char *>(&header), sizeof(header))
+        != qint64(sizeof(header))) {
+        abandon();
+    }
+}
+
+DecodeCache::Writer::~Writer()
+{
+    abandon();
+}
+
+void
+DecodeCache::Writer::abandon()
+{
+    if (!m_file.isOpen()) return;
+    m_file.close();
+    m_file.remove();
+    getCacheDirectory().release(m_partName);
+}
+
+bool
+DecodeCache::Writer::write(const float *interleaved, sv_frame_t frames)
+{
+    if (!m_file.isOpen()) return false;
+    if (frames <= 0) return true;
+
+    const sv_frame_t n = frames * m_channels;
+    qint64 bytes = 0, result = 0;
+
+    if (m_format == Float32) {
+        bytes = qint64(n * sizeof(float));
+        result = m_file.write(reinterpret_cast<const char *>(interleaved),
+                              bytes);
+    } else {
+        if (sv_frame_t(m_conversionBuffer.size()) < n) {
+            m_conversionBuffer.resize(n);
+        }
+        for (sv_frame_t i = 0; i < n; ++i) {
+            float v = interleaved[i];
+            if (v > 1.f || v < -1.f) {
+                // Normalised audio may legitimately exceed the
+                // range we can store; don't cache it in this format
+                SVDEBUG << "DecodeCache::Writer: audio exceeds 16-bit "
+                        << "range, not caching " << m_key << endl;
+                abandon();
+                return false;
+            }
+            m_conversionBuffer[i] = short(lrintf(v * 32767.f));
+        }
+        bytes = qint64(n * sizeof(short));
+        result = m_file.write(reinterpret_cast<const char *>
+                              (m_conversionBuffer.data()), bytes);
+    }
+
+    if (result != bytes) {
+        SVCERR << "WARNING: DecodeCache::Writer: write failed for "
+               << m_file.fileName() << ": " << m_file.errorString() << endl;
+        abandon();
+        return false;
+    }
+
+    m_written += frames;
+    return true;
+}
+
+bool
+DecodeCache::Writer::commit(const Metadata &metadata)
+{
+    if (!m_file.isOpen()) return false;
+
+    if (metadata.channels != m_channels ||
+        metadata.frameCount != m_written) {
+        SVCERR << "WARNING: DecodeCache::Writer::commit: metadata ("
+               << metadata.channels << " channels, " << metadata.frameCount
+               << " frames) does not match audio written (" << m_channels
+               << " channels, " << m_written << " frames), discarding"
+               << endl;
+        abandon();
+        return false;
+    }
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magic, sizeof(header.magic));
+    header.version = formatVersion;
+    header.sampleFormat = uint32_t(m_format);
+    header.channels = uint32_t(metadata.channels);
+    header.sampleRate = metadata.sampleRate;
+    header.fileRate = metadata.fileRate;
+    header.frameCount = metadata.frameCount;
+    header.fileFrameCount = metadata.fileFrameCount;
+    header.max = metadata.max;
+    header.gain = metadata.gain;
+    header.trimFromStart = metadata.trimFromStart;
+    header.trimFromEnd = metadata.trimFromEnd;
+    header.clippedCount = metadata.clippedCount;
+    header.firstNonzero = metadata.firstNonzero;
+    header.lastNonzero = metadata.lastNonzero;
+
+    if (!m_file.seek(0) ||
+        m_file.write(reinterpret_cast<const char *>(&header), sizeof(header))
+        != qint64(sizeof(header)) ||
+        !m_file.flush()) {
+        SVCERR << "WARNING: DecodeCache::Writer::commit: failed to write "
+               << "header to " << m_file.fileName() << ": "
+               << m_file.errorString() << endl;
+        abandon();
+        return false;
+    }
+
+    m_file.close();
+
+    CacheDirectory &directory = getCacheDirectory();
+
+    // The entry is already in the directory (under its temporary
+    // name, protected from pruning) so we need reserve nothing more
+    if (!directory.prune()) {
+        SVDEBUG << "DecodeCache::Writer::commit: entry of "
+                << m_file.size() << " bytes does not fit within cache "
+                << "directory limit, discarding it" << endl;
+        m_file.remove();
+        directory.release(m_partName);
+        return false;
+    }
+
+    QString path = directory.getFilePath(m_key);
+
+    // Another writer may have committed the same entry first, and
+    // readers may have it mapped. We must not remove it before
+    // renaming ours into place, as a reader opening it in between
+    // would find nothing, and Windows refuses to remove a file that
+    // is open anyway.
+    
+#ifdef Q_OS_WIN
+    // Windows cannot replace an open file. The other writer's entry
+    // has the same key, so it is as good as ours: keep it
+    bool renamed = m_file.rename(path);
+    if (!renamed && QFile::exists(path)) {
+        SVDEBUG << "DecodeCache::Writer::commit: " << path
+                << " already exists, keeping it" << endl;
+        m_file.remove();
+        directory.release(m_partName);
+        return true;
+    }
+#else
+    // rename(2) replaces any existing entry atomically. A reader that
+    // has the old one mapped keeps it until it lets go
+    bool renamed = (::rename(QFile::encodeName(m_file.fileName()).constData(),
+                             QFile::encodeName(path).constData()) == 0);
+#endif
+
+    if (!renamed) {
+        SVCERR << "WARNING: DecodeCache::Writer::commit: failed to rename "
+               << m_file.fileName() << " to " << path << endl;
+        m_file.remove();
+    } else {
+        SVDEBUG << "DecodeCache::Writer::commit: wrote " << path << endl;
+    }
+
+    directory.release(m_partName);
+    return renamed;
+}
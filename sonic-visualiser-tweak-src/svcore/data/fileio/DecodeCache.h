@@ -0,0 +1,197 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_DECODE_CACHE_H
+#define SV_DECODE_CACHE_H
+
+#include "base/BaseTypes.h"
+
+#include <QString>
+#include <QFile>
+
+#include <vector>
+
+class CacheDirectory;
+
+/**
+ * A persistent cache of decoded audio, used by CodedAudioFileReader
+ * so that a compressed file that has been decoded once need not be
+ * decoded again when it is opened in a later session.
+ *
+ * Each entry is a single file in a CacheDirectory, named by a key
+ * made from the encoded file's identity and a short fingerprint of
+ * its content, together with the decoder parameters (see makeKey()). It holds the decoded and
+ * (possibly) resampled audio as interleaved 32-bit float or 16-bit
+ * integer samples, preceded by a header recording the metadata the
+ * reader calculated while decoding: rates, frame counts, trim,
+ * clipping and normalisation gain.
+ *
+ * Entries are written with a Writer, which writes to a temporary
+ * file that is renamed into place only once the decode has completed
+ * successfully, and read with a Reader, which memory-maps the file.
+ * An existing entry with the same key is replaced atomically, or
+ * kept where the platform cannot do that, but never removed first,
+ * so a reader never finds it missing.
+ *
+ * The cache may be disabled with the "enabled" key in the
+ * "DecodeCache" settings group. The sample format of new entries is
+ * set by the "sample-format" key in the same group, either "float"
+ * (the default) or "int16".
+ */
+class DecodeCache
+{
+public:
+    enum SampleFormat {
+        Float32 = 0,
+        Int16 = 1
+    };
+
+    struct Metadata {
+        Metadata() :
+            channels(0), sampleRate(0), fileRate(0),
+            frameCount(0), fileFrameCount(0),
+            max(0.f), gain(1.f),
+            trimFromStart(0), trimFromEnd(0),
+            clippedCount(0), firstNonzero(0), lastNonzero(0) { }
+
+        int channels;
+        sv_samplerate_t sampleRate;
+        sv_samplerate_t fileRate;
+        sv_frame_t frameCount;
+        sv_frame_t fileFrameCount;
+        float max;
+        float gain;
+        sv_frame_t trimFromStart;
+        sv_frame_t trimFromEnd;
+        sv_frame_t clippedCount;
+        sv_frame_t firstNonzero;
+        sv_frame_t lastNonzero;
+    };
+
+    /**
+     * Return true if the decode cache is enabled in the settings.
+     */
+    static bool isEnabled();
+
+    /**
+     * Return the sample format to be used for new cache entries.
+     */
+    static SampleFormat getPreferredSampleFormat();
+
+    /**
+     * Return a key identifying the decoded form of the given encoded
+     * file, made from the file's path, size and modification time, a
+     * fingerprint of its first and last 64K, and the given decoder
+     * parameters, which must describe everything other than the file
+     * content that affects the decoded audio. This reads a bounded
+     * amount of the file however large it is, so it is quick enough
+     * to call from the GUI thread. Return an empty string if the file
+     * could not be read.
+     */
+    static QString makeKey(QString encodedPath, QString decoderParams);
+
+    /**
+     * Return the cache directory shared by all decode cache entries.
+     */
+    static CacheDirectory &getCacheDirectory();
+
+    /**
+     * Reader for a complete cache entry. Construct with the key and
+     * check isOK(); a reader that is not OK means there is no usable
+     * entry for that key. Reading is thread safe.
+     */
+    class Reader
+    {
+    public:
+        Reader(QString key);
+        ~Reader();
+
+        bool isOK() const { return m_data != nullptr; }
+
+        const Metadata &getMetadata() const { return m_metadata; }
+        SampleFormat getSampleFormat() const { return m_format; }
+
+        /**
+         * Convert up to count interleaved frames starting at the
+         * given frame into the given buffer, which must have room
+         * for count * channels samples. Return the number of frames
+         * actually written, which is less than count if the request
+         * extends beyond the end of the audio.
+         */
+        sv_frame_t getInterleavedFrames(sv_frame_t start, sv_frame_t count,
+                                        float *to) const;
+
+    private:
+        Reader(const Reader &) =delete;
+        Reader &operator=(const Reader &) =delete;
+
+        QString m_key;
+        QFile m_file;
+        uchar *m_data;
+        const uchar *m_samples;
+        SampleFormat m_format;
+        Metadata m_metadata;
+    };
+
+    /**
+     * Writer for a new cache entry. Construct, check isOK(), write()
+     * the audio in order, and then commit() with the metadata. An
+     * entry that has not been committed when the writer is deleted
+     * is discarded.
+     */
+    class Writer
+    {
+    public:
+        Writer(QString key, int channels);
+        ~Writer();
+
+        bool isOK() const { return m_file.isOpen(); }
+
+        /**
+         * Append the given interleaved frames. Return false, and
+         * discard the entry, on a write failure, or if the sample
+         * format cannot represent the audio (values outside [-1,1]
+         * in the 16-bit format).
+         */
+        bool write(const float *interleaved, sv_frame_t frames);
+
+        /**
+         * Complete the entry with the given metadata and make it
+         * available to readers. Return false, discarding the entry,
+         * on failure, or if the audio written does not match the
+         * frame count in the metadata, or if the entry would not fit
+         * within the cache directory's size limit.
+         */
+        bool commit(const Metadata &metadata);
+
+        /**
+         * Discard the entry.
+         */
+        void abandon();
+
+    private:
+        Writer(const Writer &) =delete;
+        Writer &operator=(const Writer &) =delete;
+
+        QString m_key;
+        QString m_partName;
+        QFile m_file;
+        int m_channels;
+        SampleFormat m_format;
+        sv_frame_t m_written;
+        std::vector<short> m_conversionBuffer;
+    };
+};
+
+#endif
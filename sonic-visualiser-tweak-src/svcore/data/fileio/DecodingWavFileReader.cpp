@@ -55,12 +55,21 @@ DecodingWavFileReader::DecodingWavFileReader(FileSource source,
         return;
     }
 
-    m_channelCount = m_original->getChannelCount();
-    m_fileRate = m_original->getSampleRate();
-
     m_title = m_original->getTitle();
     m_maker = m_original->getMaker();
 
+    if (openPersistentDecodeCache(m_path, "DecodingWavFileReader")) {
+        // Resampled in an earlier session
+        delete m_original;
+        m_original = nullptr;
+        m_completion = 100;
+        if (m_reporter) m_reporter->setProgress(100);
+        return;
+    }
+
+    m_channelCount = m_original->getChannelCount();
+    m_fileRate = m_original->getSampleRate();
+
     initialiseDecodeCache();
 
     if (decodeMode == DecodeAtOnce) {
@@ -87,6 +96,7 @@ DecodingWavFileReader::DecodingWavFileReader(FileSource source,
             if (m_cancelled) break;
         }
 
+        if (m_cancelled) abandonPersistentDecodeCache();
         if (isDecodeCacheInitialised()) finishDecodeCache();
         endSerialised();
 
@@ -143,7 +153,8 @@ DecodingWavFileReader::DecodeThread::run()
 
         if (m_reader->m_cancelled) break;
     }
-    
+
+    if (m_reader->m_cancelled) m_reader->abandonPersistentDecodeCache();
     if (m_reader->isDecodeCacheInitialised()) m_reader->finishDecodeCache();
     m_reader->m_completion = 100;
 
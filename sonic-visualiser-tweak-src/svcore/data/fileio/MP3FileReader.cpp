@@ -96,6 +96,18 @@ MP3FileReader::MP3FileReader(FileSource source, DecodeMode decodeMode,
     }   
 
     m_fileSize = qfile.size();
+
+    if (openPersistentDecodeCache
+        (m_path, QString("MP3FileReader:%1")
+         .arg(m_gaplessMode == GaplessMode::Gapless ? "gapless" : "gappy"))) {
+        // Decoded in an earlier session: we need only the tags
+        loadTags(qfile.handle());
+        qfile.close();
+        m_done = true;
+        m_completion = 100;
+        if (m_reporter) m_reporter->setProgress(100);
+        return;
+    }
     
     try {
         // We need a mysterious MAD_BUFFER_GUARD (== 8) zero bytes at
@@ -137,6 +149,8 @@ MP3FileReader::MP3FileReader(FileSource source, DecodeMode decodeMode,
             m_error = QString("Failed to decode file %1.").arg(m_path);
         }
 
+        if (m_cancelled) abandonPersistentDecodeCache();
+
         if (m_sampleBuffer) {
             for (int c = 0; c < m_channelCount; ++c) {
                 delete[] m_sampleBuffer[c];
@@ -291,6 +305,8 @@ MP3FileReader::DecodeThread::run()
         m_reader->m_error = QString("Failed to decode file %1.").arg(m_reader->m_path);
     }
 
+    if (m_reader->m_cancelled) m_reader->abandonPersistentDecodeCache();
+
     delete[] m_reader->m_fileBuffer;
     m_reader->m_fileBuffer = nullptr;
 
@@ -0,0 +1,329 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "MappedWavFile.h"
+
+#include "base/Debug.h"
+#include "base/Profiler.h"
+
+#include <QtEndian>
+
+#include <cstring>
+#include <algorithm>
+
+namespace {
+
+const int formatPCM = 0x0001;
+const int formatFloat = 0x0003;
+const int formatExtensible = 0xfffe;
+
+// Sony Wave64 identifies its chunks with GUIDs. The RIFF and WAVE
+// GUIDs are checked in full; the fmt and data GUIDs share the WAVE
+// GUID's trailing bytes, so we identify those by their first four
+// bytes alone, as the other readers we know of do
+const uchar w64Riff[16] = {
+    'r', 'i', 'f', 'f', 0x2e, 0x91, 0xcf, 0x11,
+    0xa5, 0xd6, 0x28, 0xdb, 0x04, 0xc1, 0x00, 0x00
+};
+const uchar w64Wave[16] = {
+    'w', 'a', 'v', 'e', 0xf3, 0xac, 0xd3, 0x11,
+    0x8c, 0xd1, 0x00, 0xc0, 0x4f, 0x8e, 0xdb, 0x8a
+};
+
+quint16 u16(const uchar *p) { return qFromLittleEndian<quint16>(p); }
+quint32 u32(const uchar *p) { return qFromLittleEndian<quint32>(p); }
+quint64 u64(const uchar *p) { return qFromLittleEndian<quint64>(p); }
+
+}
+
+MappedWavFile::MappedWavFile(QString path) :
+    m_data(nullptr),
+    m_samples(nullptr),
+    m_channels(0),
+    m_sampleRate(0),
+    m_frameCount(0),
+    m_format(SampleFormat::Int16),
+    m_bytesPerSample(0)
+{
+#if Q_BYTE_ORDER == Q_BIG_ENDIAN
+    // We convert samples straight from the mapping assuming a
+    // little-endian host
+    return;
+#endif
+
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    qint64 size = m_file.size();
+    if (size < 44) {
+        m_file.close();
+        return;
+    }
+
+    m_data = m_file.map(0, size);
+    if (!m_data) {
+        SVDEBUG << "MappedWavFile: failed to map " << path << ": "
+                << m_file.errorString() << endl;
+        m_file.close();
+        return;
+    }
+
+    qint64 dataOffset = 0, dataSize = 0;
+
+    if (!parse(m_data, size, dataOffset, dataSize)) {
+        m_file.unmap(m_data);
+        m_data = nullptr;
+        m_file.close();
+        return;
+    }
+
+    // A file whose writer never updated the header (or which was
+    // truncated) may claim more data than it has
+    if (dataSize > size - dataOffset) {
+        dataSize = size - dataOffset;
+    }
+
+    m_frameCount = dataSize / getBytesPerFrame();
+    m_samples = m_data + dataOffset;
+
+    SVDEBUG << "MappedWavFile: mapped " << path << ": " << m_channels
+            << " channel(s), rate " << m_sampleRate << ", "
+            << m_frameCount << " frames, " << m_bytesPerSample
+            << " byte(s) per sample" << endl;
+}
+
+MappedWavFile::~MappedWavFile()
+{
+    if (m_data) {
+        m_file.unmap(m_data);
+    }
+    m_file.close();
+}
+
+bool
+MappedWavFile::parse(const uchar *data, qint64 size,
+                     qint64 &dataOffset, qint64 &dataSize)
+{
+    qint64 fmtOffset = 0, fmtSize = 0;
+    bool found = false;
+
+    if (!memcmp(data, "RIFF", 4) && !memcmp(data + 8, "WAVE", 4)) {
+        found = parseRiff(data, size, false,
+                          fmtOffset, fmtSize, dataOffset, dataSize);
+    } else if (!memcmp(data, "RF64", 4) && !memcmp(data + 8, "WAVE", 4)) {
+        found = parseRiff(data, size, true,
+                          fmtOffset, fmtSize, dataOffset, dataSize);
+    } else if (size >= 40 &&
+               !memcmp(data, w64Riff, 16) && !memcmp(data + 24, w64Wave, 16)) {
+        found = parseWave64(data, size,
+                            fmtOffset, fmtSize, dataOffset, dataSize);
+    }
+
+    if (!found || fmtOffset == 0 || dataOffset == 0) {
+        return false;
+    }
+
+    return parseFormat(data + fmtOffset, fmtSize);
+}
+
+bool
+MappedWavFile::parseRiff(const uchar *data, qint64 size, bool rf64,
+                         qint64 &fmtOffset, qint64 &fmtSize,
+                         qint64 &dataOffset, qint64 &dataSize)
+{
+    qint64 ds64DataSize = -1;
+    qint64 offset = 12;
+
+    while (offset + 8 <= size) {
+
+        const uchar *chunk = data + offset;
+        qint64 chunkSize = u32(chunk + 4);
+        qint64 body = offset + 8;
+
+        if (!memcmp(chunk, "ds64", 4)) {
+            if (!rf64 || chunkSize < 24 || body + 24 > size) return false;
+            ds64DataSize = qint64(u64(data + body + 8));
+
+        } else if (!memcmp(chunk, "fmt ", 4)) {
+            if (chunkSize < 16 || body + chunkSize > size) return false;
+            fmtOffset = body;
+            fmtSize = chunkSize;
+
+        } else if (!memcmp(chunk, "data", 4)) {
+            if (rf64 && chunkSize == 0xffffffff) {
+                if (ds64DataSize < 0) return false;
+                chunkSize = ds64DataSize;
+            }
+            dataOffset = body;
+            dataSize = chunkSize;
+            // The data chunk is normally last, and its size may be
+            // a placeholder anyway, so we don't look beyond it
+            return true;
+        }
+
+        offset = body + chunkSize + (chunkSize & 1);
+    }
+
+    return false;
+}
+
+bool
+MappedWavFile::parseWave64(const uchar *data, qint64 size,
+                           qint64 &fmtOffset, qint64 &fmtSize,
+                           qint64 &dataOffset, qint64 &dataSize)
+{
+    // Chunk sizes in Wave64 include the 24-byte chunk header, and
+    // chunks are aligned to 8 bytes
+
+    qint64 offset = 40;
+
+    while (offset + 24 <= size) {
+
+        const uchar *chunk = data + offset;
+        qint64 chunkSize = qint64(u64(chunk + 16));
+        qint64 body = offset + 24;
+
+        if (chunkSize < 24) return false;
+
+        if (!memcmp(chunk, "data", 4)) {
+            // As for RIFF, the data chunk may claim more than the
+            // file has, as when it was never finished; use what
+            // there is
+            dataOffset = body;
+            dataSize = std::min(chunkSize, size - offset) - 24;
+            return true;
+        }
+
+        // Any other chunk must lie within the file. Checking this
+        // before anything else also means offset cannot overflow
+        if (chunkSize > size - offset) return false;
+
+        if (!memcmp(chunk, "fmt ", 4)) {
+            if (chunkSize - 24 < 16) return false;
+            fmtOffset = body;
+            fmtSize = chunkSize - 24;
+        }
+
+        offset += (chunkSize + 7) & ~qint64(7);
+    }
+
+    return false;
+}
+
+bool
+MappedWavFile::parseFormat(const uchar *fmt, qint64 fmtSize)
+{
+    int tag = u16(fmt);
+    int channels = u16(fmt + 2);
+    quint32 rate = u32(fmt + 4);
+    int blockAlign = u16(fmt + 12);
+    int bits = u16(fmt + 14);
+
+    if (tag == formatExtensible) {
+        if (fmtSize < 40) return false;
+        // The sub-format GUID begins with the format tag
+        tag = u16(fmt + 24);
+    }
+
+    if (channels <= 0 || rate == 0 || blockAlign % channels != 0) {
+        return false;
+    }
+
+    // We handle only samples that exactly fill their containers
+    int bytes = blockAlign / channels;
+    if (bits != bytes * 8) {
+        return false;
+    }
+
+    if (tag == formatPCM) {
+        switch (bytes) {
+        case 1: m_format = SampleFormat::UInt8; break;
+        case 2: m_format = SampleFormat::Int16; break;
+        case 3: m_format = SampleFormat::Int24; break;
+        case 4: m_format = SampleFormat::Int32; break;
+        default: return false;
+        }
+    } else if (tag == formatFloat && bytes == 4) {
+        m_format = SampleFormat::Float32;
+    } else {
+        return false;
+    }
+
+    m_channels = channels;
+    m_sampleRate = rate;
+    m_bytesPerSample = bytes;
+    return true;
+}
+
+sv_frame_t
+MappedWavFile::getInterleavedFrames(sv_frame_t start, sv_frame_t count,
+                                    float *to) const
+{
+    Profiler profiler("MappedWavFile::getInterleavedFrames");
+
+    if (!m_samples || start < 0 || count <= 0) return 0;
+    if (start >= m_frameCount) return 0;
+    if (count > m_frameCount - start) {
+        count = m_frameCount - start;
+    }
+
+    const uchar *from = m_samples + start * getBytesPerFrame();
+    const sv_frame_t n = count * m_channels;
+
+    // The scale factors are those libsndfile uses when reading
+    // integer formats as float
+
+    switch (m_format) {
+
+    case SampleFormat::UInt8:
+        for (sv_frame_t i = 0; i < n; ++i) {
+            to[i] = float(int(from[i]) - 0x80) * (1.f / 0x80);
+        }
+        break;
+
+    case SampleFormat::Int16:
+        for (sv_frame_t i = 0; i < n; ++i) {
+            qint16 v;
+            memcpy(&v, from + i * 2, 2);
+            to[i] = float(v) * (1.f / 0x8000);
+        }
+        break;
+
+    case SampleFormat::Int24:
+        for (sv_frame_t i = 0; i < n; ++i) {
+            const uchar *p = from + i * 3;
+            qint32 v = qint32((quint32(p[0]) << 8) |
+                              (quint32(p[1]) << 16) |
+                              (quint32(p[2]) << 24)) >> 8;
+            to[i] = float(v) * (1.f / 0x800000);
+        }
+        break;
+
+    case SampleFormat::Int32:
+        for (sv_frame_t i = 0; i < n; ++i) {
+            qint32 v;
+            memcpy(&v, from + i * 4, 4);
+            to[i] = float(v) * (1.f / 2147483648.f);
+        }
+        break;
+
+    case SampleFormat::Float32:
+        memcpy(to, from, n * sizeof(float));
+        break;
+    }
+
+    return count;
+}
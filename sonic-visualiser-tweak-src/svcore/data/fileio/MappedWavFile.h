@@ -0,0 +1,112 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_MAPPED_WAV_FILE_H
+#define SV_MAPPED_WAV_FILE_H
+
+#include "base/BaseTypes.h"
+
+#include <QString>
+#include <QFile>
+
+/**
+ * A read-only memory-mapped view of the sample data in an
+ * uncompressed, little-endian WAV file (RIFF, RF64 or Sony Wave64)
+ * containing 8-, 16-, 24- or 32-bit integer PCM or 32-bit float
+ * samples.
+ *
+ * This is used by WavFileReader, for files it can handle, in place
+ * of reading through libsndfile: samples are converted to float
+ * straight from the mapping into the caller's buffer, with no
+ * locking, seeking or intermediate allocation. The conversions match
+ * those used by libsndfile, so the results are the same either way.
+ *
+ * The file must be complete, i.e. not still being written.  Check
+ * isOK() after construction; a file that is not OK is simply one
+ * that this class can't map, which is not an error -- fall back to
+ * libsndfile for it.
+ *
+ * Reading is thread safe.
+ */
+class MappedWavFile
+{
+public:
+    enum class SampleFormat {
+        UInt8,
+        Int16,
+        Int24,
+        Int32,
+        Float32
+    };
+
+    MappedWavFile(QString path);
+    ~MappedWavFile();
+
+    bool isOK() const { return m_samples != nullptr; }
+
+    int getChannelCount() const { return m_channels; }
+    sv_samplerate_t getSampleRate() const { return m_sampleRate; }
+    sv_frame_t getFrameCount() const { return m_frameCount; }
+    SampleFormat getSampleFormat() const { return m_format; }
+
+    /**
+     * Return the number of bytes occupied by one interleaved frame.
+     */
+    int getBytesPerFrame() const { return m_bytesPerSample * m_channels; }
+
+    /**
+     * Return a pointer to the raw (unconverted) interleaved sample
+     * data starting at the given frame, in the format returned by
+     * getSampleFormat(). The pointer remains valid for the lifetime
+     * of this object. Return nullptr if the frame is out of range.
+     */
+    const uchar *getFrameData(sv_frame_t frame) const {
+        if (!m_samples || frame < 0 || frame >= m_frameCount) return nullptr;
+        return m_samples + frame * getBytesPerFrame();
+    }
+
+    /**
+     * Convert up to count interleaved frames starting at the given
+     * frame into the given buffer, which must have room for count *
+     * getChannelCount() samples. Return the number of frames written,
+     * which is less than count if the end of the file is reached.
+     */
+    sv_frame_t getInterleavedFrames(sv_frame_t start, sv_frame_t count,
+                                    float *to) const;
+
+private:
+    MappedWavFile(const MappedWavFile &) =delete;
+    MappedWavFile &operator=(const MappedWavFile &) =delete;
+
+    QFile m_file;
+    uchar *m_data;
+    const uchar *m_samples;
+    int m_channels;
+    sv_samplerate_t m_sampleRate;
+    sv_frame_t m_frameCount;
+    SampleFormat m_format;
+    int m_bytesPerSample;
+
+    bool parse(const uchar *data, qint64 size,
+               qint64 &dataOffset, qint64 &dataSize);
+    bool parseRiff(const uchar *data, qint64 size, bool rf64,
+                   qint64 &fmtOffset, qint64 &fmtSize,
+                   qint64 &dataOffset, qint64 &dataSize);
+    bool parseWave64(const uchar *data, qint64 size,
+                     qint64 &fmtOffset, qint64 &fmtSize,
+                     qint64 &dataOffset, qint64 &dataSize);
+    bool parseFormat(const uchar *fmt, qint64 fmtSize);
+};
+
+#endif
@@ -0,0 +1,286 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "SessionContainer.h"
+
+#include "base/Debug.h"
+
+#include <QObject>
+
+#include <cstring>
+#include <climits>
+
+namespace {
+
+const char containerMagic[8] = { 'S', 'V', 'S', 'E', 'S', 'S', '\r', '\n' };
+const quint32 containerVersion = 1;
+
+struct Header {
+    char magic[8];
+    quint32 version;
+    quint32 blobCount;
+    quint64 manifestOffset;
+    quint64 manifestLength;
+    quint64 tableOffset;
+    quint64 pad;
+};
+
+static_assert(sizeof(Header) == 48, "Session container header must be 48 bytes");
+
+}
+
+SessionContainerWriter::SessionContainerWriter(QString path) :
+    m_file(path),
+    m_finished(false)
+{
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        m_error = m_file.errorString();
+        return;
+    }
+
+    // Placeholder, rewritten by finish()
+    Header header;
+    memset(&header, 0, sizeof(header));
+    write(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+SessionContainerWriter::~SessionContainerWriter()
+{
+    if (!m_finished) {
+        SVDEBUG << "SessionContainerWriter: Container \"" << m_file.fileName()
+                << "\" was not finished" << endl;
+    }
+}
+
+void
+SessionContainerWriter::write(const char *data, qint64 size)
+{
+    if (!isOK()) return;
+    if (m_file.write(data, size) != size) {
+        m_error = m_file.errorString();
+    }
+}
+
+void
+SessionContainerWriter::align()
+{
+    static const char zeros[8] = { 0 };
+    qint64 over = m_file.pos() % 8;
+    if (over > 0) {
+        write(zeros, 8 - over);
+    }
+}
+
+int
+SessionContainerWriter::addBlob(const QByteArray &data, QString key)
+{
+    int index = findBlob(key);
+    if (index >= 0) {
+        return index;
+    }
+
+    index = int(m_blobs.size());
+
+    if (m_finished) {
+        SVCERR << "SessionContainerWriter::addBlob: Container already finished"
+               << endl;
+        return index;
+    }
+
+    align();
+    quint64 offset = m_file.pos();
+    write(data.constData(), data.size());
+    m_blobs.push_back({ offset, quint64(data.size()) });
+    if (key != "") {
+        m_keys[key] = index;
+    }
+
+    return index;
+}
+
+int
+SessionContainerWriter::findBlob(QString key)
+{
+    if (key == "") return -1;
+    auto itr = m_keys.find(key);
+    if (itr == m_keys.end()) return -1;
+    return itr->second;
+}
+
+bool
+SessionContainerWriter::finish(const QByteArray &manifest)
+{
+    if (m_finished) return isOK();
+    m_finished = true;
+
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, containerMagic, sizeof(header.magic));
+    header.version = containerVersion;
+    header.blobCount = quint32(m_blobs.size());
+
+    align();
+    header.manifestOffset = m_file.pos();
+    header.manifestLength = manifest.size();
+    write(manifest.constData(), manifest.size());
+
+    align();
+    header.tableOffset = m_file.pos();
+    for (const auto &b: m_blobs) {
+        quint64 entry[2] = { b.first, b.second };
+        write(reinterpret_cast<const char *>(entry), sizeof(entry));
+    }
+
+    if (isOK() && !m_file.seek(0)) {
+        m_error = m_file.errorString();
+    }
+    write(reinterpret_cast<const char *>(&header), sizeof(header));
+
+    if (isOK() && !m_file.flush()) {
+        m_error = m_file.errorString();
+    }
+    m_file.close();
+
+    if (!isOK()) {
+        SVCERR << "SessionContainerWriter: Failed to write container \""
+               << m_file.fileName() << "\": " << m_error << endl;
+    }
+
+    return isOK();
+}
+
+SessionContainerReader::SessionContainerReader(QString path) :
+    m_file(path),
+    m_data(nullptr),
+    m_size(0),
+    m_manifestOffset(0),
+    m_manifestLength(0)
+{
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        m_error = m_file.errorString();
+        return;
+    }
+
+    m_size = m_file.size();
+
+#ifdef Q_OS_WIN
+    uchar *map = nullptr;
+#else
+    uchar *map = m_file.map(0, m_size);
+#endif
+
+    if (map) {
+        m_data = reinterpret_cast<const char *>(map);
+    } else {
+        SVDEBUG << "SessionContainerReader: Failed to map \"" << path
+                << "\", reading it instead" << endl;
+        m_contents = m_file.readAll();
+        m_data = m_contents.constData();
+        m_size = m_contents.size();
+        m_file.close();
+    }
+
+    if (!readHeader()) {
+        if (m_error == "") {
+            m_error = QObject::tr("File is not a valid session container");
+        }
+        SVCERR << "SessionContainerReader: " << m_error << endl;
+    }
+}
+
+SessionContainerReader::~SessionContainerReader()
+{
+    if (m_data && m_contents.isEmpty()) {
+        m_file.unmap(reinterpret_cast<uchar *>(const_cast<char *>(m_data)));
+    }
+}
+
+bool
+SessionContainerReader::isSessionContainer(QString path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    char magic[sizeof(containerMagic)];
+    return file.read(magic, sizeof(magic)) == qint64(sizeof(magic)) &&
+        memcmp(magic, containerMagic, sizeof(magic)) == 0;
+}
+
+bool
+SessionContainerReader::readHeader()
+{
+    Header header;
+    if (m_size < qint64(sizeof(header))) {
+        return false;
+    }
+    memcpy(&header, m_data, sizeof(header));
+
+    if (memcmp(header.magic, containerMagic, sizeof(header.magic))) {
+        return false;
+    }
+    if (header.version != containerVersion) {
+        m_error = QObject::tr("Session container has unsupported version %1")
+            .arg(header.version);
+        return false;
+    }
+
+    const quint64 size = quint64(m_size);
+
+    auto inFile = [&](quint64 offset, quint64 length) {
+        return offset <= size && length <= size - offset;
+    };
+
+    if (!inFile(header.manifestOffset, header.manifestLength) ||
+        header.manifestLength > quint64(INT_MAX) ||
+        header.blobCount > (size / 16) ||
+        !inFile(header.tableOffset, quint64(header.blobCount) * 16)) {
+        return false;
+    }
+
+    m_manifestOffset = header.manifestOffset;
+    m_manifestLength = header.manifestLength;
+
+    for (quint32 i = 0; i < header.blobCount; ++i) {
+        quint64 entry[2];
+        memcpy(entry, m_data + header.tableOffset + i * sizeof(entry),
+               sizeof(entry));
+        if (!inFile(entry[0], entry[1])) {
+            return false;
+        }
+        m_blobs.push_back({ entry[0], entry[1] });
+    }
+
+    return true;
+}
+
+QByteArray
+SessionContainerReader::getManifest() const
+{
+    if (!isOK()) return {};
+    return QByteArray::fromRawData(m_data + m_manifestOffset,
+                                   int(m_manifestLength));
+}
+
+bool
+SessionContainerReader::getBlob(int index,
+                                const char *&data, qint64 &size) const
+{
+    if (!isOK() || index < 0 || index >= getBlobCount()) {
+        return false;
+    }
+    data = m_data + m_blobs[index].first;
+    size = qint64(m_blobs[index].second);
+    return true;
+}
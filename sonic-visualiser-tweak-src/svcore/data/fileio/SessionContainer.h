@@ -0,0 +1,148 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_SESSION_CONTAINER_H
+#define SV_SESSION_CONTAINER_H
+
+#include "base/XmlExportable.h"
+
+#include <QFile>
+#include <QString>
+#include <QByteArray>
+
+#include <vector>
+#include <map>
+
+/**
+ * A session container is an alternative to the bzipped XML of a .sv
+ * file, for sessions with large models. It holds a manifest, which is
+ * the session XML exactly as it would otherwise be written, together
+ * with binary blobs holding the datasets of the models that support
+ * them (event series and editable dense 3-D models). Those datasets
+ * appear in the manifest as dataset elements with a blob attribute
+ * giving the blob index, in place of a child element per point.
+ *
+ * The file consists of a 48-byte header, then the blobs, each
+ * starting at a multiple of 8 bytes, then the manifest as UTF-8, and
+ * finally a table of the offset and length of each blob as pairs of
+ * 64-bit values. The header holds an 8-byte magic string, the format
+ * version and blob count as 32-bit values, then the offset and length
+ * of the manifest and the offset of the table as 64-bit values,
+ * padded with a zero. Numbers are written in the byte order of the
+ * machine that saved the file, and a reader with the other byte
+ * order will refuse it as being of an unknown version.
+ *
+ * The reader maps the file into memory, so that a blob's pages are
+ * only read from disc when it is decoded. Models loaded from a
+ * container keep the reader, and so the mapping, until they have
+ * decoded their blobs, which they do when first used. (On Windows,
+ * where a mapped file cannot be replaced, the reader reads the whole
+ * file instead, so that the session can still be saved over it.)
+ */
+class SessionContainerWriter : public XmlExportable::BlobSink
+{
+public:
+    /**
+     * Create a container at the given path, replacing any file
+     * already there. Check isOK() before use.
+     */
+    SessionContainerWriter(QString path);
+    virtual ~SessionContainerWriter();
+
+    bool isOK() const { return m_error == ""; }
+    QString getError() const { return m_error; }
+
+    /**
+     * Write a blob to the container and return its index. If a blob
+     * has already been written with the same non-empty key, return
+     * the index of that one instead of writing it again.
+     */
+    int addBlob(const QByteArray &data, QString key) override;
+
+    /**
+     * Return the index of a blob already written to this container
+     * with the given key, or -1 if there is none.
+     */
+    int findBlob(QString key) override;
+
+    /**
+     * Return the number of bytes written to the container so far.
+     */
+    qint64 getBytesWritten() const { return m_file.pos(); }
+
+    /**
+     * Write the manifest and the blob table, complete the header and
+     * close the file. Return false if anything failed to write.
+     */
+    bool finish(const QByteArray &manifest);
+
+private:
+    QFile m_file;
+    QString m_error;
+    std::vector<std::pair<quint64, quint64>> m_blobs;
+    std::map<QString, int> m_keys;
+    bool m_finished;
+
+    void write(const char *data, qint64 size);
+    void align();
+};
+
+class SessionContainerReader
+{
+public:
+    /**
+     * Open and map the container at the given path. Check isOK()
+     * before use.
+     */
+    SessionContainerReader(QString path);
+    virtual ~SessionContainerReader();
+
+    /**
+     * Return true if the file at the given path starts with the
+     * magic string of a session container.
+     */
+    static bool isSessionContainer(QString path);
+
+    bool isOK() const { return m_error == ""; }
+    QString getError() const { return m_error; }
+
+    /**
+     * Return the manifest. The returned array refers to the mapped
+     * file and is only valid during the lifetime of this reader.
+     */
+    QByteArray getManifest() const;
+
+    int getBlobCount() const { return int(m_blobs.size()); }
+
+    /**
+     * Obtain the data and size of the given blob, which are valid
+     * during the lifetime of this reader. Return false if there is no
+     * such blob.
+     */
+    bool getBlob(int index, const char *&data, qint64 &size) const;
+
+private:
+    QFile m_file;
+    QString m_error;
+    const char *m_data;
+    qint64 m_size;
+    QByteArray m_contents; // if the file could not be mapped
+    quint64 m_manifestOffset;
+    quint64 m_manifestLength;
+    std::vector<std::pair<quint64, quint64>> m_blobs;
+
+    bool readHeader();
+};
+
+#endif
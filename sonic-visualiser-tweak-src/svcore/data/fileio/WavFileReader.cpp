@@ -14,11 +14,13 @@
 */
 
 #include "WavFileReader.h"
+#include "MappedWavFile.h"
 
 #include "base/HitCount.h"
 #include "base/Profiler.h"
 
 #include <iostream>
+#include <algorithm>
 
 #include <QMutexLocker>
 #include <QFileInfo>
@@ -36,7 +38,8 @@ WavFileReader::WavFileReader(FileSource source,
     m_lastCount(0),
     m_normalisation(normalisation),
     m_max(0.f),
-    m_updating(fileUpdating)
+    m_updating(fileUpdating),
+    m_mapped(nullptr)
 {
     m_frameCount = 0;
     m_channelCount = 0;
@@ -92,6 +95,10 @@ WavFileReader::WavFileReader(FileSource source,
             m_seekable = true;
         }
 
+        if (!m_updating) {
+            mapFile();
+        }
+
         if (m_normalisation != Normalisation::None && !m_updating) {
             m_max = getMax();
         }
@@ -111,14 +118,59 @@ WavFileReader::WavFileReader(FileSource source,
 
 WavFileReader::~WavFileReader()
 {
+    delete m_mapped.load();
     if (m_file) sf_close(m_file);
 }
 
+void
+WavFileReader::mapFile()
+{
+    if (m_mapped || !m_file || m_fileInfo.channels <= 0) return;
+
+    int type = m_fileInfo.format & SF_FORMAT_TYPEMASK;
+    int subtype = m_fileInfo.format & SF_FORMAT_SUBMASK;
+    int endian = m_fileInfo.format & SF_FORMAT_ENDMASK;
+
+    if (type != SF_FORMAT_WAV && type != SF_FORMAT_W64 &&
+        type != SF_FORMAT_RF64) {
+        return;
+    }
+    if (subtype != SF_FORMAT_PCM_U8 && subtype != SF_FORMAT_PCM_16 &&
+        subtype != SF_FORMAT_PCM_24 && subtype != SF_FORMAT_PCM_32 &&
+        subtype != SF_FORMAT_FLOAT) {
+        return;
+    }
+    if (endian != SF_ENDIAN_FILE && endian != SF_ENDIAN_LITTLE) {
+        return;
+    }
+
+    MappedWavFile *mapped = new MappedWavFile(m_path);
+
+    // Use the mapping only if it agrees with libsndfile about what
+    // the file contains
+    if (!mapped->isOK() ||
+        mapped->getChannelCount() != m_fileInfo.channels ||
+        mapped->getSampleRate() != m_fileInfo.samplerate ||
+        mapped->getFrameCount() != m_fileInfo.frames) {
+        SVDEBUG << "WavFileReader: not memory-mapping \"" << m_path
+                << "\", reading through libsndfile instead" << endl;
+        delete mapped;
+        return;
+    }
+
+    m_mapped = mapped;
+}
+
 void
 WavFileReader::updateFrameCount()
 {
     QMutexLocker locker(&m_mutex);
 
+    if (m_mapped) {
+        // complete already
+        return;
+    }
+
     sv_frame_t prevCount = m_fileInfo.frames;
 
     if (m_file) {
@@ -153,6 +205,10 @@ WavFileReader::updateDone()
 {
     updateFrameCount();
     m_updating = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        mapFile();
+    }
     if (m_normalisation != Normalisation::None) {
         m_max = getMax();
     }
@@ -174,6 +230,27 @@ WavFileReader::getInterleavedFrames(sv_frame_t start, sv_frame_t count) const
     return frames;
 }
 
+sv_frame_t
+WavFileReader::readInterleavedFrames(sv_frame_t start, sv_frame_t count,
+                                     float *buffer) const
+{
+    const MappedWavFile *mapped = m_mapped;
+    if (!mapped) {
+        return AudioFileReader::readInterleavedFrames(start, count, buffer);
+    }
+
+    sv_frame_t got = mapped->getInterleavedFrames(start, count, buffer);
+
+    if (m_normalisation != Normalisation::None && m_max != 0.f) {
+        sv_frame_t n = got * m_channelCount;
+        for (sv_frame_t i = 0; i < n; ++i) {
+            buffer[i] /= m_max;
+        }
+    }
+
+    return got;
+}
+
 floatvec_t
 WavFileReader::getInterleavedFramesUnnormalised(sv_frame_t start,
                                                 sv_frame_t count) const
@@ -182,6 +259,16 @@ WavFileReader::getInterleavedFramesUnnormalised(sv_frame_t start,
 
     if (count == 0) return {};
 
+    if (const MappedWavFile *mapped = m_mapped) {
+        // No locking or last-read caching needed: conversion
+        // from the mapping is cheap and thread safe
+        if (start < 0 || start >= mapped->getFrameCount()) return {};
+        count = std::min(count, mapped->getFrameCount() - start);
+        floatvec_t data(count * mapped->getChannelCount());
+        mapped->getInterleavedFrames(start, count, data.data());
+        return data;
+    }
+
     QMutexLocker locker(&m_mutex);
 
     Profiler profiler("WavFileReader::getInterleavedFrames");
@@ -27,6 +27,9 @@
 #include <QMutex>
 
 #include <set>
+#include <atomic>
+
+class MappedWavFile;
 
 /**
  * Reader for audio files using libsndfile.
@@ -37,6 +40,10 @@
  * Compressed files supported by libsndfile (e.g. Ogg, FLAC) should
  * normally be read using DecodingWavFileReader instead (which decodes
  * to an intermediate cached file).
+ *
+ * Complete (non-updating) uncompressed WAV files in the common
+ * integer and float sample formats are memory-mapped, and read
+ * through a MappedWavFile rather than libsndfile.
  */
 class WavFileReader : public AudioFileReader
 {
@@ -63,6 +70,15 @@ public:
      * arguments on the same object at the same time.
      */
     floatvec_t getInterleavedFrames(sv_frame_t start, sv_frame_t count) const override;
+
+    sv_frame_t readInterleavedFrames(sv_frame_t start, sv_frame_t count,
+                                     float *buffer) const override;
+
+    /**
+     * Return true if the file is being read through a memory
+     * mapping rather than through libsndfile.
+     */
+    bool isMapped() const { return m_mapped != nullptr; }
     
     static void getSupportedExtensions(std::set<QString> &extensions);
     static bool supportsExtension(QString ext);
@@ -98,6 +114,11 @@ protected:
 
     bool m_updating;
 
+    // Set at most once, when the file is known to be complete, and
+    // not changed thereafter
+    std::atomic<MappedWavFile *> m_mapped;
+
+    void mapFile();
     floatvec_t getInterleavedFramesUnnormalised(sv_frame_t start,
                                                 sv_frame_t count) const;
     float getMax() const;
@@ -0,0 +1,187 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_BZIP_FILE_DEVICE_H
+#define TEST_BZIP_FILE_DEVICE_H
+
+#include "../BZipFileDevice.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include <bzlib.h>
+
+using namespace std;
+
+class BZipFileDeviceTest : public QObject
+{
+    Q_OBJECT
+
+    QTemporaryDir m_dir;
+
+    QByteArray makeData(int size) {
+        // Compressible, but not trivially so
+        QByteArray data;
+        data.reserve(size);
+        unsigned int x = 1;
+        while (data.size() < size) {
+            x = x * 1103515245u + 12345u;
+            data.append(QByteArray::number((x >> 16) % 1000));
+            data.append(' ');
+        }
+        data.resize(size);
+        return data;
+    }
+
+    bool writeFile(QString path, const QByteArray &data,
+                   BZipFileDevice::Codec codec, bool parallel) {
+        BZipFileDevice device(path, codec, parallel);
+        if (!device.open(QIODevice::WriteOnly)) return false;
+        // In uneven pieces, to cross block boundaries mid-write
+        int done = 0;
+        while (done < data.size()) {
+            int n = std::min(data.size() - done, 77777);
+            if (device.write(data.constData() + done, n) != n) return false;
+            done += n;
+        }
+        device.close();
+        return device.isOK();
+    }
+
+    QByteArray readFile(QString path, bool *ok) {
+        BZipFileDevice device(path);
+        *ok = device.open(QIODevice::ReadOnly);
+        if (!*ok) return {};
+        QByteArray data = device.readAll();
+        *ok = device.isOK();
+        device.close();
+        return data;
+    }
+
+    void roundTrip(BZipFileDevice::Codec codec, int size, bool parallel) {
+        QString path = m_dir.filePath(QString("%1-%2-%3.bz")
+                                      .arg(codec).arg(size).arg(parallel));
+        QByteArray data = makeData(size);
+        QVERIFY(writeFile(path, data, codec, parallel));
+        bool ok = false;
+        QByteArray back = readFile(path, &ok);
+        QVERIFY(ok);
+        QCOMPARE(back.size(), data.size());
+        QVERIFY(back == data);
+    }
+
+    bool isSingleStream(QString path, int size) {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) return false;
+        QByteArray compressed = file.readAll();
+        QByteArray out(size + 100, '\0');
+        unsigned int n = out.size();
+        return BZ2_bzBuffToBuffDecompress(out.data(), &n,
+                                          compressed.data(),
+                                          compressed.size(), 0, 0) == BZ_OK &&
+            int(n) == size;
+    }
+
+private slots:
+    void bzip2Small() {
+        roundTrip(BZipFileDevice::BZip2, 0, false);
+        roundTrip(BZipFileDevice::BZip2, 1000, false);
+        roundTrip(BZipFileDevice::BZip2, 0, true);
+        roundTrip(BZipFileDevice::BZip2, 1000, true);
+    }
+
+    void bzip2SingleStream() {
+        // Much more than one block, written by default as a single
+        // stream that any bzip2 reader can decode
+        roundTrip(BZipFileDevice::BZip2, 5 * 1000 * 1000 + 17, false);
+        QString path = m_dir.filePath("single-large.bz");
+        QByteArray data = makeData(2000000);
+        QVERIFY(writeFile(path, data, BZipFileDevice::BZip2, false));
+        QVERIFY(isSingleStream(path, data.size()));
+    }
+
+    void bzip2MultiStream() {
+        // Several blocks, compressed in parallel and read back as
+        // consecutive streams
+        roundTrip(BZipFileDevice::BZip2, 5 * 1000 * 1000 + 17, true);
+    }
+
+    void bzip2SingleStreamForSmallData() {
+        // Anything within one block should be readable by a
+        // single-stream bzip2 reader, even when compressed in
+        // parallel
+        QString path = m_dir.filePath("single.bz");
+        QByteArray data = makeData(100000);
+        QVERIFY(writeFile(path, data, BZipFileDevice::BZip2, true));
+
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QByteArray compressed = file.readAll();
+        QByteArray out(data.size() + 100, '\0');
+        unsigned int n = out.size();
+        QCOMPARE(BZ2_bzBuffToBuffDecompress(out.data(), &n,
+                                            compressed.data(),
+                                            compressed.size(), 0, 0),
+                 BZ_OK);
+        QCOMPARE(int(n), data.size());
+    }
+
+    void bzip2TrailingAndTruncated() {
+        QString path = m_dir.filePath("trailing.bz");
+        QByteArray data = makeData(2000000);
+        QVERIFY(writeFile(path, data, BZipFileDevice::BZip2, true));
+        {
+            QFile file(path);
+            QVERIFY(file.open(QIODevice::Append));
+            file.write("\n\n");
+        }
+        bool ok = false;
+        QVERIFY(readFile(path, &ok) == data);
+        QVERIFY(ok);
+
+        path = m_dir.filePath("truncated.bz");
+        QVERIFY(writeFile(path, data, BZipFileDevice::BZip2, true));
+        {
+            QFile file(path);
+            QVERIFY(file.resize(file.size() - 10));
+        }
+        readFile(path, &ok);
+        QVERIFY(!ok);
+    }
+
+    void zstd() {
+        if (!BZipFileDevice::isCodecSupported(BZipFileDevice::Zstd)) {
+            QSKIP("zstd not supported in this build");
+        }
+        roundTrip(BZipFileDevice::Zstd, 0, false);
+        roundTrip(BZipFileDevice::Zstd, 0, true);
+        roundTrip(BZipFileDevice::Zstd, 10 * 1000 * 1000 + 3, false);
+        roundTrip(BZipFileDevice::Zstd, 10 * 1000 * 1000 + 3, true);
+    }
+
+    void refuseUncompressed() {
+        QString path = m_dir.filePath("plain.xml");
+        {
+            QFile file(path);
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write("<?xml version=\"1.0\"?>\n<sv/>\n");
+        }
+        BZipFileDevice device(path);
+        QVERIFY(!device.open(QIODevice::ReadOnly));
+        QVERIFY(!device.isOK());
+    }
+};
+
+#endif
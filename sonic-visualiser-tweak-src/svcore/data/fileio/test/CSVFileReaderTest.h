@@ -0,0 +1,200 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_CSV_FILE_READER_H
+#define TEST_CSV_FILE_READER_H
+
+// Tests for reading CSV files into models, and for the tokeniser
+// that splits them up
+
+#include "../CSVFileReader.h"
+#include "../CSVTokeniser.h"
+
+#include "data/model/SparseTimeValueModel.h"
+#include "data/model/EditableDenseThreeDimensionalModel.h"
+
+#include "base/StringBits.h"
+#include "base/Debug.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QDir>
+#include <QTemporaryFile>
+
+#include <iostream>
+#include <memory>
+
+using namespace std;
+
+class CSVFileReaderTest : public QObject
+{
+    Q_OBJECT
+
+private:
+    QDir csvDir;
+
+    void compareSplit(QString text, QChar separator, bool quoting) {
+        QByteArray bytes = text.toUtf8();
+        CSVTokeniser tokeniser(separator, quoting);
+        tokeniser.tokenise(bytes.constData(), bytes.size());
+        QStringList lines = text.split(QRegExp("[\r\n]"),
+                                       QString::SkipEmptyParts);
+        QCOMPARE(tokeniser.getLineCount(), lines.size());
+        for (int li = 0; li < lines.size(); ++li) {
+            QStringList expected =
+                StringBits::split(lines[li], separator, quoting);
+            QCOMPARE(tokeniser.getFieldCount(li), expected.size());
+            for (int i = 0; i < expected.size(); ++i) {
+                QCOMPARE(tokeniser.getString(li, i), expected[i]);
+            }
+        }
+    }
+
+public:
+    CSVFileReaderTest(QString base) {
+        if (base == "") {
+            base = "svcore/data/fileio/test";
+        }
+        csvDir = QDir(base + "/csv");
+    }
+
+private slots:
+    void init() {
+        if (!csvDir.exists()) {
+            SVCERR << "ERROR: CSV test file directory \"" << csvDir.absolutePath() << "\" does not exist" << endl;
+            QVERIFY2(csvDir.exists(), "CSV test file directory not found");
+        }
+    }
+
+    void tokeniseAsStringBits() {
+        compareSplit("a,b,c\n1,,3\r\n\n,x,\r", ',', false);
+        compareSplit("a,b,c\n1,,3\r\n\n,x,\r", ',', true);
+        compareSplit("'a, b',\"c,d\",e\\,f\n\"unterminated,g\n'',x", ',', true);
+        compareSplit("  1  2\t3 \"four five\"  \n", ' ', true);
+        compareSplit("  1  2\t3  \n", ' ', false);
+        compareSplit("café au lait 2\n", ' ', true);
+        compareSplit("é|è||x\n", '|', true);
+        compareSplit("a§b§c\n", QChar(0xa7), true);
+    }
+
+    void tokeniseComments() {
+        QByteArray text("# comment, with, fields\n1,2\n#another\r3,4");
+        CSVTokeniser tokeniser(',', true);
+        tokeniser.tokenise(text.constData(), text.size());
+        QCOMPARE(tokeniser.getLineCount(), 2);
+        QCOMPARE(tokeniser.getString(1, 1), QString("4"));
+        QCOMPARE(tokeniser.getLine(0), QString("1,2"));
+    }
+
+    void parseNumbers() {
+        // Whatever the fast parser accepts, it must agree with Qt
+        QStringList numbers {
+            "0", "-0", "1", "-1", "0.1", "  2.5 ", "3.", ".3", "+3",
+            "1e10", "1E-10", "1.5e+3", "1e23", "1e-30", "0.000001",
+            "123456789012345", "12345678901234567890", "0.30000000000000004",
+            "nan", "inf", "1,5", "1.2.3", "", " ", "e5", "-", "9007199254740993"
+        };
+        for (QString n: numbers) {
+            QByteArray b = n.toUtf8();
+            double d = 0.0;
+            bool integral = false;
+            bool ok = false;
+            double expected = n.toDouble(&ok);
+            if (CSVTokeniser::parseNumber(b.constData(),
+                                          b.constData() + b.size(),
+                                          d, integral)) {
+                QVERIFY2(ok, b.constData());
+                QCOMPARE(d, expected);
+            }
+        }
+        double d = 0.0;
+        bool integral = false;
+        QByteArray b("-42");
+        QVERIFY(CSVTokeniser::parseNumber(b.constData(), b.constData() + 3,
+                                          d, integral));
+        QCOMPARE(d, -42.0);
+        QVERIFY(integral);
+    }
+
+    void readTimeValue() {
+        QString path = csvDir.filePath("model-type-2d-seconds.csv");
+        CSVFormat format(path);
+        CSVFileReader reader(path, format, 44100);
+        QVERIFY(reader.isOK());
+        unique_ptr<Model> model(reader.load());
+        auto stvm = dynamic_cast<SparseTimeValueModel *>(model.get());
+        QVERIFY(stvm);
+        EventVector events = stvm->getAllEvents();
+        QCOMPARE(int(events.size()), 5);
+        QCOMPARE(events[0].getFrame(), sv_frame_t(48510));
+        QCOMPARE(events[0].getValue(), 4.f);
+        QCOMPARE(events[4].getValue(), -2.3f);
+    }
+
+    void readThreeDimensional() {
+        QString path = csvDir.filePath("model-type-3d-samples.csv");
+        CSVFormat format(path);
+        CSVFileReader reader(path, format, 44100);
+        QVERIFY(reader.isOK());
+        unique_ptr<Model> model(reader.load());
+        auto m = dynamic_cast<EditableDenseThreeDimensionalModel *>
+            (model.get());
+        QVERIFY(m);
+        QCOMPARE(m->getWidth(), 6);
+        QCOMPARE(m->getHeight(), 6);
+        QCOMPARE(m->getColumn(0)[0], 143.f);
+        QCOMPARE(m->getColumn(5)[5], -0.3f);
+        QCOMPARE(m->getStartFrame(), sv_frame_t(22050));
+        QCOMPARE(m->getResolution(), 22050);
+    }
+
+    void readLargeInParallel() {
+        // Long enough to be split across threads, with CR line
+        // endings in one part and a comment in the middle
+        QTemporaryFile file(QDir::tempPath() + "/XXXXXX.csv");
+        QVERIFY(file.open());
+        const int n = 200000;
+        for (int i = 0; i < n; ++i) {
+            QByteArray line = QByteArray::number(i * 0.01, 'f', 2) + "," +
+                QByteArray::number(i % 100) +
+                (i > n/2 ? "\r" : "\n");
+            file.write(line);
+            if (i == n/3) file.write("# comment\n");
+        }
+        file.close();
+
+        CSVFormat format;
+        format.setSeparator(',');
+        format.setModelType(CSVFormat::TwoDimensionalModel);
+        format.setTimingType(CSVFormat::ExplicitTiming);
+        format.setTimeUnits(CSVFormat::TimeSeconds);
+        format.setColumnCount(2);
+        format.setColumnPurpose(0, CSVFormat::ColumnStartTime);
+        format.setColumnPurpose(1, CSVFormat::ColumnValue);
+
+        CSVFileReader reader(file.fileName(), format, 100);
+        QVERIFY(reader.isOK());
+        unique_ptr<Model> model(reader.load());
+        auto stvm = dynamic_cast<SparseTimeValueModel *>(model.get());
+        QVERIFY(stvm);
+        EventVector events = stvm->getAllEvents();
+        QCOMPARE(int(events.size()), n);
+        for (int i = 0; i < n; i += 997) {
+            QCOMPARE(events[i].getFrame(), sv_frame_t(i));
+            QCOMPARE(events[i].getValue(), float(i % 100));
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,217 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_DECODE_CACHE_H
+#define TEST_DECODE_CACHE_H
+
+#include "../DecodeCache.h"
+
+#include "base/CacheDirectory.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QUuid>
+#include <QTemporaryFile>
+
+#include <vector>
+#include <cmath>
+
+using namespace std;
+
+class DecodeCacheTest : public QObject
+{
+    Q_OBJECT
+
+    QString m_key;
+
+    vector<float> makeAudio(int channels, sv_frame_t frames) {
+        vector<float> audio(frames * channels);
+        for (sv_frame_t i = 0; i < frames; ++i) {
+            for (int c = 0; c < channels; ++c) {
+                audio[i * channels + c] = float(sin(double(i) / (c + 3)));
+            }
+        }
+        return audio;
+    }
+
+    DecodeCache::Metadata makeMetadata(int channels, sv_frame_t frames) {
+        DecodeCache::Metadata md;
+        md.channels = channels;
+        md.sampleRate = 44100;
+        md.fileRate = 48000;
+        md.frameCount = frames;
+        md.fileFrameCount = 1234;
+        md.max = 0.5f;
+        md.gain = 2.f;
+        md.trimFromStart = 529;
+        md.trimFromEnd = 100;
+        md.clippedCount = 7;
+        md.firstNonzero = 1;
+        md.lastNonzero = frames - 1;
+        return md;
+    }
+
+private slots:
+    void init() {
+        m_key = QString::fromLatin1
+            (QUuid::createUuid().toRfc4122().toHex()) + ".svdec";
+    }
+
+    void cleanup() {
+        DecodeCache::getCacheDirectory().remove(m_key);
+    }
+
+    void missing() {
+        DecodeCache::Reader reader(m_key);
+        QVERIFY(!reader.isOK());
+    }
+
+    void roundTrip() {
+        const int channels = 2;
+        const sv_frame_t frames = 10000;
+        auto audio = makeAudio(channels, frames);
+        {
+            DecodeCache::Writer writer(m_key, channels);
+            QVERIFY(writer.isOK());
+            // write in uneven pieces
+            QVERIFY(writer.write(audio.data(), 3333));
+            QVERIFY(writer.write(audio.data() + 3333 * channels,
+                                 frames - 3333));
+            QVERIFY(writer.commit(makeMetadata(channels, frames)));
+        }
+
+        DecodeCache::Reader reader(m_key);
+        QVERIFY(reader.isOK());
+
+        const auto &md = reader.getMetadata();
+        QCOMPARE(md.channels, channels);
+        QCOMPARE(md.sampleRate, 44100.0);
+        QCOMPARE(md.fileRate, 48000.0);
+        QCOMPARE(md.frameCount, frames);
+        QCOMPARE(md.fileFrameCount, sv_frame_t(1234));
+        QCOMPARE(md.max, 0.5f);
+        QCOMPARE(md.gain, 2.f);
+        QCOMPARE(md.trimFromStart, sv_frame_t(529));
+        QCOMPARE(md.trimFromEnd, sv_frame_t(100));
+        QCOMPARE(md.clippedCount, sv_frame_t(7));
+
+        // A request running off the end is truncated
+        vector<float> buffer(200 * channels, -9.f);
+        QCOMPARE(reader.getInterleavedFrames(frames - 100, 200,
+                                             buffer.data()),
+                 sv_frame_t(100));
+        for (int i = 0; i < 100 * channels; ++i) {
+            QCOMPARE(buffer[i], audio[(frames - 100) * channels + i]);
+        }
+        QCOMPARE(buffer[100 * channels], -9.f);
+
+        QCOMPARE(reader.getInterleavedFrames(frames, 10, buffer.data()),
+                 sv_frame_t(0));
+    }
+
+    void mismatchedCommit() {
+        auto audio = makeAudio(1, 100);
+        DecodeCache::Writer writer(m_key, 1);
+        QVERIFY(writer.write(audio.data(), 100));
+        QVERIFY(!writer.commit(makeMetadata(1, 101)));
+        DecodeCache::Reader reader(m_key);
+        QVERIFY(!reader.isOK());
+    }
+
+    void abandoned() {
+        auto audio = makeAudio(1, 100);
+        {
+            DecodeCache::Writer writer(m_key, 1);
+            QVERIFY(writer.write(audio.data(), 100));
+        }
+        DecodeCache::Reader reader(m_key);
+        QVERIFY(!reader.isOK());
+    }
+
+    void corrupt() {
+        QFile file(DecodeCache::getCacheDirectory().getFilePath(m_key));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.write(QByteArray(200, 'x'));
+        file.close();
+        DecodeCache::Reader reader(m_key);
+        QVERIFY(!reader.isOK());
+        QVERIFY(!file.exists());
+    }
+
+    void keyDependsOnParams() {
+        QTemporaryFile file;
+        QVERIFY(file.open());
+        file.write(QByteArray(3000000, 'a'));
+        file.close();
+        QString a = DecodeCache::makeKey(file.fileName(), "x:44100:0");
+        QString b = DecodeCache::makeKey(file.fileName(), "x:48000:0");
+        QVERIFY(a != "");
+        QVERIFY(a != b);
+        QCOMPARE(DecodeCache::makeKey(file.fileName(), "x:44100:0"), a);
+        QCOMPARE(DecodeCache::makeKey("/no/such/file", "x"), QString());
+    }
+
+    void keyDependsOnFile() {
+        QTemporaryFile file1, file2;
+        QVERIFY(file1.open());
+        QVERIFY(file2.open());
+        file1.write(QByteArray(3000000, 'a'));
+        file2.write(QByteArray(3000000, 'a'));
+        file1.close();
+        file2.close();
+        QString a = DecodeCache::makeKey(file1.fileName(), "x");
+        QVERIFY(a != "");
+        QVERIFY(DecodeCache::makeKey(file2.fileName(), "x") != a);
+
+        // A change near the end, beyond the start of the file, is
+        // caught even if the modification time does not change
+        QVERIFY(file1.open());
+        QVERIFY(file1.seek(2999999));
+        file1.write("b");
+        file1.close();
+        QVERIFY(DecodeCache::makeKey(file1.fileName(), "x") != a);
+    }
+
+    void commitOverExisting() {
+        auto audio = makeAudio(1, 100);
+        {
+            DecodeCache::Writer writer(m_key, 1);
+            QVERIFY(writer.write(audio.data(), 100));
+            QVERIFY(writer.commit(makeMetadata(1, 100)));
+        }
+
+        // A second writer commits the same key while a reader has
+        // the first entry mapped
+        DecodeCache::Reader first(m_key);
+        QVERIFY(first.isOK());
+        {
+            DecodeCache::Writer writer(m_key, 1);
+            QVERIFY(writer.write(audio.data(), 100));
+            QVERIFY(writer.commit(makeMetadata(1, 100)));
+        }
+
+        vector<float> buffer(100);
+        QCOMPARE(first.getInterleavedFrames(0, 100, buffer.data()),
+                 sv_frame_t(100));
+        for (int i = 0; i < 100; ++i) {
+            QCOMPARE(buffer[i], audio[i]);
+        }
+
+        DecodeCache::Reader second(m_key);
+        QVERIFY(second.isOK());
+        QCOMPARE(second.getMetadata().frameCount, sv_frame_t(100));
+    }
+};
+
+#endif
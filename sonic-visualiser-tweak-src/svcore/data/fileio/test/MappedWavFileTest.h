@@ -0,0 +1,214 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_MAPPED_WAV_FILE_H
+#define TEST_MAPPED_WAV_FILE_H
+
+#include "../MappedWavFile.h"
+#include "../WavFileReader.h"
+
+#include <sndfile.h>
+
+#include <QObject>
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QtEndian>
+
+#include <vector>
+#include <cmath>
+
+using namespace std;
+
+// Check that reading through a memory mapping gives exactly the
+// same samples as reading through libsndfile, for each of the
+// formats we map
+
+class MappedWavFileTest : public QObject
+{
+    Q_OBJECT
+
+    QTemporaryDir m_dir;
+
+    QString write(QString name, int format, int channels, sv_frame_t frames) {
+        QString path = m_dir.filePath(name);
+        SF_INFO info;
+        memset(&info, 0, sizeof(info));
+        info.samplerate = 44100;
+        info.channels = channels;
+        info.format = format;
+        SNDFILE *file = sf_open(path.toLocal8Bit().data(), SFM_WRITE, &info);
+        if (!file) return {};
+        vector<float> data(frames * channels);
+        for (sv_frame_t i = 0; i < frames; ++i) {
+            for (int c = 0; c < channels; ++c) {
+                data[i * channels + c] =
+                    float(0.9 * sin(double(i) / (c + 2)));
+            }
+        }
+        sf_writef_float(file, data.data(), frames);
+        sf_close(file);
+        return path;
+    }
+
+    void compare(QString path, int channels, sv_frame_t frames) {
+
+        MappedWavFile mapped(path);
+        QVERIFY(mapped.isOK());
+        QCOMPARE(mapped.getChannelCount(), channels);
+        QCOMPARE(mapped.getSampleRate(), 44100.0);
+        QCOMPARE(mapped.getFrameCount(), frames);
+
+        SF_INFO info;
+        memset(&info, 0, sizeof(info));
+        SNDFILE *file = sf_open(path.toLocal8Bit().data(), SFM_READ, &info);
+        QVERIFY(file);
+        vector<float> expected(frames * channels);
+        QCOMPARE(sv_frame_t(sf_readf_float(file, expected.data(), frames)),
+                 frames);
+        sf_close(file);
+
+        // Read from an offset and past the end
+        sv_frame_t offset = 17;
+        vector<float> obtained((frames - offset) * channels + 10, -9.f);
+        QCOMPARE(mapped.getInterleavedFrames(offset, frames, obtained.data()),
+                 frames - offset);
+        for (sv_frame_t i = 0; i < (frames - offset) * channels; ++i) {
+            QCOMPARE(obtained[i], expected[offset * channels + i]);
+        }
+        QCOMPARE(obtained[(frames - offset) * channels], -9.f);
+    }
+
+    QString writeBytes(QString name, QByteArray contents) {
+        QString path = m_dir.filePath(name);
+        QFile file(path);
+        if (!file.open(QIODevice::WriteOnly)) return {};
+        file.write(contents);
+        return path;
+    }
+
+    static QByteArray withSize(QByteArray contents, int chunkOffset,
+                               quint64 size) {
+        // Wave64 chunk size follows the 16-byte chunk GUID
+        qToLittleEndian<quint64>
+            (size, reinterpret_cast<uchar *>(contents.data() +
+                                             chunkOffset + 16));
+        return contents;
+    }
+
+private slots:
+    void formats_data() {
+        QTest::addColumn<int>("format");
+        QTest::addColumn<int>("channels");
+        QTest::newRow("wav-u8") << int(SF_FORMAT_WAV | SF_FORMAT_PCM_U8) << 1;
+        QTest::newRow("wav-16") << int(SF_FORMAT_WAV | SF_FORMAT_PCM_16) << 2;
+        QTest::newRow("wav-24") << int(SF_FORMAT_WAV | SF_FORMAT_PCM_24) << 3;
+        QTest::newRow("wav-32") << int(SF_FORMAT_WAV | SF_FORMAT_PCM_32) << 2;
+        QTest::newRow("wav-float") << int(SF_FORMAT_WAV | SF_FORMAT_FLOAT) << 2;
+        QTest::newRow("w64-float") << int(SF_FORMAT_W64 | SF_FORMAT_FLOAT) << 2;
+        QTest::newRow("w64-16") << int(SF_FORMAT_W64 | SF_FORMAT_PCM_16) << 1;
+        QTest::newRow("rf64-24") << int(SF_FORMAT_RF64 | SF_FORMAT_PCM_24) << 2;
+        // more than two channels is written as WAVE_FORMAT_EXTENSIBLE
+        QTest::newRow("wavex-16") << int(SF_FORMAT_WAVEX | SF_FORMAT_PCM_16) << 6;
+    }
+
+    void formats() {
+        QFETCH(int, format);
+        QFETCH(int, channels);
+        const sv_frame_t frames = 10001;
+        QString path = write(QTest::currentDataTag(), format, channels, frames);
+        QVERIFY(path != "");
+        compare(path, channels, frames);
+    }
+
+    void unmappable() {
+        // ADPCM and doubles are left to libsndfile
+        QString path = write("adpcm", SF_FORMAT_WAV | SF_FORMAT_IMA_ADPCM,
+                             1, 1000);
+        QVERIFY(path != "");
+        QVERIFY(!MappedWavFile(path).isOK());
+        path = write("double", SF_FORMAT_WAV | SF_FORMAT_DOUBLE, 1, 1000);
+        QVERIFY(path != "");
+        QVERIFY(!MappedWavFile(path).isOK());
+        path = write("aiff", SF_FORMAT_AIFF | SF_FORMAT_PCM_16, 1, 1000);
+        QVERIFY(path != "");
+        QVERIFY(!MappedWavFile(path).isOK());
+    }
+
+    void corruptWave64() {
+        const sv_frame_t frames = 1000;
+        QString path = write("w64-good", SF_FORMAT_W64 | SF_FORMAT_PCM_16,
+                             1, frames);
+        QVERIFY(path != "");
+        QFile file(path);
+        QVERIFY(file.open(QIODevice::ReadOnly));
+        QByteArray good = file.readAll();
+        file.close();
+
+        // Chunks follow the 40-byte header, fmt first
+        int fmt = 40;
+        QCOMPARE(good.mid(fmt, 4), QByteArray("fmt "));
+        int data = good.indexOf("data", fmt);
+        QVERIFY(data > fmt);
+
+        // Chunk sizes that run past the end of the file, or wrap
+        // when added to the offset
+        path = writeBytes("w64-huge-fmt",
+                          withSize(good, fmt, 0x7ffffffffffffff0ULL));
+        QVERIFY(!MappedWavFile(path).isOK());
+        path = writeBytes("w64-negative-fmt",
+                          withSize(good, fmt, 0xffffffffffffffffULL));
+        QVERIFY(!MappedWavFile(path).isOK());
+
+        // Truncated within the fmt chunk
+        path = writeBytes("w64-truncated-fmt", good.left(fmt + 30));
+        QVERIFY(!MappedWavFile(path).isOK());
+
+        // A data chunk claiming more than the file has, or truncated
+        // part way through, gives the frames that are there
+        path = writeBytes("w64-huge-data",
+                          withSize(good, data, 0x7fffffffffffffffULL));
+        MappedWavFile hugeData(path);
+        QVERIFY(hugeData.isOK());
+        QCOMPARE(hugeData.getFrameCount(), frames);
+
+        path = writeBytes("w64-truncated-data",
+                          good.left(data + 24 + 500 * 2));
+        MappedWavFile truncatedData(path);
+        QVERIFY(truncatedData.isOK());
+        QCOMPARE(truncatedData.getFrameCount(), sv_frame_t(500));
+    }
+
+    void reader() {
+        QString path = write("reader", SF_FORMAT_WAV | SF_FORMAT_PCM_16,
+                             2, 5000);
+        WavFileReader reader(path);
+        QVERIFY(reader.isOK());
+        QVERIFY(reader.isMapped());
+        vector<float> buffer(100 * 2);
+        QCOMPARE(reader.readInterleavedFrames(4950, 100, buffer.data()),
+                 sv_frame_t(50));
+        auto frames = reader.getInterleavedFrames(4950, 100);
+        QCOMPARE(sv_frame_t(frames.size()), sv_frame_t(100));
+        for (int i = 0; i < 100; ++i) {
+            QCOMPARE(buffer[i], frames[i]);
+        }
+
+        WavFileReader updating(path, true);
+        QVERIFY(!updating.isMapped());
+        updating.updateDone();
+        QVERIFY(updating.isMapped());
+    }
+};
+
+#endif
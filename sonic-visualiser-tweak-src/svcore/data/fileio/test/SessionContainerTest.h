@@ -0,0 +1,139 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_SESSION_CONTAINER_H
+#define TEST_SESSION_CONTAINER_H
+
+#include "../SessionContainer.h"
+
+#include "data/model/EditableDenseThreeDimensionalModel.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+using namespace std;
+
+class SessionContainerTest : public QObject
+{
+    Q_OBJECT
+
+    QTemporaryDir m_dir;
+
+private slots:
+    void roundTrip() {
+
+        QString path = m_dir.filePath("session.sv");
+        QByteArray manifest("<?xml version=\"1.0\"?><sv/>");
+        QByteArray first("abc");
+        QByteArray second(1000, 'x');
+
+        SessionContainerWriter writer(path);
+        QVERIFY(writer.isOK());
+        QCOMPARE(writer.addBlob(first, "first"), 0);
+        QCOMPARE(writer.addBlob(QByteArray(), {}), 1);
+        QCOMPARE(writer.addBlob(second, {}), 2);
+        QCOMPARE(writer.findBlob("first"), 0);
+        QCOMPARE(writer.findBlob("second"), -1);
+        QCOMPARE(writer.addBlob(first, "first"), 0);
+        QVERIFY(writer.finish(manifest));
+
+        QVERIFY(SessionContainerReader::isSessionContainer(path));
+
+        SessionContainerReader reader(path);
+        QVERIFY(reader.isOK());
+        QCOMPARE(reader.getManifest(), manifest);
+        QCOMPARE(reader.getBlobCount(), 3);
+
+        const char *data = nullptr;
+        qint64 size = 0;
+        QVERIFY(reader.getBlob(0, data, size));
+        QCOMPARE(QByteArray(data, int(size)), first);
+        QCOMPARE(quintptr(data) % 8, quintptr(0));
+        QVERIFY(reader.getBlob(1, data, size));
+        QCOMPARE(size, qint64(0));
+        QVERIFY(reader.getBlob(2, data, size));
+        QCOMPARE(QByteArray(data, int(size)), second);
+        QVERIFY(!reader.getBlob(3, data, size));
+    }
+
+    void refuseOthers() {
+
+        QString path = m_dir.filePath("plain.sv");
+        {
+            QFile file(path);
+            QVERIFY(file.open(QIODevice::WriteOnly));
+            file.write("BZh91AY&SY not a container");
+        }
+        QVERIFY(!SessionContainerReader::isSessionContainer(path));
+        QVERIFY(!SessionContainerReader(path).isOK());
+
+        // A container whose end has been lost
+        QString truncated = m_dir.filePath("truncated.sv");
+        {
+            SessionContainerWriter writer(truncated);
+            writer.addBlob(QByteArray(100, 'y'), {});
+            QVERIFY(writer.finish("<sv/>"));
+        }
+        {
+            QFile file(truncated);
+            QVERIFY(file.resize(file.size() - 8));
+        }
+        QVERIFY(SessionContainerReader::isSessionContainer(truncated));
+        QVERIFY(!SessionContainerReader(truncated).isOK());
+    }
+
+    void denseModel() {
+
+        EditableDenseThreeDimensionalModel model(100, 10, 3);
+        model.setColumn(0, { 1.f, 2.f, 3.f });
+        model.setColumn(1, { -1.f, 0.5f });
+        model.setColumn(3, { 7.f, 8.f, 9.f });
+
+        QString path = m_dir.filePath("dense.sv");
+        SessionContainerWriter writer(path);
+        QString xml;
+        {
+            QTextStream out(&xml);
+            XmlExportable::BlobSink *previous =
+                XmlExportable::setBlobSink(&writer);
+            model.toXml(out);
+            XmlExportable::setBlobSink(previous);
+        }
+        QVERIFY(writer.finish(xml.toUtf8()));
+        QVERIFY(xml.contains("blob=\"0\""));
+        QVERIFY(!xml.contains("<row"));
+
+        SessionContainerReader reader(path);
+        const char *data = nullptr;
+        qint64 size = 0;
+        QVERIFY(reader.getBlob(0, data, size));
+
+        EditableDenseThreeDimensionalModel copy(100, 10, 3);
+        QVERIFY(copy.setColumnsFromBlob({}, data, size));
+        QCOMPARE(copy.getWidth(), 4);
+        for (int i = 0; i < 4; ++i) {
+            QCOMPARE(copy.getColumn(i), model.getColumn(i));
+        }
+        QCOMPARE(copy.getMinimumLevel(), -1.f);
+        QCOMPARE(copy.getMaximumLevel(), 9.f);
+
+        EditableDenseThreeDimensionalModel bad(100, 10, 3);
+        QVERIFY(!bad.setColumnsFromBlob({}, data, size - 4));
+        QCOMPARE(bad.getWidth(), 0);
+    }
+};
+
+#endif
@@ -6,10 +6,15 @@ TEST_HEADERS += \
 	BogusAudioFileReaderTest.h \
 	AudioFileWriterTest.h \
 	AudioTestData.h \
+	DecodeCacheTest.h \
+	MappedWavFileTest.h \
 	EncodingTest.h \
 	MIDIFileReaderTest.h \
 	CSVFormatTest.h \
-	CSVStreamWriterTest.h
+	CSVFileReaderTest.h \
+	CSVStreamWriterTest.h \
+	SessionContainerTest.h \
+	BZipFileDeviceTest.h
      
 TEST_SOURCES += \
 	../../model/test/MockWaveModel.cpp \
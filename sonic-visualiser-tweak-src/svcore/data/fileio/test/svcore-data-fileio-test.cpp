@@ -15,10 +15,15 @@
 #include "AudioFileReaderTest.h"
 #include "BogusAudioFileReaderTest.h"
 #include "AudioFileWriterTest.h"
+#include "DecodeCacheTest.h"
+#include "MappedWavFileTest.h"
 #include "EncodingTest.h"
 #include "MIDIFileReaderTest.h"
 #include "CSVFormatTest.h"
+#include "CSVFileReaderTest.h"
 #include "CSVStreamWriterTest.h"
+#include "SessionContainerTest.h"
+#include "BZipFileDeviceTest.h"
 
 #include "system/Init.h"
 
@@ -65,6 +70,18 @@ int main(int argc, char *argv[])
         else ++bad;
     }
 
+    {
+        MappedWavFileTest t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+
+    {
+        DecodeCacheTest t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+
     {
         BogusAudioFileReaderTest t;
         if (QTest::qExec(&t, argc, argv) == 0) ++good;
@@ -89,12 +106,30 @@ int main(int argc, char *argv[])
         else ++bad;
     }
 
+    {
+        CSVFileReaderTest t(testDir);
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+
     {
         CSVStreamWriterTest t;
         if (QTest::qExec(&t, argc, argv) == 0) ++good;
         else ++bad;
     }
 
+    {
+        SessionContainerTest t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+
+    {
+        BZipFileDeviceTest t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+
     if (bad > 0) {
         SVCERR << "\n********* " << bad << " test suite(s) failed!\n" << endl;
         return 1;
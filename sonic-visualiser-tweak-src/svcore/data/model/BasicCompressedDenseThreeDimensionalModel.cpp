@@ -166,6 +166,25 @@ BasicCompressedDenseThreeDimensionalModel::truncateAndStore(int index,
 
     //cout << "truncateAndStore(" << index << ", " << values.size() << ")" << endl;
 
+    // Maximum distance between a column and the one we refer to as
+    // the source of its truncated values.  Limited by having to fit
+    // in a signed char, but in any case small values are usually
+    // better
+    static int maxdist = 6;
+
+    // Any later column that was truncated against this one can no
+    // longer be expanded from it once it changes, so store that
+    // column whole first. This only happens when columns are set out
+    // of order, or replaced
+    for (int k = index + 1; k <= index + maxdist; ++k) {
+        if (!in_range_for(m_data, k)) break;
+        int trunc = m_trunc[k];
+        if (trunc != 0 && k - std::abs(trunc) == index) {
+            m_data[k] = expandAndRetrieve(k);
+            m_trunc[k] = 0;
+        }
+    }
+
     // The default case is to store the entire column at m_data[index]
     // and place 0 at m_trunc[index] to indicate that it has not been
     // truncated.  We only do clever stuff if one of the clever-stuff
@@ -180,12 +199,6 @@ BasicCompressedDenseThreeDimensionalModel::truncateAndStore(int index,
         return;
     }
 
-    // Maximum distance between a column and the one we refer to as
-    // the source of its truncated values.  Limited by having to fit
-    // in a signed char, but in any case small values are usually
-    // better
-    static int maxdist = 6;
-
     bool known = false; // do we know whether to truncate at top or bottom?
     bool top = false;   // if we do know, will we truncate at top?
 
@@ -207,6 +220,14 @@ BasicCompressedDenseThreeDimensionalModel::truncateAndStore(int index,
         tdist = ptrunc + 1;
     }
 
+    // A column that has not been set yet (because columns are
+    // arriving out of order) would expand to zeros, and must not be
+    // compared against, as it will not stay that way
+    if (m_data[index - tdist].empty()) {
+        m_data[index] = values;
+        return;
+    }
+
     Column p = expandAndRetrieve(index - tdist);
     int h = m_yBinCount;
 
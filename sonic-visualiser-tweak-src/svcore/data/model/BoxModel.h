@@ -102,8 +102,16 @@ public:
         UnitDatabase::getInstance()->registerUnit(units);
     }
 
-    float getValueMinimum() const { return m_valueMinimum; }
-    float getValueMaximum() const { return m_valueMaximum; }
+    // These depend on the events, so decode any that are still in a
+    // blob (see setEventsFromBlob)
+    float getValueMinimum() const {
+        m_events.decodeDeferred();
+        return m_valueMinimum;
+    }
+    float getValueMaximum() const {
+        m_events.decodeDeferred();
+        return m_valueMaximum;
+    }
     
     int getCompletion() const override { return m_completion; }
 
@@ -175,25 +183,27 @@ public:
         {
             QMutexLocker locker(&m_mutex);
             m_events.add(e);
-
-            float f0 = e.getValue();
-            float f1 = f0 + fabsf(e.getLevel());
-            
-            if (!m_haveExtents || f0 < m_valueMinimum) {
-                m_valueMinimum = f0; allChange = true;
-            }
-            if (!m_haveExtents || f1 > m_valueMaximum) {
-                m_valueMaximum = f1; allChange = true;
-            }
-            m_haveExtents = true;
+            allChange = updateExtents(e);
         }
-        
+
         m_notifier.update(e.getFrame(), e.getDuration() + m_resolution);
 
         if (allChange) {
             emit modelChanged(getId());
         }
     }
+
+    bool setEventsFromBlob(std::shared_ptr<const void> owner,
+                           const char *data, qint64 size) override {
+        if (!m_events.setFromBlob(owner, data, size,
+                                  [this](const Event &e) {
+                                      updateExtents(e);
+                                  })) {
+            return false;
+        }
+        emit modelChanged(getId());
+        return true;
+    }
     
     void remove(Event e) override {
         {
@@ -383,6 +393,28 @@ public:
     }
 
 protected:
+    // Take account of a new event in the extents, returning true if
+    // they have changed. Called from add() with m_mutex held, and
+    // also while m_events decodes a blob, when m_mutex must not be
+    // taken as add() takes it before the lock in m_events
+    bool updateExtents(const Event &e) {
+
+        bool allChange = false;
+
+        float f0 = e.getValue();
+        float f1 = f0 + fabsf(e.getLevel());
+
+        if (!m_haveExtents || f0 < m_valueMinimum) {
+            m_valueMinimum = f0; allChange = true;
+        }
+        if (!m_haveExtents || f1 > m_valueMaximum) {
+            m_valueMaximum = f1; allChange = true;
+        }
+        m_haveExtents = true;
+
+        return allChange;
+    }
+
     sv_samplerate_t m_sampleRate;
     int m_resolution;
 
@@ -23,7 +23,13 @@ Dense3DModelPeakCache::Dense3DModelPeakCache(ModelId sourceId,
                                              int columnsPerPeak) :
     m_source(sourceId),
     m_columnsPerPeak(columnsPerPeak),
-    m_finalColumnIncomplete(false)
+    m_finalColumnIncomplete(false),
+    m_bytes(0),
+    // Each peak column is made from columnsPerPeak source columns
+    m_account("Dense3DModelPeakCache",
+              columnsPerPeak > 1 ? MemoryBudget::Expensive :
+              MemoryBudget::Moderate,
+              [this]() { releaseColumns(); })
 {
     auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
     if (!source) {
@@ -43,20 +49,29 @@ Dense3DModelPeakCache::~Dense3DModelPeakCache()
 Dense3DModelPeakCache::Column
 Dense3DModelPeakCache::getColumn(int column) const
 {
-    if (!haveColumn(column)) fillColumn(column);
-    return m_cache.at(column);
+    m_account.touch();
+    {
+        QMutexLocker locker(&m_mutex);
+        if (haveColumn(column)) return m_cache.at(column);
+    }
+    return fillColumn(column);
 }
 
 float
 Dense3DModelPeakCache::getValueAt(int column, int n) const
 {
-    if (!haveColumn(column)) fillColumn(column);
-    return m_cache.at(column).at(n);
+    {
+        QMutexLocker locker(&m_mutex);
+        if (haveColumn(column)) return m_cache.at(column).at(n);
+    }
+    return fillColumn(column).at(n);
 }
 
 void
 Dense3DModelPeakCache::sourceModelChanged(ModelId)
 {
+    QMutexLocker locker(&m_mutex);
+    
     if (m_finalColumnIncomplete && m_coverage.size() > 0) {
         // The last peak came from an incomplete read, which may since
         // have been filled, so reset it
@@ -65,6 +80,23 @@ Dense3DModelPeakCache::sourceModelChanged(ModelId)
     }
 }
 
+void
+Dense3DModelPeakCache::releaseColumns()
+{
+    // Called by the memory budget, possibly while another thread is
+    // filling a column on this cache; if so, leave it alone
+    if (!m_mutex.tryLock()) return;
+
+    std::vector<std::vector<float>>().swap(m_cache);
+    std::vector<bool>().swap(m_coverage);
+    m_finalColumnIncomplete = false;
+    m_bytes = 0;
+
+    m_mutex.unlock();
+
+    m_account.setBytes(0);
+}
+
 bool
 Dense3DModelPeakCache::haveColumn(int column) const
 {
@@ -78,11 +110,46 @@ Dense3DModelPeakCache::haveColumn(int column) const
     }
 }
 
-void
+Dense3DModelPeakCache::Column
 Dense3DModelPeakCache::fillColumn(int column) const
 {
     Profiler profiler("Dense3DModelPeakCache::fillColumn");
 
+    // The peak is calculated without the mutex held, so that other
+    // threads can meanwhile retrieve (or calculate) other columns. If
+    // two threads happen to calculate the same column, they will
+    // obtain the same result and it doesn't matter which is stored.
+
+    Column peak;
+    bool incomplete = false;
+    
+    auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
+    int sourceWidth = (source ? source->getWidth() : 0);
+    int sourceColumn = column * m_columnsPerPeak;
+
+    if (source && sourceColumn < sourceWidth) {
+
+        peak = source->getColumn(sourceColumn);
+        int n = int(peak.size());
+    
+        for (int i = 1; i < m_columnsPerPeak; ++i) {
+
+            ++sourceColumn;
+            if (sourceColumn >= sourceWidth) {
+                incomplete = true;
+                break;
+            }
+        
+            Column here = source->getColumn(sourceColumn);
+            int m = std::min(n, int(here.size()));
+            for (int j = 0; j < m; ++j) {
+                peak[j] = std::max(here[j], peak[j]);
+            }
+        }
+    }
+
+    QMutexLocker locker(&m_mutex);
+    
     if (!in_range_for(m_coverage, column)) {
         if (m_finalColumnIncomplete && m_coverage.size() > 0) {
             // The last peak may have come from an incomplete read, which
@@ -93,38 +160,26 @@ Dense3DModelPeakCache::fillColumn(int column) const
         m_coverage.resize(column + 1, false);
         m_cache.resize(column + 1, {});
     }
-    
-    auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
-    if (!source) {
-        return;
-    }
-    
-    int sourceWidth = source->getWidth();
-    int sourceColumn = column * m_columnsPerPeak;
-    if (sourceColumn >= sourceWidth) {
-        return;
-    }
 
-    Column peak = source->getColumn(sourceColumn);
-    int n = int(peak.size());
-    
-    for (int i = 1; i < m_columnsPerPeak; ++i) {
+    if (!source || column * m_columnsPerPeak >= sourceWidth) {
+        return peak;
+    }
 
-        ++sourceColumn;
-        if (sourceColumn >= sourceWidth) {
-            m_finalColumnIncomplete = true;
-            break;
-        }
-        
-        Column here = source->getColumn(sourceColumn);
-        int m = std::min(n, int(here.size()));
-        for (int j = 0; j < m; ++j) {
-            peak[j] = std::max(here[j], peak[j]);
-        }
+    if (incomplete) {
+        m_finalColumnIncomplete = true;
     }
 
+    m_bytes -= m_cache[column].size() * sizeof(float);
+    m_bytes += peak.size() * sizeof(float);
+    
     m_cache[column] = peak;
     m_coverage[column] = true;
-}
 
+    // Account outside the lock, as this may cause other caches to be
+    // released
+    size_t bytes = m_bytes;
+    locker.unlock();
+    m_account.setBytes(bytes);
 
+    return peak;
+}
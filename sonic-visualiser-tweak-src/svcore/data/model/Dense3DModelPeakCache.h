@@ -19,6 +19,10 @@
 #include "DenseThreeDimensionalModel.h"
 #include "EditableDenseThreeDimensionalModel.h"
 
+#include "base/MemoryBudget.h"
+
+#include <QMutex>
+
 /**
  * A DenseThreeDimensionalModel that represents a reduction in the
  * time dimension of another DenseThreeDimensionalModel. Each column
@@ -26,7 +30,13 @@
  * the source. Each column is populated from the source model when
  * first requested, and is returned from cache on subsequent requests.
  *
- * Dense3DModelPeakCache is not thread-safe.
+ * Dense3DModelPeakCache is thread-safe, but supports concurrent
+ * reads (in the sense of supportsConcurrentReads()) only if its
+ * source model does.
+ *
+ * The cached columns are accounted with the MemoryBudget, which may
+ * discard them all when memory is short, after which they are
+ * recalculated as requested.
  */
 class Dense3DModelPeakCache : public DenseThreeDimensionalModel
 {
@@ -114,6 +124,11 @@ public:
 
     QString getTypeName() const override { return tr("Dense 3-D Peak Cache"); }
 
+    bool supportsConcurrentReads() const override {
+        auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
+        return source ? source->supportsConcurrentReads() : false;
+    }
+
     int getCompletion() const override {
         auto source = ModelById::get(m_source);
         return source ? source->getCompletion() : 100;
@@ -135,9 +150,13 @@ private:
     mutable std::vector<bool> m_coverage; // bool for space efficiency
                                           // (vector of bool is a bitmap)
     mutable bool m_finalColumnIncomplete;
+    mutable size_t m_bytes;
+    mutable QMutex m_mutex;
+    mutable MemoryBudget::Account m_account;
 
-    bool haveColumn(int column) const;
-    void fillColumn(int column) const;
+    bool haveColumn(int column) const; // call with m_mutex held
+    Column fillColumn(int column) const;
+    void releaseColumns();
 };
 
 
@@ -0,0 +1,316 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "Dense3DModelRangeIndex.h"
+
+#include "base/Profiler.h"
+
+#include <algorithm>
+
+Dense3DModelRangeIndex::Dense3DModelRangeIndex(ModelId sourceId,
+                                               int columnsPerBlock) :
+    m_source(sourceId),
+    m_columnsPerBlock(std::max(columnsPerBlock, 1)),
+    m_height(0),
+    m_blocks(0),
+    // Rebuilding means reading every column of the source
+    m_account("Dense3DModelRangeIndex", MemoryBudget::Expensive,
+              [this]() { release(); })
+{
+    auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
+    if (!source) {
+        SVCERR << "WARNING: Dense3DModelRangeIndex constructed for unknown or wrong-type source model id " << m_source << endl;
+        m_source = {};
+        return;
+    }
+
+    m_height = source->getHeight();
+    m_sums.resize(m_height, 0.0);
+
+    connect(source.get(), SIGNAL(modelChanged(ModelId)),
+            this, SLOT(sourceModelChanged(ModelId)));
+    connect(source.get(),
+            SIGNAL(modelChangedWithin(ModelId, sv_frame_t, sv_frame_t)),
+            this,
+            SLOT(sourceModelChangedWithin(ModelId, sv_frame_t, sv_frame_t)));
+}
+
+Dense3DModelRangeIndex::~Dense3DModelRangeIndex()
+{
+}
+
+int
+Dense3DModelRangeIndex::getIndexedColumnCount() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_blocks * m_columnsPerBlock;
+}
+
+bool
+Dense3DModelRangeIndex::prepare(std::shared_ptr<DenseThreeDimensionalModel> source,
+                                int &col0, int &col1) const
+{
+    if (!source) return false;
+
+    int width = source->getWidth();
+    if (col0 < 0) col0 = 0;
+    if (col1 >= width) col1 = width - 1;
+    if (col1 < col0) return false;
+
+    m_account.touch();
+
+    int height = source->getHeight();
+    if (height != m_height) {
+        QMutexLocker locker(&m_mutex);
+        truncate(0);
+        m_height = height;
+        m_sums.assign(m_height, 0.0);
+    }
+
+    return true;
+}
+
+Dense3DModelRangeIndex::Column
+Dense3DModelRangeIndex::getMeanColumn(int col0, int col1) const
+{
+    Profiler profiler("Dense3DModelRangeIndex::getMeanColumn");
+
+    auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
+    if (!prepare(source, col0, col1)) return {};
+
+    // The whole blocks within the range, taken from the index
+    int b0 = (col0 + m_columnsPerBlock - 1) / m_columnsPerBlock;
+    int b1 = (col1 + 1) / m_columnsPerBlock;
+
+    QMutexLocker locker(&m_mutex);
+    int height = m_height;
+    std::vector<double> sum(height, 0.0);
+    size_t bytes = extend(source, b1);
+    b1 = std::min(b1, m_blocks);
+    if (b1 > b0) {
+        const double *s0 = m_sums.data() + size_t(b0) * height;
+        const double *s1 = m_sums.data() + size_t(b1) * height;
+        for (int i = 0; i < height; ++i) {
+            sum[i] = s1[i] - s0[i];
+        }
+    }
+    locker.unlock();
+    m_account.setBytes(bytes);
+
+    // The remaining columns at either end, from the source
+    auto add = [&](int c) {
+        Column column = source->getColumn(c);
+        int n = std::min(height, int(column.size()));
+        for (int i = 0; i < n; ++i) {
+            sum[i] += column[i];
+        }
+    };
+    if (b1 > b0) {
+        for (int c = col0; c < b0 * m_columnsPerBlock; ++c) add(c);
+        for (int c = b1 * m_columnsPerBlock; c <= col1; ++c) add(c);
+    } else {
+        for (int c = col0; c <= col1; ++c) add(c);
+    }
+
+    Column mean(height, 0.f);
+    double count = double(col1 - col0 + 1);
+    for (int i = 0; i < height; ++i) {
+        mean[i] = float(sum[i] / count);
+    }
+    return mean;
+}
+
+Dense3DModelRangeIndex::Column
+Dense3DModelRangeIndex::getPeakColumn(int col0, int col1) const
+{
+    Profiler profiler("Dense3DModelRangeIndex::getPeakColumn");
+
+    auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
+    if (!prepare(source, col0, col1)) return {};
+
+    int height = 0;
+    Column peak;
+
+    auto merge = [&](const float *values, int n) {
+        n = std::min(height, n);
+        if (peak.empty()) {
+            peak = Column(values, values + n);
+            peak.resize(height, 0.f);
+        } else {
+            for (int i = 0; i < n; ++i) {
+                peak[i] = std::max(peak[i], values[i]);
+            }
+        }
+    };
+
+    int b0 = (col0 + m_columnsPerBlock - 1) / m_columnsPerBlock;
+    int b1 = (col1 + 1) / m_columnsPerBlock;
+
+    QMutexLocker locker(&m_mutex);
+    height = m_height;
+    size_t bytes = extend(source, b1);
+    b1 = std::min(b1, m_blocks);
+    if (b1 > b0) {
+        // Ascend the pyramid from each end of the block range,
+        // taking the peaks of any node that lies wholly within it
+        int lo = b0, hi = b1;
+        for (int k = 0; lo < hi; ++k) {
+            const float *level = m_peaks[k].data();
+            if (lo & 1) {
+                merge(level + size_t(lo) * height, height);
+                ++lo;
+            }
+            if (hi & 1) {
+                --hi;
+                merge(level + size_t(hi) * height, height);
+            }
+            lo >>= 1;
+            hi >>= 1;
+        }
+    }
+    locker.unlock();
+    m_account.setBytes(bytes);
+
+    auto mergeColumn = [&](int c) {
+        Column column = source->getColumn(c);
+        merge(column.data(), int(column.size()));
+    };
+    if (b1 > b0) {
+        for (int c = col0; c < b0 * m_columnsPerBlock; ++c) mergeColumn(c);
+        for (int c = b1 * m_columnsPerBlock; c <= col1; ++c) mergeColumn(c);
+    } else {
+        for (int c = col0; c <= col1; ++c) mergeColumn(c);
+    }
+
+    return peak;
+}
+
+size_t
+Dense3DModelRangeIndex::extend(std::shared_ptr<DenseThreeDimensionalModel> source,
+                               int blocks) const
+{
+    // Only blocks whose columns are all present can be indexed
+    blocks = std::min(blocks, source->getWidth() / m_columnsPerBlock);
+
+    int height = m_height;
+
+    while (m_blocks < blocks) {
+
+        int b = m_blocks;
+
+        std::vector<double> sum(m_sums.end() - height, m_sums.end());
+        std::vector<float> peak;
+
+        for (int i = 0; i < m_columnsPerBlock; ++i) {
+            Column column = source->getColumn(b * m_columnsPerBlock + i);
+            int n = std::min(height, int(column.size()));
+            if (i == 0) {
+                peak = column;
+                peak.resize(height, 0.f);
+            }
+            for (int j = 0; j < n; ++j) {
+                sum[j] += column[j];
+                peak[j] = std::max(peak[j], column[j]);
+            }
+        }
+
+        m_sums.insert(m_sums.end(), sum.begin(), sum.end());
+
+        if (m_peaks.empty()) m_peaks.resize(1);
+        m_peaks[0].insert(m_peaks[0].end(), peak.begin(), peak.end());
+
+        ++m_blocks;
+
+        // Completing the second of a pair of rows at one level
+        // completes a row at the level above
+        int row = b;
+        for (int k = 0; row % 2 == 1; ++k) {
+            if (int(m_peaks.size()) < k + 2) m_peaks.resize(k + 2);
+            const float *a = m_peaks[k].data() + size_t(row - 1) * height;
+            const float *c = m_peaks[k].data() + size_t(row) * height;
+            for (int j = 0; j < height; ++j) {
+                m_peaks[k+1].push_back(std::max(a[j], c[j]));
+            }
+            row /= 2;
+        }
+    }
+
+    return getDataSize();
+}
+
+void
+Dense3DModelRangeIndex::truncate(int blocks) const
+{
+    if (blocks >= m_blocks) return;
+    if (blocks < 0) blocks = 0;
+
+    m_blocks = blocks;
+    m_sums.resize(size_t(m_blocks + 1) * m_height);
+    for (int k = 0; k < int(m_peaks.size()); ++k) {
+        m_peaks[k].resize(size_t(m_blocks >> k) * m_height);
+    }
+}
+
+size_t
+Dense3DModelRangeIndex::getDataSize() const
+{
+    size_t bytes = m_sums.capacity() * sizeof(double);
+    for (const auto &level: m_peaks) {
+        bytes += level.capacity() * sizeof(float);
+    }
+    return bytes;
+}
+
+void
+Dense3DModelRangeIndex::sourceModelChanged(ModelId)
+{
+    auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
+    if (!source || !source->isReady()) return;
+
+    QMutexLocker locker(&m_mutex);
+    truncate(0);
+}
+
+void
+Dense3DModelRangeIndex::sourceModelChangedWithin(ModelId, sv_frame_t start,
+                                                 sv_frame_t)
+{
+    auto source = ModelById::getAs<DenseThreeDimensionalModel>(m_source);
+    if (!source) return;
+
+    int resolution = source->getResolution();
+    if (resolution <= 0) return;
+
+    sv_frame_t column = std::max(start, sv_frame_t(0)) / resolution;
+
+    QMutexLocker locker(&m_mutex);
+    truncate(int(column / m_columnsPerBlock));
+}
+
+void
+Dense3DModelRangeIndex::release()
+{
+    // Called by the memory budget, possibly while another thread is
+    // querying or extending the index; if so, leave it alone
+    if (!m_mutex.tryLock()) return;
+
+    m_blocks = 0;
+    std::vector<double>(m_height, 0.0).swap(m_sums);
+    std::vector<std::vector<float>>().swap(m_peaks);
+    size_t bytes = getDataSize();
+
+    m_mutex.unlock();
+
+    m_account.setBytes(bytes);
+}
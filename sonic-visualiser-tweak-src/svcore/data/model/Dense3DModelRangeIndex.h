@@ -0,0 +1,124 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_DENSE_3D_MODEL_RANGE_INDEX_H
+#define SV_DENSE_3D_MODEL_RANGE_INDEX_H
+
+#include "DenseThreeDimensionalModel.h"
+
+#include "base/MemoryBudget.h"
+
+#include <QObject>
+#include <QMutex>
+
+#include <vector>
+
+/**
+ * An index over the columns of a DenseThreeDimensionalModel that
+ * returns the mean or the peak, in each bin, of any range of columns
+ * without reading every column in the range.
+ *
+ * The source columns are grouped into blocks of a fixed number of
+ * columns. For each block the index records a running (prefix) sum of
+ * all columns up to the start of that block, and the peak values of
+ * the block, together with a pyramid of peaks across 2, 4, 8... blocks.
+ * A query reads the columns at either end of the range that do not
+ * make up a whole block directly from the source, and takes the rest
+ * from the index, so it costs at most about two blocks' worth of
+ * columns plus a logarithmic number of peak rows, however wide the
+ * range.
+ *
+ * Blocks are indexed when first needed by a query, and only once the
+ * source has all of their columns, so the index grows incrementally
+ * with the source. When the source reports a change within a range,
+ * blocks from the start of the range onward are discarded. A change
+ * to the whole of a source that is still being calculated is taken
+ * to be growth only (as with Dense3DModelPeakCache, the columns that
+ * are already present are assumed not to change); a change to the
+ * whole of a complete source discards the whole index.
+ *
+ * The index is accounted with the MemoryBudget, which may discard it
+ * when memory is short, after which it is rebuilt as needed.
+ *
+ * Dense3DModelRangeIndex is thread-safe.
+ */
+class Dense3DModelRangeIndex : public QObject
+{
+    Q_OBJECT
+
+public:
+    typedef DenseThreeDimensionalModel::Column Column;
+
+    Dense3DModelRangeIndex(ModelId source, // a DenseThreeDimensionalModel
+                           int columnsPerBlock = 64);
+    ~Dense3DModelRangeIndex();
+
+    int getColumnsPerBlock() const {
+        return m_columnsPerBlock;
+    }
+
+    /**
+     * Return the number of source columns currently covered by whole
+     * indexed blocks.
+     */
+    int getIndexedColumnCount() const;
+
+    /**
+     * Return a column containing, in each bin, the mean of the values
+     * in that bin across source columns col0 to col1 inclusive. The
+     * range is clamped to the width of the source. Return an empty
+     * column if it is empty.
+     */
+    Column getMeanColumn(int col0, int col1) const;
+
+    /**
+     * Return a column containing, in each bin, the maximum of the
+     * values in that bin across source columns col0 to col1
+     * inclusive. The range is clamped to the width of the
+     * source. Return an empty column if it is empty.
+     */
+    Column getPeakColumn(int col0, int col1) const;
+
+protected slots:
+    void sourceModelChanged(ModelId);
+    void sourceModelChangedWithin(ModelId, sv_frame_t, sv_frame_t);
+
+private:
+    ModelId m_source;
+    int m_columnsPerBlock;
+
+    mutable int m_height;
+    mutable int m_blocks; // number of whole blocks indexed
+
+    // Row b (of m_height values) contains the sums of all source
+    // columns before block b; there are m_blocks + 1 rows
+    mutable std::vector<double> m_sums;
+
+    // Level k contains, in row i, the peaks across blocks i * 2^k to
+    // (i+1) * 2^k - 1; there are (m_blocks >> k) rows
+    mutable std::vector<std::vector<float>> m_peaks;
+
+    mutable QMutex m_mutex;
+    mutable MemoryBudget::Account m_account;
+
+    bool prepare(std::shared_ptr<DenseThreeDimensionalModel> source,
+                 int &col0, int &col1) const;
+    size_t extend(std::shared_ptr<DenseThreeDimensionalModel> source,
+                  int blocks) const; // call with m_mutex held
+    void truncate(int blocks) const; // call with m_mutex held
+    size_t getDataSize() const; // call with m_mutex held
+    void release();
+};
+
+#endif
@@ -68,6 +68,14 @@ public:
      */
     virtual float getValueAt(int column, int n) const = 0;
 
+    /**
+     * Return true if getColumn() and getValueAt() may safely be
+     * called from more than one thread at the same time. Renderers
+     * use this to decide whether they can split their work across
+     * threads.
+     */
+    virtual bool supportsConcurrentReads() const { return false; }
+
     /**
      * Get the name of a given bin (i.e. a label to associate with
      * that bin across all columns).
@@ -16,6 +16,32 @@
 #include "DenseTimeValueModel.h"
 
 #include <QStringList>
+
+#include <algorithm>
+
+sv_frame_t
+DenseTimeValueModel::readData(int channel, sv_frame_t start,
+                              sv_frame_t count, float *buffer) const
+{
+    auto data = getData(channel, start, count);
+    sv_frame_t n = std::min(count, sv_frame_t(data.size()));
+    std::copy(data.begin(), data.begin() + n, buffer);
+    return n;
+}
+
+sv_frame_t
+DenseTimeValueModel::readMultiChannelData(int fromchannel, int tochannel,
+                                          sv_frame_t start, sv_frame_t count,
+                                          float *const *buffers) const
+{
+    auto data = getMultiChannelData(fromchannel, tochannel, start, count);
+    if (data.empty()) return 0;
+    sv_frame_t n = std::min(count, sv_frame_t(data[0].size()));
+    for (int c = 0; in_range_for(data, c); ++c) {
+        std::copy(data[c].begin(), data[c].begin() + n, buffers[c]);
+    }
+    return n;
+}
         
 QString
 DenseTimeValueModel::toDelimitedDataString(QString delimiter,
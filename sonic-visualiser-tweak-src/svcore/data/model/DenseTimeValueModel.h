@@ -67,6 +67,19 @@ public:
     virtual floatvec_t getData(int channel, sv_frame_t start, sv_frame_t count)
         const = 0;
 
+    /**
+     * Get the specified set of samples from the given channel (or
+     * mixdown, if channel is -1) as for getData(), but write them
+     * into the given buffer, which must have room for count
+     * samples. Return the number of samples written, which may be
+     * fewer than requested if the end of file was reached.
+     *
+     * The default implementation calls getData() and copies;
+     * subclasses that can read directly into the buffer override it.
+     */
+    virtual sv_frame_t readData(int channel, sv_frame_t start,
+                                sv_frame_t count, float *buffer) const;
+
     /**
      * Get the specified set of samples from given contiguous range of
      * channels of the model in single-precision floating-point
@@ -79,6 +92,24 @@ public:
                                                         sv_frame_t count)
         const = 0;
 
+    /**
+     * Get the specified set of samples from the given contiguous
+     * range of channels as for getMultiChannelData(), but write them
+     * into the given buffers, one per channel, each of which must
+     * have room for count samples. Return the number of samples
+     * written to each, which may be fewer than requested if the end
+     * of file was reached.
+     *
+     * The default implementation calls getMultiChannelData() and
+     * copies; subclasses that can read directly into the buffers
+     * override it.
+     */
+    virtual sv_frame_t readMultiChannelData(int fromchannel,
+                                            int tochannel,
+                                            sv_frame_t start,
+                                            sv_frame_t count,
+                                            float *const *buffers) const;
+
     bool canPlay() const override { return true; }
     QString getDefaultPlayClipId() const override { return ""; }
 
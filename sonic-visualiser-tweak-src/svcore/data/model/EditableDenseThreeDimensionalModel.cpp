@@ -25,9 +25,17 @@
 
 #include <cmath>
 #include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <climits>
+#include <atomic>
 
 using std::vector;
 
+// Revisions are drawn from a single counter so that a blob key made
+// from one identifies the contents of one model only
+static std::atomic<quint64> revisionCounter(0);
+
 #include "system/System.h"
 
 EditableDenseThreeDimensionalModel::EditableDenseThreeDimensionalModel(sv_samplerate_t sampleRate,
@@ -44,7 +52,8 @@ EditableDenseThreeDimensionalModel::EditableDenseThreeDimensionalModel(sv_sample
     m_notifyOnAdd(notifyOnAdd),
     m_sinceLastNotifyMin(-1),
     m_sinceLastNotifyMax(-1),
-    m_completion(100)
+    m_completion(100),
+    m_revision(++revisionCounter)
 {
 }    
 
@@ -82,7 +91,7 @@ EditableDenseThreeDimensionalModel::setStartFrame(sv_frame_t f)
 sv_frame_t
 EditableDenseThreeDimensionalModel::getTrueEndFrame() const
 {
-    return m_resolution * m_data.size() + (m_resolution - 1);
+    return sv_frame_t(m_resolution) * getWidth() + (m_resolution - 1);
 }
 
 int
@@ -100,6 +109,8 @@ EditableDenseThreeDimensionalModel::setResolution(int sz)
 int
 EditableDenseThreeDimensionalModel::getWidth() const
 {
+    QMutexLocker locker(&m_mutex);
+    if (m_deferred) return m_deferred->width;
     return int(m_data.size());
 }
 
@@ -118,6 +129,8 @@ EditableDenseThreeDimensionalModel::setHeight(int sz)
 float
 EditableDenseThreeDimensionalModel::getMinimumLevel() const
 {
+    QMutexLocker locker(&m_mutex);
+    decodeDeferred();
     return m_minimum;
 }
 
@@ -130,6 +143,8 @@ EditableDenseThreeDimensionalModel::setMinimumLevel(float level)
 float
 EditableDenseThreeDimensionalModel::getMaximumLevel() const
 {
+    QMutexLocker locker(&m_mutex);
+    decodeDeferred();
     return m_maximum;
 }
 
@@ -143,6 +158,7 @@ EditableDenseThreeDimensionalModel::Column
 EditableDenseThreeDimensionalModel::getColumn(int index) const
 {
     QMutexLocker locker(&m_mutex);
+    decodeDeferred();
     if (!in_range_for(m_data, index)) {
         return {};
     }
@@ -160,6 +176,7 @@ float
 EditableDenseThreeDimensionalModel::getValueAt(int index, int n) const
 {
     QMutexLocker locker(&m_mutex);
+    decodeDeferred();
     if (!in_range_for(m_data, index)) {
         return m_minimum;
     }
@@ -180,26 +197,15 @@ EditableDenseThreeDimensionalModel::setColumn(int index,
 
     {
         QMutexLocker locker(&m_mutex);
+        decodeDeferred();
+
+        m_revision = ++revisionCounter;
 
         while (index >= int(m_data.size())) {
             m_data.push_back(Column());
         }
 
-        for (int i = 0; in_range_for(values, i); ++i) {
-            float value = values[i];
-            if (ISNAN(value) || ISINF(value)) {
-                continue;
-            }
-            if (!m_haveExtents || value < m_minimum) {
-                m_minimum = value;
-                allChange = true;
-            }
-            if (!m_haveExtents || value > m_maximum) {
-                m_maximum = value;
-                allChange = true;
-            }
-            m_haveExtents = true;
-        }
+        allChange = updateExtents(values);
 
         m_data[index] = values;
 
@@ -232,6 +238,28 @@ EditableDenseThreeDimensionalModel::setColumn(int index,
     }
 }
 
+bool
+EditableDenseThreeDimensionalModel::updateExtents(const Column &values)
+{
+    bool changed = false;
+    for (int i = 0; in_range_for(values, i); ++i) {
+        float value = values[i];
+        if (ISNAN(value) || ISINF(value)) {
+            continue;
+        }
+        if (!m_haveExtents || value < m_minimum) {
+            m_minimum = value;
+            changed = true;
+        }
+        if (!m_haveExtents || value > m_maximum) {
+            m_maximum = value;
+            changed = true;
+        }
+        m_haveExtents = true;
+    }
+    return changed;
+}
+
 QString
 EditableDenseThreeDimensionalModel::getBinName(int n) const
 {
@@ -289,6 +317,7 @@ bool
 EditableDenseThreeDimensionalModel::shouldUseLogValueScale() const
 {
     QMutexLocker locker(&m_mutex);
+    decodeDeferred();
 
     vector<double> sample;
     vector<int> n;
@@ -358,6 +387,7 @@ EditableDenseThreeDimensionalModel::toDelimitedDataString(QString delimiter,
                                                           sv_frame_t duration) const
 {
     QMutexLocker locker(&m_mutex);
+    decodeDeferred();
     QString s;
     for (int i = 0; in_range_for(m_data, i); ++i) {
         sv_frame_t fr = m_startFrame + i * m_resolution;
@@ -398,9 +428,30 @@ EditableDenseThreeDimensionalModel::toXml(QTextStream &out,
          .arg(m_startFrame)
          .arg(extraAttributes));
 
+    BlobSink *sink = getBlobSink();
+
+    if (!sink) {
+        decodeDeferred();
+    }
+
     out << indent;
-    out << QString("<dataset id=\"%1\" dimensions=\"3\" separator=\" \">\n")
-        .arg(getExportId());
+    if (sink) {
+        QString key = QString("dense:%1").arg(m_revision);
+        int index = sink->findBlob(key);
+        if (index < 0 && m_deferred) {
+            // Still not copied out, so the blob we were given is current
+            index = sink->addBlob(QByteArray(m_deferred->data,
+                                             int(m_deferred->size)), key);
+        } else if (index < 0) {
+            index = sink->addBlob(encodeColumns(), key);
+        }
+        out << QString("<dataset id=\"%1\" dimensions=\"3\" blob=\"%2\">\n")
+            .arg(getExportId())
+            .arg(index);
+    } else {
+        out << QString("<dataset id=\"%1\" dimensions=\"3\" separator=\" \">\n")
+            .arg(getExportId());
+    }
 
     for (int i = 0; in_range_for(m_binNames, i); ++i) {
         if (m_binNames[i] != "") {
@@ -410,19 +461,148 @@ EditableDenseThreeDimensionalModel::toXml(QTextStream &out,
         }
     }
 
-    for (int i = 0; in_range_for(m_data, i); ++i) {
-        Column c = getColumn(i);
-        out << indent + "  ";
-        out << QString("<row n=\"%1\">").arg(i);
-        for (int j = 0; in_range_for(c, j); ++j) {
-            if (j > 0) out << " ";
-            out << c.at(j);
+    if (!sink) {
+        auto writeRows = [](QTextStream &out, QString indent,
+                            const ValueMatrix &data,
+                            int yBinCount) {
+            for (int i = 0; in_range_for(data, i); ++i) {
+                Column c = data.at(i);
+                if (int(c.size()) != yBinCount) {
+                    c.resize(yBinCount, 0.0);
+                }
+                out << indent + "  ";
+                out << QString("<row n=\"%1\">").arg(i);
+                for (int j = 0; in_range_for(c, j); ++j) {
+                    if (j > 0) out << " ";
+                    out << c.at(j);
+                }
+                out << QString("</row>\n");
+                out.flush();
+            }
+        };
+        if (FragmentSink *fragments = getFragmentSink()) {
+            // The sink may write the rows later, so give it a copy
+            ValueMatrix data(m_data);
+            int yBinCount = m_yBinCount;
+            fragments->addDeferredFragment
+                (out, [writeRows, indent, data, yBinCount](QTextStream &fout) {
+                    writeRows(fout, indent, data, yBinCount);
+                });
+        } else {
+            writeRows(out, indent, m_data, m_yBinCount);
         }
-        out << QString("</row>\n");
-        out.flush();
     }
 
     out << indent + "</dataset>\n";
 }
 
 
+
+// Blob form of the columns: four 32-bit words (magic, version, column
+// count and a zero pad), then the number of values in each column as
+// a 32-bit word, then all the values as floats, in host byte order
+
+static const uint32_t columnBlobMagic = 0x44335653; // "SV3D" little-endian
+static const uint32_t columnBlobVersion = 1;
+
+QByteArray
+EditableDenseThreeDimensionalModel::encodeColumns() const
+{
+    std::vector<uint32_t> header {
+        columnBlobMagic, columnBlobVersion, uint32_t(m_data.size()), 0
+    };
+    size_t values = 0;
+    for (const auto &c: m_data) {
+        header.push_back(uint32_t(c.size()));
+        values += c.size();
+    }
+    
+    QByteArray blob;
+    blob.reserve(int(header.size() * sizeof(uint32_t) +
+                     values * sizeof(float)));
+    blob.append(reinterpret_cast<const char *>(header.data()),
+                int(header.size() * sizeof(uint32_t)));
+    for (const auto &c: m_data) {
+        blob.append(reinterpret_cast<const char *>(c.data()),
+                    int(c.size() * sizeof(float)));
+    }
+    return blob;
+}
+
+bool
+EditableDenseThreeDimensionalModel::setColumnsFromBlob(std::shared_ptr<const void> owner,
+                                                       const char *data,
+                                                       qint64 size)
+{
+    uint32_t header[4];
+    if (size < qint64(sizeof(header))) {
+        return false;
+    }
+    memcpy(header, data, sizeof(header));
+    if (header[0] != columnBlobMagic || header[1] != columnBlobVersion ||
+        header[2] > uint32_t(INT_MAX)) {
+        return false;
+    }
+
+    // Check that the heights account for exactly the rest of the
+    // blob, so that decodeDeferred can copy without checking
+
+    const qint64 columns = header[2];
+    qint64 offset = sizeof(header);
+    if (size - offset < columns * qint64(sizeof(uint32_t))) {
+        return false;
+    }
+
+    qint64 values = 0;
+    for (qint64 i = 0; i < columns; ++i) {
+        uint32_t height = 0;
+        memcpy(&height, data + offset + i * sizeof(uint32_t), sizeof(height));
+        values += height;
+    }
+    offset += columns * sizeof(uint32_t);
+
+    if ((size - offset) % qint64(sizeof(float)) != 0 ||
+        (size - offset) / qint64(sizeof(float)) != values) {
+        return false;
+    }
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_data.clear();
+        m_deferred.reset(new DeferredColumns {
+                owner, data, size, int(columns)
+            });
+        m_revision = ++revisionCounter;
+    }
+
+    emit modelChanged(getId());
+    return true;
+}
+
+void
+EditableDenseThreeDimensionalModel::decodeDeferred() const
+{
+    if (!m_deferred) return;
+
+    // This fills in the columns that the model already logically
+    // contains, so it does not change the revision or notify
+    auto self = const_cast<EditableDenseThreeDimensionalModel *>(this);
+    std::unique_ptr<DeferredColumns> deferred(std::move(self->m_deferred));
+
+    const int width = deferred->width;
+    const char *heights = deferred->data + 4 * sizeof(uint32_t);
+    const char *values = heights + size_t(width) * sizeof(uint32_t);
+
+    self->m_data.resize(width);
+
+    for (int i = 0; i < width; ++i) {
+        uint32_t height = 0;
+        memcpy(&height, heights + size_t(i) * sizeof(uint32_t),
+               sizeof(height));
+        Column &column = self->m_data[i];
+        column.resize(height);
+        memcpy(column.data(), values, size_t(height) * sizeof(float));
+        values += size_t(height) * sizeof(float);
+        self->updateExtents(column);
+    }
+}
@@ -21,6 +21,7 @@
 #include <QMutex>
 
 #include <vector>
+#include <memory>
 
 class EditableDenseThreeDimensionalModel : public DenseThreeDimensionalModel
 {
@@ -113,6 +114,19 @@ public:
      */
     virtual void setColumn(int x, const Column &values);
 
+    /**
+     * Replace the columns with those in a blob written by toXml when
+     * saving to a session container. The blob is checked here, but
+     * the columns are only copied out of it, all together, when they
+     * are first needed; until then the width is taken from the blob,
+     * and toXml with a blob sink writes it out unchanged. The owner
+     * is held until the columns have been copied, and must keep the
+     * data valid. Return false, leaving the model unchanged, if the
+     * blob is not valid.
+     */
+    bool setColumnsFromBlob(std::shared_ptr<const void> owner,
+                            const char *data, qint64 size);
+
     /**
      * Return the name of bin n. This is a single label per bin that
      * does not vary from one column to the next.
@@ -172,6 +186,8 @@ public:
 
     QString getTypeName() const override { return tr("Editable Dense 3-D"); }
 
+    bool supportsConcurrentReads() const override { return true; }
+
     QString toDelimitedDataString(QString delimiter,
                                   DataExportOptions options,
                                   sv_frame_t startFrame,
@@ -200,8 +216,23 @@ protected:
     sv_frame_t m_sinceLastNotifyMin;
     sv_frame_t m_sinceLastNotifyMax;
     int m_completion;
+    quint64 m_revision; // changes with every setColumn, for blob keys
+
+    // Columns set by setColumnsFromBlob and not yet copied out. While
+    // this exists, m_data is empty
+    struct DeferredColumns {
+        std::shared_ptr<const void> owner;
+        const char *data;
+        qint64 size;
+        int width;
+    };
+    std::unique_ptr<DeferredColumns> m_deferred;
 
     mutable QMutex m_mutex;
+
+    QByteArray encodeColumns() const; // call with m_mutex held
+    void decodeDeferred() const; // call with m_mutex held
+    bool updateExtents(const Column &values); // call with m_mutex held
 };
 
 #endif
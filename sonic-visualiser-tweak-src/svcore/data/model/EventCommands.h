@@ -28,6 +28,15 @@ class EventEditable
 public:
     virtual void add(Event e) = 0;
     virtual void remove(Event e) = 0;
+
+    /**
+     * Replace the events with those in a blob read from a session
+     * container, to be decoded when they are first needed (see
+     * EventSeries::setFromBlob). Return false if the blob is not
+     * valid.
+     */
+    virtual bool setEventsFromBlob(std::shared_ptr<const void> owner,
+                                   const char *data, qint64 size) = 0;
 };
 
 class WithEditable
@@ -0,0 +1,252 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "FFTColumnStore.h"
+
+#include "base/CacheDirectory.h"
+#include "base/Debug.h"
+
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(std::atomic<uint8_t>) == 1,
+              "FFTColumnStore requires single-byte atomic flags");
+
+namespace {
+
+const char *const magic = "SVFFTCS1";
+const uint32_t formatVersion = 2;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t reserved[11];
+};
+
+static_assert(sizeof(Header) == 64, "FFTColumnStore header must be 64 bytes");
+
+qint64 readyTableSize(int width) {
+    // pad to a multiple of 64 so that column data is well aligned
+    return ((qint64(width) + 63) / 64) * 64;
+}
+
+}
+
+CacheDirectory &
+FFTColumnStore::getCacheDirectory()
+{
+    static CacheDirectory directory("fft-cache", 8192);
+    return directory;
+}
+
+qint64
+FFTColumnStore::getStoreSize(int width, int height)
+{
+    return qint64(sizeof(Header)) + readyTableSize(width) +
+        qint64(width) * height * qint64(sizeof(std::complex<float>));
+}
+
+QString
+FFTColumnStore::makeFilename(QString sourceKey,
+                             int channel,
+                             WindowType windowType,
+                             int windowSize,
+                             int windowIncrement,
+                             int fftSize)
+{
+    return QString("%1-c%2-w%3-%4-%5-%6.fftcols")
+        .arg(sourceKey)
+        .arg(channel)
+        .arg(int(windowType))
+        .arg(windowSize)
+        .arg(windowIncrement)
+        .arg(fftSize);
+}
+
+FFTColumnStore::FFTColumnStore(CacheDirectory &directory,
+                               QString filename,
+                               int width, int height) :
+    m_directory(directory),
+    m_filename(filename),
+    m_width(width),
+    m_height(height),
+    m_data(nullptr),
+    m_state(nullptr),
+    m_columns(nullptr)
+{
+    m_directory.acquire(m_filename);
+
+    m_file.setFileName(m_directory.getFilePath(m_filename));
+
+    if (m_file.exists()) {
+        if (open(false)) {
+            m_directory.touch(m_filename);
+            return;
+        }
+        SVDEBUG << "FFTColumnStore: existing store " << m_filename
+                << " is unusable, recreating it" << endl;
+        m_file.remove();
+    }
+
+    qint64 size = getStoreSize(width, height);
+    if (!m_directory.prune(size)) {
+        SVDEBUG << "FFTColumnStore: store of " << size << " bytes would "
+                << "exceed cache directory limit, not creating it" << endl;
+        return;
+    }
+
+    (void)open(true);
+}
+
+FFTColumnStore::~FFTColumnStore()
+{
+    if (m_data) {
+        m_file.unmap(m_data);
+    }
+    m_file.close();
+    m_directory.release(m_filename);
+}
+
+bool
+FFTColumnStore::open(bool create)
+{
+    qint64 size = getStoreSize(m_width, m_height);
+
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        SVCERR << "WARNING: FFTColumnStore: failed to open "
+               << m_file.fileName() << ": " << m_file.errorString() << endl;
+        return false;
+    }
+
+    if (create) {
+        Header header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, magic, sizeof(header.magic));
+        header.version = formatVersion;
+        header.width = uint32_t(m_width);
+        header.height = uint32_t(m_height);
+        if (m_file.write(reinterpret_cast<const char *>(&header),
+                         sizeof(header)) != qint64(sizeof(header)) ||
+            !m_file.resize(size)) {
+            SVCERR << "WARNING: FFTColumnStore: failed to create "
+                   << m_file.fileName() << ": " << m_file.errorString()
+                   << endl;
+            m_file.close();
+            m_file.remove();
+            return false;
+        }
+    } else if (m_file.size() != size) {
+        m_file.close();
+        return false;
+    }
+
+    m_data = m_file.map(0, size);
+    if (!m_data) {
+        SVCERR << "WARNING: FFTColumnStore: failed to map "
+               << m_file.fileName() << ": " << m_file.errorString() << endl;
+        m_file.close();
+        if (create) m_file.remove();
+        return false;
+    }
+
+    const Header *header = reinterpret_cast<const Header *>(m_data);
+    if (memcmp(header->magic, magic, sizeof(header->magic)) ||
+        header->version != formatVersion ||
+        header->width != uint32_t(m_width) ||
+        header->height != uint32_t(m_height)) {
+        m_file.unmap(m_data);
+        m_data = nullptr;
+        m_file.close();
+        return false;
+    }
+
+    m_state = reinterpret_cast<std::atomic<uint8_t> *>(m_data + sizeof(Header));
+    m_columns = reinterpret_cast<std::complex<float> *>
+        (m_data + sizeof(Header) + readyTableSize(m_width));
+
+    int count = 0;
+    for (int i = 0; i < m_width; ++i) {
+        if (m_state[i].load(std::memory_order_relaxed) == Ready) ++count;
+    }
+
+    SVDEBUG << "FFTColumnStore: opened " << m_file.fileName() << " with "
+            << count << " of " << m_width << " columns ready" << endl;
+
+    return true;
+}
+
+void
+FFTColumnStore::setColumns(int x, int count,
+                           const std::complex<float> *values)
+{
+    if (!m_data || x < 0 || count <= 0 || x + count > m_width) return;
+
+    // Claim the columns nobody else has, and write them
+    
+    std::vector<int> claimed;
+    claimed.reserve(count);
+    
+    for (int i = 0; i < count; ++i) {
+        uint8_t expected = Empty;
+        if (m_state[x + i].compare_exchange_strong
+            (expected, Writing, std::memory_order_acq_rel)) {
+            memcpy(m_columns + size_t(x + i) * m_height,
+                   values + size_t(i) * m_height,
+                   m_height * sizeof(std::complex<float>));
+            claimed.push_back(x + i);
+        }
+    }
+
+    if (claimed.empty()) return;
+
+    // Flush the data before marking any of it ready, so that a ready
+    // state found in the file in a later session never refers to data
+    // that did not reach it
+
+    flush(m_columns + size_t(claimed[0]) * m_height,
+          size_t(claimed[claimed.size()-1] - claimed[0] + 1) * m_height *
+          sizeof(std::complex<float>));
+
+    for (int c: claimed) {
+        m_state[c].store(Ready, std::memory_order_release);
+    }
+}
+
+void
+FFTColumnStore::flush(const void *data, size_t bytes)
+{
+#ifdef _WIN32
+    if (!FlushViewOfFile(data, bytes)) {
+        SVDEBUG << "FFTColumnStore: failed to flush " << m_filename << endl;
+    }
+#else
+    // msync needs a page-aligned start address
+    static const uintptr_t pageSize = uintptr_t(sysconf(_SC_PAGESIZE));
+    uintptr_t start = reinterpret_cast<uintptr_t>(data);
+    uintptr_t aligned = start - (start % pageSize);
+    if (msync(reinterpret_cast<void *>(aligned), bytes + (start - aligned),
+              MS_SYNC)) {
+        SVDEBUG << "FFTColumnStore: failed to flush " << m_filename << endl;
+    }
+#endif
+}
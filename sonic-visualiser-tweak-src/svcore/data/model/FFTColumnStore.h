@@ -0,0 +1,141 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_FFT_COLUMN_STORE_H
+#define SV_FFT_COLUMN_STORE_H
+
+#include "base/Window.h"
+
+#include <QString>
+#include <QFile>
+
+#include <atomic>
+#include <complex>
+
+class CacheDirectory;
+
+/**
+ * A memory-mapped on-disc store of complex FFT columns, used by
+ * FFTModel to avoid recalculating the same columns repeatedly and to
+ * retain them from one session to the next.
+ *
+ * A store is identified by a key for the source audio together
+ * with the channel, window and FFT parameters; see makeFilename().
+ * The file consists of a short header, a table of one state byte per
+ * column, and then the column data itself as interleaved complex
+ * float values.
+ *
+ * Each column is empty, being written, or ready. A writer claims a
+ * column by moving it from empty to being written, so only one
+ * writer in any process ever writes it. setColumns() writes the data
+ * of its claimed columns, flushes it to the file, and only then marks
+ * them ready (with release semantics). Readers take no locks:
+ * haveColumn() and getColumn() read the state with acquire
+ * semantics, so a ready column's data is always complete, including
+ * in a later session after a crash.
+ *
+ * Several stores, in this process or in others, may map the same
+ * file. Because the column states are in the file, each sees the
+ * columns written through the others. A column left being written by
+ * a writer that crashed is never filled, and is calculated afresh
+ * each time instead.
+ */
+class FFTColumnStore
+{
+public:
+    /**
+     * Open the store in the given file of the given cache directory,
+     * creating it if it does not exist or is not compatible with the
+     * given dimensions. Check isOK() after construction.
+     */
+    FFTColumnStore(CacheDirectory &directory, QString filename,
+                   int width, int height);
+    ~FFTColumnStore();
+
+    bool isOK() const { return m_data != nullptr; }
+
+    int getWidth() const { return m_width; }
+    int getHeight() const { return m_height; }
+
+    /**
+     * Return true if the given column has been written (in this or a
+     * previous session).
+     */
+    bool haveColumn(int x) const {
+        if (x < 0 || x >= m_width) return false;
+        return m_state[x].load(std::memory_order_acquire) == Ready;
+    }
+
+    /**
+     * Return a pointer to the complex values of the given column, or
+     * nullptr if the column has not yet been written.
+     */
+    const std::complex<float> *getColumn(int x) const {
+        if (!haveColumn(x)) return nullptr;
+        return m_columns + size_t(x) * m_height;
+    }
+
+    /**
+     * Write the given count of consecutive columns starting at x,
+     * from values which must contain count * getHeight() complex
+     * values, and publish them to readers. Columns that are already
+     * ready, or being written by another writer, are skipped.
+     */
+    void setColumns(int x, int count, const std::complex<float> *values);
+
+    /**
+     * Return a filename for a store identified by the given source
+     * key and FFT parameters.
+     */
+    static QString makeFilename(QString sourceKey,
+                                int channel,
+                                WindowType windowType,
+                                int windowSize,
+                                int windowIncrement,
+                                int fftSize);
+
+    /**
+     * Return the size in bytes of a store of the given dimensions.
+     */
+    static qint64 getStoreSize(int width, int height);
+
+    /**
+     * Return the cache directory shared by all FFT column stores.
+     */
+    static CacheDirectory &getCacheDirectory();
+
+private:
+    FFTColumnStore(const FFTColumnStore &) =delete;
+    FFTColumnStore &operator=(const FFTColumnStore &) =delete;
+
+    CacheDirectory &m_directory;
+    QString m_filename;
+    QFile m_file;
+    int m_width;
+    int m_height;
+    uchar *m_data;
+    enum State : uint8_t {
+        Empty = 0,
+        Writing = 1,
+        Ready = 2
+    };
+
+    std::atomic<uint8_t> *m_state;
+    std::complex<float> *m_columns;
+
+    bool open(bool create);
+    void flush(const void *data, size_t bytes);
+};
+
+#endif
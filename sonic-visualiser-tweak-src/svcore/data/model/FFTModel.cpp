@@ -14,23 +14,52 @@
 */
 
 #include "FFTModel.h"
+#include "FFTColumnStore.h"
 #include "DenseTimeValueModel.h"
+#include "ReadOnlyWaveFileModel.h"
 
 #include "base/Profiler.h"
 #include "base/Pitch.h"
 #include "base/HitCount.h"
 #include "base/Debug.h"
 #include "base/MovingMedian.h"
+#include "base/CacheDirectory.h"
+#include "base/Exceptions.h"
+#include "base/Preferences.h"
+
+#include <bqvec/VectorOpsComplex.h>
+
+#include <QCryptographicHash>
+#include <QSemaphore>
 
 #include <algorithm>
 
 #include <cassert>
 #include <deque>
+#include <memory>
 
 using namespace std;
 
 static HitCount inSmallCache("FFTModel: Small FFT cache");
 static HitCount inSourceCache("FFTModel: Source data cache");
+static HitCount inColumnStore("FFTModel: Column store");
+static HitCount inReadahead("FFTModel: Readahead columns");
+
+const size_t FFTModel::m_cacheSize = 3;
+const int FFTModel::m_batchSize = 32;
+
+FFTModel::CalculationContext::CalculationContext(const FFTModel &model) :
+    windower(model.m_windowType, model.m_windowSize),
+    fft(model.m_fftSize),
+    cacheWriteIndex(0),
+    readahead({ -1, 0, {} }),
+    lastRequestedColumn(-2)
+{
+    while (cached.size() < m_cacheSize) {
+        cached.push_back({ -1, cvec(model.m_fftSize / 2 + 1) });
+    }
+    fft.initFloat();
+}
 
 FFTModel::FFTModel(ModelId modelId,
                    int channel,
@@ -45,24 +74,20 @@ FFTModel::FFTModel(ModelId modelId,
     m_windowSize(windowSize),
     m_windowIncrement(windowIncrement),
     m_fftSize(fftSize),
-    m_windower(windowType, windowSize),
-    m_fft(fftSize),
     m_maximumFrequency(0.0),
-    m_cacheWriteIndex(0),
-    m_cacheSize(3)
+    m_lifetime(make_shared<int>(0)),
+    m_storeThreadCount(0),
+    m_store(nullptr),
+    m_storePrepared(false),
+    m_nextStoreBlock(0),
+    m_exiting(false)
 {
-    while (m_cached.size() < m_cacheSize) {
-        m_cached.push_back({ -1, cvec(m_fftSize / 2 + 1) });
-    }
-    
     if (m_windowSize > m_fftSize) {
         SVCERR << "ERROR: FFTModel::FFTModel: window size (" << m_windowSize
                << ") may not exceed FFT size (" << m_fftSize << ")" << endl;
         throw invalid_argument("FFTModel window size may not exceed FFT size");
     }
 
-    m_fft.initFloat();
-
     auto model = ModelById::getAs<DenseTimeValueModel>(m_model);
     if (model) {
         m_sampleRate = model->getSampleRate();
@@ -78,6 +103,49 @@ FFTModel::FFTModel(ModelId modelId,
 
 FFTModel::~FFTModel()
 {
+    m_exiting = true;
+    for (auto t: m_storeFillThreads) {
+        t->wait();
+        delete t;
+    }
+    delete m_store.load();
+}
+
+FFTModel::CalculationContext &
+FFTModel::getContext() const
+{
+    // Each thread keeps its own contexts, one for each model it has
+    // read from. They are deleted when the thread exits - which
+    // includes idle render pool threads, after the pool's expiry
+    // timeout - or, for a model that has since been deleted, the next
+    // time the thread asks any model for a context.
+
+    struct Entry {
+        weak_ptr<const int> model;
+        unique_ptr<CalculationContext> context;
+    };
+    static thread_local vector<Entry> contexts;
+
+    CalculationContext *found = nullptr;
+
+    for (auto itr = contexts.begin(); itr != contexts.end(); ) {
+        auto model = itr->model.lock();
+        if (!model) {
+            itr = contexts.erase(itr);
+            continue;
+        }
+        if (model == m_lifetime) {
+            found = itr->context.get();
+        }
+        ++itr;
+    }
+
+    if (!found) {
+        contexts.push_back({ m_lifetime, make_unique<CalculationContext>(*this) });
+        found = contexts.back().context.get();
+    }
+    
+    return *found;
 }
 
 bool
@@ -112,6 +180,204 @@ FFTModel::setMaximumFrequency(double freq)
     m_maximumFrequency = freq;
 }
 
+void
+FFTModel::enableColumnStore(int threads)
+{
+    if (m_storeThreadCount > 0) return;
+
+    if (!Preferences::getInstance()->getStoreSpectrogramData()) return;
+
+    if (threads <= 0) {
+        threads = std::max(1, QThread::idealThreadCount() - 1);
+    }
+    m_storeThreadCount = threads;
+
+    // Only audio files have an identity that lets a store be found
+    // again in a later session
+    auto model = ModelById::getAs<ReadOnlyWaveFileModel>(m_model);
+    if (!model) return;
+
+    if (model->isReady()) {
+        startColumnStoreThreads();
+    } else {
+        connect(model.get(), SIGNAL(ready(ModelId)),
+                this, SLOT(sourceModelReady()));
+    }
+}
+
+void
+FFTModel::sourceModelReady()
+{
+    if (m_storeThreadCount > 0 && m_storeFillThreads.empty()) {
+        startColumnStoreThreads();
+    }
+}
+
+void
+FFTModel::startColumnStoreThreads()
+{
+    SVDEBUG << "FFTModel::startColumnStoreThreads: starting "
+            << m_storeThreadCount << " thread(s)" << endl;
+
+    for (int i = 0; i < m_storeThreadCount; ++i) {
+        auto t = new StoreFillThread(*this);
+        m_storeFillThreads.push_back(t);
+        t->start();
+    }
+}
+
+QString
+FFTModel::makeSourceKey() const
+{
+    auto model = ModelById::getAs<ReadOnlyWaveFileModel>(m_model);
+    if (!model) return {};
+
+    QString identity = model->getSourceIdentity();
+    if (identity == "") return {};
+
+    // The file's identity, plus a fingerprint of the audio at the
+    // start and end of our channel as a check against anything the
+    // identity misses. This is cheap however long the file is.
+    
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(identity.toUtf8());
+
+    sv_frame_t start = model->getStartFrame();
+    sv_frame_t end = model->getEndFrame();
+    hash.addData(QString(":%1").arg(end - start).toUtf8());
+    
+    const sv_frame_t fingerprintFrames = 65536;
+
+    auto head = model->getData
+        (m_channel, start, std::min(fingerprintFrames, end - start));
+    hash.addData(reinterpret_cast<const char *>(head.data()),
+                 int(head.size() * sizeof(float)));
+
+    if (end - start > fingerprintFrames) {
+        auto tail = model->getData
+            (m_channel, end - fingerprintFrames, fingerprintFrames);
+        hash.addData(reinterpret_cast<const char *>(tail.data()),
+                     int(tail.size() * sizeof(float)));
+    }
+
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+bool
+FFTModel::prepareColumnStore()
+{
+    // Called from each fill thread; the first to arrive does the
+    // work, while the others wait for it
+
+    QMutexLocker locker(&m_storeMutex);
+
+    if (m_storePrepared) {
+        return m_store.load() != nullptr;
+    }
+    m_storePrepared = true;
+
+    QString sourceKey = makeSourceKey();
+    if (sourceKey == "") return false;
+
+    QString filename = FFTColumnStore::makeFilename
+        (sourceKey, m_channel, m_windowType,
+         m_windowSize, m_windowIncrement, m_fftSize);
+
+    FFTColumnStore *store = nullptr;
+    
+    try {
+        store = new FFTColumnStore(FFTColumnStore::getCacheDirectory(),
+                                   filename, getWidth(), m_fftSize / 2 + 1);
+    } catch (const DirectoryCreationFailed &f) {
+        SVCERR << "WARNING: FFTModel::prepareColumnStore: " << f.what()
+               << endl;
+        return false;
+    }
+
+    if (!store->isOK()) {
+        delete store;
+        return false;
+    }
+
+    m_store.store(store, std::memory_order_release);
+    return true;
+}
+
+static QSemaphore &
+getStoreFillSlots()
+{
+    // Shared by the fill threads of every FFTModel, so that several
+    // spectrograms filling their stores at once do not between them
+    // start more calculations than there are cores to spare
+    static QSemaphore fillSlots(std::max(1, QThread::idealThreadCount() - 1));
+    return fillSlots;
+}
+
+void
+FFTModel::StoreFillThread::run()
+{
+    if (!m_model.prepareColumnStore()) return;
+
+    FFTColumnStore *store = m_model.m_store.load(std::memory_order_acquire);
+
+    int width = store->getWidth();
+    int height = store->getHeight();
+
+    // Columns are handed out in blocks, so that each thread can read
+    // the overlapping source data for a block in one go and transform
+    // the block together
+    const int blockSize = 64;
+    
+    Window<float> windower(m_model.m_windowType, m_model.m_windowSize);
+    breakfastquay::FFT fft(m_model.m_fftSize);
+    fft.initFloat();
+
+    fvec frames;
+    cvec cols(size_t(blockSize) * height);
+
+    while (!m_model.m_exiting) {
+
+        int first = m_model.m_nextStoreBlock.fetch_add(1) * blockSize;
+        if (first >= width) break;
+        int last = std::min(first + blockSize, width); // exclusive
+
+        int x = first;
+        while (x < last && store->haveColumn(x)) ++x;
+        if (x == last) continue;
+
+        QSemaphore &fillSlots = getStoreFillSlots();
+        while (!fillSlots.tryAcquire(1, 100)) {
+            if (m_model.m_exiting) return;
+        }
+
+        Profiler profiler("FFTModel::StoreFillThread::run (block)");
+
+        auto range = std::make_pair(m_model.getSourceSampleRange(x).first,
+                                    m_model.getSourceSampleRange(last - 1).second);
+        auto data = m_model.getSourceDataUncached(range);
+        if (sv_frame_t(data.size()) < range.second - range.first) {
+            // source model has gone away
+            fillSlots.release();
+            break;
+        }
+
+        m_model.calculateColumns(data.data(), last - x, windower, fft,
+                                 frames, cols.data());
+
+        store->setColumns(x, last - x, cols.data());
+
+        fillSlots.release();
+    }
+}
+
+const std::complex<float> *
+FFTModel::getStoredColumn(int x) const
+{
+    FFTColumnStore *store = m_store.load(std::memory_order_acquire);
+    if (!store) return nullptr;
+    return store->getColumn(x);
+}
+
 int
 FFTModel::getWidth() const
 {
@@ -150,9 +416,10 @@ FFTModel::Column
 FFTModel::getColumn(int x) const
 {
     auto cplx = getFFTColumn(x);
-    Column col;
-    col.reserve(cplx.size());
-    for (auto c: cplx) col.push_back(abs(c));
+    int n = int(cplx.size());
+    Column col(n);
+    breakfastquay::v_cartesian_interleaved_to_magnitudes
+        (col.data(), reinterpret_cast<const float *>(cplx.data()), n);
     return col;
 }
 
@@ -160,11 +427,10 @@ FFTModel::Column
 FFTModel::getPhases(int x) const
 {
     auto cplx = getFFTColumn(x);
-    Column col;
-    col.reserve(cplx.size());
-    for (auto c: cplx) {
-        col.push_back(arg(c));
-    }
+    int n = int(cplx.size());
+    Column mags(n), col(n);
+    breakfastquay::v_cartesian_interleaved_to_polar
+        (mags.data(), col.data(), reinterpret_cast<const float *>(cplx.data()), n);
     return col;
 }
 
@@ -214,10 +480,14 @@ bool
 FFTModel::getMagnitudesAt(int x, float *values, int minbin, int count) const
 {
     if (count == 0) count = getHeight();
-    auto col = getFFTColumn(x);
-    for (int i = 0; i < count; ++i) {
-        values[i] = abs(col[minbin + i]);
+    if (auto stored = getStoredColumn(x)) {
+        breakfastquay::v_cartesian_interleaved_to_magnitudes
+            (values, reinterpret_cast<const float *>(stored + minbin), count);
+        return true;
     }
+    auto col = getFFTColumn(x);
+    breakfastquay::v_cartesian_interleaved_to_magnitudes
+        (values, reinterpret_cast<const float *>(col.data() + minbin), count);
     return true;
 }
 
@@ -247,65 +517,43 @@ FFTModel::getValuesAt(int x, float *reals, float *imags, int minbin, int count)
 }
 
 FFTModel::fvec
-FFTModel::getSourceSamples(int column) const
+FFTModel::getSourceData(CalculationContext &context,
+                        pair<sv_frame_t, sv_frame_t> range) const
 {
-    // m_fftSize may be greater than m_windowSize, but not the reverse
-
-//    cerr << "getSourceSamples(" << column << ")" << endl;
+    SavedSourceData &saved = context.savedData;
     
-    auto range = getSourceSampleRange(column);
-    auto data = getSourceData(range);
-
-    int off = (m_fftSize - m_windowSize) / 2;
-
-    if (off == 0) {
-        return data;
-    } else {
-        vector<float> pad(off, 0.f);
-        fvec padded;
-        padded.reserve(m_fftSize);
-        padded.insert(padded.end(), pad.begin(), pad.end());
-        padded.insert(padded.end(), data.begin(), data.end());
-        padded.insert(padded.end(), pad.begin(), pad.end());
-        return padded;
-    }
-}
-
-FFTModel::fvec
-FFTModel::getSourceData(pair<sv_frame_t, sv_frame_t> range) const
-{
 //    cerr << "getSourceData(" << range.first << "," << range.second
-//         << "): saved range is (" << m_savedData.range.first
-//         << "," << m_savedData.range.second << ")" << endl;
+//         << "): saved range is (" << saved.range.first
+//         << "," << saved.range.second << ")" << endl;
 
-    if (m_savedData.range == range) {
+    if (saved.range == range) {
         inSourceCache.hit();
-        return m_savedData.data;
+        return saved.data;
     }
 
     Profiler profiler("FFTModel::getSourceData (cache miss)");
     
-    if (range.first < m_savedData.range.second &&
-        range.first >= m_savedData.range.first &&
-        range.second > m_savedData.range.second) {
+    if (range.first < saved.range.second &&
+        range.first >= saved.range.first &&
+        range.second > saved.range.second) {
 
         inSourceCache.partial();
         
-        sv_frame_t discard = range.first - m_savedData.range.first;
+        sv_frame_t discard = range.first - saved.range.first;
 
         fvec data;
         data.reserve(range.second - range.first);
 
         data.insert(data.end(),
-                    m_savedData.data.begin() + discard,
-                    m_savedData.data.end());
+                    saved.data.begin() + discard,
+                    saved.data.end());
 
         fvec rest = getSourceDataUncached
-            ({ m_savedData.range.second, range.second });
+            ({ saved.range.second, range.second });
 
         data.insert(data.end(), rest.begin(), rest.end());
         
-        m_savedData = { range, data };
+        saved = { range, data };
         return data;
 
     } else {
@@ -313,7 +561,7 @@ FFTModel::getSourceData(pair<sv_frame_t, sv_frame_t> range) const
         inSourceCache.miss();
         
         auto data = getSourceDataUncached(range);
-        m_savedData = { range, data };
+        saved = { range, data };
         return data;
     }
 }
@@ -332,23 +580,15 @@ FFTModel::getSourceDataUncached(pair<sv_frame_t, sv_frame_t> range) const
         range = { 0, range.second };
     }
 
-    auto data = model->getData(m_channel,
-                               range.first,
-                               range.second - range.first);
-/*
-    if (data.empty()) {
-        SVDEBUG << "NOTE: empty source data for range (" << range.first << ","
-                << range.second << ") (model end frame "
-                << model->getEndFrame() << ")" << endl;
-    }
-*/
-    
-    // don't return a partial frame
-    data.resize(range.second - range.first, 0.f);
-
-    if (pfx > 0) {
-        vector<float> pad(pfx, 0.f);
-        data.insert(data.begin(), pad.begin(), pad.end());
+    // Read straight into the returned buffer, after any zero padding
+    // at the start, and leave any shortfall at the end as zeros (we
+    // don't return a partial frame)
+    fvec data(pfx + (range.second - range.first), 0.f);
+    if (range.second > range.first) {
+        model->readData(m_channel,
+                        range.first,
+                        range.second - range.first,
+                        data.data() + pfx);
     }
     
     if (m_channel == -1) {
@@ -371,14 +611,16 @@ FFTModel::getFFTColumn(int n) const
 {
     int h = getHeight();
     bool truncate = (h < m_fftSize / 2 + 1);
+
+    CalculationContext &context = getContext();
     
-    // The small cache (i.e. the m_cached deque) is for cases where
-    // values are looked up individually, and for e.g. peak-frequency
+    // The small cache (i.e. the context's cached columns) is for
+    // cases where values are looked up individually, and for e.g. peak-frequency
     // spectrograms where values from two consecutive columns are
     // needed at once. This cache gets essentially no hits when
     // scrolling through a magnitude spectrogram, but 95%+ hits with a
     // peak-frequency spectrogram or spectrum.
-    for (const auto &incache : m_cached) {
+    for (const auto &incache : context.cached) {
         if (incache.n == n) {
             inSmallCache.hit();
             if (!truncate) {
@@ -390,20 +632,56 @@ FFTModel::getFFTColumn(int n) const
     }
     inSmallCache.miss();
 
-    Profiler profiler("FFTModel::getFFTColumn (cache miss)");
+    if (auto stored = getStoredColumn(n)) {
+        inColumnStore.hit();
+        return cvec(stored, stored + h);
+    }
+    inColumnStore.miss();
+
+    int prev = context.lastRequestedColumn;
+    context.lastRequestedColumn = n;
+    
+    ReadaheadColumns &readahead = context.readahead;
     
-    auto samples = getSourceSamples(n);
-    m_windower.cut(samples.data() + (m_fftSize - m_windowSize) / 2);
-    breakfastquay::v_fftshift(samples.data(), m_fftSize);
+    if (n >= readahead.first && n < readahead.first + readahead.count) {
+        inReadahead.hit();
+        auto itr = readahead.cols.begin() +
+            size_t(n - readahead.first) * (m_fftSize / 2 + 1);
+        return cvec(itr, itr + h);
+    }
+    inReadahead.miss();
+
+    Profiler profiler("FFTModel::getFFTColumn (cache miss)");
 
-    cvec &col = m_cached[m_cacheWriteIndex].col;
+    // If columns are being requested one after another, in either
+    // direction, calculate a batch of them at once in that direction
+    // rather than just the one asked for
     
-    m_fft.forwardInterleaved(samples.data(),
-                             reinterpret_cast<float *>(col.data()));
+    int first = -1;
+    if (n == prev + 1) {
+        first = n;
+    } else if (n == prev - 1) {
+        first = std::max(0, n - m_batchSize + 1);
+    }
 
-    m_cached[m_cacheWriteIndex].n = n;
+    if (first >= 0) {
+        int count = std::min(m_batchSize, getWidth() - first);
+        if (count > 1) {
+            readahead.cols.resize(size_t(count) * (m_fftSize / 2 + 1));
+            calculateColumnRange(context, first, count, readahead.cols.data());
+            readahead.first = first;
+            readahead.count = count;
+            auto itr = readahead.cols.begin() +
+                size_t(n - first) * (m_fftSize / 2 + 1);
+            return cvec(itr, itr + h);
+        }
+    }
+
+    cvec &col = context.cached[context.cacheWriteIndex].col;
+    calculateColumnRange(context, n, 1, col.data());
+    context.cached[context.cacheWriteIndex].n = n;
 
-    m_cacheWriteIndex = (m_cacheWriteIndex + 1) % m_cacheSize;
+    context.cacheWriteIndex = (context.cacheWriteIndex + 1) % m_cacheSize;
 
     if (!truncate) {
         return col;
@@ -412,6 +690,110 @@ FFTModel::getFFTColumn(int n) const
     }
 }
 
+void
+FFTModel::getFFTColumns(int firstColumn, int count,
+                        std::complex<float> *out) const
+{
+    Profiler profiler("FFTModel::getFFTColumns");
+    
+    int h = getHeight();
+    int fullHeight = m_fftSize / 2 + 1;
+    bool truncate = (h < fullHeight);
+
+    CalculationContext &context = getContext();
+
+    int i = 0;
+    
+    while (i < count) {
+
+        int x = firstColumn + i;
+
+        if (auto stored = getStoredColumn(x)) {
+            inColumnStore.hit();
+            std::copy(stored, stored + h, out + size_t(i) * h);
+            ++i;
+            continue;
+        }
+        inColumnStore.miss();
+
+        // Find the run of columns missing from the store, up to our
+        // batch size, and calculate those together
+        
+        int j = i + 1;
+        while (j < count && j - i < m_batchSize &&
+               !getStoredColumn(firstColumn + j)) {
+            ++j;
+        }
+        int n = j - i;
+
+        if (!truncate) {
+            calculateColumnRange(context, x, n, out + size_t(i) * h);
+        } else {
+            context.batchScratch.resize(size_t(n) * fullHeight);
+            calculateColumnRange(context, x, n, context.batchScratch.data());
+            for (int k = 0; k < n; ++k) {
+                auto itr = context.batchScratch.begin() + size_t(k) * fullHeight;
+                std::copy(itr, itr + h, out + size_t(i + k) * h);
+            }
+        }
+
+        i = j;
+    }
+}
+
+void
+FFTModel::calculateColumnRange(CalculationContext &context,
+                               int firstColumn, int count,
+                               std::complex<float> *out) const
+{
+    // Read the source for all columns at once. Consecutive calls for
+    // consecutive ranges overlap in their source data, which
+    // getSourceData will reuse
+    
+    auto range = std::make_pair
+        (getSourceSampleRange(firstColumn).first,
+         getSourceSampleRange(firstColumn + count - 1).second);
+    
+    auto data = getSourceData(context, range);
+    
+    calculateColumns(data.data(), count, context.windower, context.fft,
+                     context.frames, out);
+}
+
+void
+FFTModel::calculateColumns(const float *source, int count,
+                           const Window<float> &windower,
+                           breakfastquay::FFT &fft,
+                           fvec &frames,
+                           std::complex<float> *out) const
+{
+    // m_fftSize may be greater than m_windowSize, but not the
+    // reverse. Any zero padding is split evenly either side of the
+    // windowed samples.
+
+    int sz = m_fftSize;
+    int off = (sz - m_windowSize) / 2;
+
+    if (int(frames.size()) < count * sz) {
+        frames.resize(size_t(count) * sz);
+    }
+    
+    if (off > 0) {
+        // a previous shift will have moved samples into the padding
+        breakfastquay::v_zero(frames.data(), count * sz);
+    }
+
+    for (int i = 0; i < count; ++i) {
+        float *frame = frames.data() + size_t(i) * sz;
+        windower.cut(source + size_t(i) * m_windowIncrement, frame + off);
+        breakfastquay::v_fftshift(frame, sz);
+    }
+
+    fft.forwardInterleavedMulti(frames.data(), sz,
+                                reinterpret_cast<float *>(out), sz + 2,
+                                count);
+}
+
 bool
 FFTModel::estimateStableFrequency(int x, int y, double &frequency)
 {
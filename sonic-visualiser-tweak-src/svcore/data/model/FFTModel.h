@@ -20,24 +20,34 @@
 #include "DenseTimeValueModel.h"
 
 #include "base/Window.h"
+#include "base/Thread.h"
 
 #include <bqfft/FFT.h>
 #include <bqvec/Allocators.h>
 
+#include <QMutex>
+
 #include <set>
+#include <map>
 #include <vector>
 #include <complex>
+#include <atomic>
+#include <memory>
+
+class FFTColumnStore;
 
 /**
  * An implementation of DenseThreeDimensionalModel that makes FFT data
  * derived from a DenseTimeValueModel available as a generic data
  * grid.
+ *
+ * The model may be read from more than one thread at once: each
+ * reading thread gets its own FFT, window and caches.
  */
 class FFTModel : public DenseThreeDimensionalModel
 {
     Q_OBJECT
 
-    //!!! threading requirements?
     //!!! doubles? since we're not caching much
 
 public:
@@ -117,6 +127,30 @@ public:
     void setMaximumFrequency(double freq);
     double getMaximumFrequency() const { return m_maximumFrequency; }
 
+    /**
+     * Start calculating every column into a persistent on-disc
+     * column store (see FFTColumnStore) in the background, using the
+     * given number of worker threads, or one fewer than the number of
+     * available cores if threads is zero. Columns found in the store
+     * are subsequently returned from it without recalculation, and
+     * the store is retained for use by later sessions that open the
+     * same audio with the same parameters.
+     *
+     * Does nothing if the "Store Spectrogram Data" preference is
+     * off, or if the source model is not an audio file. A store is
+     * identified by the file's path, size and modification time and
+     * a short fingerprint of its audio.
+     *
+     * However many models are filling stores, at most one fewer
+     * block of columns than the number of available cores is
+     * calculated at any one time.
+     *
+     * If the source model is not yet ready, the store is started when
+     * it becomes so. Does nothing if the column store is already
+     * enabled.
+     */
+    void enableColumnStore(int threads = 0);
+
 //!!! review which of these are ever actually called
     
     float getMagnitudeAt(int x, int y) const;
@@ -128,6 +162,18 @@ public:
     bool getPhasesAt(int x, float *values, int minbin = 0, int count = 0) const;
     bool getValuesAt(int x, float *reals, float *imaginaries, int minbin = 0, int count = 0) const;
 
+    /**
+     * Retrieve the complex values of count consecutive columns,
+     * starting at firstColumn, into out, which must have room for
+     * count * getHeight() values. Column i occupies out[i *
+     * getHeight()] onwards. This is much faster than retrieving each
+     * column individually, as the source audio is read once for the
+     * whole range and the columns are windowed and transformed
+     * together.
+     */
+    void getFFTColumns(int firstColumn, int count,
+                       std::complex<float> *out) const;
+
     /**
      * Calculate an estimated frequency for a stable signal in this
      * bin, using phase unwrapping.  This will be completely wrong if
@@ -160,6 +206,11 @@ public:
 
     QString getTypeName() const override { return tr("FFT"); }
 
+    bool supportsConcurrentReads() const override { return true; }
+
+private slots:
+    void sourceModelReady();
+
 private:
     FFTModel(const FFTModel &) =delete;
     FFTModel &operator=(const FFTModel &) =delete;
@@ -171,8 +222,6 @@ private:
     int m_windowSize;
     int m_windowIncrement;
     int m_fftSize;
-    Window<float> m_windower;
-    mutable breakfastquay::FFT m_fft;
     double m_maximumFrequency;
     mutable QString m_error;
     
@@ -192,24 +241,100 @@ private:
     typedef std::vector<std::complex<float>,
                         breakfastquay::StlAllocator<std::complex<float>>> cvec;
 
-    cvec getFFTColumn(int column) const;
-    fvec getSourceSamples(int column) const;
-    fvec getSourceData(std::pair<sv_frame_t, sv_frame_t>) const;
-    fvec getSourceDataUncached(std::pair<sv_frame_t, sv_frame_t>) const;
-
     struct SavedSourceData {
         std::pair<sv_frame_t, sv_frame_t> range;
         fvec data;
     };
-    mutable SavedSourceData m_savedData;
 
     struct SavedColumn {
         int n;
         cvec col;
     };
-    mutable std::vector<SavedColumn> m_cached;
-    mutable size_t m_cacheWriteIndex;
-    size_t m_cacheSize;
+
+    // Columns calculated ahead of (or behind) the most recent
+    // request, when requests are found to be arriving sequentially
+    struct ReadaheadColumns {
+        int first;
+        int count;
+        cvec cols; // count * (m_fftSize/2 + 1)
+    };
+
+    /**
+     * Everything that a column calculation writes to. One of these
+     * is kept for each thread that reads from the model, so that
+     * columns may be retrieved from several threads at once (see
+     * supportsConcurrentReads()) and so that each thread's caches
+     * reflect its own access pattern. Contexts are held in
+     * thread-local storage (see getContext()), so they need no
+     * locking and are deleted when their thread exits.
+     */
+    struct CalculationContext {
+        CalculationContext(const FFTModel &model);
+        Window<float> windower;
+        breakfastquay::FFT fft;
+        SavedSourceData savedData;
+        std::vector<SavedColumn> cached;
+        size_t cacheWriteIndex;
+        ReadaheadColumns readahead;
+        int lastRequestedColumn;
+        fvec frames; // scratch for calculateColumns
+        cvec batchScratch; // for truncated columns in getFFTColumns
+    };
+
+    CalculationContext &getContext() const;
+
+    // Owned only by this model: contexts refer to it weakly, so as to
+    // find out when the model they were made for has gone
+    std::shared_ptr<const int> m_lifetime;
+
+    cvec getFFTColumn(int column) const;
+    void calculateColumnRange(CalculationContext &context,
+                              int firstColumn, int count,
+                              std::complex<float> *out) const;
+    fvec getSourceData(CalculationContext &context,
+                       std::pair<sv_frame_t, sv_frame_t>) const;
+    fvec getSourceDataUncached(std::pair<sv_frame_t, sv_frame_t>) const;
+
+    static const size_t m_cacheSize;
+    static const int m_batchSize;
+
+    /**
+     * Window, shift and transform count columns' worth of source
+     * samples into out, which must have room for count *
+     * (m_fftSize/2+1) values. The source samples for column i are
+     * the m_windowSize samples starting at source + i *
+     * m_windowIncrement. The windower, fft and frames scratch buffer
+     * (resized as necessary) are passed in so that worker threads can
+     * supply their own.
+     */
+    void calculateColumns(const float *source, int count,
+                          const Window<float> &windower,
+                          breakfastquay::FFT &fft,
+                          fvec &frames,
+                          std::complex<float> *out) const;
+
+    class StoreFillThread : public Thread
+    {
+    public:
+        StoreFillThread(FFTModel &model) : m_model(model) { }
+        void run() override;
+
+    private:
+        FFTModel &m_model;
+    };
+
+    const std::complex<float> *getStoredColumn(int x) const;
+    QString makeSourceKey() const;
+    bool prepareColumnStore();
+    void startColumnStoreThreads();
+
+    int m_storeThreadCount;
+    std::vector<StoreFillThread *> m_storeFillThreads;
+    std::atomic<FFTColumnStore *> m_store;
+    QMutex m_storeMutex;
+    bool m_storePrepared;
+    std::atomic<int> m_nextStoreBlock;
+    std::atomic<bool> m_exiting;
 };
 
 #endif
@@ -134,8 +134,16 @@ public:
     float getValueQuantization() const { return m_valueQuantization; }
     void setValueQuantization(float q) { m_valueQuantization = q; }
 
-    float getValueMinimum() const { return m_valueMinimum; }
-    float getValueMaximum() const { return m_valueMaximum; }
+    // These depend on the events, so decode any that are still in a
+    // blob (see setEventsFromBlob)
+    float getValueMinimum() const {
+        m_events.decodeDeferred();
+        return m_valueMinimum;
+    }
+    float getValueMaximum() const {
+        m_events.decodeDeferred();
+        return m_valueMaximum;
+    }
     
     int getCompletion() const override { return m_completion; }
 
@@ -206,26 +214,28 @@ public:
      */
     void add(Event e) override {
 
-        bool allChange = false;
-           
         m_events.add(e);
-        float v = e.getValue();
-        if (!ISNAN(v) && !ISINF(v)) {
-            if (!m_haveExtents || v < m_valueMinimum) {
-                m_valueMinimum = v; allChange = true;
-            }
-            if (!m_haveExtents || v > m_valueMaximum) {
-                m_valueMaximum = v; allChange = true;
-            }
-            m_haveExtents = true;
-        }
-        
+
+        bool allChange = updateExtents(e);
+
         m_notifier.update(e.getFrame(), e.getDuration() + m_resolution);
 
         if (allChange) {
             emit modelChanged(getId());
         }
     }
+
+    bool setEventsFromBlob(std::shared_ptr<const void> owner,
+                           const char *data, qint64 size) override {
+        if (!m_events.setFromBlob(owner, data, size,
+                                  [this](const Event &e) {
+                                      updateExtents(e);
+                                  })) {
+            return false;
+        }
+        emit modelChanged(getId());
+        return true;
+    }
     
     void remove(Event e) override {
         m_events.remove(e);
@@ -423,6 +433,26 @@ public:
     }
 
 protected:
+    // Take account of a new event in the extents, returning true if
+    // they have changed
+    bool updateExtents(const Event &e) {
+
+        bool allChange = false;
+
+        float v = e.getValue();
+        if (!ISNAN(v) && !ISINF(v)) {
+            if (!m_haveExtents || v < m_valueMinimum) {
+                m_valueMinimum = v; allChange = true;
+            }
+            if (!m_haveExtents || v > m_valueMaximum) {
+                m_valueMaximum = v; allChange = true;
+            }
+            m_haveExtents = true;
+        }
+
+        return allChange;
+    }
+
     Subtype m_subtype;
     sv_samplerate_t m_sampleRate;
     int m_resolution;
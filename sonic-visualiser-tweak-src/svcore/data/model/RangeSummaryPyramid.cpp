@@ -0,0 +1,228 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "RangeSummaryPyramid.h"
+
+#include <QIODevice>
+
+#include <cstring>
+
+namespace {
+
+const char *const magic = "SVRSPYR1";
+const uint32_t formatVersion = 1;
+
+struct Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t channels;
+    uint32_t baseBlockSize;
+    uint32_t levelCount;
+};
+
+// Ranges are written as min, max, absmean
+const int valuesPerRange = 3;
+
+// Number of ranges converted at a time when reading or writing
+const size_t chunkSize = 16384;
+
+}
+
+RangeSummaryPyramid::RangeSummaryPyramid(int channels, int baseBlockSize) :
+    m_channels(channels),
+    m_baseBlockSize(baseBlockSize),
+    m_finished(false)
+{
+}
+
+sv_frame_t
+RangeSummaryPyramid::getBlockCount(int level) const
+{
+    if (level < 0 || level >= getLevelCount() || m_channels == 0) return 0;
+    return sv_frame_t(m_levels[level].size()) / m_channels;
+}
+
+void
+RangeSummaryPyramid::append(const Range *ranges)
+{
+    if (m_finished) return;
+    appendAt(0, ranges);
+}
+
+void
+RangeSummaryPyramid::appendAt(int level, const Range *ranges)
+{
+    if (level == getLevelCount()) {
+        m_levels.push_back({});
+    }
+
+    RangeBlock &block = m_levels[level];
+    block.insert(block.end(), ranges, ranges + m_channels);
+
+    size_t n = block.size() / m_channels;
+    if (n % 2 != 0) return;
+
+    // Both halves of a block at the next level up are now present
+
+    std::vector<Range> merged(m_channels);
+    for (int c = 0; c < m_channels; ++c) {
+        merged[c] = merge(block[(n - 2) * m_channels + c],
+                          block[(n - 1) * m_channels + c]);
+    }
+    appendAt(level + 1, merged.data());
+}
+
+void
+RangeSummaryPyramid::finish()
+{
+    if (m_finished) return;
+
+    // An odd number of blocks at any level (other than a single
+    // block at the top) means the last one has not been summarised
+    // above. Carry it up on its own, as a partial block.
+
+    for (int level = 0; level < getLevelCount(); ++level) {
+        size_t n = m_levels[level].size() / m_channels;
+        if (n > 1 && n % 2 != 0) {
+            std::vector<Range> trailing(m_levels[level].end() - m_channels,
+                                        m_levels[level].end());
+            appendAt(level + 1, trailing.data());
+        }
+    }
+
+    m_finished = true;
+}
+
+size_t
+RangeSummaryPyramid::getDataSize() const
+{
+    size_t total = 0;
+    for (const auto &block: m_levels) {
+        total += block.size() * sizeof(Range);
+    }
+    return total;
+}
+
+bool
+RangeSummaryPyramid::write(QIODevice &device) const
+{
+    Header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magic, sizeof(header.magic));
+    header.version = formatVersion;
+    header.channels = uint32_t(m_channels);
+    header.baseBlockSize = uint32_t(m_baseBlockSize);
+    header.levelCount = uint32_t(m_levels.size());
+
+    if (device.write(reinterpret_cast<const char *>(&header), sizeof(header))
+        != qint64(sizeof(header))) {
+        return false;
+    }
+
+    for (const auto &block: m_levels) {
+        uint64_t count = block.size();
+        if (device.write(reinterpret_cast<const char *>(&count), sizeof(count))
+            != qint64(sizeof(count))) {
+            return false;
+        }
+    }
+
+    std::vector<float> buffer(chunkSize * valuesPerRange);
+
+    for (const auto &block: m_levels) {
+        for (size_t i = 0; i < block.size(); i += chunkSize) {
+            size_t n = std::min(chunkSize, block.size() - i);
+            for (size_t j = 0; j < n; ++j) {
+                const Range &r = block[i + j];
+                buffer[j * valuesPerRange] = r.min();
+                buffer[j * valuesPerRange + 1] = r.max();
+                buffer[j * valuesPerRange + 2] = r.absmean();
+            }
+            qint64 bytes = qint64(n * valuesPerRange * sizeof(float));
+            if (device.write(reinterpret_cast<const char *>(buffer.data()),
+                             bytes) != bytes) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool
+RangeSummaryPyramid::read(QIODevice &device)
+{
+    m_levels.clear();
+    m_finished = false;
+
+    Header header;
+    if (device.read(reinterpret_cast<char *>(&header), sizeof(header))
+        != qint64(sizeof(header))) {
+        return false;
+    }
+    if (memcmp(header.magic, magic, sizeof(header.magic)) ||
+        header.version != formatVersion ||
+        header.channels != uint32_t(m_channels) ||
+        header.baseBlockSize != uint32_t(m_baseBlockSize) ||
+        header.levelCount > 64) {
+        return false;
+    }
+
+    std::vector<uint64_t> counts(header.levelCount);
+    for (auto &count: counts) {
+        if (device.read(reinterpret_cast<char *>(&count), sizeof(count))
+            != qint64(sizeof(count))) {
+            return false;
+        }
+    }
+
+    // Check that the counts are plausible before allocating
+    // anything. Compare each against the number of ranges the rest of
+    // the device could hold, rather than multiplying it out, so that a
+    // corrupt count cannot overflow
+    qint64 available = device.bytesAvailable();
+    if (available < 0) return false;
+    uint64_t remaining =
+        uint64_t(available) / (valuesPerRange * sizeof(float));
+    for (auto count: counts) {
+        if (count % m_channels != 0) return false;
+        if (count > remaining) return false;
+        remaining -= count;
+    }
+
+    std::vector<RangeBlock> levels(counts.size());
+    std::vector<float> buffer(chunkSize * valuesPerRange);
+
+    for (size_t level = 0; level < counts.size(); ++level) {
+        RangeBlock &block = levels[level];
+        block.reserve(counts[level]);
+        for (uint64_t i = 0; i < counts[level]; i += chunkSize) {
+            size_t n = size_t(std::min(uint64_t(chunkSize), counts[level] - i));
+            qint64 bytes = qint64(n * valuesPerRange * sizeof(float));
+            if (device.read(reinterpret_cast<char *>(buffer.data()), bytes)
+                != bytes) {
+                return false;
+            }
+            for (size_t j = 0; j < n; ++j) {
+                block.push_back(Range(buffer[j * valuesPerRange],
+                                      buffer[j * valuesPerRange + 1],
+                                      buffer[j * valuesPerRange + 2]));
+            }
+        }
+    }
+
+    m_levels.swap(levels);
+    m_finished = true;
+    return true;
+}
@@ -0,0 +1,132 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_RANGE_SUMMARY_PYRAMID_H
+#define SV_RANGE_SUMMARY_PYRAMID_H
+
+#include "RangeSummarisableTimeValueModel.h"
+
+#include <vector>
+#include <algorithm>
+
+class QIODevice;
+
+/**
+ * A multi-resolution store of min/max/absmean summaries for a
+ * multi-channel signal. Level 0 contains one range per channel for
+ * each block of getBaseBlockSize() frames; each subsequent level
+ * summarises pairs of blocks from the level below, so that level n
+ * has a block size of getBaseBlockSize() * 2^n. A summary at any
+ * power-of-two multiple of the base block size can therefore be read
+ * from a single level with one range per output block.
+ *
+ * Each level is a RangeBlock with channels interleaved, i.e. the
+ * range for block b and channel c is at index b * channels + c.
+ *
+ * The pyramid is built incrementally by appending base-level blocks
+ * with append(). Coarser levels are filled as soon as both of their
+ * halves are available. Call finish() after appending the final
+ * (possibly partial) block, to propagate any unpaired trailing
+ * blocks upward so that every level covers the whole signal.
+ *
+ * This class is not thread-safe; callers must lock.
+ */
+class RangeSummaryPyramid
+{
+public:
+    typedef RangeSummarisableTimeValueModel::Range Range;
+    typedef RangeSummarisableTimeValueModel::RangeBlock RangeBlock;
+
+    RangeSummaryPyramid(int channels, int baseBlockSize);
+
+    int getChannelCount() const { return m_channels; }
+    int getBaseBlockSize() const { return m_baseBlockSize; }
+
+    /**
+     * Return the number of levels, including the base level. This
+     * is zero if nothing has been appended.
+     */
+    int getLevelCount() const { return int(m_levels.size()); }
+
+    /**
+     * Return the block size, in frames, of the given level.
+     */
+    sv_frame_t getBlockSize(int level) const {
+        return sv_frame_t(m_baseBlockSize) << level;
+    }
+
+    /**
+     * Return the number of blocks (per channel) available at the
+     * given level.
+     */
+    sv_frame_t getBlockCount(int level) const;
+
+    /**
+     * Return the interleaved ranges of the given level.
+     */
+    const RangeBlock &getLevel(int level) const { return m_levels.at(level); }
+
+    /**
+     * Append a single base-level block, supplied as one range per
+     * channel.
+     */
+    void append(const Range *ranges);
+
+    /**
+     * Mark the pyramid complete, propagating trailing blocks upward.
+     * Nothing may be appended after this.
+     */
+    void finish();
+
+    bool isFinished() const { return m_finished; }
+
+    /**
+     * Return the total size of the summary data in bytes.
+     */
+    size_t getDataSize() const;
+
+    /**
+     * Write the pyramid to the given device. The pyramid should have
+     * been finished. Return false on a write error.
+     */
+    bool write(QIODevice &device) const;
+
+    /**
+     * Replace the contents of this pyramid with those read from the
+     * given device. Return false, leaving this pyramid empty, if the
+     * device does not contain a finished pyramid with the same
+     * channel count and base block size as this one.
+     */
+    bool read(QIODevice &device);
+
+    /**
+     * Return a range summarising the two given ranges, which are
+     * assumed to represent the same number of frames.
+     */
+    static Range merge(const Range &a, const Range &b) {
+        return Range(std::min(a.min(), b.min()),
+                     std::max(a.max(), b.max()),
+                     (a.absmean() + b.absmean()) / 2.f);
+    }
+
+private:
+    int m_channels;
+    int m_baseBlockSize;
+    std::vector<RangeBlock> m_levels;
+    bool m_finished;
+
+    void appendAt(int level, const Range *ranges);
+};
+
+#endif
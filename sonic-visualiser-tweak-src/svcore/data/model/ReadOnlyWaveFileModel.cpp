@@ -22,12 +22,19 @@
 
 #include "base/Preferences.h"
 #include "base/PlayParameterRepository.h"
+#include "base/CacheDirectory.h"
+#include "base/Exceptions.h"
 
 #include <QFileInfo>
 #include <QTextStream>
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QSettings>
+#include <QSaveFile>
 
 #include <iostream>
 #include <cmath>
+#include <algorithm>
 #include <sndfile.h>
 
 #include <cassert>
@@ -52,8 +59,12 @@ ReadOnlyWaveFileModel::ReadOnlyWaveFileModel(FileSource source, sv_samplerate_t
     m_prevCompletion(0),
     m_exiting(false),
     m_lastDirectReadStart(0),
-    m_lastDirectReadCount(0)
+    m_lastDirectReadCount(0),
+    m_summaryAccount("ReadOnlyWaveFileModel summaries",
+                     MemoryBudget::Unevictable)
 {
+    m_pyramid[0] = m_pyramid[1] = nullptr;
+    
     SVDEBUG << "ReadOnlyWaveFileModel::ReadOnlyWaveFileModel: path "
             << m_path << ", target rate " << targetRate << endl;
     
@@ -101,8 +112,12 @@ ReadOnlyWaveFileModel::ReadOnlyWaveFileModel(FileSource source, AudioFileReader
     m_updateTimer(nullptr),
     m_lastFillExtent(0),
     m_prevCompletion(0),
-    m_exiting(false)
+    m_exiting(false),
+    m_summaryAccount("ReadOnlyWaveFileModel summaries",
+                     MemoryBudget::Unevictable)
 {
+    m_pyramid[0] = m_pyramid[1] = nullptr;
+    
     SVDEBUG << "ReadOnlyWaveFileModel::ReadOnlyWaveFileModel: path "
             << m_path << ", with reader" << endl;
     
@@ -126,8 +141,12 @@ ReadOnlyWaveFileModel::~ReadOnlyWaveFileModel()
     m_reader = nullptr;
 
     SVDEBUG << "ReadOnlyWaveFileModel: Destructor exiting; we had caches of "
-            << (m_cache[0].size() * sizeof(Range)) << " and "
-            << (m_cache[1].size() * sizeof(Range)) << " bytes" << endl;
+            << (m_pyramid[0] ? m_pyramid[0]->getDataSize() : 0) << " and "
+            << (m_pyramid[1] ? m_pyramid[1]->getDataSize() : 0) << " bytes"
+            << endl;
+
+    delete m_pyramid[0];
+    delete m_pyramid[1];
 }
 
 bool
@@ -249,58 +268,101 @@ ReadOnlyWaveFileModel::getData(int channel,
     // channels (if channel == -1) directly from the file.  This is
     // used for e.g. audio playback or input to transforms.
 
-    Profiler profiler("ReadOnlyWaveFileModel::getData");
+    if (!m_reader || !m_reader->isOK() || count <= 0) {
+        return {};
+    }
+
+    // Don't allocate for more than the reader can currently provide
+    count = std::min(count, m_startFrame + m_reader->getFrameCount() - start);
+    if (count <= 0) return {};
+
+    floatvec_t result(count, 0.f);
+    sv_frame_t obtained = readData(channel, start, count, result.data());
+    result.resize(obtained);
+    return result;
+}
+
+sv_frame_t
+ReadOnlyWaveFileModel::readData(int channel,
+                                sv_frame_t start,
+                                sv_frame_t count,
+                                float *buffer)
+    const
+{
+    Profiler profiler("ReadOnlyWaveFileModel::readData");
     
 #ifdef DEBUG_WAVE_FILE_MODEL_READ
-    cout << "ReadOnlyWaveFileModel::getData[" << this << "]: " << channel << ", " << start << ", " << count << endl;
+    cout << "ReadOnlyWaveFileModel::readData[" << this << "]: " << channel << ", " << start << ", " << count << endl;
 #endif
 
     int channels = getChannelCount();
 
     if (channel >= channels) {
-        SVCERR << "ERROR: WaveFileModel::getData: channel ("
+        SVCERR << "ERROR: WaveFileModel::readData: channel ("
              << channel << ") >= channel count (" << channels << ")"
              << endl;
-        return {};
+        return 0;
     }
 
-    if (!m_reader || !m_reader->isOK() || count == 0) {
-        return {};
+    if (!m_reader || !m_reader->isOK() || count <= 0) {
+        return 0;
     }
 
     if (start >= m_startFrame) {
         start -= m_startFrame;
     } else {
         if (count <= m_startFrame - start) {
-            return {};
+            return 0;
         } else {
             count -= (m_startFrame - start);
             start = 0;
         }
     }
 
-    floatvec_t interleaved = m_reader->getInterleavedFrames(start, count);
-    if (channels == 1) return interleaved;
+    if (channels == 1) {
+        return m_reader->readInterleavedFrames(start, count, buffer);
+    }
 
-    sv_frame_t obtained = interleaved.size() / channels;
-    
-    floatvec_t result(obtained, 0.f);
-    
-    if (channel != -1) {
-        // get a single channel
-        for (int i = 0; i < obtained; ++i) {
-            result[i] = interleaved[i * channels + channel];
-        }
-    } else {
-        // channel == -1, mix down all channels
-        for (int i = 0; i < obtained; ++i) {
-            for (int c = 0; c < channels; ++c) {
-                result[i] += interleaved[i * channels + c];
+    // Convert a block at a time into a scratch buffer that is kept
+    // per thread, so that repeated reads allocate nothing
+
+    const sv_frame_t blockSize = 16384;
+    thread_local std::vector<float> interleaved;
+    if (sv_frame_t(interleaved.size()) < blockSize * channels) {
+        interleaved.resize(blockSize * channels);
+    }
+
+    sv_frame_t obtained = 0;
+
+    while (obtained < count) {
+
+        sv_frame_t n = m_reader->readInterleavedFrames
+            (start + obtained, std::min(blockSize, count - obtained),
+             interleaved.data());
+        if (n <= 0) break;
+
+        float *out = buffer + obtained;
+        
+        if (channel != -1) {
+            // get a single channel
+            for (sv_frame_t i = 0; i < n; ++i) {
+                out[i] = interleaved[i * channels + channel];
+            }
+        } else {
+            // channel == -1, mix down all channels
+            for (sv_frame_t i = 0; i < n; ++i) {
+                float sum = 0.f;
+                for (int c = 0; c < channels; ++c) {
+                    sum += interleaved[i * channels + c];
+                }
+                out[i] = sum;
             }
         }
+
+        obtained += n;
     }
 
-    return result;
+    return obtained;
 }
 
 vector<floatvec_t>
@@ -310,61 +372,109 @@ ReadOnlyWaveFileModel::getMultiChannelData(int fromchannel, int tochannel,
     // Read a set of channels directly from the file.  This is used
     // for e.g. audio playback or input to transforms.
 
-    Profiler profiler("ReadOnlyWaveFileModel::getMultiChannelData");
+    if (!m_reader || !m_reader->isOK() || count <= 0 ||
+        fromchannel > tochannel) {
+        return {};
+    }
+
+    // Don't allocate for more than the reader can currently provide
+    count = std::min(count, m_startFrame + m_reader->getFrameCount() - start);
+    if (count <= 0) return {};
+
+    int reqchannels = (tochannel - fromchannel) + 1;
+    vector<floatvec_t> result(reqchannels, floatvec_t(count, 0.f));
+
+    vector<float *> buffers(reqchannels);
+    for (int c = 0; c < reqchannels; ++c) {
+        buffers[c] = result[c].data();
+    }
+
+    sv_frame_t obtained = readMultiChannelData
+        (fromchannel, tochannel, start, count, buffers.data());
+    if (obtained == 0 && tochannel >= getChannelCount()) {
+        return {};
+    }
+
+    for (auto &r: result) {
+        r.resize(obtained);
+    }
+    return result;
+}
+
+sv_frame_t
+ReadOnlyWaveFileModel::readMultiChannelData(int fromchannel, int tochannel,
+                                            sv_frame_t start, sv_frame_t count,
+                                            float *const *buffers) const
+{
+    Profiler profiler("ReadOnlyWaveFileModel::readMultiChannelData");
 
 #ifdef DEBUG_WAVE_FILE_MODEL_READ
-    cout << "ReadOnlyWaveFileModel::getData[" << this << "]: " << fromchannel << "," << tochannel << ", " << start << ", " << count << endl;
+    cout << "ReadOnlyWaveFileModel::readMultiChannelData[" << this << "]: " << fromchannel << "," << tochannel << ", " << start << ", " << count << endl;
 #endif
 
     int channels = getChannelCount();
 
     if (fromchannel > tochannel) {
-        SVCERR << "ERROR: ReadOnlyWaveFileModel::getMultiChannelData: "
+        SVCERR << "ERROR: ReadOnlyWaveFileModel::readMultiChannelData: "
                << "fromchannel (" << fromchannel
                << ") > tochannel (" << tochannel << ")"
                << endl;
-        return {};
+        return 0;
     }
 
     if (tochannel >= channels) {
-        SVCERR << "ERROR: ReadOnlyWaveFileModel::getMultiChannelData: "
+        SVCERR << "ERROR: ReadOnlyWaveFileModel::readMultiChannelData: "
                << "tochannel (" << tochannel
                << ") >= channel count (" << channels << ")"
                << endl;
-        return {};
+        return 0;
     }
 
-    if (!m_reader || !m_reader->isOK() || count == 0) {
-        return {};
+    if (!m_reader || !m_reader->isOK() || count <= 0) {
+        return 0;
     }
 
-    int reqchannels = (tochannel - fromchannel) + 1;
-
     if (start >= m_startFrame) {
         start -= m_startFrame;
     } else {
         if (count <= m_startFrame - start) {
-            return {};
+            return 0;
         } else {
             count -= (m_startFrame - start);
             start = 0;
         }
     }
 
-    floatvec_t interleaved = m_reader->getInterleavedFrames(start, count);
-    if (channels == 1) return { interleaved };
+    if (channels == 1) {
+        return m_reader->readInterleavedFrames(start, count, buffers[0]);
+    }
+
+    const sv_frame_t blockSize = 16384;
+    thread_local std::vector<float> interleaved;
+    if (sv_frame_t(interleaved.size()) < blockSize * channels) {
+        interleaved.resize(blockSize * channels);
+    }
+
+    sv_frame_t obtained = 0;
+
+    while (obtained < count) {
 
-    sv_frame_t obtained = interleaved.size() / channels;
-    vector<floatvec_t> result(reqchannels, floatvec_t(obtained, 0.f));
+        sv_frame_t n = m_reader->readInterleavedFrames
+            (start + obtained, std::min(blockSize, count - obtained),
+             interleaved.data());
+        if (n <= 0) break;
 
-    for (int c = fromchannel; c <= tochannel; ++c) {
-        int destc = c - fromchannel;
-        for (int i = 0; i < obtained; ++i) {
-            result[destc][i] = interleaved[i * channels + c];
+        for (int c = fromchannel; c <= tochannel; ++c) {
+            float *out = buffers[c - fromchannel] + obtained;
+            for (sv_frame_t i = 0; i < n; ++i) {
+                out[i] = interleaved[i * channels + c];
+            }
         }
+
+        obtained += n;
     }
     
-    return result;
+    return obtained;
 }
 
 int
@@ -461,19 +571,26 @@ ReadOnlyWaveFileModel::getSummaries(int channel, sv_frame_t start, sv_frame_t co
     } else {
 
         QMutexLocker locker(&m_mutex);
-    
-        const RangeBlock &cache = m_cache[cacheType];
+
+        const RangeSummaryPyramid *pyramid = m_pyramid[cacheType];
+        if (!pyramid || pyramid->getLevelCount() == 0) return;
 
         blockSize = roundedBlockSize;
 
         sv_frame_t cacheBlock, div;
 
-        cacheBlock = (sv_frame_t(1) << m_zoomConstraint.getMinCachePower());
-        if (cacheType == 1) {
-            cacheBlock = sv_frame_t(double(cacheBlock) * sqrt(2.) + 0.01);
-        }
+        cacheBlock = pyramid->getBaseBlockSize();
         div = blockSize / cacheBlock;
 
+        // Read from the coarsest level that can supply this block
+        // size, so that we only have to aggregate a few ranges per
+        // output block however far out we are zoomed
+        
+        int level = chooseSummaryLevel(*pyramid, start, count, div);
+        const RangeBlock &cache = pyramid->getLevel(level);
+        cacheBlock = pyramid->getBlockSize(level);
+        div = div >> level;
+
         sv_frame_t startIndex = start / cacheBlock;
         sv_frame_t endIndex = (start + count) / cacheBlock;
 
@@ -481,7 +598,7 @@ ReadOnlyWaveFileModel::getSummaries(int channel, sv_frame_t start, sv_frame_t co
         sv_frame_t i = 0, got = 0;
 
 #ifdef DEBUG_WAVE_FILE_MODEL_READ
-        cerr << "blockSize is " << blockSize << ", cacheBlock " << cacheBlock << ", start " << start << ", count " << count << " (frame count " << getFrameCount() << "), power is " << power << ", div is " << div << ", startIndex " << startIndex << ", endIndex " << endIndex << endl;
+        cerr << "blockSize is " << blockSize << ", level " << level << ", cacheBlock " << cacheBlock << ", start " << start << ", count " << count << " (frame count " << getFrameCount() << "), power is " << power << ", div is " << div << ", startIndex " << startIndex << ", endIndex " << endIndex << endl;
 #endif
 
         for (i = 0; i <= endIndex - startIndex; ) {
@@ -515,6 +632,35 @@ ReadOnlyWaveFileModel::getSummaries(int channel, sv_frame_t start, sv_frame_t co
     return;
 }
 
+int
+ReadOnlyWaveFileModel::chooseSummaryLevel(const RangeSummaryPyramid &pyramid,
+                                          sv_frame_t start, sv_frame_t count,
+                                          sv_frame_t div) const
+{
+    // A level is usable if its block size divides both the requested
+    // block size (div base blocks) and the start frame, so that its
+    // blocks fall exactly on the boundaries of the requested ones,
+    // and if it has been filled as far as the base level has for the
+    // requested range. (While the pyramid is still being built, the
+    // coarser levels lag behind the base level.)
+
+    sv_frame_t base = pyramid.getBaseBlockSize();
+    sv_frame_t needed = std::min((start + count) / base + 1,
+                                 pyramid.getBlockCount(0));
+    
+    int level = 0;
+
+    while (level + 1 < pyramid.getLevelCount()) {
+        int next = level + 1;
+        if (div % (sv_frame_t(1) << next) != 0) break;
+        if (start % pyramid.getBlockSize(next) != 0) break;
+        if ((pyramid.getBlockCount(next) << next) < needed) break;
+        level = next;
+    }
+
+    return level;
+}
+
 ReadOnlyWaveFileModel::Range
 ReadOnlyWaveFileModel::getSummary(int channel, sv_frame_t start, sv_frame_t count) const
 {
@@ -617,7 +763,14 @@ ReadOnlyWaveFileModel::cacheFilled()
     m_updateTimer = nullptr;
     auto prevFillExtent = m_lastFillExtent;
     m_lastFillExtent = getEndFrame();
+    size_t summaryBytes = 0;
+    for (int cacheType = 0; cacheType < 2; ++cacheType) {
+        if (m_pyramid[cacheType]) {
+            summaryBytes += m_pyramid[cacheType]->getDataSize();
+        }
+    }
     m_mutex.unlock();
+    m_summaryAccount.setBytes(summaryBytes);
 #ifdef DEBUG_WAVE_FILE_MODEL
     SVCERR << "ReadOnlyWaveFileModel(" << objectName() << ")::cacheFilled, about to emit things" << endl;
 #endif
@@ -628,6 +781,164 @@ ReadOnlyWaveFileModel::cacheFilled()
     emit ready(getId());
 }
 
+CacheDirectory &
+ReadOnlyWaveFileModel::getSummaryCacheDirectory()
+{
+    static CacheDirectory directory("summary-cache", 2048);
+    return directory;
+}
+
+QString
+ReadOnlyWaveFileModel::getSourceIdentity() const
+{
+    if (!m_reader) return {};
+    
+    // Identify the file by its original location rather than by the
+    // reader's local filename, which for a coded file is a decode
+    // cache that differs from one session to the next
+    QString filename = m_source.getLocalFilename();
+    if (filename == "") filename = getLocalFilename();
+    if (filename == "") return {};
+
+    QFileInfo fi(filename);
+    if (!fi.exists()) return {};
+
+    // The file's identity, plus everything that may affect the
+    // decoded samples (rate conversion, normalisation, gapless
+    // trimming)
+    
+    Preferences *prefs = Preferences::getInstance();
+    
+    return QString("%1:%2:%3:%4:%5:%6:%7")
+        .arg(fi.canonicalFilePath())
+        .arg(fi.size())
+        .arg(fi.lastModified().toMSecsSinceEpoch())
+        .arg(m_reader->getSampleRate())
+        .arg(m_reader->getChannelCount())
+        .arg(prefs->getNormaliseAudio())
+        .arg(prefs->getUseGaplessMode());
+}
+
+QString
+ReadOnlyWaveFileModel::getSummaryCacheKey() const
+{
+    QSettings settings;
+    settings.beginGroup("SummaryCache");
+    bool enabled = settings.value("enabled", true).toBool();
+    settings.endGroup();
+    if (!enabled) return {};
+
+    QString identity = getSourceIdentity();
+    if (identity == "") return {};
+
+    // Add a fingerprint of the first decoded audio as a check
+    // against anything the identity misses. A reader that is still
+    // decoding may not have that much audio yet, in which case we
+    // wait for it.
+
+    const sv_frame_t fingerprintFrames = 65536;
+
+    while (!m_exiting &&
+           m_reader->isUpdating() &&
+           m_reader->getFrameCount() < fingerprintFrames) {
+        QThread::msleep(100);
+    }
+    if (m_exiting) return {};
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(identity.toUtf8());
+
+    auto data = m_reader->getInterleavedFrames(0, fingerprintFrames);
+    hash.addData(reinterpret_cast<const char *>(data.data()),
+                 int(data.size() * sizeof(float)));
+
+    return QString::fromLatin1(hash.result().toHex()) + ".svsum";
+}
+
+bool
+ReadOnlyWaveFileModel::loadSummaries(QString key, int channels)
+{
+    CacheDirectory &directory = getSummaryCacheDirectory();
+
+    QFile file;
+    try {
+        file.setFileName(directory.getFilePath(key));
+    } catch (const DirectoryCreationFailed &f) {
+        SVCERR << "WARNING: ReadOnlyWaveFileModel::loadSummaries: "
+               << f.what() << endl;
+        return false;
+    }
+    
+    if (!file.exists() || !file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    RangeSummaryPyramid *loaded[2];
+
+    for (int cacheType = 0; cacheType < 2; ++cacheType) {
+        loaded[cacheType] = new RangeSummaryPyramid
+            (channels, m_pyramid[cacheType]->getBaseBlockSize());
+        if (!loaded[cacheType]->read(file)) {
+            SVDEBUG << "ReadOnlyWaveFileModel::loadSummaries: cached summary "
+                    << key << " is unusable, removing it" << endl;
+            delete loaded[0];
+            if (cacheType == 1) delete loaded[1];
+            file.close();
+            directory.remove(key);
+            return false;
+        }
+    }
+
+    directory.touch(key);
+
+    QMutexLocker locker(&m_mutex);
+
+    for (int cacheType = 0; cacheType < 2; ++cacheType) {
+        delete m_pyramid[cacheType];
+        m_pyramid[cacheType] = loaded[cacheType];
+    }
+
+    SVDEBUG << "ReadOnlyWaveFileModel::loadSummaries: loaded " << key << endl;
+    return true;
+}
+
+void
+ReadOnlyWaveFileModel::saveSummaries(QString key) const
+{
+    CacheDirectory &directory = getSummaryCacheDirectory();
+
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_pyramid[0] || !m_pyramid[1]) return;
+
+    qint64 size = qint64(m_pyramid[0]->getDataSize() +
+                         m_pyramid[1]->getDataSize());
+    
+    try {
+        if (!directory.prune(size)) {
+            SVDEBUG << "ReadOnlyWaveFileModel::saveSummaries: summary of "
+                    << size << " bytes would exceed cache limit, not saving"
+                    << endl;
+            return;
+        }
+
+        // QSaveFile so that a partly-written file is never seen
+        QSaveFile file(directory.getFilePath(key));
+        if (!file.open(QIODevice::WriteOnly) ||
+            !m_pyramid[0]->write(file) ||
+            !m_pyramid[1]->write(file) ||
+            !file.commit()) {
+            SVCERR << "WARNING: ReadOnlyWaveFileModel::saveSummaries: failed "
+                   << "to write " << file.fileName() << ": "
+                   << file.errorString() << endl;
+        }
+        
+    } catch (const DirectoryCreationFailed &f) {
+        SVCERR << "WARNING: ReadOnlyWaveFileModel::saveSummaries: "
+               << f.what() << endl;
+    }
+}
+
 void
 ReadOnlyWaveFileModel::RangeCacheFillThread::run()
 {
@@ -638,7 +949,6 @@ ReadOnlyWaveFileModel::RangeCacheFillThread::run()
     
     sv_frame_t frame = 0;
     const sv_frame_t readBlockSize = 32768;
-    floatvec_t block;
 
     if (!m_model.isOK()) return;
     
@@ -655,6 +965,37 @@ ReadOnlyWaveFileModel::RangeCacheFillThread::run()
         }
     }
 
+    if (m_model.m_exiting) return;
+
+    m_model.m_mutex.lock();
+    for (int cacheType = 0; cacheType < 2; ++cacheType) {
+        m_model.m_pyramid[cacheType] = new RangeSummaryPyramid
+            (channels, cacheBlockSize[cacheType]);
+    }
+    m_model.m_mutex.unlock();
+
+    QString cacheKey = m_model.getSummaryCacheKey();
+
+    if (cacheKey != "" && m_model.loadSummaries(cacheKey, channels)) {
+
+        // We have the complete summaries already, but we still
+        // track the reader's progress so as to report it and so as
+        // not to be ready until it is
+
+        while (!m_model.m_exiting) {
+            updating = m_model.m_reader->isUpdating();
+            m_frameCount = m_model.getFrameCount();
+            m_fillExtent = m_frameCount;
+            if (!updating) break;
+            sleep(1);
+        }
+        return;
+    }
+
+    floatvec_t block(readBlockSize * channels, 0.f);
+
+    // Ranges in progress for each cache type, with channels
+    // consecutive within each type
     Range *range = new Range[2 * channels];
     float *means = new float[2 * channels];
     int count[2];
@@ -685,9 +1026,8 @@ ReadOnlyWaveFileModel::RangeCacheFillThread::run()
                 break;
             }
 
-            block = m_model.m_reader->getInterleavedFrames(frame, readBlockSize);
-
-            sv_frame_t gotBlockSize = block.size() / channels;
+            sv_frame_t gotBlockSize = m_model.m_reader->readInterleavedFrames
+                (frame, readBlockSize, block.data());
 
             m_model.m_mutex.lock();
 
@@ -699,7 +1039,7 @@ ReadOnlyWaveFileModel::RangeCacheFillThread::run()
                     float sample = block[index];
                     
                     for (int cacheType = 0; cacheType < 2; ++cacheType) {
-                        sv_frame_t rangeIndex = ch * 2 + cacheType;
+                        sv_frame_t rangeIndex = cacheType * channels + ch;
                         range[rangeIndex].sample(sample);
                         means[rangeIndex] += fabsf(sample);
                     }
@@ -710,10 +1050,16 @@ ReadOnlyWaveFileModel::RangeCacheFillThread::run()
                     if (++count[cacheType] == cacheBlockSize[cacheType]) {
                         
                         for (int ch = 0; ch < int(channels); ++ch) {
-                            int rangeIndex = ch * 2 + cacheType;
+                            int rangeIndex = cacheType * channels + ch;
                             means[rangeIndex] = means[rangeIndex] / float(count[cacheType]);
                             range[rangeIndex].setAbsmean(means[rangeIndex]);
-                            m_model.m_cache[cacheType].push_back(range[rangeIndex]);
+                        }
+
+                        m_model.m_pyramid[cacheType]->append
+                            (range + cacheType * channels);
+                        
+                        for (int ch = 0; ch < int(channels); ++ch) {
+                            int rangeIndex = cacheType * channels + ch;
                             range[rangeIndex] = Range();
                             means[rangeIndex] = 0.f;
                         }
@@ -747,19 +1093,24 @@ ReadOnlyWaveFileModel::RangeCacheFillThread::run()
             if (count[cacheType] > 0) {
 
                 for (int ch = 0; ch < int(channels); ++ch) {
-                    int rangeIndex = ch * 2 + cacheType;
+                    int rangeIndex = cacheType * channels + ch;
                     means[rangeIndex] = means[rangeIndex] / float(count[cacheType]);
                     range[rangeIndex].setAbsmean(means[rangeIndex]);
-                    m_model.m_cache[cacheType].push_back(range[rangeIndex]);
+                }
+                
+                m_model.m_pyramid[cacheType]->append
+                    (range + cacheType * channels);
+                
+                for (int ch = 0; ch < int(channels); ++ch) {
+                    int rangeIndex = cacheType * channels + ch;
                     range[rangeIndex] = Range();
                     means[rangeIndex] = 0.f;
                 }
 
                 count[cacheType] = 0;
             }
-            
-            const Range &rr = *m_model.m_cache[cacheType].begin();
-            MUNLOCK(&rr, m_model.m_cache[cacheType].capacity() * sizeof(Range));
+
+            m_model.m_pyramid[cacheType]->finish();
         }
     }
     
@@ -770,9 +1121,13 @@ ReadOnlyWaveFileModel::RangeCacheFillThread::run()
 
 #ifdef DEBUG_WAVE_FILE_MODEL        
     for (int cacheType = 0; cacheType < 2; ++cacheType) {
-        SVCERR << "ReadOnlyWaveFileModel(" << m_model.objectName() << "): Cache type " << cacheType << " now contains " << m_model.m_cache[cacheType].size() << " ranges" << endl;
+        SVCERR << "ReadOnlyWaveFileModel(" << m_model.objectName() << "): Cache type " << cacheType << " now contains " << m_model.m_pyramid[cacheType]->getLevelCount() << " levels of " << m_model.m_pyramid[cacheType]->getDataSize() << " bytes" << endl;
     }
 #endif
+
+    if (!m_model.m_exiting && cacheKey != "") {
+        m_model.saveSummaries(cacheKey);
+    }
 }
 
 void
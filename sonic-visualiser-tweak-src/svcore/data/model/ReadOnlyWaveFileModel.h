@@ -19,17 +19,20 @@
 #include "WaveFileModel.h"
 
 #include "base/Thread.h"
+#include "base/MemoryBudget.h"
 #include <QMutex>
 #include <QTimer>
 
 #include "data/fileio/FileSource.h"
 
 #include "RangeSummarisableTimeValueModel.h"
+#include "RangeSummaryPyramid.h"
 #include "PowerOfSqrtTwoZoomConstraint.h"
 
 #include <stdlib.h>
 
 class AudioFileReader;
+class CacheDirectory;
 
 class ReadOnlyWaveFileModel : public WaveFileModel
 {
@@ -73,6 +76,16 @@ public:
 
     QString getLocalFilename() const;
 
+    /**
+     * Return a string identifying the source file and the way it is
+     * decoded: its path, size and modification time, the sample rate
+     * and channel count, and the decoding preferences in effect. This
+     * is cheap to obtain and suitable as part of a key for caches of
+     * data derived from the audio. Return an empty string if the
+     * model has no local file.
+     */
+    QString getSourceIdentity() const;
+
     float getValueMinimum() const override { return -1.0f; }
     float getValueMaximum() const override { return  1.0f; }
 
@@ -83,8 +96,15 @@ public:
 
     floatvec_t getData(int channel, sv_frame_t start, sv_frame_t count) const override;
 
+    sv_frame_t readData(int channel, sv_frame_t start, sv_frame_t count,
+                        float *buffer) const override;
+
     std::vector<floatvec_t> getMultiChannelData(int fromchannel, int tochannel, sv_frame_t start, sv_frame_t count) const override;
 
+    sv_frame_t readMultiChannelData(int fromchannel, int tochannel,
+                                    sv_frame_t start, sv_frame_t count,
+                                    float *const *buffers) const override;
+
     int getSummaryBlockSize(int desired) const override;
 
     void getSummaries(int channel, sv_frame_t start, sv_frame_t count,
@@ -124,6 +144,23 @@ protected:
          
     void fillCache();
 
+    /**
+     * Return a key identifying the summaries of this file in the
+     * persistent summary cache, or an empty string if summaries
+     * should not be cached. Called from the fill thread; may wait
+     * for the first audio to be decoded.
+     */
+    QString getSummaryCacheKey() const;
+
+    bool loadSummaries(QString key, int channels);
+    void saveSummaries(QString key) const;
+
+    int chooseSummaryLevel(const RangeSummaryPyramid &pyramid,
+                           sv_frame_t start, sv_frame_t count,
+                           sv_frame_t div) const;
+
+    static CacheDirectory &getSummaryCacheDirectory();
+
     FileSource m_source;
     QString m_path;
     AudioFileReader *m_reader;
@@ -131,7 +168,10 @@ protected:
 
     sv_frame_t m_startFrame;
 
-    RangeBlock m_cache[2]; // interleaved at two base resolutions
+    // Summary pyramids at two base resolutions (power-of-two and
+    // power-of-sqrt-two block sizes). Null until the fill thread has
+    // found the channel count.
+    RangeSummaryPyramid *m_pyramid[2];
     mutable QMutex m_mutex;
     RangeCacheFillThread *m_fillThread;
     QTimer *m_updateTimer;
@@ -144,6 +184,9 @@ protected:
     mutable sv_frame_t m_lastDirectReadStart;
     mutable sv_frame_t m_lastDirectReadCount;
     mutable QMutex m_directReadMutex;
+
+    // Accounts for the summary pyramids, once filled
+    MemoryBudget::Account m_summaryAccount;
 };    
 
 #endif
@@ -83,7 +83,12 @@ public:
     bool canPlay() const override { return true; }
     QString getDefaultPlayClipId() const override { return "tap"; }
     
-    bool hasTextLabels() const { return m_haveTextLabels; }
+    bool hasTextLabels() const {
+        // Depends on the events, so decode any that are still in a
+        // blob (see setEventsFromBlob)
+        m_events.decodeDeferred();
+        return m_haveTextLabels;
+    }
         
     int getCompletion() const override { return m_completion; }
 
@@ -152,12 +157,22 @@ public:
 
         m_events.add(e.withoutValue().withoutDuration());
 
-        if (e.getLabel() != "") {
-            m_haveTextLabels = true;
-        }
-        
+        updateLabelFlag(e);
+
         m_notifier.update(e.getFrame(), m_resolution);
     }
+
+    bool setEventsFromBlob(std::shared_ptr<const void> owner,
+                           const char *data, qint64 size) override {
+        if (!m_events.setFromBlob(owner, data, size,
+                                  [this](const Event &e) {
+                                      updateLabelFlag(e);
+                                  })) {
+            return false;
+        }
+        emit modelChanged(getId());
+        return true;
+    }
     
     void remove(Event e) override {
         m_events.remove(e);
@@ -322,6 +337,12 @@ public:
     }
     
 protected:
+    void updateLabelFlag(const Event &e) {
+        if (e.getLabel() != "") {
+            m_haveTextLabels = true;
+        }
+    }
+
     sv_samplerate_t m_sampleRate;
     int m_resolution;
 
@@ -115,10 +115,20 @@ public:
         UnitDatabase::getInstance()->registerUnit(units);
     }
 
-    bool hasTextLabels() const { return m_haveTextLabels; }
-    
-    float getValueMinimum() const { return m_valueMinimum; }
-    float getValueMaximum() const { return m_valueMaximum; }
+    // These depend on the events, so decode any that are still in a
+    // blob (see setEventsFromBlob)
+    bool hasTextLabels() const {
+        m_events.decodeDeferred();
+        return m_haveTextLabels;
+    }
+    float getValueMinimum() const {
+        m_events.decodeDeferred();
+        return m_valueMinimum;
+    }
+    float getValueMaximum() const {
+        m_events.decodeDeferred();
+        return m_valueMaximum;
+    }
     
     int getCompletion() const override { return m_completion; }
 
@@ -187,24 +197,9 @@ public:
      */
     void add(Event e) override {
 
-        bool allChange = false;
-           
         m_events.add(e.withoutDuration()); // can't have duration here
 
-        if (e.getLabel() != "") {
-            m_haveTextLabels = true;
-        }
-
-        float v = e.getValue();
-        if (!ISNAN(v) && !ISINF(v)) {
-            if (!m_haveExtents || v < m_valueMinimum) {
-                m_valueMinimum = v; allChange = true;
-            }
-            if (!m_haveExtents || v > m_valueMaximum) {
-                m_valueMaximum = v; allChange = true;
-            }
-            m_haveExtents = true;
-        }
+        bool allChange = updateExtents(e);
         
         m_notifier.update(e.getFrame(), m_resolution);
 
@@ -212,6 +207,18 @@ public:
             emit modelChanged(getId());
         }
     }
+
+    bool setEventsFromBlob(std::shared_ptr<const void> owner,
+                           const char *data, qint64 size) override {
+        if (!m_events.setFromBlob(owner, data, size,
+                                  [this](const Event &e) {
+                                      updateExtents(e);
+                                  })) {
+            return false;
+        }
+        emit modelChanged(getId());
+        return true;
+    }
     
     void remove(Event e) override {
         m_events.remove(e);
@@ -361,6 +368,30 @@ public:
     }
   
 protected:
+    // Take account of a new event in the extents and label flag,
+    // returning true if the extents have changed
+    bool updateExtents(const Event &e) {
+
+        bool allChange = false;
+
+        if (e.getLabel() != "") {
+            m_haveTextLabels = true;
+        }
+
+        float v = e.getValue();
+        if (!ISNAN(v) && !ISINF(v)) {
+            if (!m_haveExtents || v < m_valueMinimum) {
+                m_valueMinimum = v; allChange = true;
+            }
+            if (!m_haveExtents || v > m_valueMaximum) {
+                m_valueMaximum = v; allChange = true;
+            }
+            m_haveExtents = true;
+        }
+
+        return allChange;
+    }
+
     sv_samplerate_t m_sampleRate;
     int m_resolution;
 
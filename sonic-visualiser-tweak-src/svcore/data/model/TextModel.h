@@ -143,6 +143,15 @@ public:
         
         m_notifier.update(e.getFrame(), m_resolution);
     }
+
+    bool setEventsFromBlob(std::shared_ptr<const void> owner,
+                           const char *data, qint64 size) override {
+        if (!m_events.setFromBlob(owner, data, size)) {
+            return false;
+        }
+        emit modelChanged(getId());
+        return true;
+    }
     
     void remove(Event e) override {
         {   QMutexLocker locker(&m_mutex);
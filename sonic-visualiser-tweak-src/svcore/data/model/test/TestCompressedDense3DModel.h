@@ -0,0 +1,101 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_COMPRESSED_DENSE_3D_MODEL_H
+#define TEST_COMPRESSED_DENSE_3D_MODEL_H
+
+#include "../BasicCompressedDenseThreeDimensionalModel.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+
+using namespace std;
+
+class TestCompressedDense3DModel : public QObject
+{
+    Q_OBJECT
+
+    typedef DenseThreeDimensionalModel::Column Column;
+
+    const int height = 16;
+    const int width = 100;
+
+    // The bottom bins change only every few columns and the top bins
+    // are always zero, so that most columns are stored truncated
+    // against an earlier one; the middle bins vary throughout
+    Column makeColumn(int column, int generation) {
+        Column values(height, 0.f);
+        for (int bin = 0; bin < 10; ++bin) {
+            if (bin < 6) {
+                values[bin] = float((column / 5) * 3 + bin + generation);
+            } else {
+                values[bin] = float((column * 7 + bin * 13 + generation) % 11);
+            }
+        }
+        return values;
+    }
+
+private slots:
+    void segmentedMatchesUnsegmented() {
+
+        // Columns of a dense output as an unsegmented feature
+        // extraction would add them, in order, and as four parallel
+        // segments might, with each later segment running ahead of
+        // the one before it
+
+        BasicCompressedDenseThreeDimensionalModel unsegmented
+            (44100, 512, height, false);
+        for (int c = 0; c < width; ++c) {
+            unsegmented.setColumn(c, makeColumn(c, 0));
+        }
+
+        BasicCompressedDenseThreeDimensionalModel segmented
+            (44100, 512, height, false);
+        const int segments = 4;
+        const int length = width / segments;
+        for (int i = 0; i < length; ++i) {
+            for (int s = segments - 1; s >= 0; --s) {
+                int c = s * length + i;
+                segmented.setColumn(c, makeColumn(c, 0));
+            }
+        }
+
+        QCOMPARE(segmented.getWidth(), unsegmented.getWidth());
+        for (int c = 0; c < width; ++c) {
+            QCOMPARE(unsegmented.getColumn(c), makeColumn(c, 0));
+            QCOMPARE(segmented.getColumn(c), unsegmented.getColumn(c));
+        }
+    }
+
+    void replaceColumns() {
+        BasicCompressedDenseThreeDimensionalModel model
+            (44100, 512, height, false);
+        for (int c = 0; c < width; ++c) {
+            model.setColumn(c, makeColumn(c, 0));
+        }
+        // Replacing a column must not disturb any later column that
+        // was stored relative to it
+        for (int c = width - 1; c >= 0; c -= 3) {
+            model.setColumn(c, makeColumn(c, 1));
+        }
+        for (int c = 0; c < width; ++c) {
+            int generation = ((width - 1 - c) % 3 == 0 ? 1 : 0);
+            QCOMPARE(model.getColumn(c), makeColumn(c, generation));
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,152 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_DENSE_3D_MODEL_RANGE_INDEX_H
+#define TEST_DENSE_3D_MODEL_RANGE_INDEX_H
+
+#include "../Dense3DModelRangeIndex.h"
+#include "../EditableDenseThreeDimensionalModel.h"
+
+#include "Compares.h"
+
+#include <QObject>
+#include <QtTest>
+
+#include <iostream>
+#include <algorithm>
+
+using namespace std;
+
+class TestDense3DModelRangeIndex : public QObject
+{
+    Q_OBJECT
+
+    typedef DenseThreeDimensionalModel::Column Column;
+
+    const int height = 5;
+    const int columnsPerBlock = 8;
+
+    // Small integers, so that sums are exact and peaks move about
+    float makeValue(int column, int bin) {
+        return float((column * 7 + bin * 13) % 23 - 11);
+    }
+
+    ModelId makeModel(int width) {
+        auto model = std::make_shared<EditableDenseThreeDimensionalModel>
+            (44100, 512, height);
+        for (int c = 0; c < width; ++c) {
+            Column column(height);
+            for (int b = 0; b < height; ++b) {
+                column[b] = makeValue(c, b);
+            }
+            model->setColumn(c, column);
+        }
+        return ModelById::add(model);
+    }
+
+    void checkRange(ModelId id, const Dense3DModelRangeIndex &index,
+                    int col0, int col1) {
+        auto model = ModelById::getAs<DenseThreeDimensionalModel>(id);
+        Column mean = index.getMeanColumn(col0, col1);
+        Column peak = index.getPeakColumn(col0, col1);
+        QCOMPARE(int(mean.size()), height);
+        QCOMPARE(int(peak.size()), height);
+        for (int b = 0; b < height; ++b) {
+            double sum = 0.0;
+            float max = model->getValueAt(col0, b);
+            for (int c = col0; c <= col1; ++c) {
+                float v = model->getValueAt(c, b);
+                sum += v;
+                max = std::max(max, v);
+            }
+            COMPARE_FUZZIER_F(mean[b], float(sum / (col1 - col0 + 1)));
+            QCOMPARE(peak[b], max);
+        }
+    }
+
+private slots:
+    void emptyRange() {
+        ModelId id = makeModel(20);
+        Dense3DModelRangeIndex index(id, columnsPerBlock);
+        QVERIFY(index.getMeanColumn(5, 4).empty());
+        QVERIFY(index.getPeakColumn(30, 40).empty());
+        ModelById::release(id);
+    }
+
+    void matchesDirectCalculation() {
+        int width = 300;
+        ModelId id = makeModel(width);
+        Dense3DModelRangeIndex index(id, columnsPerBlock);
+        // single columns, within a block, across block boundaries,
+        // and long ranges with partial blocks at each end
+        int ranges[][2] = {
+            { 0, 0 }, { 3, 3 }, { 1, 6 }, { 0, 7 }, { 0, 8 }, { 5, 20 },
+            { 8, 15 }, { 7, 16 }, { 13, 250 }, { 0, 299 }, { 64, 127 },
+            { 33, 298 }, { 290, 299 }
+        };
+        for (auto r: ranges) {
+            checkRange(id, index, r[0], r[1]);
+        }
+        QCOMPARE(index.getIndexedColumnCount(), 296);
+        ModelById::release(id);
+    }
+
+    void clampsToWidth() {
+        ModelId id = makeModel(50);
+        Dense3DModelRangeIndex index(id, columnsPerBlock);
+        Column clamped = index.getPeakColumn(-10, 100);
+        Column whole = index.getPeakColumn(0, 49);
+        QCOMPARE(clamped, whole);
+        ModelById::release(id);
+    }
+
+    void followsGrowth() {
+        ModelId id = makeModel(20);
+        Dense3DModelRangeIndex index(id, columnsPerBlock);
+        checkRange(id, index, 0, 19);
+        QCOMPARE(index.getIndexedColumnCount(), 16);
+        auto model = ModelById::getAs<EditableDenseThreeDimensionalModel>(id);
+        for (int c = 20; c < 100; ++c) {
+            Column column(height);
+            for (int b = 0; b < height; ++b) {
+                column[b] = makeValue(c, b);
+            }
+            model->setColumn(c, column);
+        }
+        checkRange(id, index, 0, 99);
+        checkRange(id, index, 10, 90);
+        ModelById::release(id);
+    }
+
+    void followsChanges() {
+        ModelId id = makeModel(200);
+        Dense3DModelRangeIndex index(id, columnsPerBlock);
+        checkRange(id, index, 0, 199);
+        auto model = ModelById::getAs<EditableDenseThreeDimensionalModel>(id);
+        // Within the existing extents of the model
+        Column column(height, -11.f);
+        column[2] = 11.f;
+        model->setColumn(100, column);
+        checkRange(id, index, 0, 199);
+        checkRange(id, index, 90, 150);
+        // Outside them
+        column[3] = 1000.f;
+        model->setColumn(40, column);
+        checkRange(id, index, 0, 199);
+        checkRange(id, index, 17, 63);
+        ModelById::release(id);
+    }
+};
+
+#endif
@@ -0,0 +1,200 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+  Sonic Visualiser
+  An audio file viewer and annotation editor.
+  Centre for Digital Music, Queen Mary, University of London.
+
+  This program is free software; you can redistribute it and/or
+  modify it under the terms of the GNU General Public License as
+  published by the Free Software Foundation; either version 2 of the
+  License, or (at your option) any later version.  See the file
+  COPYING included with this distribution for more information.
+*/
+
+#ifndef TEST_RANGE_SUMMARY_PYRAMID_H
+#define TEST_RANGE_SUMMARY_PYRAMID_H
+
+#include "../RangeSummaryPyramid.h"
+
+#include <QObject>
+#include <QtTest>
+#include <QBuffer>
+
+#include <iostream>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+class TestRangeSummaryPyramid : public QObject
+{
+    Q_OBJECT
+
+    typedef RangeSummaryPyramid::Range Range;
+
+    // Channel 0 ramps up, channel 1 ramps down, so that min and max
+    // come from different ends of each block
+    Range makeRange(int block, int channel) {
+        float v = float(block) / 100.f;
+        if (channel == 1) v = -v;
+        return Range(v - 0.5f, v + 0.5f, fabsf(v));
+    }
+
+    RangeSummaryPyramid makePyramid(int blocks) {
+        RangeSummaryPyramid p(2, 64);
+        for (int b = 0; b < blocks; ++b) {
+            Range rr[2] = { makeRange(b, 0), makeRange(b, 1) };
+            p.append(rr);
+        }
+        p.finish();
+        return p;
+    }
+
+    // Summarise base blocks [b0, b1) of a channel directly
+    Range summarise(int b0, int b1, int channel) {
+        Range r = makeRange(b0, channel);
+        for (int b = b0 + 1; b < b1; ++b) {
+            Range s = makeRange(b, channel);
+            r.setMin(std::min(r.min(), s.min()));
+            r.setMax(std::max(r.max(), s.max()));
+        }
+        return r;
+    }
+
+    void checkLevels(const RangeSummaryPyramid &p, int blocks) {
+        for (int level = 0; level < p.getLevelCount(); ++level) {
+            int span = 1 << level;
+            int expectedCount = (blocks + span - 1) / span;
+            QCOMPARE(p.getBlockCount(level), sv_frame_t(expectedCount));
+            for (int b = 0; b < expectedCount; ++b) {
+                for (int c = 0; c < 2; ++c) {
+                    Range expected = summarise
+                        (b * span, std::min((b + 1) * span, blocks), c);
+                    const Range &obtained = p.getLevel(level)[b * 2 + c];
+                    QCOMPARE(obtained.min(), expected.min());
+                    QCOMPARE(obtained.max(), expected.max());
+                }
+            }
+        }
+        QCOMPARE(p.getBlockCount(p.getLevelCount() - 1), sv_frame_t(1));
+    }
+
+private slots:
+    void empty() {
+        RangeSummaryPyramid p(2, 64);
+        p.finish();
+        QCOMPARE(p.getLevelCount(), 0);
+        QCOMPARE(p.getBlockCount(0), sv_frame_t(0));
+    }
+
+    void single() {
+        RangeSummaryPyramid p = makePyramid(1);
+        QCOMPARE(p.getLevelCount(), 1);
+        checkLevels(p, 1);
+    }
+
+    void powerOfTwo() {
+        RangeSummaryPyramid p = makePyramid(64);
+        QCOMPARE(p.getLevelCount(), 7);
+        checkLevels(p, 64);
+    }
+
+    void ragged() {
+        // The trailing partial blocks at each level must be carried
+        // up by finish()
+        for (int blocks: { 3, 5, 7, 13, 100, 1000 }) {
+            RangeSummaryPyramid p = makePyramid(blocks);
+            checkLevels(p, blocks);
+        }
+    }
+
+    void absmean() {
+        RangeSummaryPyramid p = makePyramid(4);
+        // level 2 holds one block summarising all four, whose absmean
+        // for channel 0 is the mean of 0, 0.01, 0.02, 0.03
+        QCOMPARE(p.getLevelCount(), 3);
+        QVERIFY(fabsf(p.getLevel(2)[0].absmean() - 0.015f) < 1e-6f);
+    }
+
+    void incremental() {
+        // Coarser levels are available as soon as both halves are
+        RangeSummaryPyramid p(2, 64);
+        for (int b = 0; b < 6; ++b) {
+            Range rr[2] = { makeRange(b, 0), makeRange(b, 1) };
+            p.append(rr);
+        }
+        QCOMPARE(p.getBlockCount(0), sv_frame_t(6));
+        QCOMPARE(p.getBlockCount(1), sv_frame_t(3));
+        QCOMPARE(p.getBlockCount(2), sv_frame_t(1));
+        QVERIFY(!p.isFinished());
+        p.finish();
+        QVERIFY(p.isFinished());
+        QCOMPARE(p.getBlockCount(2), sv_frame_t(2));
+        QCOMPARE(p.getBlockCount(3), sv_frame_t(1));
+    }
+
+    void roundTrip() {
+        RangeSummaryPyramid p = makePyramid(1000);
+        QBuffer buffer;
+        buffer.open(QIODevice::ReadWrite);
+        QVERIFY(p.write(buffer));
+        buffer.seek(0);
+        RangeSummaryPyramid q(2, 64);
+        QVERIFY(q.read(buffer));
+        QVERIFY(q.isFinished());
+        QCOMPARE(q.getLevelCount(), p.getLevelCount());
+        for (int level = 0; level < p.getLevelCount(); ++level) {
+            QCOMPARE(q.getBlockCount(level), p.getBlockCount(level));
+            for (int i = 0; in_range_for(p.getLevel(level), i); ++i) {
+                QCOMPARE(q.getLevel(level)[i].min(), p.getLevel(level)[i].min());
+                QCOMPARE(q.getLevel(level)[i].max(), p.getLevel(level)[i].max());
+                QCOMPARE(q.getLevel(level)[i].absmean(),
+                         p.getLevel(level)[i].absmean());
+            }
+        }
+    }
+
+    void readMismatched() {
+        RangeSummaryPyramid p = makePyramid(10);
+        QBuffer buffer;
+        buffer.open(QIODevice::ReadWrite);
+        QVERIFY(p.write(buffer));
+
+        buffer.seek(0);
+        RangeSummaryPyramid wrongChannels(1, 64);
+        QVERIFY(!wrongChannels.read(buffer));
+        QCOMPARE(wrongChannels.getLevelCount(), 0);
+
+        buffer.seek(0);
+        RangeSummaryPyramid wrongBlockSize(2, 90);
+        QVERIFY(!wrongBlockSize.read(buffer));
+
+        QByteArray truncated = buffer.data().left(buffer.data().size() - 4);
+        QBuffer truncatedBuffer(&truncated);
+        truncatedBuffer.open(QIODevice::ReadOnly);
+        RangeSummaryPyramid q(2, 64);
+        QVERIFY(!q.read(truncatedBuffer));
+    }
+
+    void readCorruptCount() {
+        RangeSummaryPyramid p = makePyramid(10);
+        QBuffer buffer;
+        buffer.open(QIODevice::ReadWrite);
+        QVERIFY(p.write(buffer));
+
+        // Replace the first level's range count, which follows the
+        // 24-byte header, with one that wraps to zero when multiplied
+        // by the size of a range
+        QByteArray corrupt = buffer.data();
+        uint64_t count = uint64_t(1) << 62;
+        memcpy(corrupt.data() + 24, &count, sizeof(count));
+        QBuffer corruptBuffer(&corrupt);
+        corruptBuffer.open(QIODevice::ReadOnly);
+        RangeSummaryPyramid q(2, 64);
+        QVERIFY(!q.read(corruptBuffer));
+        QCOMPARE(q.getLevelCount(), 0);
+    }
+};
+
+#endif
@@ -1,7 +1,10 @@
 TEST_HEADERS += \
 	Compares.h \
 	MockWaveModel.h \
+	TestCompressedDense3DModel.h \
+	TestDense3DModelRangeIndex.h \
 	TestFFTModel.h \
+        TestRangeSummaryPyramid.h \
         TestSparseModels.h \
         TestWaveformOversampler.h \
         TestZoomConstraints.h
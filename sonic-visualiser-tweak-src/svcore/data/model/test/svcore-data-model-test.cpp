@@ -15,6 +15,9 @@
 #include "TestZoomConstraints.h"
 #include "TestWaveformOversampler.h"
 #include "TestSparseModels.h"
+#include "TestRangeSummaryPyramid.h"
+#include "TestDense3DModelRangeIndex.h"
+#include "TestCompressedDense3DModel.h"
 
 #include "system/Init.h"
 
@@ -58,6 +61,24 @@ int main(int argc, char *argv[])
         else ++bad;
     }
 
+    {
+        TestRangeSummaryPyramid t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+
+    {
+        TestDense3DModelRangeIndex t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+
+    {
+        TestCompressedDense3DModel t;
+        if (QTest::qExec(&t, argc, argv) == 0) ++good;
+        else ++bad;
+    }
+
     if (bad > 0) {
         SVCERR << "\n********* " << bad << " test suite(s) failed!\n" << endl;
         return 1;
@@ -4,18 +4,23 @@ SVCORE_HEADERS = \
            base/AudioRecordTarget.h \
            base/BaseTypes.h \
            base/ById.h \
+           base/CacheDirectory.h \
            base/Clipboard.h \
            base/ColumnOp.h \
            base/Command.h \
            base/Debug.h \
            base/Event.h \
+           base/EventColumns.h \
+           base/EventIntervalIndex.h \
            base/EventSeries.h \
            base/Exceptions.h \
            base/Extents.h \
            base/HelperExecPath.h \
            base/HitCount.h \
+           base/InterleavedRingBuffer.h \
            base/LogRange.h \
            base/MagnitudeRange.h \
+           base/MemoryBudget.h \
            base/NoteData.h \
            base/NoteExportable.h \
            base/Pitch.h \
@@ -37,7 +42,6 @@ SVCORE_HEADERS = \
            base/Scavenger.h \
            base/Selection.h \
            base/Serialiser.h \
-           base/StorageAdviser.h \
            base/StringBits.h \
            base/Strings.h \
            base/TempDirectory.h \
@@ -61,15 +65,19 @@ SVCORE_HEADERS = \
            data/fileio/CSVFileWriter.h \
            data/fileio/CSVFormat.h \
            data/fileio/CSVStreamWriter.h \
+           data/fileio/CSVTokeniser.h \
            data/fileio/DataFileReader.h \
+           data/fileio/DecodeCache.h \
            data/fileio/DataFileReaderFactory.h \
            data/fileio/FileFinder.h \
            data/fileio/FileReadThread.h \
            data/fileio/FileSource.h \
+           data/fileio/MappedWavFile.h \
            data/fileio/MIDIFileReader.h \
            data/fileio/MIDIFileWriter.h \
            data/fileio/MP3FileReader.h \
            data/fileio/PlaylistFileReader.h \
+           data/fileio/SessionContainer.h \
            data/fileio/DecodingWavFileReader.h \
            data/fileio/WavFileReader.h \
            data/fileio/WavFileWriter.h \
@@ -80,11 +88,13 @@ SVCORE_HEADERS = \
            data/model/AlignmentModel.h \
            data/model/BasicCompressedDenseThreeDimensionalModel.h \
            data/model/Dense3DModelPeakCache.h \
+           data/model/Dense3DModelRangeIndex.h \
            data/model/DenseThreeDimensionalModel.h \
            data/model/DenseTimeValueModel.h \
            data/model/DeferredNotifier.h \
            data/model/EditableDenseThreeDimensionalModel.h \
            data/model/EventCommands.h \
+           data/model/FFTColumnStore.h \
            data/model/FFTModel.h \
            data/model/ImageModel.h \
            data/model/Labeller.h \
@@ -96,6 +106,7 @@ SVCORE_HEADERS = \
            data/model/PowerOfTwoZoomConstraint.h \
            data/model/RangeSummarisableTimeValueModel.h \
            data/model/RegionModel.h \
+           data/model/RangeSummaryPyramid.h \
            data/model/RelativelyFineZoomConstraint.h \
            data/model/SparseOneDimensionalModel.h \
            data/model/SparseTimeValueModel.h \
@@ -117,6 +128,7 @@ SVCORE_HEADERS = \
            plugin/LADSPAPluginInstance.h \
            plugin/NativeVampPluginFactory.h \
            plugin/PiperVampPluginFactory.h \
+           plugin/PluginCatalogue.h \
            plugin/PluginIdentifier.h \
            plugin/PluginPathSetter.h \
            plugin/PluginXml.h \
@@ -153,14 +165,19 @@ SVCORE_HEADERS = \
 SVCORE_SOURCES = \
            base/AudioLevel.cpp \
            base/ById.cpp \
+           base/CacheDirectory.cpp \
            base/Clipboard.cpp \
            base/ColumnOp.cpp \
            base/Command.cpp \
            base/Debug.cpp \
+           base/EventColumns.cpp \
+           base/EventIntervalIndex.cpp \
            base/EventSeries.cpp \
            base/Exceptions.cpp \
            base/HelperExecPath.cpp \
+           base/InterleavedRingBuffer.cpp \
            base/LogRange.cpp \
+           base/MemoryBudget.cpp \
            base/Pitch.cpp \
            base/PlayParameterRepository.cpp \
            base/PlayParameters.cpp \
@@ -176,7 +193,6 @@ SVCORE_SOURCES = \
            base/ResourceFinder.cpp \
            base/Selection.cpp \
            base/Serialiser.cpp \
-           base/StorageAdviser.cpp \
            base/StringBits.cpp \
            base/Strings.cpp \
            base/TempDirectory.cpp \
@@ -197,13 +213,17 @@ SVCORE_SOURCES = \
            data/fileio/CSVFileReader.cpp \
            data/fileio/CSVFileWriter.cpp \
            data/fileio/CSVFormat.cpp \
+           data/fileio/CSVTokeniser.cpp \
            data/fileio/DataFileReaderFactory.cpp \
+           data/fileio/DecodeCache.cpp \
            data/fileio/FileReadThread.cpp \
            data/fileio/FileSource.cpp \
+           data/fileio/MappedWavFile.cpp \
            data/fileio/MIDIFileReader.cpp \
            data/fileio/MIDIFileWriter.cpp \
            data/fileio/MP3FileReader.cpp \
            data/fileio/PlaylistFileReader.cpp \
+           data/fileio/SessionContainer.cpp \
            data/fileio/DecodingWavFileReader.cpp \
            data/fileio/WavFileReader.cpp \
            data/fileio/WavFileWriter.cpp \
@@ -213,14 +233,17 @@ SVCORE_SOURCES = \
            data/model/AlignmentModel.cpp \
            data/model/BasicCompressedDenseThreeDimensionalModel.cpp \
            data/model/Dense3DModelPeakCache.cpp \
+           data/model/Dense3DModelRangeIndex.cpp \
            data/model/DenseTimeValueModel.cpp \
            data/model/EditableDenseThreeDimensionalModel.cpp \
+           data/model/FFTColumnStore.cpp \
            data/model/FFTModel.cpp \
            data/model/Model.cpp \
            data/model/ModelDataTableModel.cpp \
            data/model/PowerOfSqrtTwoZoomConstraint.cpp \
            data/model/PowerOfTwoZoomConstraint.cpp \
            data/model/RangeSummarisableTimeValueModel.cpp \
+           data/model/RangeSummaryPyramid.cpp \
            data/model/RelativelyFineZoomConstraint.cpp \
            data/model/WaveformOversampler.cpp \
            data/model/WaveFileModel.cpp \
@@ -236,6 +259,7 @@ SVCORE_SOURCES = \
            plugin/LADSPAPluginInstance.cpp \
            plugin/NativeVampPluginFactory.cpp \
            plugin/PiperVampPluginFactory.cpp \
+           plugin/PluginCatalogue.cpp \
            plugin/PluginIdentifier.cpp \
            plugin/PluginPathSetter.cpp \
            plugin/PluginXml.cpp \
@@ -21,6 +21,7 @@
 #include "system/System.h"
 
 #include "PluginScan.h"
+#include "PluginCatalogue.h"
 
 #ifdef _WIN32
 #undef VOID
@@ -31,6 +32,9 @@
 #include "vamp-client/qt/PiperAutoPlugin.h"
 #include "vamp-client/qt/ProcessQtTransport.h"
 #include "vamp-client/CapnpRRClient.h"
+#include "vamp-capnp/VampnProto.h"
+
+#include <capnp/serialize.h>
 
 #include <QDir>
 #include <QFile>
@@ -39,6 +43,7 @@
 #include <QCoreApplication>
 
 #include <iostream>
+#include <cstring>
 
 #include "base/Profiler.h"
 #include "base/HelperExecPath.h"
@@ -47,6 +52,58 @@ using namespace std;
 
 //#define DEBUG_PLUGIN_SCAN_AND_INSTANTIATE 1
 
+// The static data for the plugins in a single library are kept in the
+// plugin catalogue in the same Cap'n Proto form as the server sends
+// them in
+
+static QByteArray
+encodeStaticData(const vector<piper_vamp::PluginStaticData> &data)
+{
+    piper_vamp::ListResponse resp;
+    resp.available = data;
+    
+    capnp::MallocMessageBuilder message;
+    piper::ListResponse::Builder builder =
+        message.initRoot<piper::ListResponse>();
+    piper_vamp::VampnProto::buildListResponse(builder, resp);
+
+    kj::Array<capnp::word> words = capnp::messageToFlatArray(message);
+    kj::ArrayPtr<kj::byte> bytes = words.asBytes();
+    return QByteArray(reinterpret_cast<const char *>(bytes.begin()),
+                      int(bytes.size()));
+}
+
+static bool
+decodeStaticData(const QByteArray &encoded,
+                 vector<piper_vamp::PluginStaticData> &data)
+{
+    if (encoded.size() % sizeof(capnp::word) != 0) {
+        return false;
+    }
+
+    // copy, as the reader requires word-aligned data
+    kj::Array<capnp::word> words =
+        kj::heapArray<capnp::word>(encoded.size() / sizeof(capnp::word));
+    memcpy(words.begin(), encoded.constData(), encoded.size());
+
+    try {
+        capnp::FlatArrayMessageReader reader(words);
+        piper_vamp::ListResponse resp;
+        piper_vamp::VampnProto::readListResponse
+            (resp, reader.getRoot<piper::ListResponse>());
+        data = resp.available;
+        return true;
+    } catch (const kj::Exception &e) {
+        SVDEBUG << "PiperVampPluginFactory: Failed to decode cached static data: "
+                << e.getDescription().cStr() << endl;
+        return false;
+    } catch (const std::exception &e) {
+        SVDEBUG << "PiperVampPluginFactory: Failed to decode cached static data: "
+                << e.what() << endl;
+        return false;
+    }
+}
+
 class PiperVampPluginFactory::Logger : public piper_vamp::client::LogCallback {
 protected:
     void log(std::string message) const override {
@@ -271,20 +328,40 @@ PiperVampPluginFactory::populateFrom(const HelperExecPath::HelperExec &server,
     SVDEBUG << "INFO: Have " << candidateLibraries.size()
             << " candidate Vamp plugin libraries from scanner" << endl;
         
+    // Libraries that are unchanged since the server last listed them
+    // are taken from the plugin catalogue; only the rest are passed
+    // to the server
+    PluginCatalogue *catalogue = PluginCatalogue::getInstance();
+    QString context = PluginCatalogue::makeContext("piper", server.executable);
+
+    vector<piper_vamp::PluginStaticData> available;
     vector<string> from;
+    map<string, QString> uncatalogued; // soname -> full file path
+    bool haveCandidates = false;
+    
     for (const auto &c: candidateLibraries) {
         if (c.helperTag == tag) {
+            haveCandidates = true;
             string soname = QFileInfo(c.libraryPath).baseName().toStdString();
-            SVDEBUG << "INFO: For tag \"" << tag << "\" giving library " << soname << endl;
-            from.push_back(soname);
             QString qsoname = QString::fromStdString(soname);
             if (m_libraries.find(qsoname) == m_libraries.end()) {
                 m_libraries[qsoname] = c.libraryPath;
             }
+            QByteArray encoded;
+            vector<piper_vamp::PluginStaticData> data;
+            if (catalogue->lookup(context, c.libraryPath, encoded) &&
+                decodeStaticData(encoded, data)) {
+                SVDEBUG << "INFO: For tag \"" << tag << "\" found library " << soname << " in catalogue" << endl;
+                available.insert(available.end(), data.begin(), data.end());
+            } else {
+                SVDEBUG << "INFO: For tag \"" << tag << "\" giving library " << soname << endl;
+                from.push_back(soname);
+                uncatalogued[soname] = c.libraryPath;
+            }
         }
     }
 
-    if (from.empty()) {
+    if (!haveCandidates) {
         SVDEBUG << "PiperVampPluginFactory: No candidate libraries for tag \""
              << tag << "\"";
         if (scan->scanSucceeded()) {
@@ -298,38 +375,66 @@ PiperVampPluginFactory::populateFrom(const HelperExecPath::HelperExec &server,
         }
     }
     
-    piper_vamp::client::ProcessQtTransport transport(executable, "capnp", m_logger);
-    if (!transport.isOK()) {
-        SVDEBUG << "PiperVampPluginFactory: Failed to start Piper process transport" << endl;
-        errorMessage = QObject::tr("Could not start external plugin host");
-        return;
-    }
+    // An empty list here means something different (no exclusions)
+    // if it arises because we have no candidates than if it is
+    // because they were all catalogued
+    if (!from.empty() || !haveCandidates) {
+        
+        piper_vamp::client::ProcessQtTransport transport(executable, "capnp", m_logger);
+        if (!transport.isOK()) {
+            SVDEBUG << "PiperVampPluginFactory: Failed to start Piper process transport" << endl;
+            errorMessage = QObject::tr("Could not start external plugin host");
+            return;
+        }
 
-    piper_vamp::client::CapnpRRClient client(&transport, m_logger);
+        piper_vamp::client::CapnpRRClient client(&transport, m_logger);
 
-    piper_vamp::ListRequest req;
-    req.from = from;
+        piper_vamp::ListRequest req;
+        req.from = from;
     
-    piper_vamp::ListResponse resp;
+        piper_vamp::ListResponse resp;
+
+        try {
+            resp = client.list(req);
+        } catch (const piper_vamp::client::ServerCrashed &) {
+            SVDEBUG << "PiperVampPluginFactory: Piper server crashed" << endl;
+            errorMessage = QObject::tr
+                ("External plugin host exited unexpectedly while listing plugins");
+            return;
+        } catch (const std::exception &e) {
+            SVDEBUG << "PiperVampPluginFactory: Exception caught: " << e.what() << endl;
+            errorMessage = QObject::tr("External plugin host invocation failed: %1")
+                .arg(e.what());
+            return;
+        }
 
-    try {
-        resp = client.list(req);
-    } catch (const piper_vamp::client::ServerCrashed &) {
-        SVDEBUG << "PiperVampPluginFactory: Piper server crashed" << endl;
-        errorMessage = QObject::tr
-            ("External plugin host exited unexpectedly while listing plugins");
-        return;
-    } catch (const std::exception &e) {
-        SVDEBUG << "PiperVampPluginFactory: Exception caught: " << e.what() << endl;
-        errorMessage = QObject::tr("External plugin host invocation failed: %1")
-            .arg(e.what());
-        return;
+        SVDEBUG << "PiperVampPluginFactory: server \"" << executable << "\" lists "
+                << resp.available.size() << " plugin(s)" << endl;
+
+        // Catalogue the listed libraries, including those that turn
+        // out to contain no plugins the server can load
+        map<string, vector<piper_vamp::PluginStaticData>> bySoname;
+        for (const auto &u: uncatalogued) {
+            bySoname[u.first] = {};
+        }
+        for (const auto &pd: resp.available) {
+            string soname = pd.pluginKey.substr(0, pd.pluginKey.find(':'));
+            if (bySoname.find(soname) != bySoname.end()) {
+                bySoname[soname].push_back(pd);
+            }
+        }
+        for (const auto &b: bySoname) {
+            catalogue->store(context, uncatalogued[b.first],
+                             encodeStaticData(b.second));
+        }
+    
+        available.insert(available.end(),
+                         resp.available.begin(), resp.available.end());
     }
 
-    SVDEBUG << "PiperVampPluginFactory: server \"" << executable << "\" lists "
-            << resp.available.size() << " plugin(s)" << endl;
+    catalogue->save();
 
-    for (const auto &pd: resp.available) {
+    for (const auto &pd: available) {
         
         QString identifier =
             QString("vamp:") + QString::fromStdString(pd.pluginKey);
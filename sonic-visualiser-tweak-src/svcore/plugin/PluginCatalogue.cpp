@@ -0,0 +1,250 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#include "PluginCatalogue.h"
+
+#include "base/CacheDirectory.h"
+#include "base/Exceptions.h"
+#include "base/Debug.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QDateTime>
+#include <QSettings>
+#include <QMutexLocker>
+
+static const quint32 catalogueMagic = 0x53565043; // "SVPC"
+static const quint32 catalogueVersion = 1;
+static const QString catalogueFile = "catalogue";
+
+static CacheDirectory &
+getCatalogueDirectory()
+{
+    static CacheDirectory directory("plugin-catalogue", 16);
+    return directory;
+}
+
+PluginCatalogue *
+PluginCatalogue::getInstance()
+{
+    static PluginCatalogue instance;
+    return &instance;
+}
+
+PluginCatalogue::PluginCatalogue() :
+    m_loaded(false),
+    m_changed(false)
+{
+    QSettings settings;
+    settings.beginGroup("PluginCatalogue");
+    m_enabled = settings.value("enabled", true).toBool();
+    settings.endGroup();
+}
+
+PluginCatalogue::~PluginCatalogue()
+{
+}
+
+bool
+PluginCatalogue::getIdentity(QString path, qint64 &size, qint64 &modified)
+{
+    QFileInfo fi(path);
+    if (!fi.exists()) return false;
+    size = fi.size();
+    modified = fi.lastModified().toMSecsSinceEpoch();
+    return true;
+}
+
+QString
+PluginCatalogue::makeContext(QString kind, QString executable)
+{
+    qint64 size = 0, modified = 0;
+    getIdentity(executable, size, modified);
+    return QString("%1:%2:%3:%4").arg(kind).arg(executable)
+        .arg(size).arg(modified);
+}
+
+bool
+PluginCatalogue::lookup(QString context, QString libraryPath,
+                        QByteArray &value)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_enabled) return false;
+    if (!m_loaded) load();
+
+    m_usedContexts.insert(context);
+
+    auto ci = m_entries.find(context);
+    if (ci == m_entries.end()) return false;
+
+    auto ei = ci->second.find(libraryPath);
+    if (ei == ci->second.end()) return false;
+
+    Entry &entry = ei->second;
+
+    qint64 size = 0, modified = 0;
+    if (!getIdentity(libraryPath, size, modified) ||
+        size != entry.size ||
+        modified != entry.modified) {
+        SVDEBUG << "PluginCatalogue: Library " << libraryPath
+                << " has changed since it was catalogued" << endl;
+        return false;
+    }
+
+    entry.used = true;
+    value = entry.value;
+    return true;
+}
+
+void
+PluginCatalogue::store(QString context, QString libraryPath, QByteArray value)
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_enabled) return;
+    if (!m_loaded) load();
+
+    m_usedContexts.insert(context);
+
+    Entry entry;
+    if (!getIdentity(libraryPath, entry.size, entry.modified)) {
+        return;
+    }
+    entry.value = value;
+    entry.used = true;
+
+    m_entries[context][libraryPath] = entry;
+    m_changed = true;
+}
+
+void
+PluginCatalogue::load()
+{
+    // Called with m_mutex held
+
+    m_loaded = true;
+
+    QFile file;
+    try {
+        file.setFileName(getCatalogueDirectory().getFilePath(catalogueFile));
+    } catch (const DirectoryCreationFailed &f) {
+        SVCERR << "WARNING: PluginCatalogue::load: " << f.what() << endl;
+        return;
+    }
+
+    if (!file.exists() || !file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_0);
+
+    quint32 magic = 0, version = 0, contextCount = 0;
+    stream >> magic >> version;
+    if (magic != catalogueMagic || version != catalogueVersion) {
+        SVDEBUG << "PluginCatalogue::load: Catalogue has wrong magic or version, ignoring it" << endl;
+        return;
+    }
+
+    EntryMap entries;
+
+    stream >> contextCount;
+    for (quint32 i = 0; i < contextCount && stream.status() == QDataStream::Ok; ++i) {
+        QString context;
+        quint32 entryCount = 0;
+        stream >> context >> entryCount;
+        for (quint32 j = 0; j < entryCount && stream.status() == QDataStream::Ok; ++j) {
+            QString path;
+            Entry entry;
+            stream >> path >> entry.size >> entry.modified >> entry.value;
+            entries[context][path] = entry;
+        }
+    }
+
+    if (stream.status() != QDataStream::Ok) {
+        SVDEBUG << "PluginCatalogue::load: Catalogue is truncated or corrupt, ignoring it" << endl;
+        return;
+    }
+
+    m_entries = entries;
+
+    SVDEBUG << "PluginCatalogue::load: Read entries for " << m_entries.size()
+            << " context(s)" << endl;
+}
+
+void
+PluginCatalogue::save()
+{
+    QMutexLocker locker(&m_mutex);
+
+    if (!m_enabled || !m_loaded) return;
+
+    // Discard entries that were not asked about, in contexts that
+    // were, as they are for libraries that are no longer installed.
+    // Contexts that have not been consulted yet this session (or
+    // whose helper is missing this time) are left alone
+
+    for (auto c: m_usedContexts) {
+        auto ci = m_entries.find(c);
+        if (ci == m_entries.end()) continue;
+        auto &entries = ci->second;
+        for (auto ei = entries.begin(); ei != entries.end(); ) {
+            if (!ei->second.used) {
+                ei = entries.erase(ei);
+                m_changed = true;
+            } else {
+                ++ei;
+            }
+        }
+    }
+
+    if (!m_changed) return;
+
+    try {
+        // QSaveFile so that a partly-written catalogue is never seen
+        QSaveFile file(getCatalogueDirectory().getFilePath(catalogueFile));
+        if (!file.open(QIODevice::WriteOnly)) {
+            SVCERR << "WARNING: PluginCatalogue::save: Failed to open "
+                   << file.fileName() << " for writing" << endl;
+            return;
+        }
+
+        QDataStream stream(&file);
+        stream.setVersion(QDataStream::Qt_5_0);
+
+        stream << catalogueMagic << catalogueVersion;
+        stream << quint32(m_entries.size());
+        for (const auto &c: m_entries) {
+            stream << c.first << quint32(c.second.size());
+            for (const auto &e: c.second) {
+                stream << e.first << e.second.size << e.second.modified
+                       << e.second.value;
+            }
+        }
+
+        if (stream.status() != QDataStream::Ok || !file.commit()) {
+            SVCERR << "WARNING: PluginCatalogue::save: Failed to write "
+                   << file.fileName() << endl;
+            return;
+        }
+    } catch (const DirectoryCreationFailed &f) {
+        SVCERR << "WARNING: PluginCatalogue::save: " << f.what() << endl;
+        return;
+    }
+
+    m_changed = false;
+}
@@ -0,0 +1,105 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_PLUGIN_CATALOGUE_H
+#define SV_PLUGIN_CATALOGUE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QMutex>
+
+#include <map>
+#include <set>
+
+/**
+ * A persistent record of what was learned about each installed plugin
+ * library at startup -- whether the load checker found it loadable,
+ * and what plugins an external plugin server reported it as
+ * containing -- so that libraries that have not changed since the
+ * last session need not be examined again.
+ *
+ * Each value is an opaque byte array stored against a context (which
+ * identifies the helper program and query that produced it) and a
+ * library path. A value is only returned by lookup() if the library
+ * still has the same size and modification time as when the value was
+ * stored. Contexts made with makeContext() likewise include the size
+ * and modification time of the helper program, so that installing a
+ * new helper discards everything it reported.
+ *
+ * The catalogue is read from the "plugin-catalogue" cache directory
+ * on first use, and written back by save(). Only the entries looked
+ * up or stored during this session are written, so libraries that
+ * have been removed drop out of the catalogue. Setting "enabled" to
+ * false in the "PluginCatalogue" settings group disables it.
+ *
+ * This class is thread safe.
+ */
+class PluginCatalogue
+{
+public:
+    static PluginCatalogue *getInstance();
+
+    /**
+     * Return a context string for values produced by the given
+     * helper executable. The kind distinguishes different uses of
+     * the same executable.
+     */
+    static QString makeContext(QString kind, QString executable);
+
+    /**
+     * Retrieve the value stored for the given library in the given
+     * context. Return false if there is none, or if the library has
+     * changed or disappeared since it was stored.
+     */
+    bool lookup(QString context, QString libraryPath, QByteArray &value);
+
+    /**
+     * Store a value for the given library in the given context,
+     * replacing any existing one.
+     */
+    void store(QString context, QString libraryPath, QByteArray value);
+
+    /**
+     * Write the catalogue to disc, if anything has changed since it
+     * was read.
+     */
+    void save();
+
+private:
+    PluginCatalogue();
+    ~PluginCatalogue();
+
+    struct Entry {
+        Entry() : size(0), modified(0), used(false) { }
+        qint64 size;
+        qint64 modified;
+        QByteArray value;
+        bool used;
+    };
+
+    // context -> library path -> entry
+    typedef std::map<QString, std::map<QString, Entry>> EntryMap;
+
+    QMutex m_mutex;
+    EntryMap m_entries;
+    std::set<QString> m_usedContexts;
+    bool m_enabled;
+    bool m_loaded;
+    bool m_changed;
+
+    void load();
+    static bool getIdentity(QString path, qint64 &size, qint64 &modified);
+};
+
+#endif
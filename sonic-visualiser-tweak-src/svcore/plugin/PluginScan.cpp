@@ -13,6 +13,7 @@
 */
 
 #include "PluginScan.h"
+#include "PluginCatalogue.h"
 
 #include "base/Debug.h"
 #include "base/Preferences.h"
@@ -40,6 +41,38 @@ protected:
     }
 };
 
+#ifdef HAVE_PLUGIN_CHECKER_HELPER
+class PluginScan::ResultCache : public PluginCandidates::ResultCache
+{
+public:
+    ResultCache(QString helper) :
+        m_context(PluginCatalogue::makeContext("checker", helper)) { }
+
+    bool lookup(std::string tag, std::string library,
+                std::string &result) override {
+        QByteArray value;
+        if (!PluginCatalogue::getInstance()->lookup
+            (m_context + "/" + QString::fromStdString(tag),
+             QString::fromStdString(library), value)) {
+            return false;
+        }
+        result = value.toStdString();
+        return true;
+    }
+    
+    void store(std::string tag, std::string library,
+               std::string result) override {
+        PluginCatalogue::getInstance()->store
+            (m_context + "/" + QString::fromStdString(tag),
+             QString::fromStdString(library),
+             QByteArray::fromStdString(result));
+    }
+
+private:
+    QString m_context;
+};
+#endif
+
 PluginScan *PluginScan::getInstance()
 {
     static QMutex mutex;
@@ -92,8 +125,9 @@ PluginScan::scan()
 
     for (auto p: helpers) {
         try {
+            ResultCache cache(p.executable);
             KnownPluginCandidates *kp = new KnownPluginCandidates
-                (p.executable.toStdString(), m_logger);
+                (p.executable.toStdString(), m_logger, &cache);
             if (m_kp.find(p.tag) != m_kp.end()) {
                 SVDEBUG << "WARNING: PluginScan::scan: Duplicate tag " << p.tag
                      << " for helpers" << endl;
@@ -107,6 +141,8 @@ PluginScan::scan()
         }
     }
 
+    PluginCatalogue::getInstance()->save();
+
     SVDEBUG << "PluginScan::scan complete" << endl;
 #endif
 }
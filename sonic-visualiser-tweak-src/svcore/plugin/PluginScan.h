@@ -90,6 +90,8 @@ private:
 
     class Logger;
     Logger *m_logger;
+
+    class ResultCache;
 };
 
 #endif
@@ -35,16 +35,24 @@
 
 #include "TransformFactory.h"
 
+#include "base/Thread.h"
+
 #include <iostream>
+#include <deque>
+#include <memory>
+#include <limits>
 
 #include <QSettings>
+#include <QStringList>
 
 //#define DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN 1
 
 FeatureExtractionModelTransformer::FeatureExtractionModelTransformer(Input in,
                                                                      const Transform &transform) :
     ModelTransformer(in, transform),
-    m_plugin(nullptr),
+    m_inputChannelCount(0),
+    m_startFrame(0),
+    m_contextStart(0),
     m_haveOutputs(false)
 {
     SVDEBUG << "FeatureExtractionModelTransformer::FeatureExtractionModelTransformer: plugin " << m_transforms.begin()->getPluginIdentifier() << ", outputName " << m_transforms.begin()->getOutput() << endl;
@@ -53,7 +61,9 @@ FeatureExtractionModelTransformer::FeatureExtractionModelTransformer(Input in,
 FeatureExtractionModelTransformer::FeatureExtractionModelTransformer(Input in,
                                                                      const Transforms &transforms) :
     ModelTransformer(in, transforms),
-    m_plugin(nullptr),
+    m_inputChannelCount(0),
+    m_startFrame(0),
+    m_contextStart(0),
     m_haveOutputs(false)
 {
     if (m_transforms.empty()) {
@@ -71,42 +81,305 @@ areTransformsSimilar(const Transform &t1, const Transform &t2)
     return t1 == t2o;
 }
 
-bool
-FeatureExtractionModelTransformer::initialise()
+/**
+ * A section of the input, read by the transformer's run thread and
+ * shared read-only between the plugin runners.
+ */
+struct FeatureExtractionModelTransformer::Chunk
 {
-    // This is (now) called from the run thread. The plugin is
-    // constructed, initialised, used, and destroyed all from a single
-    // thread.
-    
-    // All transforms must use the same plugin, parameters, and
-    // inputs: they can differ only in choice of plugin output. So we
-    // initialise based purely on the first transform in the list (but
-    // first check that they are actually similar as promised)
-
-    for (int j = 1; in_range_for(m_transforms, j); ++j) {
-        if (!areTransformsSimilar(m_transforms[0], m_transforms[j])) {
-            m_message = tr("Transforms supplied to a single FeatureExtractionModelTransformer instance must be similar in every respect except plugin output");
-            SVCERR << m_message << endl;
-            return false;
+    // Blocks whose start frames lie in [start, end) are processed
+    // from this chunk
+    sv_frame_t start;
+    sv_frame_t end;
+
+    // Time-domain input, starting at frame start and extending far
+    // enough past end to fill the longest time-domain block. The
+    // mono buffer holds the input channel selected for the
+    // transformer (or the mean of all channels); the multi buffers
+    // hold every input channel
+    floatvec_t mono;
+    std::vector<floatvec_t> multi;
+
+    // Frequency-domain input, one entry per FFT configuration: count
+    // consecutive columns from firstColumn, per channel
+    struct Columns {
+        int firstColumn = 0;
+        int count = 0;
+        std::vector<std::vector<std::complex<float>>> channels;
+    };
+    std::vector<Columns> fft;
+};
+
+/**
+ * Runs a single plugin instance, on behalf of one or more transforms
+ * that differ only in plugin output. The plugin is constructed,
+ * initialised, used, and destroyed all from the runner's own
+ * thread. Input arrives from the transformer's run thread a chunk at
+ * a time, shared between all of the runners.
+ *
+ * A transform with parallel segments has one runner per segment
+ * instead. Those runners read their own input, independently of the
+ * transformer's run thread and each other.
+ */
+class FeatureExtractionModelTransformer::PluginRunner : public Thread
+{
+public:
+    PluginRunner(FeatureExtractionModelTransformer *parent,
+                 std::vector<int> transformNos,
+                 int segment = 0,
+                 int segmentCount = 1) :
+        m_parent(parent),
+        m_transformNos(transformNos),
+        m_transform(parent->m_transforms[transformNos[0]]),
+        m_plugin(nullptr),
+        m_apiVersion(0),
+        m_channelCount(0),
+        m_frequencyDomain(false),
+        m_fftConfig(-1),
+        m_state(State::Initialising),
+        m_exited(false),
+        m_sampleRate(0),
+        m_startFrame(0),
+        m_contextStart(0),
+        m_contextDuration(0),
+        m_haveContext(false),
+        m_segment(segment),
+        m_segmentCount(segmentCount),
+        m_firstBlock(0),
+        m_ownStart(0),
+        m_ownEnd(0),
+        m_progressStart(0),
+        m_progressEnd(0),
+        m_completion(0)
+    { }
+
+    virtual ~PluginRunner() { }
+
+    /**
+     * Wait for the plugin to be initialised in the runner thread and
+     * return true if that succeeded. The remaining accessors may be
+     * used once this has returned true.
+     */
+    bool waitForInitialisation() {
+        QMutexLocker locker(&m_mutex);
+        while (m_state == State::Initialising) {
+            m_condition.wait(&m_mutex, 100);
+        }
+        return m_state == State::Initialised;
+    }
+
+    const std::vector<int> &getTransformNos() const { return m_transformNos; }
+    const Transform &getTransform() const { return m_transform; }
+    int getApiVersion() const { return m_apiVersion; }
+    int getChannelCount() const { return m_channelCount; }
+    bool isFrequencyDomain() const { return m_frequencyDomain; }
+    QString getMessage() const { return m_message; }
+
+    // Plugin output index and descriptor for each of getTransformNos()
+    const std::vector<int> &getOutputNos() const { return m_outputNos; }
+    const Vamp::Plugin::OutputList &getDescriptors() const {
+        return m_descriptors;
+    }
+
+    void setFFTConfig(int config) { m_fftConfig = config; }
+    int getFFTConfig() const { return m_fftConfig; }
+
+    bool isSegmented() const { return m_segmentCount > 1; }
+    void setSegment(int segment, int segmentCount) {
+        QMutexLocker locker(&m_mutex);
+        m_segment = segment;
+        m_segmentCount = segmentCount;
+    }
+
+    void setContext(sv_samplerate_t sampleRate,
+                    sv_frame_t startFrame,
+                    sv_frame_t contextStart,
+                    sv_frame_t contextDuration) {
+
+        QMutexLocker locker(&m_mutex);
+        m_sampleRate = sampleRate;
+        m_startFrame = startFrame;
+        m_contextStart = contextStart;
+        m_contextDuration = contextDuration;
+
+        m_firstBlock = contextStart;
+        m_ownStart = std::numeric_limits<sv_frame_t>::min();
+        m_ownEnd = std::numeric_limits<sv_frame_t>::max();
+        m_progressStart = contextStart;
+        m_progressEnd = contextStart + contextDuration;
+
+        if (m_segmentCount > 1) {
+
+            // Segment boundaries fall on the same grid of block
+            // frames as an unsegmented run would use, so the blocks
+            // processed are the same either way
+            int step = m_transform.getStepSize();
+            auto boundary = [&](int i) {
+                return contextStart +
+                    ((contextDuration * i / m_segmentCount) / step) * step;
+            };
+
+            if (m_segment > 0) {
+                m_ownStart = boundary(m_segment);
+                sv_frame_t overlap = RealTime::realTime2Frame
+                    (m_transform.getSegmentOverlap(), sampleRate);
+                if (overlap < 0) overlap = 0;
+                sv_frame_t overlapSteps = (overlap + step - 1) / step;
+                m_firstBlock = std::max(contextStart,
+                                        m_ownStart - overlapSteps * step);
+                m_progressStart = m_firstBlock;
+            }
+
+            if (m_segment + 1 < m_segmentCount) {
+                m_ownEnd = boundary(m_segment + 1);
+                m_progressEnd = m_ownEnd;
+            }
+        }
+
+        m_haveContext = true;
+        m_condition.wakeAll();
+    }
+
+    /**
+     * Queue a chunk of input for processing, waiting if the runner
+     * is too far behind. A null chunk marks the end of the input.
+     */
+    void push(std::shared_ptr<const Chunk> chunk) {
+        const int maxQueued = 3;
+        QMutexLocker locker(&m_mutex);
+        while (chunk && int(m_queue.size()) >= maxQueued &&
+               !m_exited && !m_parent->m_abandoned) {
+            m_condition.wait(&m_mutex, 100);
+        }
+        m_queue.push_back(chunk);
+        m_condition.wakeAll();
+    }
+
+protected:
+    void run() override;
+
+private:
+    FeatureExtractionModelTransformer *m_parent;
+    std::vector<int> m_transformNos;
+    Transform m_transform;
+    Vamp::Plugin *m_plugin;
+    int m_apiVersion;
+    int m_channelCount;
+    bool m_frequencyDomain;
+    int m_fftConfig;
+    std::vector<int> m_outputNos;
+    Vamp::Plugin::OutputList m_descriptors;
+    QString m_message;
+
+    enum class State { Initialising, Initialised, Failed };
+    State m_state;
+    bool m_exited;
+    std::deque<std::shared_ptr<const Chunk>> m_queue;
+    QMutex m_mutex;
+    QWaitCondition m_condition;
+
+    sv_samplerate_t m_sampleRate;
+    sv_frame_t m_startFrame;
+    sv_frame_t m_contextStart;
+    sv_frame_t m_contextDuration;
+    bool m_haveContext;
+
+    // For parallel segments: this runner processes blocks from
+    // m_firstBlock onwards, but keeps only features that fall within
+    // [m_ownStart, m_ownEnd), the earlier ones being warm-up
+    int m_segment;
+    int m_segmentCount;
+    sv_frame_t m_firstBlock;
+    sv_frame_t m_ownStart;
+    sv_frame_t m_ownEnd;
+
+    // Range of block frames, and latest completion, for progress
+    sv_frame_t m_progressStart;
+    sv_frame_t m_progressEnd;
+    int m_completion;
+
+    bool initialise();
+    void process();
+    void processSegment(float **buffers);
+    bool processChunk(const Chunk &chunk, sv_frame_t &blockFrame,
+                      int &prevCompletion, float **buffers);
+    void processRemaining(sv_frame_t blockFrame);
+    bool isOwned(int n, sv_frame_t blockFrame,
+                 const Vamp::Plugin::Feature &feature) const;
+    bool haveAllModels() const;
+    void deinitialise();
+
+    friend class FeatureExtractionModelTransformer;
+
+    bool pop(std::shared_ptr<const Chunk> &chunk) {
+        QMutexLocker locker(&m_mutex);
+        while (m_queue.empty()) {
+            if (m_parent->m_abandoned) return false;
+            m_condition.wait(&m_mutex, 100);
+        }
+        chunk = m_queue.front();
+        m_queue.pop_front();
+        m_condition.wakeAll();
+        return bool(chunk);
+    }
+};
+
+void
+FeatureExtractionModelTransformer::PluginRunner::run()
+{
+    bool ok = false;
+
+    try {
+        ok = initialise();
+    } catch (const std::exception &e) {
+        m_message = e.what();
+        SVCERR << m_message << endl;
+    }
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_state = (ok ? State::Initialised : State::Failed);
+        m_condition.wakeAll();
+    }
+
+    if (ok) {
+        try {
+            process();
+        } catch (const std::exception &e) {
+            SVCERR << "FeatureExtractionModelTransformer::PluginRunner::run: Exception caught: "
+                   << e.what() << endl;
+            m_message = e.what();
+            m_parent->abandon();
         }
     }
 
-    Transform primaryTransform = m_transforms[0];
+    {
+        QMutexLocker locker(&m_mutex);
+        m_exited = true;
+        m_condition.wakeAll();
+    }
+
+    deinitialise();
+}
 
-    QString pluginId = primaryTransform.getPluginIdentifier();
+bool
+FeatureExtractionModelTransformer::PluginRunner::initialise()
+{
+    QString pluginId = m_transform.getPluginIdentifier();
 
     FeatureExtractionPluginFactory *factory =
         FeatureExtractionPluginFactory::instance();
 
     if (!factory) {
-        m_message = tr("No factory available for feature extraction plugin id \"%1\" (unknown plugin type, or internal error?)").arg(pluginId);
+        m_message = FeatureExtractionModelTransformer::tr("No factory available for feature extraction plugin id \"%1\" (unknown plugin type, or internal error?)").arg(pluginId);
         SVCERR << m_message << endl;
         return false;
     }
 
-    auto input = ModelById::getAs<DenseTimeValueModel>(getInputModel());
+    auto input = ModelById::getAs<DenseTimeValueModel>
+        (m_parent->getInputModel());
     if (!input) {
-        m_message = tr("Input model for feature extraction plugin \"%1\" is of wrong type (internal error?)").arg(pluginId);
+        m_message = FeatureExtractionModelTransformer::tr("Input model for feature extraction plugin \"%1\" is of wrong type (internal error?)").arg(pluginId);
         SVCERR << m_message << endl;
         return false;
     }
@@ -116,23 +389,23 @@ FeatureExtractionModelTransformer::initialise()
     
     m_plugin = factory->instantiatePlugin(pluginId, input->getSampleRate());
     if (!m_plugin) {
-        m_message = tr("Failed to instantiate plugin \"%1\"").arg(pluginId);
+        m_message = FeatureExtractionModelTransformer::tr("Failed to instantiate plugin \"%1\"").arg(pluginId);
         SVCERR << m_message << endl;
         return false;
     }
 
     TransformFactory::getInstance()->makeContextConsistentWithPlugin
-        (primaryTransform, m_plugin);
+        (m_transform, m_plugin);
     
     TransformFactory::getInstance()->setPluginParameters
-        (primaryTransform, m_plugin);
+        (m_transform, m_plugin);
     
     int channelCount = input->getChannelCount();
     if ((int)m_plugin->getMaxChannelCount() < channelCount) {
         channelCount = 1;
     }
     if ((int)m_plugin->getMinChannelCount() > channelCount) {
-        m_message = tr("Cannot provide enough channels to feature extraction plugin \"%1\" (plugin min is %2, max %3; input model has %4)")
+        m_message = FeatureExtractionModelTransformer::tr("Cannot provide enough channels to feature extraction plugin \"%1\" (plugin min is %2, max %3; input model has %4)")
             .arg(pluginId)
             .arg(m_plugin->getMinChannelCount())
             .arg(m_plugin->getMaxChannelCount())
@@ -141,8 +414,8 @@ FeatureExtractionModelTransformer::initialise()
         return false;
     }
 
-    int step = primaryTransform.getStepSize();
-    int block = primaryTransform.getBlockSize();
+    int step = m_transform.getStepSize();
+    int block = m_transform.getBlockSize();
     
     SVDEBUG << "Initialising feature extraction plugin with channels = "
             << channelCount << ", step = " << step
@@ -164,7 +437,7 @@ FeatureExtractionModelTransformer::initialise()
 
                 SVDEBUG << "Initialisation failed again" << endl;
                 
-                m_message = tr("Failed to initialise feature extraction plugin \"%1\"").arg(pluginId);
+                m_message = FeatureExtractionModelTransformer::tr("Failed to initialise feature extraction plugin \"%1\"").arg(pluginId);
                 SVCERR << m_message << endl;
                 return false;
 
@@ -172,11 +445,12 @@ FeatureExtractionModelTransformer::initialise()
                 
                 SVDEBUG << "Initialisation succeeded this time" << endl;
 
-                // Set these values into the primary transform in the list
-                m_transforms[0].setStepSize(preferredStep);
-                m_transforms[0].setBlockSize(preferredBlock);
+                // The transformer copies these back into its
+                // transforms once we are initialised
+                m_transform.setStepSize(preferredStep);
+                m_transform.setBlockSize(preferredBlock);
                 
-                m_message = tr("Feature extraction plugin \"%1\" rejected the given step and block sizes (%2 and %3); using plugin defaults (%4 and %5) instead")
+                m_message = FeatureExtractionModelTransformer::tr("Feature extraction plugin \"%1\" rejected the given step and block sizes (%2 and %3); using plugin defaults (%4 and %5) instead")
                     .arg(pluginId)
                     .arg(step)
                     .arg(block)
@@ -191,7 +465,7 @@ FeatureExtractionModelTransformer::initialise()
                     << " and block = " << block
                     << ", both matching the plugin's preference)" << endl;
                 
-            m_message = tr("Failed to initialise feature extraction plugin \"%1\"").arg(pluginId);
+            m_message = FeatureExtractionModelTransformer::tr("Failed to initialise feature extraction plugin \"%1\"").arg(pluginId);
             SVCERR << m_message << endl;
             return false;
         }
@@ -199,11 +473,11 @@ FeatureExtractionModelTransformer::initialise()
         SVDEBUG << "Initialisation succeeded" << endl;
     }
 
-    if (primaryTransform.getPluginVersion() != "") {
+    if (m_transform.getPluginVersion() != "") {
         QString pv = QString("%1").arg(m_plugin->getPluginVersion());
-        if (pv != primaryTransform.getPluginVersion()) {
-            QString vm = tr("Transform was configured for version %1 of plugin \"%2\", but the plugin being used is version %3")
-                .arg(primaryTransform.getPluginVersion())
+        if (pv != m_transform.getPluginVersion()) {
+            QString vm = FeatureExtractionModelTransformer::tr("Transform was configured for version %1 of plugin \"%2\", but the plugin being used is version %3")
+                .arg(m_transform.getPluginVersion())
                 .arg(pluginId)
                 .arg(pv);
             if (m_message != "") {
@@ -218,49 +492,44 @@ FeatureExtractionModelTransformer::initialise()
     Vamp::Plugin::OutputList outputs = m_plugin->getOutputDescriptors();
 
     if (outputs.empty()) {
-        m_message = tr("Plugin \"%1\" has no outputs").arg(pluginId);
+        m_message = FeatureExtractionModelTransformer::tr("Plugin \"%1\" has no outputs").arg(pluginId);
         SVCERR << m_message << endl;
         return false;
     }
 
-    for (int j = 0; in_range_for(m_transforms, j); ++j) {
+    for (int j = 0; in_range_for(m_transformNos, j); ++j) {
+
+        const Transform &transform = m_parent->m_transforms[m_transformNos[j]];
 
         for (int i = 0; in_range_for(outputs, i); ++i) {
 
-            if (m_transforms[j].getOutput() == "" ||
-                outputs[i].identifier ==
-                m_transforms[j].getOutput().toStdString()) {
-                
+            if (transform.getOutput() == "" ||
+                outputs[i].identifier == transform.getOutput().toStdString()) {
                 m_outputNos.push_back(i);
                 m_descriptors.push_back(outputs[i]);
-                m_fixedRateFeatureNos.push_back(-1); // we increment before use
                 break;
             }
         }
 
         if (!in_range_for(m_descriptors, j)) {
-            m_message = tr("Plugin \"%1\" has no output named \"%2\"")
+            m_message = FeatureExtractionModelTransformer::tr("Plugin \"%1\" has no output named \"%2\"")
                 .arg(pluginId)
-                .arg(m_transforms[j].getOutput());
+                .arg(transform.getOutput());
             SVCERR << m_message << endl;
             return false;
         }
     }
 
-    for (int j = 0; in_range_for(m_transforms, j); ++j) {
-        createOutputModels(j);
-    }
-
-    m_outputMutex.lock();
-    m_haveOutputs = true;
-    m_outputsCondition.wakeAll();
-    m_outputMutex.unlock();
+    m_apiVersion = int(m_plugin->getVampApiVersion());
+    m_channelCount = channelCount;
+    m_frequencyDomain = (m_plugin->getInputDomain() ==
+                         Vamp::Plugin::FrequencyDomain);
 
     return true;
 }
 
 void
-FeatureExtractionModelTransformer::deinitialise()
+FeatureExtractionModelTransformer::PluginRunner::deinitialise()
 {
     SVDEBUG << "FeatureExtractionModelTransformer: deleting plugin for transform in thread "
             << QThread::currentThreadId() << endl;
@@ -275,8 +544,456 @@ FeatureExtractionModelTransformer::deinitialise()
         m_message = e.what();
     }
     m_plugin = nullptr;
+}
+
+void
+FeatureExtractionModelTransformer::PluginRunner::process()
+{
+    int blockSize = m_transform.getBlockSize();
+
+    std::vector<floatvec_t> buffers(m_channelCount, floatvec_t(blockSize + 2));
+    std::vector<float *> bufferPtrs;
+    for (auto &b : buffers) bufferPtrs.push_back(b.data());
+
+    // Wait for the context (or for the end of input, if the
+    // transformer gives up before it gets that far). Our segment, if
+    // any, is also set by then
+    {
+        QMutexLocker locker(&m_mutex);
+        while (!m_haveContext && m_queue.empty() && !m_parent->m_abandoned) {
+            m_condition.wait(&m_mutex, 100);
+        }
+        if (!m_haveContext) {
+            return;
+        }
+    }
+
+    if (isSegmented()) {
+        processSegment(bufferPtrs.data());
+        return;
+    }
+    
+    sv_frame_t blockFrame = m_firstBlock;
+    int prevCompletion = 0;
+    bool done = false;
+
+    std::shared_ptr<const Chunk> chunk;
+
+    while (pop(chunk)) {
+        if (done) {
+            // The rest of the input is for other plugins' benefit
+            continue;
+        }
+        done = processChunk(*chunk, blockFrame, prevCompletion,
+                            bufferPtrs.data());
+    }
+
+    if (m_parent->m_abandoned) {
+        return;
+    }
+
+    processRemaining(blockFrame);
+}
+
+void
+FeatureExtractionModelTransformer::PluginRunner::processSegment(float **buffers)
+{
+    // We read our own input rather than waiting for chunks from the
+    // transformer's run thread
+    
+    int stepSize = m_transform.getStepSize();
+    int blockSize = m_transform.getBlockSize();
+
+    sv_frame_t end = m_ownEnd;
+    if (m_segment + 1 == m_segmentCount) {
+        end = m_contextStart + m_contextDuration;
+        if (m_frequencyDomain) {
+            end += blockSize/2 + 1;
+        }
+    }
+    
+    sv_frame_t chunkSize =
+        std::max(sv_frame_t(stepSize) * 16, sv_frame_t(65536));
+
+    sv_frame_t blockFrame = m_firstBlock;
+    int prevCompletion = 0;
+    
+    for (sv_frame_t chunkStart = m_firstBlock; chunkStart < end;
+         chunkStart += chunkSize) {
+
+        if (m_parent->m_abandoned) {
+            return;
+        }
+        
+        Chunk chunk;
+        chunk.start = chunkStart;
+        chunk.end = std::min(chunkStart + chunkSize, end);
+
+        QString error = m_parent->fillChunk
+            (chunk,
+             m_frequencyDomain ? 0 : blockSize,
+             !m_frequencyDomain && m_channelCount == 1,
+             !m_frequencyDomain && m_channelCount > 1,
+             m_fftConfig);
+
+        if (error != "") {
+            SVCERR << "FeatureExtractionModelTransformer::PluginRunner::processSegment: Abandoning, error is " << error << endl;
+            m_message = error;
+            m_parent->abandon();
+            return;
+        }
+
+        if (processChunk(chunk, blockFrame, prevCompletion, buffers)) {
+            break;
+        }
+    }
+
+    if (m_parent->m_abandoned) {
+        return;
+    }
+
+    processRemaining(blockFrame);
+}
+
+void
+FeatureExtractionModelTransformer::PluginRunner::processRemaining(sv_frame_t blockFrame)
+{
+    auto features = m_plugin->getRemainingFeatures();
+
+    for (int j = 0; in_range_for(m_outputNos, j); ++j) {
+        for (int fi = 0; in_range_for(features[m_outputNos[j]], fi); ++fi) {
+            auto feature = features[m_outputNos[j]][fi];
+            if (!isOwned(m_transformNos[j], blockFrame, feature)) {
+                continue;
+            }
+            m_parent->addFeature(m_transformNos[j], blockFrame, feature);
+            if (m_parent->m_abandoned) {
+                break;
+            }
+        }
+    }
+}
+
+bool
+FeatureExtractionModelTransformer::PluginRunner::isOwned
+(int n, sv_frame_t blockFrame, const Vamp::Plugin::Feature &feature) const
+{
+    if (!isSegmented()) {
+        return true;
+    }
+
+    // Segmentation is refused for fixed-rate outputs, so a feature
+    // is either timestamped or belongs to its block
+    sv_frame_t frame = blockFrame;
+    if (m_parent->m_descriptors[n].sampleType ==
+        Vamp::Plugin::OutputDescriptor::VariableSampleRate &&
+        feature.hasTimestamp) {
+        frame = RealTime::realTime2Frame(feature.timestamp, m_sampleRate);
+    }
+
+    return frame >= m_ownStart && frame < m_ownEnd;
+}
+
+bool
+FeatureExtractionModelTransformer::PluginRunner::haveAllModels() const
+{
+    if (!ModelById::get(m_parent->getInputModel())) {
+#ifdef DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN
+        SVDEBUG << "FeatureExtractionModelTransformer::run: Input model no longer exists" << endl;
+#endif
+        return false;
+    }
+    for (int n : m_transformNos) {
+        if (!ModelById::get(m_parent->m_outputs[n])) {
+#ifdef DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN
+            SVDEBUG << "FeatureExtractionModelTransformer::run: Output model " << m_parent->m_outputs[n] << " no longer exists" << endl;
+#endif
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+FeatureExtractionModelTransformer::PluginRunner::processChunk
+(const Chunk &chunk, sv_frame_t &blockFrame, int &prevCompletion,
+ float **buffers)
+{
+    // Return true if we have reached the end of our input
+
+    int stepSize = m_transform.getStepSize();
+    int blockSize = m_transform.getBlockSize();
+    
+    while (blockFrame < chunk.end) {
+
+        if (m_parent->m_abandoned) {
+            return true;
+        }
+        
+        if (m_frequencyDomain) {
+            if (blockFrame - int(blockSize)/2 >
+                m_contextStart + m_contextDuration) {
+                return true;
+            }
+        } else {
+            if (blockFrame >= m_contextStart + m_contextDuration) {
+                return true;
+            }
+        }
+
+#ifdef DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN
+        SVDEBUG << "FeatureExtractionModelTransformer::run: blockFrame "
+                << blockFrame << ", blockSize " << blockSize << endl;
+#endif
+        
+        int completion = int
+            ((((blockFrame - m_progressStart) / stepSize) * 99) /
+             ((m_progressEnd - m_progressStart) / stepSize + 1));
+
+        if (!haveAllModels()) {
+            m_parent->abandon();
+            return true;
+        }
+
+        // m_channelCount is either input->channelCount or 1
+
+        if (m_frequencyDomain) {
+            const Chunk::Columns &columns = chunk.fft[m_fftConfig];
+            int column = int((blockFrame - m_startFrame) / stepSize);
+            int index = column - columns.firstColumn;
+            if (index < 0 || index >= columns.count) {
+                throw std::logic_error("FFT column for block is missing from input chunk (internal error)");
+            }
+            for (int ch = 0; ch < m_channelCount; ++ch) {
+                const std::complex<float> *values =
+                    columns.channels[ch].data() +
+                    size_t(index) * (blockSize/2 + 1);
+                for (int i = 0; i <= blockSize/2; ++i) {
+                    buffers[ch][i*2] = values[i].real();
+                    buffers[ch][i*2+1] = values[i].imag();
+                }
+            }
+        } else {
+            sv_frame_t offset = blockFrame - chunk.start;
+            for (int ch = 0; ch < m_channelCount; ++ch) {
+                const floatvec_t &source =
+                    (m_channelCount == 1 ? chunk.mono : chunk.multi[ch]);
+                std::copy(source.begin() + offset,
+                          source.begin() + offset + blockSize,
+                          buffers[ch]);
+            }
+        }
+
+        auto features = m_plugin->process
+            (buffers,
+             RealTime::frame2RealTime(blockFrame, m_sampleRate)
+             .toVampRealTime());
+            
+        if (m_parent->m_abandoned) {
+            return true;
+        }
+
+        for (int j = 0; in_range_for(m_outputNos, j); ++j) {
+            for (int fi = 0; in_range_for(features[m_outputNos[j]], fi); ++fi) {
+                auto feature = features[m_outputNos[j]][fi];
+                if (!isOwned(m_transformNos[j], blockFrame, feature)) {
+                    continue;
+                }
+                m_parent->addFeature(m_transformNos[j], blockFrame, feature);
+            }
+        }
+
+        if (blockFrame == m_progressStart || completion > prevCompletion) {
+            m_parent->reportCompletion(this, completion);
+            prevCompletion = completion;
+        }
+
+        blockFrame += stepSize;
+    }
+
+    return false;
+}
+
+bool
+FeatureExtractionModelTransformer::initialise()
+{
+    // This is called from the run thread. Each plugin is constructed,
+    // initialised, used, and destroyed all from a single thread,
+    // namely that of the PluginRunner created for it here.
+    
+    // Transforms that are similar in every respect except plugin
+    // output share a plugin instance. All transforms must share the
+    // same input context, as the input is read once for all of them.
+
+    std::vector<std::vector<int>> groups;
+    m_runnerNos = std::vector<int>(m_transforms.size(), -1);
+
+    for (int j = 0; in_range_for(m_transforms, j); ++j) {
+
+        if (m_transforms[j].getStartTime() != m_transforms[0].getStartTime() ||
+            m_transforms[j].getDuration() != m_transforms[0].getDuration()) {
+            m_message = tr("Transforms supplied to a single FeatureExtractionModelTransformer instance must share the same start time and duration");
+            SVCERR << m_message << endl;
+            return false;
+        }
+        
+        for (int g = 0; in_range_for(groups, g); ++g) {
+            if (areTransformsSimilar(m_transforms[groups[g][0]],
+                                     m_transforms[j])) {
+                groups[g].push_back(j);
+                m_runnerNos[j] = g;
+                break;
+            }
+        }
+
+        if (m_runnerNos[j] < 0) {
+            m_runnerNos[j] = int(groups.size());
+            groups.push_back({ j });
+        }
+    }
+
+    for (const auto &g : groups) {
+        PluginRunner *runner = new PluginRunner(this, g);
+        runner->setObjectName(m_transforms[g[0]].getPluginIdentifier());
+        m_runners.push_back(runner);
+        runner->start();
+    }
+
+    bool ok = true;
+    QStringList messages;
+    
+    for (auto runner : m_runners) {
+        if (!runner->waitForInitialisation()) {
+            ok = false;
+        }
+        if (runner->getMessage() != "") {
+            messages.push_back(runner->getMessage());
+        }
+    }
+
+    m_message = messages.join("; ");
+
+    if (!ok) {
+        return false;
+    }
+
+    // Add a runner for each further segment of any transform that
+    // asks for parallel segments and can have them. Runners for the
+    // same transform share the same transform numbers
+
+    std::vector<PluginRunner *> segmentRunners;
+    int groupCount = int(m_runners.size());
+
+    for (int g = 0; g < groupCount; ++g) {
+
+        PluginRunner *runner = m_runners[g];
+        int segments = runner->getTransform().getParallelSegments();
+        if (segments <= 1) {
+            continue;
+        }
+
+        QString pluginId = runner->getTransform().getPluginIdentifier();
+
+        bool segmentable = true;
+        for (const auto &d : runner->getDescriptors()) {
+            if (!TransformFactory::isOutputSegmentable
+                (d, runner->getApiVersion())) {
+                segmentable = false;
+            }
+        }
+        if (!segmentable) {
+            SVDEBUG << "FeatureExtractionModelTransformer: Plugin \""
+                    << pluginId << "\" has a fixed-rate or dense output "
+                    << "and cannot be run in parallel segments, running "
+                    << "it in one segment instead" << endl;
+            continue;
+        }
+        
+        SVDEBUG << "FeatureExtractionModelTransformer: Running plugin \""
+                << pluginId << "\" in " << segments << " parallel segments"
+                << endl;
+        
+        runner->setSegment(0, segments);
+
+        for (int i = 1; i < segments; ++i) {
+            PluginRunner *segmentRunner = new PluginRunner
+                (this, runner->getTransformNos(), i, segments);
+            segmentRunner->setObjectName(pluginId);
+            m_runners.push_back(segmentRunner);
+            segmentRunners.push_back(segmentRunner);
+            segmentRunner->start();
+        }
+    }
+
+    for (auto runner : segmentRunners) {
+        // Any message is one we already have from the first segment
+        if (!runner->waitForInitialisation()) {
+            ok = false;
+        }
+    }
+
+    if (!ok) {
+        if (m_message == "") {
+            m_message = tr("Failed to initialise plugin for parallel segment");
+        }
+        return false;
+    }
+
+    m_outputNos = std::vector<int>(m_transforms.size(), 0);
+    m_descriptors = Vamp::Plugin::OutputList(m_transforms.size());
+    m_fixedRateFeatureNos = std::vector<int>(m_transforms.size(), -1);
+                                                // we increment before use
+
+    for (int g = 0; g < groupCount; ++g) {
+        PluginRunner *runner = m_runners[g];
+        const auto &transformNos = runner->getTransformNos();
+        for (int i = 0; in_range_for(transformNos, i); ++i) {
+            int j = transformNos[i];
+            m_outputNos[j] = runner->getOutputNos()[i];
+            m_descriptors[j] = runner->getDescriptors()[i];
+            m_transforms[j].setStepSize(runner->getTransform().getStepSize());
+            m_transforms[j].setBlockSize(runner->getTransform().getBlockSize());
+        }
+    }
+    
+    for (int j = 0; in_range_for(m_transforms, j); ++j) {
+        createOutputModels(j);
+    }
+
+    m_outputMutex.lock();
+    m_haveOutputs = true;
+    m_outputsCondition.wakeAll();
+    m_outputMutex.unlock();
+
+    return true;
+}
+
+void
+FeatureExtractionModelTransformer::deinitialise()
+{
+    // Tell the runners there is no more input, wait for them to
+    // finish, and pick up any messages they have for us
+    
+    for (auto runner : m_runners) {
+        runner->push({});
+    }
+
+    QStringList messages;
+    if (m_message != "") {
+        messages.push_back(m_message);
+    }
+    
+    for (auto runner : m_runners) {
+        runner->wait();
+        QString message = runner->getMessage();
+        if (message != "" && !messages.contains(message)) {
+            messages.push_back(message);
+        }
+        delete runner;
+    }
 
-    m_descriptors.clear();
+    m_runners.clear();
+    m_message = messages.join("; ");
 }
 
 void
@@ -351,7 +1068,8 @@ FeatureExtractionModelTransformer::createOutputModels(int n)
         break;
     }
 
-    bool preDurationPlugin = (m_plugin->getVampApiVersion() < 2);
+    bool preDurationPlugin =
+        (m_runners[m_runnerNos[n]]->getApiVersion() < 2);
 
     std::shared_ptr<Model> out;
 
@@ -490,8 +1208,7 @@ FeatureExtractionModelTransformer::createOutputModels(int n)
                 (modelRate, modelResolution, false);
         }
 
-        Vamp::Plugin::OutputList outputs = m_plugin->getOutputDescriptors();
-        model->setScaleUnits(outputs[m_outputNos[n]].unit.c_str());
+        model->setScaleUnits(m_descriptors[n].unit.c_str());
 
         out.reset(model);
 
@@ -541,13 +1258,15 @@ FeatureExtractionModelTransformer::awaitOutputModels()
 FeatureExtractionModelTransformer::~FeatureExtractionModelTransformer()
 {
     // Parent class dtor set the abandoned flag and waited for the run
-    // thread to exit; the run thread owns the plugin, and should have
-    // destroyed it before exiting (via a call to deinitialise)
+    // thread to exit; the run thread owns the plugin runners, and
+    // should have waited for them and destroyed them before exiting
+    // (via a call to deinitialise)
 }
 
 FeatureExtractionModelTransformer::Models
 FeatureExtractionModelTransformer::getAdditionalOutputModels()
 {
+    QMutexLocker locker(&m_additionalModelMutex);
     Models mm;
     for (auto mp : m_additionalModels) {
         for (auto m: mp.second) {
@@ -583,6 +1302,9 @@ FeatureExtractionModelTransformer::getAdditionalModel(int n, int binNo)
         !m_needAdditionalModels[n]) {
         return {};
     }
+
+    // Runners for different plugins may call this at the same time
+    QMutexLocker locker(&m_additionalModelMutex);
     
     if (!m_additionalModels[n][binNo].isNone()) {
         return m_additionalModels[n][binNo];
@@ -622,21 +1344,22 @@ FeatureExtractionModelTransformer::run()
     try {
         if (!initialise()) {
             abandon();
+            deinitialise();
             return;
         }
     } catch (const std::exception &e) {
         abandon();
         m_message = e.what();
+        deinitialise();
         return;
     }
 
     if (m_outputs.empty()) {
         abandon();
+        deinitialise();
         return;
     }
 
-    Transform primaryTransform = m_transforms[0];
-
     ModelId inputId = getInputModel();
 
     bool ready = false;
@@ -645,6 +1368,7 @@ FeatureExtractionModelTransformer::run()
             auto input = ModelById::getAs<DenseTimeValueModel>(inputId);
             if (!input || !input->isOK()) {
                 abandon();
+                deinitialise();
                 return;
             }
             ready = input->isReady();
@@ -655,7 +1379,10 @@ FeatureExtractionModelTransformer::run()
             usleep(500000);
         }
     }
-    if (m_abandoned) return;
+    if (m_abandoned) {
+        deinitialise();
+        return;
+    }
 
 #ifdef DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN
     SVDEBUG << "FeatureExtractionModelTransformer::run: Input model "
@@ -663,7 +1390,7 @@ FeatureExtractionModelTransformer::run()
 #endif
 
     sv_samplerate_t sampleRate;
-    int channelCount;
+    int inputChannelCount;
     sv_frame_t startFrame;
     sv_frame_t endFrame;
     
@@ -672,68 +1399,113 @@ FeatureExtractionModelTransformer::run()
         auto input = ModelById::getAs<DenseTimeValueModel>(inputId);
         if (!input) {
             abandon();
+            deinitialise();
             return;
         }
 
         sampleRate = input->getSampleRate();
-
-        channelCount = input->getChannelCount();
-        if ((int)m_plugin->getMaxChannelCount() < channelCount) {
-            channelCount = 1;
-        }
-
+        inputChannelCount = input->getChannelCount();
         startFrame = input->getStartFrame();
         endFrame = input->getEndFrame();
     }
 
-    float **buffers = new float*[channelCount];
-    for (int ch = 0; ch < channelCount; ++ch) {
-        buffers[ch] = new float[primaryTransform.getBlockSize() + 2];
-    }
+    m_inputChannelCount = inputChannelCount;
+    m_startFrame = startFrame;
+    
+    // Extent of the time-domain input required by the plugins fed
+    // from this thread: the longest time-domain block, and whether
+    // any plugin wants the single input channel (or mixdown) and/or
+    // all channels
+    int timeDomainBlockSize = 0;
+    bool wantMono = false, wantMulti = false;
 
-    int stepSize = primaryTransform.getStepSize();
-    int blockSize = primaryTransform.getBlockSize();
+    int maxStepSize = 1;
+    sv_frame_t maxFrequencyDomainOverrun = 0;
+    bool haveUnsegmented = false;
 
-    bool frequencyDomain = (m_plugin->getInputDomain() ==
-                            Vamp::Plugin::FrequencyDomain);
+    QString error = "";
+    
+    for (auto runner : m_runners) {
+
+        const Transform &transform = runner->getTransform();
+        int stepSize = transform.getStepSize();
+        int blockSize = transform.getBlockSize();
+        int channelCount = runner->getChannelCount();
+
+        if (!runner->isSegmented()) {
+            haveUnsegmented = true;
+            maxStepSize = std::max(maxStepSize, stepSize);
+            if (!runner->isFrequencyDomain()) {
+                timeDomainBlockSize = std::max(timeDomainBlockSize, blockSize);
+                if (channelCount == 1) wantMono = true;
+                else wantMulti = true;
+            } else {
+                // Frequency-domain processing continues until the
+                // centre of the block passes the end of the context
+                maxFrequencyDomainOverrun =
+                    std::max(maxFrequencyDomainOverrun,
+                             sv_frame_t(blockSize/2 + 1));
+            }
+        }
+
+        if (!runner->isFrequencyDomain()) {
+            continue;
+        }
+        
+        int config = -1;
+        for (int c = 0; in_range_for(m_fftConfigs, c); ++c) {
+            if (m_fftConfigs[c].windowType == transform.getWindowType() &&
+                m_fftConfigs[c].blockSize == blockSize &&
+                m_fftConfigs[c].stepSize == stepSize &&
+                m_fftConfigs[c].channelCount == channelCount) {
+                config = c;
+                break;
+            }
+        }
 
-    std::vector<FFTModel *> fftModels;
+        if (config < 0) {
 
-    if (frequencyDomain) {
 #ifdef DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN
-        SVDEBUG << "FeatureExtractionModelTransformer::run: Input is frequency-domain" << endl;
+            SVDEBUG << "FeatureExtractionModelTransformer::run: Creating FFT model(s) for block size " << blockSize << ", step size " << stepSize << endl;
 #endif
-        for (int ch = 0; ch < channelCount; ++ch) {
-            FFTModel *model = new FFTModel
-                (inputId,
-                 channelCount == 1 ? m_input.getChannel() : ch,
-                 primaryTransform.getWindowType(),
-                 blockSize,
-                 stepSize,
-                 blockSize);
-            if (!model->isOK() || model->getError() != "") {
-                QString err = model->getError();
-                delete model;
-                for (int j = 0; in_range_for(m_outputNos, j); ++j) {
-                    setCompletion(j, 100);
-                }
-                SVDEBUG << "FeatureExtractionModelTransformer::run: Failed to create FFT model for input model " << inputId << ": " << err << endl;
-                m_message = "Failed to create the FFT model for this feature extraction model transformer: error is: " + err;
-                for (int cch = 0; cch < ch; ++cch) {
-                    delete fftModels[cch];
+            FFTConfig fc { transform.getWindowType(),
+                    blockSize, stepSize, channelCount, {} };
+            
+            for (int ch = 0; ch < channelCount; ++ch) {
+                FFTModel *model = new FFTModel
+                    (inputId,
+                     channelCount == 1 ? m_input.getChannel() : ch,
+                     fc.windowType,
+                     blockSize,
+                     stepSize,
+                     blockSize);
+                if (!model->isOK() || model->getError() != "") {
+                    error = model->getError();
+                    delete model;
+                    break;
                 }
-                abandon();
-                return;
+                fc.models.push_back(model);
+            }
+
+            config = int(m_fftConfigs.size());
+            m_fftConfigs.push_back(fc);
+
+            if (error != "") {
+                break;
             }
-            fftModels.push_back(model);
         }
-#ifdef DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN
-        SVDEBUG << "FeatureExtractionModelTransformer::run: Created FFT model(s) for frequency-domain input" << endl;
-#endif
+
+        runner->setFFTConfig(config);
     }
 
-    RealTime contextStartRT = primaryTransform.getStartTime();
-    RealTime contextDurationRT = primaryTransform.getDuration();
+    if (error != "") {
+        SVDEBUG << "FeatureExtractionModelTransformer::run: Failed to create FFT model for input model " << inputId << ": " << error << endl;
+        m_message = "Failed to create the FFT model for this feature extraction model transformer: error is: " + error;
+        abandon();
+    }
+    
+    RealTime contextStartRT = m_transforms[0].getStartTime();
+    RealTime contextDurationRT = m_transforms[0].getDuration();
 
     sv_frame_t contextStart =
         RealTime::realTime2Frame(contextStartRT, sampleRate);
@@ -752,146 +1524,58 @@ FeatureExtractionModelTransformer::run()
         contextDuration = endFrame - contextStart;
     }
 
-    sv_frame_t blockFrame = contextStart;
-
-    long prevCompletion = 0;
-
     for (int j = 0; in_range_for(m_outputNos, j); ++j) {
         setCompletion(j, 0);
     }
 
-    float *reals = nullptr;
-    float *imaginaries = nullptr;
-    if (frequencyDomain) {
-        reals = new float[blockSize/2 + 1];
-        imaginaries = new float[blockSize/2 + 1];
-    }
+    m_contextStart = contextStart;
 
-    QString error = "";
+    for (auto runner : m_runners) {
+        runner->setContext(sampleRate, startFrame,
+                           contextStart, contextDuration);
+    }
 
-    try {
-        while (!m_abandoned) {
+    // Read the input a chunk at a time, calculating the FFT columns
+    // for each configuration in use, and hand each chunk to every
+    // unsegmented runner. The runners queue a few chunks each, so
+    // reading and FFT overlap with processing, and a plugin that is
+    // quicker than the rest may run ahead of them a little
 
-            if (frequencyDomain) {
-                if (blockFrame - int(blockSize)/2 >
-                    contextStart + contextDuration) {
-                    break;
-                }
-            } else {
-                if (blockFrame >= 
-                    contextStart + contextDuration) {
-                    break;
-                }
-            }
+    sv_frame_t feedEnd = contextStart + contextDuration +
+        maxFrequencyDomainOverrun;
+    if (!haveUnsegmented) {
+        feedEnd = contextStart;
+    }
+    sv_frame_t chunkSize =
+        std::max(sv_frame_t(maxStepSize) * 16, sv_frame_t(65536));
 
-#ifdef DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN
-            SVDEBUG << "FeatureExtractionModelTransformer::run: blockFrame "
-                    << blockFrame << ", endFrame " << endFrame << ", blockSize "
-                    << blockSize << endl;
-#endif
-        
-            int completion = int
-                ((((blockFrame - contextStart) / stepSize) * 99) /
-                 (contextDuration / stepSize + 1));
+    try {
+        for (sv_frame_t chunkStart = contextStart;
+             chunkStart < feedEnd && !m_abandoned;
+             chunkStart += chunkSize) {
 
-            bool haveAllModels = true;
             if (!ModelById::get(inputId)) {
-#ifdef DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN
-                SVDEBUG << "FeatureExtractionModelTransformer::run: Input model " << inputId << " no longer exists" << endl;
-#endif
-                haveAllModels = false;
-            } else {
-#ifdef DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN
-                SVDEBUG << "Input model " << inputId << " still exists" << endl;
-#endif
-            }
-            for (auto mid: m_outputs) {
-                if (!ModelById::get(mid)) {
-#ifdef DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN
-                    SVDEBUG << "FeatureExtractionModelTransformer::run: Output model " << mid << " no longer exists" << endl;
-#endif
-                    haveAllModels = false;
-                } else {
-#ifdef DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN
-                    SVDEBUG << "Output model " << mid << " still exists" << endl;
-#endif
-                }
-            }
-            if (!haveAllModels) {
                 abandon();
                 break;
             }
             
-#ifdef DEBUG_FEATURE_EXTRACTION_TRANSFORMER_RUN
-            SVDEBUG << "FeatureExtractionModelTransformer::run: All models still exist" << endl;
-#endif
-
-            // channelCount is either input->channelCount or 1
-
-            if (frequencyDomain) {
-                for (int ch = 0; ch < channelCount; ++ch) {
-                    int column = int((blockFrame - startFrame) / stepSize);
-                    if (fftModels[ch]->getValuesAt(column, reals, imaginaries)) {
-                        for (int i = 0; i <= blockSize/2; ++i) {
-                            buffers[ch][i*2] = reals[i];
-                            buffers[ch][i*2+1] = imaginaries[i];
-                        }
-                    } else {
-                        for (int i = 0; i <= blockSize/2; ++i) {
-                            buffers[ch][i*2] = 0.f;
-                            buffers[ch][i*2+1] = 0.f;
-                        }
-                    }
-                        
-                    error = fftModels[ch]->getError();
-                    if (error != "") {
-                        SVCERR << "FeatureExtractionModelTransformer::run: Abandoning, error is " << error << endl;
-                        m_abandoned = true;
-                        m_message = error;
-                        break;
-                    }
-                }
-            } else {
-                getFrames(channelCount, blockFrame, blockSize, buffers);
+            auto chunk = std::make_shared<Chunk>();
+            chunk->start = chunkStart;
+            chunk->end = std::min(chunkStart + chunkSize, feedEnd);
+
+            error = fillChunk(*chunk, timeDomainBlockSize,
+                              wantMono, wantMulti, -1);
+            if (error != "") {
+                SVCERR << "FeatureExtractionModelTransformer::run: Abandoning, error is " << error << endl;
+                m_abandoned = true;
+                m_message = error;
             }
 
             if (m_abandoned) break;
-
-            auto features = m_plugin->process
-                (buffers,
-                 RealTime::frame2RealTime(blockFrame, sampleRate)
-                 .toVampRealTime());
             
-            if (m_abandoned) break;
-
-            for (int j = 0; in_range_for(m_outputNos, j); ++j) {
-                for (int fi = 0; in_range_for(features[m_outputNos[j]], fi); ++fi) {
-                    auto feature = features[m_outputNos[j]][fi];
-                    addFeature(j, blockFrame, feature);
-                }
-            }
-
-            if (blockFrame == contextStart || completion > prevCompletion) {
-                for (int j = 0; in_range_for(m_outputNos, j); ++j) {
-                    setCompletion(j, completion);
-                }
-                prevCompletion = completion;
-            }
-
-            blockFrame += stepSize;
-
-        }
-
-        if (!m_abandoned) {
-            auto features = m_plugin->getRemainingFeatures();
-
-            for (int j = 0; in_range_for(m_outputNos, j); ++j) {
-                for (int fi = 0; in_range_for(features[m_outputNos[j]], fi); ++fi) {
-                    auto feature = features[m_outputNos[j]][fi];
-                    addFeature(j, blockFrame, feature);
-                    if (m_abandoned) {
-                        break;
-                    }
+            for (auto runner : m_runners) {
+                if (!runner->isSegmented()) {
+                    runner->push(chunk);
                 }
             }
         }
@@ -902,43 +1586,98 @@ FeatureExtractionModelTransformer::run()
         m_message = e.what();
     }
 
+    deinitialise();
+
     for (int j = 0; j < (int)m_outputNos.size(); ++j) {
         setCompletion(j, 100);
     }
 
-    if (frequencyDomain) {
-        for (int ch = 0; ch < channelCount; ++ch) {
-            delete fftModels[ch];
+    for (const auto &fc : m_fftConfigs) {
+        for (auto model : fc.models) {
+            delete model;
         }
-        delete[] reals;
-        delete[] imaginaries;
     }
+    m_fftConfigs.clear();
+}
+
+QString
+FeatureExtractionModelTransformer::fillChunk(Chunk &chunk,
+                                             sv_frame_t timeDomainBlockSize,
+                                             bool mono,
+                                             bool multi,
+                                             int onlyConfig)
+{
+    // This may be called from several threads at once, for parallel
+    // segments. The FFT models support concurrent reads
 
-    for (int ch = 0; ch < channelCount; ++ch) {
-        delete[] buffers[ch];
+    if (mono || multi) {
+        readChunk(chunk, chunk.end - chunk.start + timeDomainBlockSize,
+                  mono, multi, m_inputChannelCount);
     }
-    delete[] buffers;
 
-    deinitialise();
+    chunk.fft = std::vector<Chunk::Columns>(m_fftConfigs.size());
+
+    for (int c = 0; in_range_for(m_fftConfigs, c); ++c) {
+
+        if (onlyConfig >= 0 && c != onlyConfig) {
+            continue;
+        }
+        
+        const FFTConfig &fc = m_fftConfigs[c];
+        
+        // The blocks in this chunk are those at m_contextStart + k *
+        // stepSize for k in [k0, k1)
+        sv_frame_t k0 =
+            (chunk.start - m_contextStart + fc.stepSize - 1) / fc.stepSize;
+        sv_frame_t k1 =
+            (chunk.end - m_contextStart + fc.stepSize - 1) / fc.stepSize;
+                
+        Chunk::Columns &columns = chunk.fft[c];
+        columns.firstColumn = int((m_contextStart + k0 * fc.stepSize
+                                   - m_startFrame) / fc.stepSize);
+        columns.count = int(k1 - k0);
+
+        for (auto model : fc.models) {
+            columns.channels.push_back
+                (std::vector<std::complex<float>>
+                 (size_t(columns.count) * (fc.blockSize/2 + 1)));
+            if (columns.count > 0) {
+                model->getFFTColumns(columns.firstColumn,
+                                     columns.count,
+                                     columns.channels.back().data());
+            }
+            QString error = model->getError();
+            if (error != "") {
+                return error;
+            }
+        }
+    }
+
+    return {};
 }
 
 void
-FeatureExtractionModelTransformer::getFrames(int channelCount,
-                                             sv_frame_t startFrame,
-                                             sv_frame_t size,
-                                             float **buffers)
+FeatureExtractionModelTransformer::readChunk(Chunk &chunk,
+                                             sv_frame_t count,
+                                             bool mono,
+                                             bool multi,
+                                             int channelCount)
 {
+    if (mono) {
+        chunk.mono = floatvec_t(count, 0.f);
+    }
+    if (multi) {
+        chunk.multi = std::vector<floatvec_t>(channelCount,
+                                              floatvec_t(count, 0.f));
+    }
+
+    sv_frame_t startFrame = chunk.start;
     sv_frame_t offset = 0;
 
     if (startFrame < 0) {
-        for (int c = 0; c < channelCount; ++c) {
-            for (sv_frame_t i = 0; i < size && startFrame + i < 0; ++i) {
-                buffers[c][i] = 0.0f;
-            }
-        }
         offset = -startFrame;
-        size -= offset;
-        if (size <= 0) return;
+        count -= offset;
+        if (count <= 0) return;
         startFrame = 0;
     }
 
@@ -946,40 +1685,40 @@ FeatureExtractionModelTransformer::getFrames(int channelCount,
     if (!input) {
         return;
     }
-    
-    sv_frame_t got = 0;
 
-    if (channelCount == 1) {
-
-        auto data = input->getData(m_input.getChannel(), startFrame, size);
-        got = data.size();
-
-        copy(data.begin(), data.end(), buffers[0] + offset);
+    int channel = m_input.getChannel();
+    
+    if (multi) {
 
-        if (m_input.getChannel() == -1 && input->getChannelCount() > 1) {
-            // use mean instead of sum, as plugin input
-            float cc = float(input->getChannelCount());
-            for (sv_frame_t i = 0; i < got; ++i) {
-                buffers[0][i + offset] /= cc;
-            }
+        std::vector<float *> buffers;
+        for (auto &b : chunk.multi) {
+            buffers.push_back(b.data() + offset);
         }
-
-    } else {
-
-        auto data = input->getMultiChannelData(0, channelCount-1, startFrame, size);
-        if (!data.empty()) {
-            got = data[0].size();
-            for (int c = 0; in_range_for(data, c); ++c) {
-                copy(data[c].begin(), data[c].end(), buffers[c] + offset);
+        sv_frame_t got = input->readMultiChannelData
+            (0, channelCount-1, startFrame, count, buffers.data());
+
+        // Derive the single channel (or sum) from what we have
+        // just read, rather than reading again
+        if (mono) {
+            for (int c = 0; c < channelCount; ++c) {
+                if (channel >= 0 && c != channel) continue;
+                for (sv_frame_t i = 0; i < got; ++i) {
+                    chunk.mono[i + offset] += chunk.multi[c][i + offset];
+                }
             }
         }
+
+    } else if (mono) {
+        input->readData(channel, startFrame, count,
+                        chunk.mono.data() + offset);
     }
 
-    while (got < size) {
-        for (int c = 0; c < channelCount; ++c) {
-            buffers[c][got + offset] = 0.0;
+    if (mono && channel == -1 && channelCount > 1) {
+        // use mean instead of sum, as plugin input
+        float cc = float(channelCount);
+        for (auto &v : chunk.mono) {
+            v /= cc;
         }
-        ++got;
     }
 }
 
@@ -1170,6 +1909,30 @@ FeatureExtractionModelTransformer::addFeature(int n,
     }
 }
 
+void
+FeatureExtractionModelTransformer::reportCompletion(PluginRunner *runner,
+                                                    int completion)
+{
+    // The completion of a transform run in parallel segments is the
+    // mean of that of its segments
+    
+    QMutexLocker locker(&m_completionMutex);
+
+    runner->m_completion = completion;
+
+    int total = 0, count = 0;
+    for (auto r : m_runners) {
+        if (r->getTransformNos() == runner->getTransformNos()) {
+            total += r->m_completion;
+            ++count;
+        }
+    }
+
+    for (int n : runner->getTransformNos()) {
+        setCompletion(n, total / count);
+    }
+}
+
 void
 FeatureExtractionModelTransformer::setCompletion(int n, int completion)
 {
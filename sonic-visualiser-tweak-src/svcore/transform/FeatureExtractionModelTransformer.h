@@ -18,6 +18,8 @@
 
 #include "ModelTransformer.h"
 
+#include "base/Window.h"
+
 #include <QString>
 #include <QMutex>
 #include <QWaitCondition>
@@ -29,6 +31,7 @@
 
 class DenseTimeValueModel;
 class SparseTimeValueModel;
+class FFTModel;
 
 class FeatureExtractionModelTransformer : public ModelTransformer // + is a Thread
 {
@@ -39,9 +42,18 @@ public:
                                       const Transform &transform);
 
     /**
-     * Obtain outputs for a set of transforms that all use the same
-     * plugin and input (but with different outputs). i.e. run the
-     * plugin once only and collect more than one output from it.
+     * Obtain outputs for a set of transforms on the same input. The
+     * transforms may use different plugins (or the same plugin with
+     * different parameters), but must share the same start time and
+     * duration.
+     *
+     * Transforms that differ only in choice of plugin output share a
+     * single plugin instance, i.e. the plugin is run once only and
+     * more than one output collected from it. Each distinct plugin
+     * instance runs on its own thread. The input audio is read once
+     * for all of them, and the FFT is calculated once for each
+     * distinct combination of window type, block size and step size
+     * among the frequency-domain plugins.
      */
     FeatureExtractionModelTransformer(Input input,
                                       const Transforms &relatedTransforms);
@@ -53,12 +65,20 @@ public:
     bool willHaveAdditionalOutputModels() override;
 
 protected:
+    class PluginRunner;
+    struct Chunk;
+
     bool initialise();
     void deinitialise();
 
     void run() override;
 
-    Vamp::Plugin *m_plugin;
+    // one runner per distinct plugin instance, each serving one or
+    // more of the transforms
+    std::vector<PluginRunner *> m_runners;
+
+    // index into m_runners per transform
+    std::vector<int> m_runnerNos;
 
     // descriptors per transform
     std::vector<Vamp::Plugin::OutputDescriptor> m_descriptors;
@@ -78,6 +98,7 @@ protected:
     typedef std::map<int, std::map<int, ModelId> > AdditionalModelMap;
     
     AdditionalModelMap m_additionalModels;
+    QMutex m_additionalModelMutex;
     
     ModelId getAdditionalModel(int transformNo, int binNo);
 
@@ -87,8 +108,30 @@ protected:
 
     void setCompletion(int, int);
 
-    void getFrames(int channelCount, sv_frame_t startFrame, sv_frame_t size,
-                   float **buffer);
+    // One set of FFT models (one per channel) for each distinct
+    // combination of window, block size, step size and channel
+    // count, shared by all frequency-domain plugins using it
+    struct FFTConfig {
+        WindowType windowType;
+        int blockSize;
+        int stepSize;
+        int channelCount;
+        std::vector<FFTModel *> models;
+    };
+    std::vector<FFTConfig> m_fftConfigs;
+
+    // Set by the run thread before any chunks are filled
+    int m_inputChannelCount;
+    sv_frame_t m_startFrame;
+    sv_frame_t m_contextStart;
+
+    QString fillChunk(Chunk &chunk, sv_frame_t timeDomainBlockSize,
+                      bool mono, bool multi, int onlyConfig);
+    void readChunk(Chunk &chunk, sv_frame_t count,
+                   bool mono, bool multi, int channelCount);
+
+    QMutex m_completionMutex;
+    void reportCompletion(PluginRunner *runner, int completion);
 
     bool m_haveOutputs;
     QMutex m_outputMutex;
@@ -22,6 +22,8 @@
 
 #include "Transform.h"
 
+#include <atomic>
+
 /**
  * A ModelTransformer turns one data model into another.
  *
@@ -126,7 +128,10 @@ protected:
     Transforms m_transforms;
     Input m_input;
     Models m_outputs;
-    bool m_abandoned;
+
+    // Set from the GUI thread and by worker threads of subclasses,
+    // and polled by both
+    std::atomic<bool> m_abandoned;
     QString m_message;
 };
 
@@ -253,12 +253,14 @@ ModelTransformerFactory::transformMultiple(const Transforms &transforms,
     
     if (!models.empty()) {
         QString imn = inputModel->objectName();
-        QString trn =
-            TransformFactory::getInstance()->getTransformFriendlyName
-            (transforms[0].getIdentifier());
         for (int i = 0; in_range_for(models, i); ++i) {
             auto model = ModelById::get(models[i]);
             if (!model) continue;
+            // The transforms may be for different plugins
+            QString trn =
+                TransformFactory::getInstance()->getTransformFriendlyName
+                (transforms[in_range_for(transforms, i) ? i : 0]
+                 .getIdentifier());
             if (imn != "") {
                 if (trn != "") {
                     model->setObjectName(tr("%1: %2").arg(imn).arg(trn));
@@ -111,11 +111,13 @@ public:
 
     /**
      * Return the multiple output models resulting from applying the
-     * named transforms to the given input model.  The transforms may
-     * differ only in output identifier for the plugin: they must all
-     * use the same plugin, parameters, and programs. The plugin will
-     * be run once only, but more than one output will be harvested
-     * (as appropriate). Models will be returned in the same order as
+     * named transforms to the given input model.  The transforms
+     * must all be feature extraction transforms sharing the same
+     * start time and duration, but may use different plugins. Each
+     * plugin will be run once only on its own thread, with more than
+     * one output harvested where transforms differ only in output
+     * identifier, and the input audio and FFT will be shared between
+     * plugins. Models will be returned in the same order as
      * the transforms were given. The plugin may still be working in
      * the background when the model is returned; check the output
      * models' isReady completion statuses for more details. To cancel
@@ -36,7 +36,8 @@ Transform::Transform() :
     m_stepSize(0),
     m_blockSize(0),
     m_windowType(HanningWindow),
-    m_sampleRate(0)
+    m_sampleRate(0),
+    m_parallelSegments(0)
 {
 }
 
@@ -45,7 +46,8 @@ Transform::Transform(QString xml) :
     m_stepSize(0),
     m_blockSize(0),
     m_windowType(HanningWindow),
-    m_sampleRate(0)
+    m_sampleRate(0),
+    m_parallelSegments(0)
 {
     QDomDocument doc;
     
@@ -119,7 +121,9 @@ Transform::operator==(const Transform &t) const
         m_windowType == t.m_windowType &&
         m_startTime == t.m_startTime &&
         m_duration == t.m_duration &&
-        m_sampleRate == t.m_sampleRate;
+        m_sampleRate == t.m_sampleRate &&
+        m_parallelSegments == t.m_parallelSegments &&
+        m_segmentOverlap == t.m_segmentOverlap;
 /*
     SVDEBUG << "Transform::operator==: identical = " << identical << endl;
     cerr << "A = " << endl;
@@ -166,6 +170,12 @@ Transform::operator<(const Transform &t) const
     if (m_sampleRate != t.m_sampleRate) {
         return m_sampleRate < t.m_sampleRate;
     }
+    if (m_parallelSegments != t.m_parallelSegments) {
+        return m_parallelSegments < t.m_parallelSegments;
+    }
+    if (m_segmentOverlap != t.m_segmentOverlap) {
+        return m_segmentOverlap < t.m_segmentOverlap;
+    }
     return false;
 }
 
@@ -386,6 +396,30 @@ Transform::setSampleRate(sv_samplerate_t rate)
     m_sampleRate = rate;
 }
 
+int
+Transform::getParallelSegments() const
+{
+    return m_parallelSegments;
+}
+
+void
+Transform::setParallelSegments(int segments)
+{
+    m_parallelSegments = segments;
+}
+
+RealTime
+Transform::getSegmentOverlap() const
+{
+    return m_segmentOverlap;
+}
+
+void
+Transform::setSegmentOverlap(RealTime overlap)
+{
+    m_segmentOverlap = overlap;
+}
+
 void
 Transform::toXml(QTextStream &out, QString indent, QString extraAttributes) const
 {
@@ -409,6 +443,12 @@ Transform::toXml(QTextStream &out, QString indent, QString extraAttributes) cons
         out << QString("\n    summaryType=\"%1\"").arg(summaryTypeToString(m_summaryType));
     }
 
+    if (m_parallelSegments > 1) {
+        out << QString("\n    parallelSegments=\"%1\"\n    segmentOverlap=\"%2\"")
+            .arg(m_parallelSegments)
+            .arg(encodeEntities(m_segmentOverlap.toString().c_str()));
+    }
+
     if (extraAttributes != "") {
         out << " " << extraAttributes;
     }
@@ -525,5 +565,14 @@ Transform::setFromXmlAttributes(const QXmlAttributes &attrs)
     if (attrs.value("summaryType") != "") {
         setSummaryType(stringToSummaryType(attrs.value("summaryType")));
     }
+
+    if (attrs.value("parallelSegments") != "") {
+        setParallelSegments(attrs.value("parallelSegments").toInt());
+    }
+
+    if (attrs.value("segmentOverlap") != "") {
+        setSegmentOverlap(RealTime::fromString
+                          (attrs.value("segmentOverlap").toStdString()));
+    }
 }
 
@@ -139,6 +139,29 @@ public:
     sv_samplerate_t getSampleRate() const; // 0 -> as input
     void setSampleRate(sv_samplerate_t rate);
 
+    /**
+     * Parallel segments. If this is greater than 1, a feature
+     * extraction transform divides its input into that many
+     * segments, each processed by a separate instance of the plugin
+     * on its own thread, and merges the results. This is only
+     * appropriate for plugins whose output does not depend on
+     * long-range state, such as per-frame spectral descriptors, and
+     * so it is never enabled by default. See also
+     * TransformFactory::setParallelSegments.
+     */
+    int getParallelSegments() const; // 0 or 1 -> not segmented
+    void setParallelSegments(int segments);
+
+    /**
+     * Warm-up overlap for parallel segments. Each segment after the
+     * first starts processing this long before the start of its
+     * segment, discarding the features obtained from the overlap, so
+     * that any short-range state within the plugin has settled by
+     * the time it reaches the segment proper.
+     */
+    RealTime getSegmentOverlap() const;
+    void setSegmentOverlap(RealTime overlap);
+
     void toXml(QTextStream &stream, QString indent = "",
                QString extraAttributes = "") const override;
 
@@ -198,6 +221,8 @@ protected:
     RealTime m_startTime;
     RealTime m_duration;
     sv_samplerate_t m_sampleRate;
+    int m_parallelSegments;
+    RealTime m_segmentOverlap;
     QString m_errorString;
 };
 
@@ -915,6 +915,87 @@ TransformFactory::isTransformConfigurable(TransformId identifier)
     } else return false;
 }
 
+bool
+TransformFactory::isTransformSegmentable(TransformId identifier)
+{
+    Transform transform;
+    transform.setIdentifier(identifier);
+
+    if (transform.getType() != Transform::FeatureExtraction) {
+        return false;
+    }
+
+    Vamp::Plugin *plugin =
+        downcastVampPlugin(instantiateDefaultPluginFor(identifier, 0));
+
+    if (!plugin) {
+        return false;
+    }
+
+    bool segmentable = false;
+    
+    Vamp::Plugin::OutputList outputs = plugin->getOutputDescriptors();
+    for (const auto &output : outputs) {
+        if (transform.getOutput() == "" ||
+            output.identifier == transform.getOutput().toStdString()) {
+            segmentable = isOutputSegmentable
+                (output, int(plugin->getVampApiVersion()));
+            break;
+        }
+    }
+
+    delete plugin;
+    return segmentable;
+}
+
+bool
+TransformFactory::isOutputSegmentable(const Vamp::Plugin::OutputDescriptor &d,
+                                      int vampApiVersion)
+{
+    typedef Vamp::Plugin::OutputDescriptor OD;
+    
+    if (d.sampleType == OD::FixedSampleRate) {
+        return false;
+    }
+
+    // The remaining cases follow the choice of output model in
+    // FeatureExtractionModelTransformer::createOutputModels: only an
+    // output with a fixed bin count other than 0 or 1, not of
+    // variable sample rate, and without durations, gets a dense 3-D
+    // model
+
+    if (!d.hasFixedBinCount || d.binCount == 0 || d.binCount == 1) {
+        return true;
+    }
+    if (d.sampleType == OD::VariableSampleRate) {
+        return true;
+    }
+    bool preDurationPlugin = (vampApiVersion < 2);
+    if (!preDurationPlugin && d.hasDuration) {
+        return true;
+    }
+    
+    return false;
+}
+
+bool
+TransformFactory::setParallelSegments(Transform &transform, int segments,
+                                      RealTime overlap)
+{
+    if (!isTransformSegmentable(transform.getIdentifier())) {
+        transform.setParallelSegments(0);
+        return false;
+    }
+
+    if (segments <= 0) {
+        segments = QThread::idealThreadCount();
+    }
+
+    transform.setParallelSegments(segments);
+    transform.setSegmentOverlap(overlap);
+    return true;
+}
+
 bool
 TransformFactory::getTransformChannelRange(TransformId identifier,
                                            int &min, int &max)
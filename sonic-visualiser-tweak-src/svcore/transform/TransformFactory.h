@@ -123,6 +123,40 @@ public:
     bool getTransformChannelRange(TransformId identifier,
                                   int &minChannels, int &maxChannels);
 
+    /**
+     * Return true if the transform could be run in parallel segments
+     * (see Transform::setParallelSegments). That requires a feature
+     * extraction transform whose output is segmentable according to
+     * isOutputSegmentable. Whether the plugin's results are
+     * independent of long-range state is something only the user can
+     * know, so this is not a recommendation to segment it.
+     */
+    bool isTransformSegmentable(TransformId identifier);
+
+    /**
+     * Return true if features from the given output, of a plugin
+     * using the given Vamp API version, may be calculated in parallel
+     * segments and added to the output model in whatever order the
+     * segments produce them. An output of fixed sample rate numbers
+     * its features implicitly from the start of the input, and one
+     * with a fixed number of values (other than one) per step at a
+     * fixed rate is stored in a dense 3-D model, which compresses
+     * each column against the one before it and so must be given its
+     * columns in order. Neither is segmentable.
+     */
+    static bool isOutputSegmentable(const Vamp::Plugin::OutputDescriptor &,
+                                    int vampApiVersion);
+
+    /**
+     * Configure the given transform to run in the given number of
+     * parallel segments, or one per available processor core if
+     * segments is zero, with the given warm-up overlap between
+     * segments. Return false and leave the transform unsegmented if
+     * it is not segmentable.
+     */
+    bool setParallelSegments(Transform &transform, int segments,
+                             RealTime overlap);
+
     /**
      * Load an appropriate plugin for the given transform and set the
      * parameters, program and configuration strings on that plugin
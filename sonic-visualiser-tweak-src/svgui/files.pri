@@ -14,6 +14,7 @@ SVGUI_HEADERS += \
            layer/Layer.h \
            layer/LayerFactory.h \
            layer/LayerGeometryProvider.h \
+           layer/LayerGeometrySnapshot.h \
            layer/LinearNumericalScale.h \
            layer/LogNumericalScale.h \
            layer/LinearColourScale.h \
@@ -1214,6 +1214,23 @@ Colour3DPlotLayer::paint(LayerGeometryProvider *v, QPainter &paint, QRect rect)
     paintWithRenderer(v, paint, rect);
 }
 
+void
+Colour3DPlotLayer::prefetch(LayerGeometryProvider *v,
+                            sv_frame_t startFrame) const
+{
+    if (m_synchronous) return;
+
+    auto model = ModelById::getAs<DenseThreeDimensionalModel>(m_model);
+    if (!model || !model->isOK() || !model->isReady() ||
+        model->getWidth() == 0) {
+        return;
+    }
+
+    if (Colour3DPlotRenderer *renderer = getRenderer(v)) {
+        renderer->prefetch(v, startFrame);
+    }
+}
+
 bool
 Colour3DPlotLayer::snapToFeatureFrame(LayerGeometryProvider *v,
                                       sv_frame_t &frame,
@@ -52,6 +52,8 @@ public:
     
     void paint(LayerGeometryProvider *v,
                QPainter &paint, QRect rect) const override;
+    void prefetch(LayerGeometryProvider *v,
+                  sv_frame_t startFrame) const override;
     void setSynchronousPainting(bool synchronous) override;
 
     int getVerticalScaleWidth(LayerGeometryProvider *v,
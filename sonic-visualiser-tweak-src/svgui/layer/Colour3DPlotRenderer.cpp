@@ -24,13 +24,22 @@
 #include "data/model/FFTModel.h"
 
 #include "LayerGeometryProvider.h"
+#include "LayerGeometrySnapshot.h"
 #include "VerticalBinLayer.h"
 #include "PaintAssistant.h"
 #include "ImageRegionFinder.h"
 
 #include "view/ViewManager.h" // for main model sample rate. Pity
 
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QMutex>
+#include <QMutexLocker>
+
 #include <vector>
+#include <cmath>
 
 #include <utility>
 using namespace std::rel_ops;
@@ -40,6 +49,73 @@ using namespace std::rel_ops;
 
 using namespace std;
 
+namespace {
+
+/**
+ * The pool used for rendering tiles of the draw buffer
+ * concurrently. It has one thread fewer than the number of available
+ * cores, as the rendering thread always renders one tile itself.
+ */
+QThreadPool *getRenderThreadPool()
+{
+    static QThreadPool *pool = []() {
+        auto p = new QThreadPool;
+        p->setMaxThreadCount(std::max(1, QThread::idealThreadCount() - 1));
+        return p;
+    }();
+    return pool;
+}
+
+/**
+ * The pool used for prefetching. One thread is enough, as only the
+ * next page of each view is ever prefetched and that should not
+ * compete with rendering that is wanted now.
+ */
+QThreadPool *getPrefetchThreadPool()
+{
+    static QThreadPool *pool = []() {
+        auto p = new QThreadPool;
+        p->setMaxThreadCount(1);
+        return p;
+    }();
+    return pool;
+}
+
+class TileTask : public QRunnable
+{
+public:
+    TileTask(std::function<void()> task) : m_task(task) { }
+    void run() override { m_task(); }
+
+private:
+    std::function<void()> m_task;
+};
+
+}
+
+struct Colour3DPlotRenderer::Prefetch
+{
+    Prefetch(Sources sources, Parameters parameters,
+             const LayerGeometryProvider *v, sv_frame_t startFrame) :
+        renderer(sources, parameters),
+        geometry(v, startFrame),
+        abandoned(false),
+        done(false) {
+        renderer.m_abandoned = &abandoned;
+    }
+
+    Colour3DPlotRenderer renderer;
+    LayerGeometrySnapshot geometry;
+    std::atomic<bool> abandoned;
+    bool done;
+    QMutex mutex; // held by the prefetch thread throughout rendering
+};
+
+Colour3DPlotRenderer::~Colour3DPlotRenderer()
+{
+    cancelPrefetch();
+}
+
 Colour3DPlotRenderer::RenderResult
 Colour3DPlotRenderer::render(const LayerGeometryProvider *v, QPainter &paint, QRect rect)
 {
@@ -75,6 +151,182 @@ Colour3DPlotRenderer::getLargestUncachedRect(const LayerGeometryProvider *v)
     }
 }
 
+void
+Colour3DPlotRenderer::prefetch(const LayerGeometryProvider *v,
+                               sv_frame_t startFrame)
+{
+    if (m_abandoned) {
+        return; // we are a prefetch already
+    }
+
+    if (m_prefetch &&
+        m_prefetch->geometry.getStartFrame() == startFrame &&
+        m_prefetch->geometry.getZoomLevel() == v->getZoomLevel() &&
+        m_prefetch->geometry.getPaintSize() == v->getPaintSize()) {
+        return; // already done or under way
+    }
+
+    cancelPrefetch();
+
+    if (v->getZoomLevel().zone != ZoomLevel::FramesPerPixel ||
+        decideRenderType(v) != DrawBufferPixelResolution) {
+        return;
+    }
+
+    std::vector<ModelId> models { m_sources.source };
+    if (!m_sources.fft.isNone()) {
+        models.push_back(m_sources.fft);
+    }
+    for (auto id: m_sources.peakCaches) {
+        models.push_back(id);
+    }
+    for (auto id: models) {
+        auto model = ModelById::getAs<DenseThreeDimensionalModel>(id);
+        if (!model || !model->isReady() || !model->supportsConcurrentReads()) {
+            return;
+        }
+    }
+
+    LayerGeometrySnapshot target(v, startFrame);
+    if (getUsableCacheWidth(&target) == target.getPaintWidth()) {
+        return; // nothing to gain
+    }
+
+#ifdef DEBUG_COLOUR_PLOT_REPAINT
+    SVDEBUG << "render " << m_sources.source
+            << ": prefetching from start frame " << startFrame << endl;
+#endif
+
+    auto prefetch = std::make_shared<Prefetch>(m_sources, m_params,
+                                               v, startFrame);
+    m_prefetch = prefetch;
+
+    getPrefetchThreadPool()->start
+        (new TileTask([prefetch]() {
+            QMutexLocker locker(&prefetch->mutex);
+            if (prefetch->abandoned) return;
+            QThread::currentThread()->setPriority(QThread::LowestPriority);
+            // We only want the cache filled, so paint the result
+            // into a token image
+            QImage image(1, 1, QImage::Format_ARGB32_Premultiplied);
+            QPainter paint(&image);
+            const LayerGeometryProvider *g = &prefetch->geometry;
+            prefetch->renderer.render(g, paint, g->getPaintRect(), false);
+            paint.end();
+            prefetch->done = !prefetch->abandoned;
+        }));
+}
+
+void
+Colour3DPlotRenderer::takePrefetch(const LayerGeometryProvider *v)
+{
+    if (!m_prefetch) return;
+
+    std::shared_ptr<Prefetch> prefetch = m_prefetch;
+
+    if (prefetch->geometry.getZoomLevel() != v->getZoomLevel() ||
+        prefetch->geometry.getPaintSize() != v->getPaintSize()) {
+        cancelPrefetch(); // of no further use
+        return;
+    }
+
+    if (m_cache.isValid() && m_cache.getStartFrame() == v->getStartFrame()) {
+        return; // not scrolled since our last render, keep it for later
+    }
+
+    // Never wait for the prefetch here; if it is still rendering,
+    // carry on without it. Once it is done, the prefetch thread no
+    // longer touches its renderer.
+    if (!prefetch->mutex.tryLock()) return;
+    bool done = prefetch->done;
+    prefetch->mutex.unlock();
+
+    if (!done) return;
+
+    Colour3DPlotRenderer &other = prefetch->renderer;
+    if (other.getUsableCacheWidth(v) > getUsableCacheWidth(v)) {
+#ifdef DEBUG_COLOUR_PLOT_REPAINT
+        SVDEBUG << "render " << m_sources.source
+                << ": taking cache prefetched from start frame "
+                << prefetch->geometry.getStartFrame() << endl;
+#endif
+        std::swap(m_cache, other.m_cache);
+        std::swap(m_magCache, other.m_magCache);
+        m_prefetch.reset();
+    }
+}
+
+void
+Colour3DPlotRenderer::cancelPrefetch()
+{
+    if (!m_prefetch) return;
+
+    std::shared_ptr<Prefetch> prefetch = m_prefetch;
+    m_prefetch.reset();
+
+    // The prefetch thread checks this between pixel columns. Wait for
+    // it to notice, as it may be using our sources
+    prefetch->abandoned = true;
+    QMutexLocker locker(&prefetch->mutex);
+}
+
+int
+Colour3DPlotRenderer::getUsableCacheWidth(const LayerGeometryProvider *v) const
+{
+    if (!m_cache.isValid() ||
+        m_cache.getSize() != v->getPaintSize() ||
+        m_cache.getZoomLevel() != v->getZoomLevel()) {
+        return 0;
+    }
+
+    int dx = v->getXForFrame(m_cache.getStartFrame()) -
+        v->getXForFrame(v->getStartFrame());
+
+    int left = std::max(0, m_cache.getValidLeft() + dx);
+    int right = std::min(m_cache.getSize().width(),
+                         m_cache.getValidRight() + dx);
+
+    return std::max(0, right - left);
+}
+
+void
+Colour3DPlotRenderer::invalidateFrames(sv_frame_t startFrame,
+                                       sv_frame_t endFrame)
+{
+    // A prefetch may have read the data before it changed
+    cancelPrefetch();
+    
+    m_cache.damage(startFrame, endFrame);
+}
+
+void
+Colour3DPlotRenderer::repairDamage(const LayerGeometryProvider *v,
+                                   RenderType renderType)
+{
+    if (!m_cache.isDamaged()) return;
+
+    QRect area = m_cache.getDamagedArea(v);
+    m_cache.clearDamage();
+
+    if (area.isEmpty()) return;
+
+#ifdef DEBUG_COLOUR_PLOT_REPAINT
+    SVDEBUG << "render " << m_sources.source
+            << ": repairing damaged columns " << area.x()
+            << " to " << area.x() + area.width() << endl;
+#endif
+
+    // The damaged area lies within the valid area, so redrawing it
+    // keeps the cache contiguous. It is usually narrow (e.g. the
+    // newly-recorded end of a model), so is never time-constrained.
+    if (renderType == DrawBufferBinResolution) {
+        renderToCacheBinResolution(v, area.x(), area.width());
+    } else {
+        renderToCachePixelResolution(v, area.x(), area.width(),
+                                     false, false);
+    }
+}
+
 bool
 Colour3DPlotRenderer::geometryChanged(const LayerGeometryProvider *v)
 {
@@ -126,6 +378,10 @@ Colour3DPlotRenderer::render(const LayerGeometryProvider *v,
         }
     }
             
+    if (renderType != DirectTranslucent) {
+        takePrefetch(v);
+    }
+            
     int x0 = v->getXForViewX(rect.x());
     int x1 = v->getXForViewX(rect.x() + rect.width());
     if (x0 < 0) x0 = 0;
@@ -158,6 +414,11 @@ Colour3DPlotRenderer::render(const LayerGeometryProvider *v,
 
     m_magCache.resize(v->getPaintSize().width());
     m_magCache.setZoomLevel(v->getZoomLevel());
+
+    m_memoryAccount.setBytes
+        (size_t(m_cache.getImage().bytesPerLine()) *
+         m_cache.getImage().height() +
+         size_t(m_drawBuffer.bytesPerLine()) * m_drawBuffer.height());
     
     if (renderType == DirectTranslucent) {
         MagnitudeRange range = renderDirectTranslucent(v, paint, rect);
@@ -191,6 +452,8 @@ Colour3DPlotRenderer::render(const LayerGeometryProvider *v,
                     << ": cache hit" << endl;
 #endif
             count.hit();
+
+            repairDamage(v, renderType);
             
             // cache is valid for the complete requested area
             paint.drawImage(rect, m_cache.getImage(), rect);
@@ -232,6 +495,8 @@ Colour3DPlotRenderer::render(const LayerGeometryProvider *v,
         m_magCache.setStartFrame(startFrame);
     }
 
+    repairDamage(v, renderType);
+
     bool rightToLeft = false;
 
     int reqx0 = x0;
@@ -1071,45 +1336,35 @@ Colour3DPlotRenderer::renderDrawBuffer(int w, int h,
             << ") (model height " << sh << ")" << endl;
 #endif
     
-    int psx = -1;
-
-    int start = 0;
-    int finish = w;
-    int step = 1;
-
-    if (rightToLeft) {
-        start = w-1;
-        finish = -1;
-        step = -1;
-    }
-
-    int xPixelCount = 0;
-    
-    vector<float> preparedColumn;
-
     int modelWidth = sourceModel->getWidth();
 
+    bool concurrent = sourceModel->supportsConcurrentReads();
+    
 #ifdef DEBUG_COLOUR_PLOT_REPAINT
     SVDEBUG << "render " << m_sources.source
-            << ": modelWidth " << modelWidth << ", divisor " << divisor << endl;
-    SVDEBUG << "render " << m_sources.source
-            << ": start = " << start << ", finish = " << finish << ", step = " << step << endl;
+            << ": modelWidth " << modelWidth << ", divisor " << divisor
+            << ", concurrent " << concurrent << endl;
 #endif
-    
-    for (int x = start; x != finish; x += step) {
+
+    // We write pixels directly rather than through QImage::setPixel,
+    // which is not safe to call from more than one thread at once
+    // even for distinct pixels
+    uchar *bits = m_drawBuffer.bits();
+    int bpl = m_drawBuffer.bytesPerLine();
+
+    auto renderer = [&](int x, PixelColumnState &state,
+                        MagnitudeRange &magRange) -> bool {
 
         // x is the on-canvas pixel coord; sx (later) will be the
         // source column index
         
-        ++xPixelCount;
-        
-        if (binforx[x] < 0) continue;
+        if (binforx[x] < 0) return false;
 
         int sx0 = binforx[x] / divisor;
         int sx1 = sx0;
         if (x+1 < w) sx1 = binforx[x+1] / divisor;
         if (sx0 < 0) sx0 = sx1 - 1;
-        if (sx0 < 0) continue;
+        if (sx0 < 0) return false;
         if (sx1 <= sx0) sx1 = sx0 + 1;
 
 #ifdef DEBUG_COLOUR_PLOT_REPAINT
@@ -1117,7 +1372,6 @@ Colour3DPlotRenderer::renderDrawBuffer(int w, int h,
 #endif
 
         vector<float> pixelPeakColumn;
-        MagnitudeRange magRange;
         
         for (int sx = sx0; sx < sx1; ++sx) {
 
@@ -1125,7 +1379,7 @@ Colour3DPlotRenderer::renderDrawBuffer(int w, int h,
                 continue;
             }
 
-            if (sx != psx) {
+            if (sx != state.psx) {
                 
                 // order:
                 // get column -> scale -> normalise -> record extents ->
@@ -1141,7 +1395,7 @@ Colour3DPlotRenderer::renderDrawBuffer(int w, int h,
                     column = ColumnOp::peakPick(column);
                 }
 
-                preparedColumn =
+                state.preparedColumn =
                     ColumnOp::distribute(column,
                                          h,
                                          binfory,
@@ -1151,53 +1405,43 @@ Colour3DPlotRenderer::renderDrawBuffer(int w, int h,
                 // Display gain belongs to the colour scale and is
                 // applied by the colour scale object when mapping it
                 
-                psx = sx;
+                state.psx = sx;
             }
 
             if (sx == sx0) {
-                pixelPeakColumn = preparedColumn;
+                pixelPeakColumn = state.preparedColumn;
             } else {
                 for (int i = 0; in_range_for(pixelPeakColumn, i); ++i) {
                     pixelPeakColumn[i] = std::max(pixelPeakColumn[i],
-                                                  preparedColumn[i]);
+                                                  state.preparedColumn[i]);
                 }
             }
         }
 
-        if (!pixelPeakColumn.empty()) {
+        if (pixelPeakColumn.empty()) return false;
 
-            for (int y = 0; y < h; ++y) {
-                int py;
-                if (m_params.invertVertical) {
-                    py = y;
-                } else {
-                    py = h - y - 1;
-                }
-                m_drawBuffer.setPixel
-                    (x,
-                     py,
-                     m_params.colourScale.getPixel(pixelPeakColumn[y]));
+        for (int y = 0; y < h; ++y) {
+            int py;
+            if (m_params.invertVertical) {
+                py = y;
+            } else {
+                py = h - y - 1;
             }
-            
-            m_magRanges.push_back(magRange);
-        }
-
-        double fractionComplete = double(xPixelCount) / double(w);
-        if (timer.outOfTime(fractionComplete)) {
-#ifdef DEBUG_COLOUR_PLOT_REPAINT
-            SVDEBUG << "render " << m_sources.source
-                    << ": out of time with xPixelCount = " << xPixelCount << endl;
-#endif
-            updateTimings(timer, xPixelCount);
-            return xPixelCount;
+            bits[py * bpl + x] = 
+                uchar(m_params.colourScale.getPixel(pixelPeakColumn[y]));
         }
-    }
 
+        return true;
+    };
+    
+    int xPixelCount = renderPixelColumns(w, rightToLeft, concurrent,
+                                         timer, renderer);
+    
     updateTimings(timer, xPixelCount);
 
 #ifdef DEBUG_COLOUR_PLOT_REPAINT
     SVDEBUG << "render " << m_sources.source
-            << ": completed with xPixelCount = " << xPixelCount << endl;
+            << ": rendered with xPixelCount = " << xPixelCount << endl;
 #endif
     return xPixelCount;
 }
@@ -1235,24 +1479,6 @@ Colour3DPlotRenderer::renderDrawBufferPeakFrequencies(const LayerGeometryProvide
     int nbins  = int(binfory[h-1]) - minbin + 1;
     if (minbin + nbins > sh) nbins = sh - minbin;
 
-    FFTModel::PeakSet peakfreqs;
-
-    int psx = -1;
-    
-    int start = 0;
-    int finish = w;
-    int step = 1;
-
-    if (rightToLeft) {
-        start = w-1;
-        finish = -1;
-        step = -1;
-    }
-    
-    int xPixelCount = 0;
-    
-    vector<float> preparedColumn;
-
     int modelWidth = fft->getWidth();
 #ifdef DEBUG_COLOUR_PLOT_REPAINT
     SVDEBUG << "render " << m_sources.source
@@ -1266,30 +1492,55 @@ Colour3DPlotRenderer::renderDrawBufferPeakFrequencies(const LayerGeometryProvide
 
     bool logarithmic = (m_params.binScale == BinScale::Log);
 
-#ifdef DEBUG_COLOUR_PLOT_REPAINT
-    SVDEBUG << "render " << m_sources.source
-            << ": start = " << start << ", finish = " << finish
-            << ", step = " << step << endl;
-#endif
+    bool concurrent = fft->supportsConcurrentReads();
+
+    // The view may not be used from the tile threads, so take the
+    // frequency-to-y mapping from it here. It is linear in frequency,
+    // or in log frequency, so the y coordinates of two reference
+    // frequencies are enough to reproduce it.
     
-    for (int x = start; x != finish; x += step) {
+    double f0 = minFreq, f1 = maxFreq;
+    if (logarithmic && f0 <= 0.0) {
+        f0 = double(fft->getSampleRate()) / fft->getFFTSize();
+    }
+    double y0 = v->getYForFrequency(f0, minFreq, maxFreq, logarithmic);
+    double y1 = v->getYForFrequency(f1, minFreq, maxFreq, logarithmic);
+    if (logarithmic) {
+        f0 = log10(f0);
+        f1 = (f1 > 0.0 ? log10(f1) : f0);
+    }
+    
+    auto yForFrequency = [=](double freq) -> double {
+        if (f1 == f0) return y0;
+        if (logarithmic) {
+            if (freq <= 0.0) return h;
+            freq = log10(freq);
+        }
+        return y0 + ((freq - f0) * (y1 - y0)) / (f1 - f0);
+    };
+
+    // As in renderDrawBuffer, write pixels directly so as to be safe
+    // when rendering concurrently
+    uchar *bits = m_drawBuffer.bits();
+    int bpl = m_drawBuffer.bytesPerLine();
+    
+    auto renderer = [&](int x, PixelColumnState &state,
+                        MagnitudeRange &magRange) -> bool {
         
         // x is the on-canvas pixel coord; sx (later) will be the
         // source column index
         
-        ++xPixelCount;
-        
-        if (binforx[x] < 0) continue;
+        if (binforx[x] < 0) return false;
 
         int sx0 = binforx[x];
         int sx1 = sx0;
         if (x+1 < w) sx1 = binforx[x+1];
         if (sx0 < 0) sx0 = sx1 - 1;
-        if (sx0 < 0) continue;
+        if (sx0 < 0) return false;
         if (sx1 <= sx0) sx1 = sx0 + 1;
 
         vector<float> pixelPeakColumn;
-        MagnitudeRange magRange;
+        FFTModel::PeakSet peakfreqs;
         
         for (int sx = sx0; sx < sx1; ++sx) {
 
@@ -1297,81 +1548,167 @@ Colour3DPlotRenderer::renderDrawBufferPeakFrequencies(const LayerGeometryProvide
                 continue;
             }
 
-            if (sx != psx) {
-                preparedColumn = getColumn(sx, minbin, nbins, fft);
-                magRange.sample(preparedColumn);
-                psx = sx;
+            if (sx != state.psx) {
+                state.preparedColumn = getColumn(sx, minbin, nbins, fft);
+                magRange.sample(state.preparedColumn);
+                state.psx = sx;
             }
 
             if (sx == sx0) {
-                pixelPeakColumn = preparedColumn;
+                pixelPeakColumn = state.preparedColumn;
                 peakfreqs = fft->getPeakFrequencies(FFTModel::AllPeaks, sx,
                                                     minbin, minbin + nbins - 1);
             } else {
                 for (int i = 0; in_range_for(pixelPeakColumn, i); ++i) {
                     pixelPeakColumn[i] = std::max(pixelPeakColumn[i],
-                                                  preparedColumn[i]);
+                                                  state.preparedColumn[i]);
                 }
             }
         }
 
-        if (!pixelPeakColumn.empty()) {
+        if (pixelPeakColumn.empty()) {
+#ifdef DEBUG_COLOUR_PLOT_REPAINT
+            SVDEBUG << "render " << m_sources.source
+                    << ": pixel peak column for range " << sx0 << " to " << sx1
+                    << " is empty" << endl;
+#endif
+            return false;
+        }
 
 #ifdef DEBUG_COLOUR_PLOT_REPAINT
-//            SVDEBUG << "found " << peakfreqs.size() << " peak freqs at column "
-//                    << sx0 << endl;
+//        SVDEBUG << "found " << peakfreqs.size() << " peak freqs at column "
+//                << sx0 << endl;
 #endif
 
-            for (FFTModel::PeakSet::const_iterator pi = peakfreqs.begin();
-                 pi != peakfreqs.end(); ++pi) {
+        for (FFTModel::PeakSet::const_iterator pi = peakfreqs.begin();
+             pi != peakfreqs.end(); ++pi) {
 
-                int bin = pi->first;
-                double freq = pi->second;
+            int bin = pi->first;
+            double freq = pi->second;
 
-                if (bin < minbin) continue;
-                if (bin >= minbin + nbins) break;
+            if (bin < minbin) continue;
+            if (bin >= minbin + nbins) break;
             
-                double value = pixelPeakColumn[bin - minbin];
+            double value = pixelPeakColumn[bin - minbin];
             
-                double y = v->getYForFrequency
-                    (freq, minFreq, maxFreq, logarithmic);
+            double y = yForFrequency(freq);
             
-                int iy = int(y + 0.5);
-                if (iy < 0 || iy >= h) continue;
+            int iy = int(y + 0.5);
+            if (iy < 0 || iy >= h) continue;
 
-                auto pixel = m_params.colourScale.getPixel(value);
+            auto pixel = m_params.colourScale.getPixel(value);
 
 #ifdef DEBUG_COLOUR_PLOT_REPAINT
-//                SVDEBUG << "frequency " << freq << " for bin " << bin
-//                        << " -> y = " << y << ", iy = " << iy << ", value = "
-//                        << value << ", pixel " << pixel << "\n";
+//            SVDEBUG << "frequency " << freq << " for bin " << bin
+//                    << " -> y = " << y << ", iy = " << iy << ", value = "
+//                    << value << ", pixel " << pixel << "\n";
 #endif
                 
-                m_drawBuffer.setPixel(x, iy, pixel);
-            }
+            bits[iy * bpl + x] = uchar(pixel);
+        }
+
+        return true;
+    };
+
+    int xPixelCount = renderPixelColumns(w, rightToLeft, concurrent,
+                                         timer, renderer);
 
-            m_magRanges.push_back(magRange);
+    updateTimings(timer, xPixelCount);
+    return xPixelCount;
+}
 
+int
+Colour3DPlotRenderer::renderPixelColumns(int w, bool rightToLeft,
+                                         bool concurrent,
+                                         RenderTimer &timer,
+                                         PixelColumnRenderer renderer)
+{
+    // Pixel columns are numbered here by position p in rendering
+    // order, which is mapped to x coordinate according to
+    // rightToLeft. Work is divided into tiles of consecutive pixel
+    // columns, and the tiles are rendered in batches of one per
+    // thread. The timer is consulted between batches, so the pixels
+    // completed when we run out of time are always contiguous from
+    // the start.
+    
+    int threads = 1;
+    int tileWidth = 1;
+
+    if (concurrent && !m_abandoned) {
+        threads = getRenderThreadPool()->maxThreadCount() + 1;
+        // aim for several batches across the width, so that there
+        // are still opportunities to stop if out of time
+        tileWidth = std::max(16, w / (threads * 4));
+        if (threads < 2 || tileWidth * 2 > w) {
+            threads = 1;
+            tileWidth = 1;
+        }
+    }
+
+    vector<MagnitudeRange> ranges(w);
+    vector<char> drawn(w, 0);
+
+    auto renderTile = [&](int p0, int p1, PixelColumnState &state) {
+        for (int p = p0; p < p1; ++p) {
+            int x = (rightToLeft ? w - p - 1 : p);
+            drawn[p] = renderer(x, state, ranges[p]);
+        }
+    };
+
+    PixelColumnState serialState;
+    
+    int xPixelCount = 0;
+
+    while (xPixelCount < w) {
+
+        int batchEnd = std::min(w, xPixelCount + threads * tileWidth);
+
+        if (threads == 1) {
+            renderTile(xPixelCount, batchEnd, serialState);
         } else {
-#ifdef DEBUG_COLOUR_PLOT_REPAINT
-            SVDEBUG << "render " << m_sources.source
-                    << ": pixel peak column for range " << sx0 << " to " << sx1
-                    << " is empty" << endl;
-#endif
+            vector<PixelColumnState> states(threads);
+            QSemaphore completed;
+            int dispatched = 0;
+            for (int i = 1; i < threads; ++i) {
+                int p0 = xPixelCount + i * tileWidth;
+                int p1 = std::min(batchEnd, p0 + tileWidth);
+                if (p0 >= p1) break;
+                getRenderThreadPool()->start
+                    (new TileTask([=, &renderTile, &states, &completed]() {
+                        renderTile(p0, p1, states[i]);
+                        completed.release();
+                    }));
+                ++dispatched;
+            }
+            renderTile(xPixelCount,
+                       std::min(batchEnd, xPixelCount + tileWidth),
+                       states[0]);
+            completed.acquire(dispatched);
+        }
+
+        for (int p = xPixelCount; p < batchEnd; ++p) {
+            if (drawn[p]) {
+                m_magRanges.push_back(ranges[p]);
+            }
+        }
+
+        xPixelCount = batchEnd;
+
+        if (m_abandoned && *m_abandoned) {
+            break;
         }
 
         double fractionComplete = double(xPixelCount) / double(w);
         if (timer.outOfTime(fractionComplete)) {
 #ifdef DEBUG_COLOUR_PLOT_REPAINT
             SVDEBUG << "render " << m_sources.source
-                    << ": out of time" << endl;
+                    << ": out of time with xPixelCount = " << xPixelCount
+                    << endl;
 #endif
-            updateTimings(timer, xPixelCount);
-            return xPixelCount;
+            break;
         }
     }
 
-    updateTimings(timer, xPixelCount);
     return xPixelCount;
 }
 
@@ -22,6 +22,7 @@
 
 #include "base/ColumnOp.h"
 #include "base/MagnitudeRange.h"
+#include "base/MemoryBudget.h"
 
 #include "data/model/Model.h"
 
@@ -29,6 +30,10 @@
 #include <QPainter>
 #include <QImage>
 
+#include <functional>
+#include <memory>
+#include <atomic>
+
 class LayerGeometryProvider;
 class VerticalBinLayer;
 class RenderTimer;
@@ -120,9 +125,21 @@ public:
         m_sources(sources),
         m_params(parameters),
         m_secondsPerXPixel(0.0),
-        m_secondsPerXPixelValid(false)
+        m_secondsPerXPixelValid(false),
+        m_abandoned(nullptr),
+        m_memoryAccount("Colour3DPlotRenderer image cache",
+                        MemoryBudget::Unevictable)
     { }
 
+    /**
+     * Wait for any prefetch in progress to be abandoned before
+     * returning.
+     */
+    ~Colour3DPlotRenderer();
+
+    Colour3DPlotRenderer(const Colour3DPlotRenderer &) = delete;
+    Colour3DPlotRenderer &operator=(const Colour3DPlotRenderer &) = delete;
+
     struct RenderResult {
         /**
          * The rect that was actually rendered. May be equal to the
@@ -198,6 +215,35 @@ public:
     RenderResult renderTimeConstrained(const LayerGeometryProvider *v,
                                        QPainter &paint, QRect rect);
 
+    /**
+     * Start rendering, on a low-priority background thread, the whole
+     * of the area that the given LayerGeometryProvider would show if
+     * it were scrolled to begin at the given start frame. A later
+     * render call for that area can then be drawn from the cache
+     * without waiting for the data. This is intended for use during
+     * playback, ahead of a view turning the page.
+     *
+     * Only one prefetch is retained at a time, and a request for a
+     * different start frame replaces any earlier one. The prefetched
+     * area is taken up by the first subsequent render call for which
+     * it is more complete than the existing cache.
+     *
+     * Prefetching only happens where the source models support
+     * concurrent reads and rendering would be at pixel resolution
+     * (i.e. zoomed out far enough that rendering may be slow). In
+     * other cases this does nothing.
+     */
+    void prefetch(const LayerGeometryProvider *v, sv_frame_t startFrame);
+
+    /**
+     * Note that the source data has changed between the given frames
+     * (which the caller should already have widened to include any
+     * frames whose rendering depends on the changed data). The part
+     * of the cache showing them is re-rendered at the next render
+     * call, while the rest of the cache goes on being used.
+     */
+    void invalidateFrames(sv_frame_t startFrame, sv_frame_t endFrame);
+
     /**
      * Return the area of the largest rectangle within the entire area
      * of the cache that is unavailable in the cache. This is only
@@ -281,6 +327,25 @@ private:
 
     double m_secondsPerXPixel;
     bool m_secondsPerXPixelValid;
+
+    // The prefetch in progress or completed, if any. Its renderer is
+    // used only by the prefetch thread until the prefetch is done.
+    struct Prefetch;
+    std::shared_ptr<Prefetch> m_prefetch;
+
+    // Set only in a renderer that is itself carrying out a
+    // prefetch. Rendering is then serial, and stops early if the flag
+    // pointed to becomes true.
+    const std::atomic<bool> *m_abandoned;
+
+    // Accounts for the image cache and draw buffer. These are used
+    // only from the rendering thread, so cannot be released on
+    // request from another
+    MemoryBudget::Account m_memoryAccount;
+
+    void takePrefetch(const LayerGeometryProvider *v);
+    void cancelPrefetch();
+    int getUsableCacheWidth(const LayerGeometryProvider *v) const;
     
     RenderResult render(const LayerGeometryProvider *v,
                         QPainter &paint, QRect rect, bool timeConstrained);
@@ -308,6 +373,34 @@ private:
                                         const std::vector<double> &binfory,
                                         bool rightToLeft,
                                         bool timeConstrained);
+
+    // Per-thread state retained from one pixel column to the next
+    // while rendering to the draw buffer, so that a source column
+    // spanning several pixels need only be prepared once
+    struct PixelColumnState {
+        PixelColumnState() : psx(-1) { }
+        int psx;
+        std::vector<float> preparedColumn;
+    };
+
+    // Render a single pixel column x of the draw buffer, returning
+    // true and setting the magnitude range if anything was drawn
+    typedef std::function<bool(int x, PixelColumnState &state,
+                               MagnitudeRange &range)> PixelColumnRenderer;
+
+    /**
+     * Call the given renderer for every pixel column of a draw
+     * buffer of width w, in the order given by rightToLeft, until
+     * done or the timer runs out. If concurrent is true, the work is
+     * divided into vertical tiles which are rendered simultaneously
+     * on a pool of threads, a batch at a time, so that progressive
+     * refinement continues to work as before. Magnitude ranges are
+     * appended to m_magRanges in rendering order. Return the number
+     * of pixel columns rendered.
+     */
+    int renderPixelColumns(int w, bool rightToLeft, bool concurrent,
+                           RenderTimer &timer,
+                           PixelColumnRenderer renderer);
     
     void recreateDrawBuffer(int w, int h);
     void clearDrawBuffer(int w, int h);
@@ -320,6 +413,8 @@ private:
 
     RenderType decideRenderType(const LayerGeometryProvider *) const;
 
+    void repairDamage(const LayerGeometryProvider *v, RenderType renderType);
+
     QImage scaleDrawBufferImage(QImage source, int targetWidth, int targetHeight)
         const;
     
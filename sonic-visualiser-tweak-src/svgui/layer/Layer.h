@@ -100,6 +100,17 @@ public:
      */
     virtual void paint(LayerGeometryProvider *, QPainter &, QRect) const = 0;   
 
+    /**
+     * Prepare, in the background if possible, to paint the whole of
+     * the given view as it would appear if it were scrolled to begin
+     * at the given start frame. This is called during playback ahead
+     * of a view turning the page, so that the page can be painted
+     * without delay when it arrives. Layers whose painting is cheap
+     * may ignore this, as the default implementation does.
+     */
+    virtual void prefetch(LayerGeometryProvider *,
+                          sv_frame_t /* startFrame */) const { }
+
     /**
      * Enable or disable synchronous painting.  If synchronous
      * painting is enabled, a call to paint() must complete painting
@@ -309,6 +320,22 @@ public:
      */
     virtual bool isLayerScrollable(const LayerGeometryProvider *) const { return true; }
 
+    /**
+     * Given the range of frames reported by a modelChangedWithin
+     * signal from this layer's model, widen it in place to cover all
+     * of the frames whose appearance in the layer may have changed as
+     * a result, and return true. A view that caches scrollable layers
+     * then needs to repaint only that part of its cache. Return false
+     * if the change may affect the whole layer, for example because
+     * it is normalised to the visible area. The default returns
+     * false, so that such views repaint layers completely unless a
+     * layer knows better.
+     */
+    virtual bool getDamagedExtents(sv_frame_t & /* startFrame */,
+                                   sv_frame_t & /* endFrame */) const {
+        return false;
+    }
+
     /**
      * This should return true if the layer completely obscures any
      * underlying layers.  It's used to determine whether the view can
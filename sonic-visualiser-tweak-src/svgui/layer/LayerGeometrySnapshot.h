@@ -0,0 +1,183 @@
+/* -*- c-basic-offset: 4 indent-tabs-mode: nil -*-  vi:set ts=8 sts=4 sw=4: */
+
+/*
+    Sonic Visualiser
+    An audio file viewer and annotation editor.
+    Centre for Digital Music, Queen Mary, University of London.
+
+    This program is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.  See the file
+    COPYING included with this distribution for more information.
+*/
+
+#ifndef SV_LAYER_GEOMETRY_SNAPSHOT_H
+#define SV_LAYER_GEOMETRY_SNAPSHOT_H
+
+#include "LayerGeometryProvider.h"
+
+#include <cmath>
+
+/**
+ * A LayerGeometryProvider that records the geometry of another one at
+ * the time of construction, as it would be if that provider were
+ * scrolled to start at a different frame. Nothing in the original
+ * provider is referred to afterwards, so a snapshot may be used to
+ * render on a thread other than the GUI thread, for example to
+ * prepare a page of a view before it is scrolled into sight.
+ *
+ * Only the FramesPerPixel zoom zone is supported, and the start frame
+ * should be on a zoom-level boundary (as it always is for a View in
+ * that zone). Feature illumination, measurement and other interactive
+ * properties are reported as absent.
+ */
+class LayerGeometrySnapshot : public LayerGeometryProvider
+{
+public:
+    LayerGeometrySnapshot(const LayerGeometryProvider *v,
+                          sv_frame_t startFrame) :
+        m_id(v->getId()),
+        m_startFrame(startFrame),
+        m_zoomLevel(v->getZoomLevel()),
+        m_paintRect(v->getPaintRect()),
+        m_modelsStartFrame(v->getModelsStartFrame()),
+        m_modelsEndFrame(v->getModelsEndFrame()),
+        m_lightBackground(v->hasLightBackground()),
+        m_foreground(v->getForeground()),
+        m_background(v->getBackground()),
+        m_viewManager(v->getViewManager()),
+        m_view(const_cast<LayerGeometryProvider *>(v)->getView())
+    { }
+
+    int getId() const override {
+        return m_id;
+    }
+    sv_frame_t getStartFrame() const override {
+        return m_startFrame;
+    }
+    sv_frame_t getCentreFrame() const override {
+        return getFrameForX(m_paintRect.width() / 2);
+    }
+    sv_frame_t getEndFrame() const override {
+        return getFrameForX(m_paintRect.width()) - 1;
+    }
+    int getXForFrame(sv_frame_t frame) const override {
+        sv_frame_t level = m_zoomLevel.level;
+        sv_frame_t fdiff = frame - m_startFrame;
+        sv_frame_t x = fdiff / level;
+        if ((fdiff < 0) && ((fdiff % level) != 0)) {
+            --x; // round to the left, as View does
+        }
+        return int(x);
+    }
+    sv_frame_t getFrameForX(int x) const override {
+        return m_startFrame + x * sv_frame_t(m_zoomLevel.level);
+    }
+    int getXForViewX(int viewx) const override {
+        return viewx;
+    }
+    int getViewXForX(int x) const override {
+        return x;
+    }
+    sv_frame_t getModelsStartFrame() const override {
+        return m_modelsStartFrame;
+    }
+    sv_frame_t getModelsEndFrame() const override {
+        return m_modelsEndFrame;
+    }
+    double getYForFrequency(double frequency,
+                            double minFreq, double maxFreq,
+                            bool logarithmic) const override {
+        // As View::getYForFrequency, but without its static caches
+        double h = m_paintRect.height();
+        if (logarithmic) {
+            double logminf = log10(minFreq), logmaxf = log10(maxFreq);
+            if (logminf == logmaxf) return 0;
+            return h - (h * (log10(frequency) - logminf)) / (logmaxf - logminf);
+        } else {
+            if (minFreq == maxFreq) return 0;
+            return h - (h * (frequency - minFreq)) / (maxFreq - minFreq);
+        }
+    }
+    double getFrequencyForY(double y, double minFreq, double maxFreq,
+                            bool logarithmic) const override {
+        double h = m_paintRect.height();
+        if (logarithmic) {
+            double logminf = log10(minFreq), logmaxf = log10(maxFreq);
+            if (logminf == logmaxf) return 0;
+            return pow(10.0, logminf + ((logmaxf - logminf) * (h - y)) / h);
+        } else {
+            if (minFreq == maxFreq) return 0;
+            return minFreq + ((h - y) * (maxFreq - minFreq)) / h;
+        }
+    }
+    int getTextLabelYCoord(const Layer *, QPainter &) const override {
+        return 0;
+    }
+    bool getVisibleExtentsForUnit(QString, double &, double &,
+                                  bool &) const override {
+        return false;
+    }
+    ZoomLevel getZoomLevel() const override {
+        return m_zoomLevel;
+    }
+    QRect getPaintRect() const override {
+        return m_paintRect;
+    }
+    bool hasLightBackground() const override {
+        return m_lightBackground;
+    }
+    QColor getForeground() const override {
+        return m_foreground;
+    }
+    QColor getBackground() const override {
+        return m_background;
+    }
+    ViewManager *getViewManager() const override {
+        return m_viewManager;
+    }
+    bool shouldIlluminateLocalFeatures(const Layer *, QPoint &) const override {
+        return false;
+    }
+    bool shouldShowFeatureLabels() const override {
+        return false;
+    }
+    void drawMeasurementRect(QPainter &, const Layer *,
+                             QRect, bool) const override {
+    }
+    void updatePaintRect(QRect) override {
+    }
+    double scaleSize(double size) const override {
+        return size;
+    }
+    int scalePixelSize(int size) const override {
+        return size;
+    }
+    double scalePenWidth(double width) const override {
+        return width;
+    }
+    QPen scalePen(QPen pen) const override {
+        return pen;
+    }
+
+    // The view is not safe to use from another thread, but callers
+    // may still compare it by identity
+    View *getView() override { return m_view; }
+    const View *getView() const override { return m_view; }
+
+private:
+    int m_id;
+    sv_frame_t m_startFrame;
+    ZoomLevel m_zoomLevel;
+    QRect m_paintRect;
+    sv_frame_t m_modelsStartFrame;
+    sv_frame_t m_modelsEndFrame;
+    bool m_lightBackground;
+    QColor m_foreground;
+    QColor m_background;
+    ViewManager *m_viewManager;
+    View *m_view;
+};
+
+#endif
@@ -17,6 +17,7 @@
 #include "base/HitCount.h"
 
 #include <iostream>
+#include <algorithm>
 using namespace std;
 
 //#define DEBUG_SCROLLABLE_IMAGE_CACHE 1
@@ -139,6 +140,59 @@ ScrollableImageCache::adjustToTouchValidArea(int &left, int &width,
     }
 }
     
+void
+ScrollableImageCache::damage(sv_frame_t startFrame, sv_frame_t endFrame)
+{
+    if (!isValid()) return;
+
+    if (endFrame < startFrame) {
+        std::swap(startFrame, endFrame);
+    }
+    
+    if (m_damaged) {
+        m_damageStart = std::min(m_damageStart, startFrame);
+        m_damageEnd = std::max(m_damageEnd, endFrame);
+    } else {
+        m_damageStart = startFrame;
+        m_damageEnd = endFrame;
+        m_damaged = true;
+    }
+
+#ifdef DEBUG_SCROLLABLE_IMAGE_CACHE
+    cerr << "ScrollableImageCache::damage: damaged range now "
+         << m_damageStart << " -> " << m_damageEnd << endl;
+#endif
+}
+
+QRect
+ScrollableImageCache::getDamagedArea(const LayerGeometryProvider *v) const
+{
+    if (!m_damaged || !isValid()) {
+        return QRect();
+    }
+
+    // Clamp to the cache extents before asking for x coordinates, as
+    // a view complains about frames far outside its own range
+    sv_frame_t endOfCache = v->getFrameForX(m_image.width());
+    sv_frame_t f0 = std::max(m_damageStart, m_startFrame);
+    sv_frame_t f1 = std::min(m_damageEnd, endOfCache);
+    if (f1 < f0) {
+        return QRect();
+    }
+
+    int origin = v->getXForFrame(m_startFrame);
+    int x0 = v->getXForFrame(f0) - origin;
+    int x1 = v->getXForFrame(f1) - origin + 1;
+
+    x0 = std::max(x0, m_validLeft);
+    x1 = std::min(x1, m_validLeft + m_validWidth);
+    if (x1 <= x0) {
+        return QRect();
+    }
+
+    return QRect(x0, 0, x1 - x0, m_image.height());
+}
+
 void
 ScrollableImageCache::drawImage(int left,
                                 int width,
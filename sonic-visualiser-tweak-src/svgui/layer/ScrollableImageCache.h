@@ -40,11 +40,15 @@ public:
     ScrollableImageCache() :
         m_validLeft(0),
         m_validWidth(0),
-        m_startFrame(0)
+        m_startFrame(0),
+        m_damaged(false),
+        m_damageStart(0),
+        m_damageEnd(0)
     {}
 
     void invalidate() {
         m_validWidth = 0;
+        m_damaged = false;
     }
     
     bool isValid() const {
@@ -139,6 +143,33 @@ public:
     void adjustToTouchValidArea(int &left, int &width,
                                 bool &isLeftOfValidArea) const;
     
+    /**
+     * Mark the part of the cache that shows the given range of
+     * frames as out of date, for example because the underlying data
+     * has changed there. The damaged part remains within the valid
+     * area, so that the rest of the cache can go on being used, and
+     * it is up to the caller to redraw it and then call
+     * clearDamage(). Successive calls accumulate, the damage being
+     * the extent of all the ranges given.
+     */
+    void damage(sv_frame_t startFrame, sv_frame_t endFrame);
+
+    bool isDamaged() const {
+        return m_damaged;
+    }
+
+    /**
+     * Return the part of the valid area that shows damaged frames,
+     * according to the geometry of the supplied
+     * LayerGeometryProvider, or an empty QRect if there is none. The
+     * provider is expected to start at the same pixel as the cache.
+     */
+    QRect getDamagedArea(const LayerGeometryProvider *v) const;
+
+    void clearDamage() {
+        m_damaged = false;
+    }
+    
     /**
      * Draw from an image onto the cache. The supplied image must have
      * the same height as the cache and the full height is always
@@ -158,6 +189,9 @@ private:
     int m_validWidth;
     sv_frame_t m_startFrame;
     ZoomLevel m_zoomLevel;
+    bool m_damaged;
+    sv_frame_t m_damageStart;
+    sv_frame_t m_damageEnd;
 };
 
 #endif
@@ -26,6 +26,8 @@
 
 #include "base/Profiler.h"
 
+#include "data/model/Dense3DModelRangeIndex.h"
+
 #include <QPainter>
 #include <QPainterPath>
 #include <QTextStream>
@@ -66,6 +68,7 @@ SliceLayer::setSliceableModel(ModelId modelId)
 
     if (m_sliceableModel == modelId) return;
     m_sliceableModel = modelId;
+    m_rangeIndex.reset();
 
     if (newModel) {
         connectSignals(m_sliceableModel);
@@ -500,19 +503,49 @@ SliceLayer::paint(LayerGeometryProvider *v, QPainter &paint, QRect rect) const
     getBiasCurve(curve);
     int cs = int(curve.size());
 
-    for (int col = col0; col <= col1; ++col) {
+    if (col1 > col0) {
+
+        // The mean or peak across a range of columns comes from the
+        // range index, at a cost that does not depend on the width
+        // of the range. The bias curve is a per-bin scale factor, so
+        // it can be applied after aggregation.
+        
+        if (!m_rangeIndex) {
+            m_rangeIndex.reset(new Dense3DModelRangeIndex(m_sliceableModel));
+        }
+        
         DenseThreeDimensionalModel::Column column =
-            sliceableModel->getColumn(col);
-        for (int bin = 0; bin < mh; ++bin) {
+            (m_samplingMode == SamplePeak ?
+             m_rangeIndex->getPeakColumn(col0, col1) :
+             m_rangeIndex->getMeanColumn(col0, col1));
+        
+        for (int bin = 0; bin < mh && bin0 + bin < int(column.size()); ++bin) {
             float value = column[bin0 + bin];
             if (bin < cs) value *= curve[bin];
             if (m_samplingMode == SamplePeak) {
                 if (value > m_values[bin]) m_values[bin] = value;
             } else {
-                m_values[bin] += value;
+                m_values[bin] = value;
+            }
+        }
+        divisor = 1; // already averaged
+
+    } else {
+    
+        for (int col = col0; col <= col1; ++col) {
+            DenseThreeDimensionalModel::Column column =
+                sliceableModel->getColumn(col);
+            for (int bin = 0; bin < mh; ++bin) {
+                float value = column[bin0 + bin];
+                if (bin < cs) value *= curve[bin];
+                if (m_samplingMode == SamplePeak) {
+                    if (value > m_values[bin]) m_values[bin] = value;
+                } else {
+                    m_values[bin] += value;
+                }
             }
+            ++divisor;
         }
-        ++divisor;
     }
 
     float max = 0.0;
@@ -24,6 +24,10 @@
 
 #include <QColor>
 
+#include <memory>
+
+class Dense3DModelRangeIndex;
+
 class SliceLayer : public SingleColourLayer
 {
     Q_OBJECT
@@ -192,6 +196,7 @@ protected:
     mutable sv_frame_t          m_currentf0;
     mutable sv_frame_t          m_currentf1;
     mutable std::vector<float>  m_values;
+    mutable std::unique_ptr<Dense3DModelRangeIndex> m_rangeIndex; // for mean & peak
 };
 
 #endif
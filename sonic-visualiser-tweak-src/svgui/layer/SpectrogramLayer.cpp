@@ -25,7 +25,7 @@
 #include "base/LogRange.h"
 #include "base/ColumnOp.h"
 #include "base/Strings.h"
-#include "base/StorageAdviser.h"
+#include "base/MemoryBudget.h"
 #include "base/Exceptions.h"
 #include "widgets/CommandHistory.h"
 #include "data/model/Dense3DModelPeakCache.h"
@@ -1088,27 +1088,42 @@ SpectrogramLayer::cacheInvalid(ModelId)
 }
 
 void
-SpectrogramLayer::cacheInvalid(
-    ModelId,
-#ifdef DEBUG_SPECTROGRAM_REPAINT
-    sv_frame_t from, sv_frame_t to
-#else 
-    sv_frame_t     , sv_frame_t
-#endif
-    )
+SpectrogramLayer::cacheInvalid(ModelId, sv_frame_t from, sv_frame_t to)
 {
 #ifdef DEBUG_SPECTROGRAM_REPAINT
     cerr << "SpectrogramLayer::cacheInvalid(" << from << ", " << to << ")" << endl;
 #endif
 
-    // We used to call invalidateMagnitudes(from, to) to invalidate
-    // only those caches whose views contained some of the (from, to)
-    // range. That's the right thing to do; it has been lost in
-    // pulling out the image cache code, but it might not matter very
-    // much, since the underlying models for spectrogram layers don't
-    // change very often. Let's see.
-    invalidateRenderers();
-    invalidateMagnitudes();
+    // Only the columns of each renderer's cache that show the
+    // affected frames need to be rendered again, unless we are
+    // normalising to the visible area, in which case a change
+    // anywhere may alter the colour of everything
+    if (!getDamagedExtents(from, to)) {
+        invalidateRenderers();
+        invalidateMagnitudes();
+        return;
+    }
+
+    for (ViewRendererMap::iterator i = m_renderers.begin();
+         i != m_renderers.end(); ++i) {
+        i->second->invalidateFrames(from, to);
+    }
+}
+
+bool
+SpectrogramLayer::getDamagedExtents(sv_frame_t &startFrame,
+                                    sv_frame_t &endFrame) const
+{
+    if (m_normalizeVisibleArea) {
+        return false;
+    }
+
+    // Every column whose window overlaps the changed range is
+    // affected
+    sv_frame_t margin = getWindowSize();
+    startFrame -= margin;
+    endFrame += margin;
+    return true;
 }
 
 bool
@@ -1440,6 +1455,8 @@ SpectrogramLayer::recreateFFTModel()
     if (m_verticallyFixed) {
         newFFTModel->setMaximumFrequency(getMaxFrequency());
     }
+
+    newFFTModel->enableColumnStore();
     
     m_fftModel = ModelById::add(newFFTModel);
 
@@ -1478,30 +1495,21 @@ SpectrogramLayer::checkCacheSpace(int *suggestedPeakDivisor,
         size_t(fftModel->getHeight()) *
         sizeof(float);
 
-    try {
-        SVDEBUG << "Requesting advice from StorageAdviser on whether to create whole-model cache" << endl;
-        // The lower amount here is the amount required for the
-        // slightly higher-resolution version of the peak cache
-        // without a whole-model cache; the higher amount is that for
-        // the whole-model cache. The factors of 1024 are because
-        // StorageAdviser rather stupidly works in kilobytes
-        StorageAdviser::Recommendation recommendation =
-            StorageAdviser::recommend
-            (StorageAdviser::Criteria(StorageAdviser::SpeedCritical |
-                                      StorageAdviser::PrecisionCritical |
-                                      StorageAdviser::FrequentLookupLikely),
-             (sz / 8) / 1024, sz / 1024);
-        if (recommendation & StorageAdviser::UseDisc) {
-            SVDEBUG << "Seems inadvisable to create whole-model cache" << endl;
-        } else if (recommendation & StorageAdviser::ConserveSpace) {
-            SVDEBUG << "Seems inadvisable to create whole-model cache but acceptable to use the slightly higher-resolution peak cache" << endl;
-            *suggestedPeakDivisor = 4;
-        } else  {
-            SVDEBUG << "Seems fine to create whole-model cache" << endl;
-            *createWholeCache = true;
-        }
-    } catch (const InsufficientDiscSpace &) {
-        SVDEBUG << "Seems like a terrible idea to create whole-model cache" << endl;
+    // The lower amount here is the amount required for the slightly
+    // higher-resolution version of the peak cache without a
+    // whole-model cache; the higher amount is that for the
+    // whole-model cache. Both are accounted with the memory budget
+    // as they fill, and may be released again if space runs short,
+    // so we need only ask whether they could fit at all
+    MemoryBudget *budget = MemoryBudget::getInstance();
+    if (budget->canAccommodate(sz)) {
+        SVDEBUG << "Seems fine to create whole-model cache" << endl;
+        *createWholeCache = true;
+    } else if (budget->canAccommodate(sz / 8)) {
+        SVDEBUG << "Seems inadvisable to create whole-model cache but acceptable to use the slightly higher-resolution peak cache" << endl;
+        *suggestedPeakDivisor = 4;
+    } else {
+        SVDEBUG << "Seems inadvisable to create whole-model cache" << endl;
     }
 }
 
@@ -1684,6 +1692,19 @@ SpectrogramLayer::paint(LayerGeometryProvider *v, QPainter &paint, QRect rect) c
     illuminateLocalFeatures(v, paint);
 }
 
+void
+SpectrogramLayer::prefetch(LayerGeometryProvider *v, sv_frame_t startFrame) const
+{
+    if (m_synchronous) return;
+
+    auto model = ModelById::getAs<DenseTimeValueModel>(m_model);
+    if (!model || !model->isOK() || !model->isReady()) {
+        return;
+    }
+
+    getRenderer(v)->prefetch(v, startFrame);
+}
+
 void
 SpectrogramLayer::illuminateLocalFeatures(LayerGeometryProvider *v, QPainter &paint) const
 {
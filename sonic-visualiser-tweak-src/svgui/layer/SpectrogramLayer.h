@@ -66,6 +66,7 @@ public:
     const ZoomConstraint *getZoomConstraint() const override { return this; }
     ModelId getModel() const override { return m_model; }
     void paint(LayerGeometryProvider *v, QPainter &paint, QRect rect) const override;
+    void prefetch(LayerGeometryProvider *v, sv_frame_t startFrame) const override;
     void setSynchronousPainting(bool synchronous) override;
 
     int getVerticalScaleWidth(LayerGeometryProvider *v, bool detailed, QPainter &) const override;
@@ -247,6 +248,9 @@ public:
 
     bool isLayerScrollable(const LayerGeometryProvider *) const override;
 
+    bool getDamagedExtents(sv_frame_t &startFrame,
+                           sv_frame_t &endFrame) const override;
+
     int getVerticalZoomSteps(int &defaultStep) const override;
     int getCurrentVerticalZoomStep() const override;
     void setVerticalZoomStep(int) override;
@@ -491,6 +491,22 @@ WaveformLayer::isLayerScrollable(const LayerGeometryProvider *) const
     return !m_autoNormalize;
 }
 
+bool
+WaveformLayer::getDamagedExtents(sv_frame_t &startFrame,
+                                 sv_frame_t &endFrame) const
+{
+    if (m_autoNormalize || m_aggressive) {
+        return false; // the aggressive cache has no partial update
+    }
+
+    // Oversampling when zoomed in reads a short filter tail either
+    // side of each pixel (see getOversampledRanges)
+    sv_frame_t tail = 16;
+    startFrame -= tail;
+    endFrame += tail;
+    return true;
+}
+
 static float meterdbs[] = { -40, -30, -20, -15, -10,
                             -5, -3, -2, -1, -0.5, 0 };
 
@@ -169,6 +169,9 @@ public:
 
     bool isLayerScrollable(const LayerGeometryProvider *) const override;
 
+    bool getDamagedExtents(sv_frame_t &startFrame,
+                           sv_frame_t &endFrame) const override;
+
     int getCompletion(LayerGeometryProvider *) const override;
 
     bool getValueExtents(double &min, double &max,
@@ -69,6 +69,9 @@ View::View(QWidget *w, bool showProgress) :
     m_cacheValid(false),
     m_cacheCentreFrame(0),
     m_cacheZoomLevel(ZoomLevel::FramesPerPixel, 1024),
+    m_cacheDamaged(false),
+    m_cacheDamageStart(0),
+    m_cacheDamageEnd(0),
     m_selectionCached(false),
     m_deleting(false),
     m_haveSelectedLayer(false),
@@ -1108,22 +1111,43 @@ View::modelChanged(ModelId modelId)
 #endif
 
     // If the model that has changed is not used by any of the cached
-    // layers, we won't need to recreate the cache
+    // layers, we won't need to recreate the cache. If it is, we may
+    // only need to repaint the part of the cache that shows the
+    // changed frames, as widened by each layer that uses the model
     
     bool recreate = false;
+    bool damaged = false;
+    sv_frame_t damageStart = startFrame, damageEnd = endFrame;
 
     bool discard;
     LayerList scrollables = getScrollableBackLayers(false, discard);
     for (LayerList::const_iterator i = scrollables.begin();
          i != scrollables.end(); ++i) {
-        if ((*i)->getModel() == modelId) {
+        if ((*i)->getModel() != modelId) {
+            continue;
+        }
+        sv_frame_t f0 = startFrame, f1 = endFrame;
+        if (m_useAligningProxy || // layer frames may not be our frames
+            !(*i)->getDamagedExtents(f0, f1)) {
             recreate = true;
             break;
         }
+        if (!damaged || f0 < damageStart) damageStart = f0;
+        if (!damaged || f1 > damageEnd) damageEnd = f1;
+        damaged = true;
     }
 
     if (recreate) {
         m_cacheValid = false;
+    } else if (damaged) {
+        if (m_cacheDamaged) {
+            m_cacheDamageStart = std::min(m_cacheDamageStart, damageStart);
+            m_cacheDamageEnd = std::max(m_cacheDamageEnd, damageEnd);
+        } else {
+            m_cacheDamageStart = damageStart;
+            m_cacheDamageEnd = damageEnd;
+            m_cacheDamaged = true;
+        }
     }
 
     emit layerModelChanged();
@@ -1396,6 +1420,10 @@ View::movePlayPointer(sv_frame_t newFrame)
             }
 
             update(xnew - 4, 0, 9, height());
+
+            if (!somethingGoingOn) {
+                prefetchNextPage();
+            }
         }
         break;
 
@@ -1408,6 +1436,73 @@ View::movePlayPointer(sv_frame_t newFrame)
     }
 }
 
+void
+View::prefetchNextPage()
+{
+    // Work out where the next page turn will take us, using the same
+    // sums as movePlayPointer, and ask the layers to prepare it in
+    // the background if the turn is coming up soon
+    
+    if (!m_manager || !m_manager->isPlaying() || m_followPlayIsDetached) {
+        return;
+    }
+    if (m_zoomLevel.zone != ZoomLevel::FramesPerPixel) {
+        return;
+    }
+    if (m_useAligningProxy) {
+        // aligned layers are painted through a proxy whose geometry
+        // we can't anticipate so simply
+        return;
+    }
+
+    sv_frame_t w = getEndFrame() - getStartFrame();
+    w -= w/5;
+    if (w <= 0) return;
+
+    sv_frame_t turnFrame = getFrameForX((width() * 7) / 8 + 1);
+    if (turnFrame <= m_playPointerFrame) return;
+
+    // The play pointer frame is in terms of the main model, as is the
+    // playback rate, and the playback speed tells us how fast it is
+    // really moving
+    double rate = m_manager->getMainModelSampleRate();
+    double speed = m_manager->getPlaybackSpeed();
+    if (rate <= 0.0 || speed <= 0.0) return;
+
+    // Allow a few times as long as a page could reasonably take to
+    // render. Starting much earlier would waste the work if the user
+    // stops or moves elsewhere first.
+    const double leadTime = 4.0; // seconds
+    double secondsToTurn =
+        double(turnFrame - m_playPointerFrame) / (rate * speed);
+    if (secondsToTurn > leadTime) return;
+
+    sv_frame_t sf = (turnFrame / w) * w - w/8;
+    sv_frame_t offset = getFrameForX(width()/2) - getStartFrame();
+    sv_frame_t centre = sf + offset;
+    sv_frame_t level = m_zoomLevel.level;
+    sv_frame_t startFrame = (centre / level) * level - (width()/2) * level;
+
+    if (startFrame + w < getModelsStartFrame() ||
+        startFrame > getModelsEndFrame()) {
+        return;
+    }
+
+#ifdef DEBUG_VIEW
+    SVCERR << "View[" << getId() << "]::prefetchNextPage: turn expected at "
+           << turnFrame << " in " << secondsToTurn << " sec, to start frame "
+           << startFrame << endl;
+#endif
+
+    ViewProxy proxy(this, effectiveDevicePixelRatio());
+
+    bool changed = false;
+    LayerList scrollables = getScrollableBackLayers(false, changed);
+    for (Layer *layer : scrollables) {
+        layer->prefetch(&proxy, startFrame);
+    }
+}
+
 void
 View::viewZoomLevelChanged(View *p, ZoomLevel z, bool locked)
 {
@@ -2309,6 +2404,24 @@ View::paintEvent(QPaintEvent *e)
     
     static HitCount count("View cache");
 
+    // The area of the cache showing frames that have changed since
+    // it was painted, if any. This is found before any scrolling, but
+    // at the current centre frame, i.e. where those frames will be
+    // after scrolling.
+    QRect damagedArea;
+    if (m_cacheDamaged) {
+        sv_frame_t f0 = std::max(m_cacheDamageStart, getStartFrame());
+        sv_frame_t f1 = std::min(m_cacheDamageEnd, getEndFrame());
+        if (f0 <= f1) {
+            int margin = 2; // for any rounding in the layers
+            int x0 = dpratio * (getXForFrame(f0) - margin);
+            int x1 = dpratio * (getXForFrame(f1) + 1 + margin);
+            damagedArea = QRect(x0, 0, x1 - x0, wholeSize.height()) &
+                wholeArea;
+        }
+        m_cacheDamaged = false;
+    }
+
     if (!scrollables.empty()) {
 
         shouldUseCache = true;
@@ -2374,6 +2487,10 @@ View::paintEvent(QPaintEvent *e)
                         QRect(0, 0, dx, m_cache->height());
                 }
 
+                if (!damagedArea.isEmpty()) {
+                    cacheAreaToRepaint |= damagedArea;
+                }
+
                 count.partial();
 
 #ifdef DEBUG_VIEW_WIDGET_PAINT
@@ -2390,8 +2507,16 @@ View::paintEvent(QPaintEvent *e)
 #ifdef DEBUG_VIEW_WIDGET_PAINT
             SVCERR << "View[" << getId() << "]::paintEvent: cache is good" << endl;
 #endif
-            count.hit();
-            shouldRepaintCache = false;
+            if (damagedArea.isEmpty()) {
+                count.hit();
+                shouldRepaintCache = false;
+            } else {
+#ifdef DEBUG_VIEW_WIDGET_PAINT
+                SVCERR << "View[" << getId() << "]::paintEvent: but damaged from x " << damagedArea.x() << " to " << damagedArea.x() + damagedArea.width() << endl;
+#endif
+                count.partial();
+                cacheAreaToRepaint = damagedArea;
+            }
         }
     }
 
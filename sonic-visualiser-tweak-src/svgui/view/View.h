@@ -527,6 +527,7 @@ protected:
     bool setCentreFrame(sv_frame_t f, bool doEmit);
 
     void movePlayPointer(sv_frame_t f);
+    void prefetchNextPage();
 
     void checkProgress(ModelId);
     void checkAlignmentProgress(ModelId);
@@ -550,6 +551,9 @@ protected:
     bool                m_cacheValid;
     sv_frame_t          m_cacheCentreFrame;
     ZoomLevel           m_cacheZoomLevel;
+    bool                m_cacheDamaged; // valid but for the range below
+    sv_frame_t          m_cacheDamageStart;
+    sv_frame_t          m_cacheDamageEnd;
     bool                m_selectionCached;
 
     bool                m_deleting;
@@ -522,6 +522,15 @@ ViewManager::getDeviceSampleRate() const
     return 0;
 }
 
+double
+ViewManager::getPlaybackSpeed() const
+{
+    if (m_playSource) {
+        return m_playSource->getPlaySpeed();
+    }
+    return 1.0;
+}
+
 void
 ViewManager::setAudioPlaySource(AudioPlaySource *source)
 {
@@ -182,6 +182,12 @@ public:
      */
     sv_samplerate_t getDeviceSampleRate() const;
 
+    /**
+     * The speed at which playback proceeds, as a multiple of normal
+     * speed.
+     */
+    double getPlaybackSpeed() const;
+
     /**
      * The sample rate of the current main model.  This may in theory
      * differ from the playback sample rate, in which case even the